@@ -53,7 +53,8 @@ PRODUCT_PACKAGES += \
 # USB HAL (AIDL)
 PRODUCT_PACKAGES += \
     android.hardware.usb-service.rpi5 \
-    android.hardware.usb.gadget-service.rpi5
+    android.hardware.usb.gadget-service.rpi5 \
+    uvc_webcam.rpi5
 
 # Audio HAL (AIDL)
 PRODUCT_PACKAGES += \
@@ -134,6 +135,11 @@ PRODUCT_PACKAGES += \
 PRODUCT_PACKAGES += \
     android.hardware.thermal-service.rpi5
 
+# Neural Networks HAL (AIDL)
+PRODUCT_PACKAGES += \
+    android.hardware.neuralnetworks-service.rpi5 \
+    libbrcm_camera_npu
+
 # Light HAL (AIDL)
 PRODUCT_PACKAGES += \
     android.hardware.light-service.rpi5
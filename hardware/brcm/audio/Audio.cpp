@@ -4,10 +4,18 @@
 #define LOG_TAG "AudioHAL"
 
 #include <android-base/logging.h>
+#include <android-base/properties.h>
 #include <hardware/audio.h>
 #include <hardware/hardware.h>
 #include <system/audio.h>
 #include <tinyalsa/asoundlib.h>
+#include <algorithm>
+#include <climits>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include "Audio.h"
 #include "AudioDevice.h"
 
@@ -23,62 +31,312 @@ static const int DEFAULT_CHANNELS = 2;
 static const int DEFAULT_PERIOD_SIZE = 1024;
 static const int DEFAULT_PERIOD_COUNT = 4;
 
+// Low-latency profile for AUDIO_OUTPUT_FLAG_FAST/RAW and AUDIO_INPUT_FLAG_FAST
+// streams: 192 frames is 4 ms at 48 kHz, two periods keep ~8 ms in flight.
+static const int LOW_LATENCY_PERIOD_SIZE = 192;
+static const int LOW_LATENCY_PERIOD_COUNT = 2;
+static const int MIN_LOW_LATENCY_PERIOD_SIZE = 48;
+static const int MAX_LOW_LATENCY_PERIOD_SIZE = 512;
+static const char* LOW_LATENCY_PERIOD_PROP = "ro.vendor.audio.low_latency_period_size";
+
+// MMAP_NOIRQ streams: the burst is the client's wakeup granularity and the
+// buffer is sized from the client's request, at least two bursts deep.
+static const int MMAP_MIN_PERIOD_COUNT = 2;
+static const int MMAP_MAX_PERIOD_COUNT = 64;
+
+// Same priority AudioFlinger gives its FastMixer/FastCapture threads
+static const int FAST_THREAD_PRIORITY = 3;
+
+static unsigned int getLowLatencyPeriodSize() {
+    unsigned int periodSize = android::base::GetUintProperty<unsigned int>(
+            LOW_LATENCY_PERIOD_PROP, LOW_LATENCY_PERIOD_SIZE, MAX_LOW_LATENCY_PERIOD_SIZE);
+    return std::max<unsigned int>(periodSize, MIN_LOW_LATENCY_PERIOD_SIZE);
+}
+
+// Opens the PCM in mmap mode when requested, falling back to read/write
+// transfers if the driver does not support it. Clears *mmap on fallback.
+static struct pcm* openPcm(int card, int device, unsigned int flags,
+                           struct pcm_config* config, bool* mmap) {
+    if (*mmap) {
+        struct pcm* pcm = pcm_open(card, device, flags | PCM_MMAP, config);
+        if (pcm_is_ready(pcm)) {
+            return pcm;
+        }
+        LOG(WARNING) << "MMAP open failed on card " << card << " device " << device
+                     << ": " << pcm_get_error(pcm) << ", using read/write transfers";
+        pcm_close(pcm);
+        *mmap = false;
+    }
+    return pcm_open(card, device, flags, config);
+}
+
+// Opens the PCM in MMAP_NOIRQ mode and describes its DMA buffer to the client.
+// The HAL never transfers data on these streams, so xrun detection is disabled
+// and the application pointer is advanced by one burst to prime the buffer.
+static int openMmapPcm(int card, int device, unsigned int flags, struct pcm_config* config,
+                       int32_t minSizeFrames, struct pcm** pcmOut,
+                       struct audio_mmap_buffer_info* info) {
+    if (minSizeFrames <= 0 || info == nullptr) {
+        return -EINVAL;
+    }
+
+    unsigned int burst = config->period_size;
+    unsigned int periodCount = (minSizeFrames + burst - 1) / burst;
+    config->period_count = std::clamp<unsigned int>(periodCount, MMAP_MIN_PERIOD_COUNT,
+                                                    MMAP_MAX_PERIOD_COUNT);
+    config->start_threshold = 0;
+    config->stop_threshold = INT_MAX;
+    config->silence_threshold = 0;
+    config->silence_size = 0;
+    config->avail_min = burst;
+
+    struct pcm* pcm = pcm_open(card, device, flags | PCM_MMAP | PCM_NOIRQ | PCM_MONOTONIC,
+                               config);
+    if (!pcm_is_ready(pcm)) {
+        LOG(ERROR) << "MMAP_NOIRQ open failed on card " << card << " device " << device
+                   << ": " << pcm_get_error(pcm);
+        pcm_close(pcm);
+        return -ENODEV;
+    }
+
+    unsigned int offset = 0;
+    unsigned int frames = 0;
+    if (pcm_mmap_begin(pcm, &info->shared_memory_address, &offset, &frames) != 0 ||
+        info->shared_memory_address == nullptr) {
+        LOG(ERROR) << "pcm_mmap_begin failed: " << pcm_get_error(pcm);
+        pcm_close(pcm);
+        return -ENODEV;
+    }
+
+    unsigned int bufferSize = pcm_get_buffer_size(pcm);
+    memset(info->shared_memory_address, 0, pcm_frames_to_bytes(pcm, bufferSize));
+
+    if (pcm_mmap_commit(pcm, 0, burst) < 0) {
+        LOG(ERROR) << "pcm_mmap_commit failed: " << pcm_get_error(pcm);
+        pcm_close(pcm);
+        return -ENODEV;
+    }
+
+    // AAudioService needs an fd to accept the stream. As in other tinyalsa
+    // HALs that is the PCM's own; it is no dma-buf or ashmem handle, so the
+    // buffer is not shareable and clients go through the audio server
+    info->shared_memory_fd = pcm_get_poll_fd(pcm);
+    info->buffer_size_frames = bufferSize;
+    info->burst_size_frames = burst;
+    info->flags = static_cast<audio_mmap_buffer_flag>(0);
+
+    LOG(INFO) << "MMAP_NOIRQ buffer card " << card << " device " << device << ": "
+              << bufferSize << " frames, burst " << burst;
+
+    *pcmOut = pcm;
+    return 0;
+}
+
+static int getMmapPcmPosition(struct pcm* pcm, struct audio_mmap_position* position) {
+    if (pcm == nullptr || position == nullptr) {
+        return -ENOSYS;
+    }
+    unsigned int hwPtr = 0;
+    struct timespec timestamp = {};
+    if (pcm_mmap_get_hw_ptr(pcm, &hwPtr, &timestamp) < 0) {
+        return -ENOSYS;
+    }
+    position->position_frames = static_cast<int32_t>(hwPtr);
+    position->time_nanoseconds =
+            static_cast<int64_t>(timestamp.tv_sec) * 1000000000LL + timestamp.tv_nsec;
+    return 0;
+}
+
+// Narrows a requested configuration to what the device advertises through
+// pcm_params: rate and channels are clamped to the supported range and the
+// format falls back to the widest supported linear PCM format. Returns false
+// if the device could not be probed, leaving the config untouched.
+static bool negotiatePcmConfig(int card, int device, unsigned int flags,
+                               struct pcm_config* config) {
+    struct pcm_params* params = pcm_params_get(card, device, flags);
+    if (!params) {
+        LOG(WARNING) << "Cannot query PCM params for card " << card << " device " << device;
+        return false;
+    }
+
+    unsigned int minRate = pcm_params_get_min(params, PCM_PARAM_RATE);
+    unsigned int maxRate = pcm_params_get_max(params, PCM_PARAM_RATE);
+    if (config->rate < minRate || config->rate > maxRate) {
+        if (DEFAULT_SAMPLE_RATE >= minRate && DEFAULT_SAMPLE_RATE <= maxRate) {
+            config->rate = DEFAULT_SAMPLE_RATE;
+        } else if (44100 >= minRate && 44100 <= maxRate) {
+            config->rate = 44100;
+        } else {
+            config->rate = std::clamp(config->rate, minRate, maxRate);
+        }
+    }
+
+    unsigned int minChannels = pcm_params_get_min(params, PCM_PARAM_CHANNELS);
+    unsigned int maxChannels = pcm_params_get_max(params, PCM_PARAM_CHANNELS);
+    config->channels = std::clamp(config->channels, minChannels, maxChannels);
+
+    if (!pcm_params_format_test(params, config->format)) {
+        static const enum pcm_format kFallbackFormats[] = {
+            PCM_FORMAT_S32_LE, PCM_FORMAT_S24_LE, PCM_FORMAT_S24_3LE,
+            PCM_FORMAT_S16_LE, PCM_FORMAT_FLOAT_LE,
+        };
+        for (enum pcm_format format : kFallbackFormats) {
+            if (pcm_params_format_test(params, format)) {
+                config->format = format;
+                break;
+            }
+        }
+    }
+
+    pcm_params_free(params);
+    return true;
+}
+
+static audio_format_t getAudioFormat(enum pcm_format format) {
+    switch (format) {
+        case PCM_FORMAT_S32_LE:
+            return AUDIO_FORMAT_PCM_32_BIT;
+        case PCM_FORMAT_S24_LE:
+            return AUDIO_FORMAT_PCM_8_24_BIT;
+        case PCM_FORMAT_S24_3LE:
+            return AUDIO_FORMAT_PCM_24_BIT_PACKED;
+        case PCM_FORMAT_FLOAT_LE:
+            return AUDIO_FORMAT_PCM_FLOAT;
+        case PCM_FORMAT_S16_LE:
+        default:
+            return AUDIO_FORMAT_PCM_16_BIT;
+    }
+}
+
+static int64_t nowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Logging every xrun from the audio thread would make things worse; log the
+// 1st, 2nd, 4th, 8th... occurrence instead.
+static bool shouldLogXrun(uint32_t count) {
+    return (count & (count - 1)) == 0;
+}
+
+// Promotes the calling thread to SCHED_FIFO once per thread
+static void promoteToRealtime(pid_t* realtimeTid) {
+    pid_t tid = gettid();
+    if (*realtimeTid == tid) {
+        return;
+    }
+    struct sched_param param = {};
+    param.sched_priority = FAST_THREAD_PRIORITY;
+    if (sched_setscheduler(tid, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) != 0) {
+        PLOG(WARNING) << "Failed to set SCHED_FIFO for tid " << tid;
+    }
+    *realtimeTid = tid;
+}
+
+// TimingHistogram implementation
+void TimingHistogram::record(int64_t durationUs) {
+    size_t bucket = 0;
+    for (int64_t d = durationUs; d > 1 && bucket < kBuckets - 1; d >>= 1) {
+        bucket++;
+    }
+    mCounts[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    int64_t max = mMaxUs.load(std::memory_order_relaxed);
+    while (durationUs > max &&
+           !mMaxUs.compare_exchange_weak(max, durationUs, std::memory_order_relaxed)) {
+    }
+}
+
+void TimingHistogram::dump(int fd, const char* name) const {
+    dprintf(fd, "    %s time histogram (us), max %lld:\n", name,
+            static_cast<long long>(mMaxUs.load(std::memory_order_relaxed)));
+    for (size_t i = 0; i < kBuckets; i++) {
+        uint64_t count = mCounts[i].load(std::memory_order_relaxed);
+        if (count == 0) {
+            continue;
+        }
+        if (i == kBuckets - 1) {
+            dprintf(fd, "      >= %u: %llu\n", 1u << i, static_cast<unsigned long long>(count));
+        } else {
+            dprintf(fd, "      %u-%u: %llu\n", i == 0 ? 0u : 1u << i, (1u << (i + 1)) - 1,
+                    static_cast<unsigned long long>(count));
+        }
+    }
+}
+
 AudioHAL::AudioHAL() {
     LOG(INFO) << "AudioHAL constructor";
-    enumerateDevices();
+    // Streams already open keep their card; new streams route to the updated list
+    mDevices.startHotplugMonitor([] { LOG(INFO) << "Audio devices changed"; });
 }
 
 AudioHAL::~AudioHAL() {
     LOG(INFO) << "AudioHAL destructor";
 }
 
-void AudioHAL::enumerateDevices() {
-    // Check for HDMI audio
-    struct mixer* hdmiMixer = mixer_open(0);
-    if (hdmiMixer) {
-        mOutputDevices.push_back({
-            .name = "HDMI Audio",
-            .card = 0,
-            .device = 0,
-            .type = AUDIO_DEVICE_OUT_AUX_DIGITAL,
-        });
-        mixer_close(hdmiMixer);
-    }
-
-    // Check for headphone jack (3.5mm audio)
-    struct mixer* headphoneMixer = mixer_open(1);
-    if (headphoneMixer) {
-        mOutputDevices.push_back({
-            .name = "Headphone Jack",
-            .card = 1,
-            .device = 0,
-            .type = AUDIO_DEVICE_OUT_WIRED_HEADPHONE,
-        });
-        mixer_close(headphoneMixer);
-    }
-
-    // USB Audio (dynamic)
-    for (int card = 2; card < 8; card++) {
-        struct mixer* usbMixer = mixer_open(card);
-        if (usbMixer) {
-            mOutputDevices.push_back({
-                .name = "USB Audio",
-                .card = card,
-                .device = 0,
-                .type = AUDIO_DEVICE_OUT_USB_DEVICE,
-            });
-            mInputDevices.push_back({
-                .name = "USB Microphone",
-                .card = card,
-                .device = 0,
-                .type = AUDIO_DEVICE_IN_USB_DEVICE,
-            });
-            mixer_close(usbMixer);
-        }
+AudioPcmProfile AudioHAL::getOutputProfile(audio_output_flags_t flags) {
+    if (flags & AUDIO_OUTPUT_FLAG_MMAP_NOIRQ) {
+        return {
+            .periodSize = getLowLatencyPeriodSize(),
+            .periodCount = MMAP_MIN_PERIOD_COUNT,
+            .startThreshold = 0,
+            .mmap = true,
+            .realtime = false,
+            .noIrq = true,
+        };
+    }
+    if (flags & (AUDIO_OUTPUT_FLAG_FAST | AUDIO_OUTPUT_FLAG_RAW)) {
+        unsigned int periodSize = getLowLatencyPeriodSize();
+        return {
+            .periodSize = periodSize,
+            .periodCount = LOW_LATENCY_PERIOD_COUNT,
+            .startThreshold = periodSize,
+            .mmap = true,
+            .realtime = true,
+            .noIrq = false,
+        };
     }
+    return {
+        .periodSize = DEFAULT_PERIOD_SIZE,
+        .periodCount = DEFAULT_PERIOD_COUNT,
+        .startThreshold = DEFAULT_PERIOD_SIZE * 2,
+        .mmap = false,
+        .realtime = false,
+        .noIrq = false,
+    };
+}
 
-    LOG(INFO) << "Found " << mOutputDevices.size() << " output devices, "
-              << mInputDevices.size() << " input devices";
+AudioPcmProfile AudioHAL::getInputProfile(audio_input_flags_t flags) {
+    if (flags & AUDIO_INPUT_FLAG_MMAP_NOIRQ) {
+        return {
+            .periodSize = getLowLatencyPeriodSize(),
+            .periodCount = MMAP_MIN_PERIOD_COUNT,
+            .startThreshold = 0,
+            .mmap = true,
+            .realtime = false,
+            .noIrq = true,
+        };
+    }
+    if (flags & AUDIO_INPUT_FLAG_FAST) {
+        unsigned int periodSize = getLowLatencyPeriodSize();
+        return {
+            .periodSize = periodSize,
+            .periodCount = LOW_LATENCY_PERIOD_COUNT,
+            .startThreshold = 1,
+            .mmap = true,
+            .realtime = true,
+            .noIrq = false,
+        };
+    }
+    return {
+        .periodSize = DEFAULT_PERIOD_SIZE,
+        .periodCount = DEFAULT_PERIOD_COUNT,
+        .startThreshold = 1,
+        .mmap = false,
+        .realtime = false,
+        .noIrq = false,
+    };
 }
 
 int AudioHAL::openOutputStream(audio_io_handle_t handle,
@@ -86,23 +344,24 @@ int AudioHAL::openOutputStream(audio_io_handle_t handle,
                                 audio_output_flags_t flags,
                                 struct audio_config* config,
                                 struct audio_stream_out** streamOut) {
-    // Find appropriate device
+    // Find appropriate device, falling back to the first output present
     int card = DEFAULT_CARD;
     int device = DEFAULT_DEVICE;
 
-    for (const auto& dev : mOutputDevices) {
-        if (dev.type & devices) {
-            card = dev.card;
-            device = dev.device;
-            break;
-        }
+    AudioDeviceInfo info;
+    if (mDevices.findOutputDevice(devices, &info) ||
+        mDevices.findOutputDevice(AUDIO_DEVICE_NONE, &info)) {
+        card = info.card;
+        device = info.device;
     }
 
-    auto stream = std::make_unique<AudioStreamOut>(card, device, config);
+    auto stream = std::make_unique<AudioStreamOut>(card, device, config,
+                                                   getOutputProfile(flags));
     if (!stream->isValid()) {
         return -ENODEV;
     }
 
+    stream->setMasterVolume(mMasterVolume, mMasterMute);
     *streamOut = stream->getStream();
     mOutputStreams[handle] = std::move(stream);
 
@@ -111,21 +370,22 @@ int AudioHAL::openOutputStream(audio_io_handle_t handle,
 
 int AudioHAL::openInputStream(audio_io_handle_t handle,
                                audio_devices_t devices,
+                               audio_input_flags_t flags,
                                struct audio_config* config,
                                struct audio_stream_in** streamIn) {
-    // Find appropriate device
+    // Find appropriate device, falling back to the first input present
     int card = DEFAULT_CARD;
     int device = DEFAULT_DEVICE;
 
-    for (const auto& dev : mInputDevices) {
-        if (dev.type & devices) {
-            card = dev.card;
-            device = dev.device;
-            break;
-        }
+    AudioDeviceInfo info;
+    if (mDevices.findInputDevice(devices, &info) ||
+        mDevices.findInputDevice(AUDIO_DEVICE_NONE, &info)) {
+        card = info.card;
+        device = info.device;
     }
 
-    auto stream = std::make_unique<AudioStreamIn>(card, device, config);
+    auto stream = std::make_unique<AudioStreamIn>(card, device, config,
+                                                  getInputProfile(flags));
     if (!stream->isValid()) {
         return -ENODEV;
     }
@@ -154,7 +414,7 @@ int AudioHAL::setMasterVolume(float volume) {
     mMasterVolume = volume;
     // Apply to all active streams
     for (auto& pair : mOutputStreams) {
-        pair.second->setVolume(volume, volume);
+        pair.second->setMasterVolume(mMasterVolume, mMasterMute);
     }
     return 0;
 }
@@ -166,6 +426,9 @@ int AudioHAL::getMasterVolume(float* volume) {
 
 int AudioHAL::setMasterMute(bool mute) {
     mMasterMute = mute;
+    for (auto& pair : mOutputStreams) {
+        pair.second->setMasterVolume(mMasterVolume, mMasterMute);
+    }
     return 0;
 }
 
@@ -174,24 +437,71 @@ int AudioHAL::getMasterMute(bool* mute) {
     return 0;
 }
 
+void AudioHAL::dump(int fd) const {
+    dprintf(fd, "Audio HAL: master volume %.3f%s\n", mMasterVolume,
+            mMasterMute ? " (muted)" : "");
+    for (const auto& pair : mOutputStreams) {
+        dprintf(fd, "  Output stream %d:\n", pair.first);
+        pair.second->dump(fd);
+    }
+    for (const auto& pair : mInputStreams) {
+        dprintf(fd, "  Input stream %d:\n", pair.first);
+        pair.second->dump(fd);
+    }
+}
+
+int AudioHAL::getBufferedLatencyEstimate(audio_io_handle_t outHandle,
+                                         audio_io_handle_t inHandle, uint32_t* latencyMs) {
+    auto out = mOutputStreams.find(outHandle);
+    auto in = mInputStreams.find(inHandle);
+    if (out == mOutputStreams.end() || in == mInputStreams.end()) {
+        return -EINVAL;
+    }
+    *latencyMs = out->second->getMeasuredLatency() + in->second->getMeasuredLatency();
+    return 0;
+}
+
 // AudioStreamOut implementation
-AudioStreamOut::AudioStreamOut(int card, int device, struct audio_config* config) 
-    : mCard(card), mDevice(device), mPcm(nullptr), mValid(false) {
-    
-    mConfig = {
-        .channels = DEFAULT_CHANNELS,
+AudioStreamOut::AudioStreamOut(int card, int device, struct audio_config* config,
+                               const AudioPcmProfile& profile)
+    : mCard(card), mDevice(device), mPcm(nullptr), mProfile(profile), mValid(false),
+      mGain(DEFAULT_CHANNELS, config->sample_rate ? config->sample_rate : DEFAULT_SAMPLE_RATE) {
+
+    mClientFormat = {
         .rate = config->sample_rate ? config->sample_rate : DEFAULT_SAMPLE_RATE,
-        .period_size = DEFAULT_PERIOD_SIZE,
-        .period_count = DEFAULT_PERIOD_COUNT,
+        .channels = DEFAULT_CHANNELS,
         .format = PCM_FORMAT_S16_LE,
-        .start_threshold = DEFAULT_PERIOD_SIZE * 2,
-        .stop_threshold = DEFAULT_PERIOD_SIZE * DEFAULT_PERIOD_COUNT,
     };
 
+    mConfig = {
+        .channels = mClientFormat.channels,
+        .rate = mClientFormat.rate,
+        .period_size = profile.periodSize,
+        .period_count = profile.periodCount,
+        .format = mClientFormat.format,
+        .start_threshold = profile.startThreshold,
+        .stop_threshold = profile.periodSize * profile.periodCount,
+    };
+    negotiatePcmConfig(card, device, PCM_OUT, &mConfig);
+
+    AudioPcmFormat native = {mConfig.rate, mConfig.channels, mConfig.format};
+    if (profile.noIrq) {
+        // The client writes the DMA buffer itself, so it must use the native format
+        mClientFormat = native;
+    } else if (native != mClientFormat) {
+        mConverter = std::make_unique<AudioConverter>(mClientFormat, native,
+                                                      AudioConverter::getDefaultQuality());
+    }
+
     // Update config with actual values
-    config->sample_rate = mConfig.rate;
-    config->channel_mask = AUDIO_CHANNEL_OUT_STEREO;
-    config->format = AUDIO_FORMAT_PCM_16_BIT;
+    config->sample_rate = mClientFormat.rate;
+    config->channel_mask = audio_channel_out_mask_from_count(mClientFormat.channels);
+    config->format = getAudioFormat(mClientFormat.format);
+
+    LOG(INFO) << "Output stream card " << card << " device " << device << ": "
+              << mConfig.period_count << " x " << mConfig.period_size << " frames ("
+              << getLatency() << " ms)" << (profile.realtime ? " low-latency" : "")
+              << (mConverter ? " converted" : "");
 
     mValid = true;
 }
@@ -204,7 +514,9 @@ AudioStreamOut::~AudioStreamOut() {
 
 int AudioStreamOut::start() {
     if (!mPcm) {
-        mPcm = pcm_open(mCard, mDevice, PCM_OUT, &mConfig);
+        // PCM_NORESTART: underruns come back as -EPIPE so they can be counted
+        mPcm = openPcm(mCard, mDevice, PCM_OUT | PCM_MONOTONIC | PCM_NORESTART, &mConfig,
+                       &mProfile.mmap);
         if (!pcm_is_ready(mPcm)) {
             LOG(ERROR) << "Failed to open PCM: " << pcm_get_error(mPcm);
             pcm_close(mPcm);
@@ -216,41 +528,214 @@ int AudioStreamOut::start() {
 }
 
 ssize_t AudioStreamOut::write(const void* buffer, size_t bytes) {
+    if (mProfile.noIrq) {
+        return -ENOSYS;
+    }
     if (start() != 0) {
         return -ENODEV;
     }
 
-    int ret = pcm_write(mPcm, buffer, bytes);
-    if (ret != 0) {
+    if (mProfile.realtime) {
+        promoteToRealtime(&mRealtimeTid);
+    }
+
+    // Stream and master volume; at unity the caller's buffer goes out untouched
+    const void* data = buffer;
+    size_t samples = bytes / sizeof(int16_t);
+    if (!mGain.isUnity()) {
+        if (mGainBuffer.size() < samples) {
+            mGainBuffer.resize(samples);
+        }
+        if (mGain.process(static_cast<const int16_t*>(buffer), mGainBuffer.data(),
+                          samples / mClientFormat.channels)) {
+            data = mGainBuffer.data();
+        }
+    }
+
+    // Convert to the device's native rate, format and channel count
+    size_t pcmBytes = bytes;
+    if (mConverter) {
+        size_t frames = samples / mClientFormat.channels;
+        frames = mConverter->convert(data, frames, &data);
+        pcmBytes = pcm_frames_to_bytes(mPcm, frames);
+        if (pcmBytes == 0) {
+            return bytes;
+        }
+    }
+
+    int64_t startUs = nowUs();
+    int ret = writePcm(data, pcmBytes);
+    mWriteTimes.record(nowUs() - startUs);
+    if (ret < 0) {
         LOG(ERROR) << "PCM write error: " << pcm_get_error(mPcm);
         return -EIO;
     }
 
+    mFramesWritten.fetch_add(pcm_bytes_to_frames(mPcm, pcmBytes), std::memory_order_relaxed);
+    updateMeasuredLatency();
     return bytes;
 }
 
+// Writes to the PCM, recovering from an underrun by re-preparing the stream
+// and writing the buffer again; the start threshold restarts the DMA once
+// enough data is queued.
+int AudioStreamOut::writePcm(const void* data, size_t bytes) {
+    int ret = mProfile.mmap ? pcm_mmap_write(mPcm, data, bytes)
+                            : pcm_write(mPcm, data, bytes);
+    if (ret != -EPIPE) {
+        return ret;
+    }
+
+    uint32_t underruns = mUnderruns.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (shouldLogXrun(underruns)) {
+        LOG(WARNING) << "Underrun on card " << mCard << " device " << mDevice
+                     << " (" << underruns << " total)";
+    }
+
+    if (pcm_prepare(mPcm) != 0) {
+        mRecoveryFailures.fetch_add(1, std::memory_order_relaxed);
+        LOG(ERROR) << "Failed to recover from underrun: " << pcm_get_error(mPcm);
+        return -EIO;
+    }
+    return mProfile.mmap ? pcm_mmap_write(mPcm, data, bytes)
+                         : pcm_write(mPcm, data, bytes);
+}
+
 int AudioStreamOut::setVolume(float left, float right) {
     mVolumeLeft = left;
     mVolumeRight = right;
+    updateGain();
+    return 0;
+}
+
+void AudioStreamOut::setMasterVolume(float volume, bool mute) {
+    mMasterVolume = volume;
+    mMasterMute = mute;
+    updateGain();
+}
+
+void AudioStreamOut::updateGain() {
+    float master = mMasterMute ? 0.0f : mMasterVolume;
+    mGain.setGain(mVolumeLeft * master, mVolumeRight * master);
+}
+
+int AudioStreamOut::createMmapBuffer(int32_t minSizeFrames,
+                                     struct audio_mmap_buffer_info* info) {
+    if (!mProfile.noIrq || mPcm) {
+        return -ENOSYS;
+    }
+    return openMmapPcm(mCard, mDevice, PCM_OUT, &mConfig, minSizeFrames, &mPcm, info);
+}
+
+int AudioStreamOut::getMmapPosition(struct audio_mmap_position* position) {
+    if (!mProfile.noIrq) {
+        return -ENOSYS;
+    }
+    return getMmapPcmPosition(mPcm, position);
+}
+
+int AudioStreamOut::startMmap() {
+    if (!mProfile.noIrq || !mPcm) {
+        return -ENOSYS;
+    }
+    return pcm_start(mPcm) == 0 ? 0 : -EIO;
+}
+
+int AudioStreamOut::stopMmap() {
+    if (!mProfile.noIrq || !mPcm) {
+        return -ENOSYS;
+    }
+    return pcm_stop(mPcm) == 0 ? 0 : -EIO;
+}
+
+uint32_t AudioStreamOut::getLatency() const {
+    return mConfig.period_size * mConfig.period_count * 1000 / mConfig.rate;
+}
+
+int AudioStreamOut::getPresentationPosition(uint64_t* frames, struct timespec* timestamp) {
+    if (!mPcm || mProfile.noIrq) {
+        return -ENODATA;
+    }
+
+    unsigned int avail;
+    if (pcm_get_htimestamp(mPcm, &avail, timestamp) != 0) {
+        return -ENODATA;
+    }
+
+    // Everything written minus what is still queued has reached the DAC
+    uint64_t queued = pcm_get_buffer_size(mPcm) - std::min(avail, pcm_get_buffer_size(mPcm));
+    uint64_t written = mFramesWritten.load(std::memory_order_relaxed);
+    if (written < queued) {
+        return -ENODATA;
+    }
+
+    uint64_t presented = written - queued;
+    if (mConfig.rate != mClientFormat.rate) {
+        presented = presented * mClientFormat.rate / mConfig.rate;
+    }
+    *frames = presented;
     return 0;
 }
 
+void AudioStreamOut::dump(int fd) const {
+    dprintf(fd, "    card %d device %d: %u Hz %u ch format %d, %u x %u frames%s%s%s\n",
+            mCard, mDevice, mConfig.rate, mConfig.channels, mConfig.format,
+            mConfig.period_count, mConfig.period_size, mProfile.mmap ? ", mmap" : "",
+            mProfile.noIrq ? ", noirq" : "", mConverter ? ", converted" : "");
+    dprintf(fd, "    latency %u ms (measured %u ms), frames written %llu\n", getLatency(),
+            mMeasuredLatencyMs,
+            static_cast<unsigned long long>(mFramesWritten.load(std::memory_order_relaxed)));
+    dprintf(fd, "    underruns %u, failed recoveries %u\n",
+            mUnderruns.load(std::memory_order_relaxed),
+            mRecoveryFailures.load(std::memory_order_relaxed));
+    mWriteTimes.dump(fd, "write");
+}
+
+void AudioStreamOut::updateMeasuredLatency() {
+    unsigned int avail;
+    struct timespec timestamp;
+    if (pcm_get_htimestamp(mPcm, &avail, &timestamp) != 0) {
+        return;
+    }
+    unsigned int bufferSize = pcm_get_buffer_size(mPcm);
+    unsigned int queued = avail < bufferSize ? bufferSize - avail : 0;
+    mMeasuredLatencyMs = queued * 1000 / mConfig.rate;
+}
+
 // AudioStreamIn implementation
-AudioStreamIn::AudioStreamIn(int card, int device, struct audio_config* config)
-    : mCard(card), mDevice(device), mPcm(nullptr), mValid(false) {
+AudioStreamIn::AudioStreamIn(int card, int device, struct audio_config* config,
+                             const AudioPcmProfile& profile)
+    : mCard(card), mDevice(device), mPcm(nullptr), mProfile(profile), mValid(false) {
 
-    mConfig = {
-        .channels = config->channel_mask == AUDIO_CHANNEL_IN_MONO ? 1u : 2u,
+    mClientFormat = {
         .rate = config->sample_rate ? config->sample_rate : DEFAULT_SAMPLE_RATE,
-        .period_size = DEFAULT_PERIOD_SIZE,
-        .period_count = DEFAULT_PERIOD_COUNT,
+        .channels = config->channel_mask == AUDIO_CHANNEL_IN_MONO ? 1u : 2u,
         .format = PCM_FORMAT_S16_LE,
-        .start_threshold = 1,
-        .stop_threshold = DEFAULT_PERIOD_SIZE * DEFAULT_PERIOD_COUNT,
     };
 
-    config->sample_rate = mConfig.rate;
-    config->format = AUDIO_FORMAT_PCM_16_BIT;
+    // FAST and MMAP_NOIRQ streams own the PCM and read it in its native
+    // format. The rest share a capture engine running at the device's default
+    // rate and layout, whichever client opens it, and convert per client in
+    // AudioCaptureClient.
+    const bool ownsPcm = profile.noIrq || profile.realtime;
+    mConfig = {
+        .channels = ownsPcm ? mClientFormat.channels : DEFAULT_CHANNELS,
+        .rate = ownsPcm ? mClientFormat.rate : DEFAULT_SAMPLE_RATE,
+        .period_size = profile.periodSize,
+        .period_count = profile.periodCount,
+        .format = mClientFormat.format,
+        .start_threshold = profile.startThreshold,
+        .stop_threshold = profile.periodSize * profile.periodCount,
+    };
+    negotiatePcmConfig(card, device, PCM_IN, &mConfig);
+
+    if (ownsPcm) {
+        mClientFormat = {mConfig.rate, mConfig.channels, mConfig.format};
+        config->channel_mask = audio_channel_in_mask_from_count(mConfig.channels);
+    }
+
+    config->sample_rate = mClientFormat.rate;
+    config->format = getAudioFormat(mClientFormat.format);
 
     mValid = true;
 }
@@ -262,32 +747,159 @@ AudioStreamIn::~AudioStreamIn() {
 }
 
 int AudioStreamIn::start() {
-    if (!mPcm) {
-        mPcm = pcm_open(mCard, mDevice, PCM_IN, &mConfig);
-        if (!pcm_is_ready(mPcm)) {
-            LOG(ERROR) << "Failed to open PCM for capture: " << pcm_get_error(mPcm);
-            pcm_close(mPcm);
-            mPcm = nullptr;
-            return -ENODEV;
+    if (mPcm || mCapture) {
+        return 0;
+    }
+    if (mProfile.realtime) {
+        // PCM_NORESTART: overruns come back as -EPIPE so they can be counted
+        mPcm = openPcm(mCard, mDevice, PCM_IN | PCM_MONOTONIC | PCM_NORESTART, &mConfig,
+                       &mProfile.mmap);
+        if (pcm_is_ready(mPcm)) {
+            return 0;
         }
+        // Most likely a shared capture holds the device; join it instead
+        LOG(WARNING) << "Failed to open PCM for fast capture: " << pcm_get_error(mPcm)
+                     << ", sharing the capture engine";
+        pcm_close(mPcm);
+        mPcm = nullptr;
+    }
+    mCapture = AudioCaptureEngine::connect(mCard, mDevice, mConfig, mProfile.mmap,
+                                           mClientFormat);
+    if (!mCapture) {
+        return -ENODEV;
     }
     return 0;
 }
 
 ssize_t AudioStreamIn::read(void* buffer, size_t bytes) {
+    if (mProfile.noIrq) {
+        return -ENOSYS;
+    }
     if (start() != 0) {
         return -ENODEV;
     }
 
-    int ret = pcm_read(mPcm, buffer, bytes);
-    if (ret != 0) {
-        LOG(ERROR) << "PCM read error: " << pcm_get_error(mPcm);
+    if (mProfile.realtime) {
+        promoteToRealtime(&mRealtimeTid);
+    }
+
+    int64_t startUs = nowUs();
+    int ret = mPcm ? readPcm(buffer, bytes) : mCapture->read(buffer, bytes);
+    mReadTimes.record(nowUs() - startUs);
+    if (ret < 0) {
+        LOG(ERROR) << "Capture read error on card " << mCard << " device " << mDevice;
         return -EIO;
     }
 
+    mFramesRead.fetch_add(bytes / (mClientFormat.channels *
+                                   AudioConverter::getBytesPerSample(mClientFormat.format)),
+                          std::memory_order_relaxed);
+    updateMeasuredLatency();
     return bytes;
 }
 
+// Reads from a PCM the stream owns, recovering from an overrun by re-preparing
+// the stream and reading again
+int AudioStreamIn::readPcm(void* buffer, size_t bytes) {
+    int ret = mProfile.mmap ? pcm_mmap_read(mPcm, buffer, bytes)
+                            : pcm_read(mPcm, buffer, bytes);
+    if (ret != -EPIPE) {
+        return ret;
+    }
+
+    uint32_t overruns = mOverruns.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (shouldLogXrun(overruns)) {
+        LOG(WARNING) << "Overrun on card " << mCard << " device " << mDevice
+                     << " (" << overruns << " total)";
+    }
+
+    if (pcm_prepare(mPcm) != 0) {
+        LOG(ERROR) << "Failed to recover from overrun: " << pcm_get_error(mPcm);
+        return -EIO;
+    }
+    return mProfile.mmap ? pcm_mmap_read(mPcm, buffer, bytes)
+                         : pcm_read(mPcm, buffer, bytes);
+}
+
+int AudioStreamIn::createMmapBuffer(int32_t minSizeFrames,
+                                    struct audio_mmap_buffer_info* info) {
+    if (!mProfile.noIrq || mPcm) {
+        return -ENOSYS;
+    }
+    return openMmapPcm(mCard, mDevice, PCM_IN, &mConfig, minSizeFrames, &mPcm, info);
+}
+
+int AudioStreamIn::getMmapPosition(struct audio_mmap_position* position) {
+    if (!mProfile.noIrq) {
+        return -ENOSYS;
+    }
+    return getMmapPcmPosition(mPcm, position);
+}
+
+int AudioStreamIn::startMmap() {
+    if (!mProfile.noIrq || !mPcm) {
+        return -ENOSYS;
+    }
+    return pcm_start(mPcm) == 0 ? 0 : -EIO;
+}
+
+int AudioStreamIn::stopMmap() {
+    if (!mProfile.noIrq || !mPcm) {
+        return -ENOSYS;
+    }
+    return pcm_stop(mPcm) == 0 ? 0 : -EIO;
+}
+
+uint32_t AudioStreamIn::getLatency() const {
+    return mConfig.period_size * mConfig.period_count * 1000 / mConfig.rate;
+}
+
+uint32_t AudioStreamIn::getOverruns() const {
+    if (!mCapture) {
+        return mOverruns.load(std::memory_order_relaxed);
+    }
+    return mCapture->getEngine().getDeviceOverruns() + mCapture->getOverruns();
+}
+
+void AudioStreamIn::dump(int fd) const {
+    dprintf(fd, "    card %d device %d: client %u Hz %u ch format %d%s%s%s\n",
+            mCard, mDevice, mClientFormat.rate, mClientFormat.channels, mClientFormat.format,
+            mProfile.mmap ? ", mmap" : "", mProfile.noIrq ? ", noirq" : "",
+            mCapture || mPcm ? "" : ", idle");
+    dprintf(fd, "    latency %u ms (measured %u ms), frames read %llu\n", getLatency(),
+            mMeasuredLatencyMs,
+            static_cast<unsigned long long>(mFramesRead.load(std::memory_order_relaxed)));
+    if (mCapture) {
+        const AudioCaptureEngine& engine = mCapture->getEngine();
+        const struct pcm_config& native = engine.getConfig();
+        dprintf(fd, "    engine %u Hz %u ch format %d, %u x %u frames, device overruns %u%s\n",
+                native.rate, native.channels, native.format, native.period_count,
+                native.period_size, engine.getDeviceOverruns(),
+                engine.hasFailed() ? ", FAILED" : "");
+        dprintf(fd, "    client overruns %u, lost frames %llu, backlog %llu frames\n",
+                mCapture->getOverruns(),
+                static_cast<unsigned long long>(mCapture->getLostFrames()),
+                static_cast<unsigned long long>(mCapture->getBacklogFrames()));
+    }
+    mReadTimes.dump(fd, "read");
+}
+
+void AudioStreamIn::updateMeasuredLatency() {
+    if (mPcm) {
+        // Frames captured into the ALSA buffer and not read yet
+        unsigned int avail;
+        struct timespec timestamp;
+        if (pcm_get_htimestamp(mPcm, &avail, &timestamp) == 0) {
+            mMeasuredLatencyMs = avail * 1000 / mConfig.rate;
+        }
+        return;
+    }
+    // Frames still waiting in the ring for this client plus the period just delivered
+    const struct pcm_config& native = mCapture->getEngine().getConfig();
+    mMeasuredLatencyMs = (mCapture->getBacklogFrames() + native.period_size) * 1000 /
+            native.rate;
+}
+
 }  // namespace audio
 }  // namespace hardware
 }  // namespace android
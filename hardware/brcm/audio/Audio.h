@@ -4,20 +4,43 @@
 
 #include <hardware/audio.h>
 #include <tinyalsa/asoundlib.h>
+#include <array>
+#include <atomic>
 #include <memory>
 #include <map>
 #include <vector>
 #include <string>
+#include "AudioCapture.h"
+#include "AudioConverter.h"
+#include "AudioDevice.h"
+#include "AudioGain.h"
 
 namespace android {
 namespace hardware {
 namespace audio {
 
-struct AudioDeviceInfo {
-    std::string name;
-    int card;
-    int device;
-    audio_devices_t type;
+// PCM buffering parameters for a stream, selected from the stream flags at open
+struct AudioPcmProfile {
+    unsigned int periodSize;        // frames
+    unsigned int periodCount;
+    unsigned int startThreshold;    // frames queued before the DMA starts
+    bool mmap;                      // open with PCM_MMAP and use pcm_mmap_write/read
+    bool realtime;                  // promote the calling write/read thread to SCHED_FIFO
+    bool noIrq;                     // MMAP_NOIRQ: DMA buffer is shared with the client
+};
+
+// Power-of-two histogram of call durations in microseconds: bucket i counts
+// calls that took [2^i, 2^(i+1)) us, the last bucket everything longer.
+class TimingHistogram {
+public:
+    static constexpr size_t kBuckets = 16;
+
+    void record(int64_t durationUs);
+    void dump(int fd, const char* name) const;
+
+private:
+    std::array<std::atomic<uint64_t>, kBuckets> mCounts = {};
+    std::atomic<int64_t> mMaxUs{0};
 };
 
 class AudioStreamOut;
@@ -36,6 +59,7 @@ public:
 
     int openInputStream(audio_io_handle_t handle,
                         audio_devices_t devices,
+                        audio_input_flags_t flags,
                         struct audio_config* config,
                         struct audio_stream_in** streamIn);
 
@@ -47,14 +71,22 @@ public:
     int setMasterMute(bool mute);
     int getMasterMute(bool* mute);
 
-    const std::vector<AudioDeviceInfo>& getOutputDevices() const { return mOutputDevices; }
-    const std::vector<AudioDeviceInfo>& getInputDevices() const { return mInputDevices; }
+    // Estimate of a stream pair's round trip, in ms: the audio queued in both
+    // directions, from the playback and capture buffer fill. Converter, codec
+    // and acoustic delays are not included; audio_latency_bench measures them.
+    int getBufferedLatencyEstimate(audio_io_handle_t outHandle, audio_io_handle_t inHandle,
+                                   uint32_t* latencyMs);
 
-private:
-    void enumerateDevices();
+    static AudioPcmProfile getOutputProfile(audio_output_flags_t flags);
+    static AudioPcmProfile getInputProfile(audio_input_flags_t flags);
+
+    void dump(int fd) const;
+
+    std::vector<AudioDeviceInfo> getOutputDevices() const { return mDevices.getOutputDevices(); }
+    std::vector<AudioDeviceInfo> getInputDevices() const { return mDevices.getInputDevices(); }
 
-    std::vector<AudioDeviceInfo> mOutputDevices;
-    std::vector<AudioDeviceInfo> mInputDevices;
+private:
+    AudioDeviceManager mDevices;
     std::map<audio_io_handle_t, std::unique_ptr<AudioStreamOut>> mOutputStreams;
     std::map<audio_io_handle_t, std::unique_ptr<AudioStreamIn>> mInputStreams;
 
@@ -64,7 +96,8 @@ private:
 
 class AudioStreamOut {
 public:
-    AudioStreamOut(int card, int device, struct audio_config* config);
+    AudioStreamOut(int card, int device, struct audio_config* config,
+                   const AudioPcmProfile& profile);
     ~AudioStreamOut();
 
     bool isValid() const { return mValid; }
@@ -73,21 +106,60 @@ public:
     int start();
     ssize_t write(const void* buffer, size_t bytes);
     int setVolume(float left, float right);
+    // Device-wide gain, applied on top of the stream volume
+    void setMasterVolume(float volume, bool mute);
+
+    // MMAP_NOIRQ streams: the client reads/writes the DMA buffer directly
+    int createMmapBuffer(int32_t minSizeFrames, struct audio_mmap_buffer_info* info);
+    int getMmapPosition(struct audio_mmap_position* position);
+    int startMmap();
+    int stopMmap();
+
+    // Nominal latency of the configured ALSA buffer
+    uint32_t getLatency() const;
+    // Queued playback depth observed from the hardware timestamp on the last write
+    uint32_t getMeasuredLatency() const { return mMeasuredLatencyMs; }
+
+    // Frames presented at the DAC, in client frames, and when that was measured
+    int getPresentationPosition(uint64_t* frames, struct timespec* timestamp);
+    uint32_t getUnderruns() const { return mUnderruns.load(std::memory_order_relaxed); }
+
+    void dump(int fd) const;
 
 private:
+    void updateMeasuredLatency();
+    void updateGain();
+    int writePcm(const void* data, size_t bytes);
+
     int mCard;
     int mDevice;
     struct pcm* mPcm;
     struct pcm_config mConfig;
+    AudioPcmFormat mClientFormat;
+    std::unique_ptr<AudioConverter> mConverter;
+    AudioPcmProfile mProfile;
     struct audio_stream_out mStream;
     bool mValid;
     float mVolumeLeft = 1.0f;
     float mVolumeRight = 1.0f;
+    float mMasterVolume = 1.0f;
+    bool mMasterMute = false;
+    GainStage mGain;
+    std::vector<int16_t> mGainBuffer;
+    pid_t mRealtimeTid = 0;
+    uint32_t mMeasuredLatencyMs = 0;
+
+    // Statistics, read by dump() from other threads
+    std::atomic<uint64_t> mFramesWritten{0};    // device frames
+    std::atomic<uint32_t> mUnderruns{0};
+    std::atomic<uint32_t> mRecoveryFailures{0};
+    TimingHistogram mWriteTimes;
 };
 
 class AudioStreamIn {
 public:
-    AudioStreamIn(int card, int device, struct audio_config* config);
+    AudioStreamIn(int card, int device, struct audio_config* config,
+                  const AudioPcmProfile& profile);
     ~AudioStreamIn();
 
     bool isValid() const { return mValid; }
@@ -96,13 +168,41 @@ public:
     int start();
     ssize_t read(void* buffer, size_t bytes);
 
+    int createMmapBuffer(int32_t minSizeFrames, struct audio_mmap_buffer_info* info);
+    int getMmapPosition(struct audio_mmap_position* position);
+    int startMmap();
+    int stopMmap();
+
+    uint32_t getLatency() const;
+    // Captured data waiting in the ALSA buffer when the last read completed
+    uint32_t getMeasuredLatency() const { return mMeasuredLatencyMs; }
+    // Device overruns of the shared engine plus this stream's own ring
+    // overruns, or the overruns of the PCM the stream owns
+    uint32_t getOverruns() const;
+
+    void dump(int fd) const;
+
 private:
+    int readPcm(void* buffer, size_t bytes);
+    void updateMeasuredLatency();
+
     int mCard;
     int mDevice;
     struct pcm* mPcm;
     struct pcm_config mConfig;
+    AudioPcmFormat mClientFormat;
+    // Reader of the shared capture engine; FAST and MMAP_NOIRQ streams use
+    // mPcm instead
+    std::unique_ptr<AudioCaptureClient> mCapture;
+    AudioPcmProfile mProfile;
     struct audio_stream_in mStream;
     bool mValid;
+    pid_t mRealtimeTid = 0;
+    uint32_t mMeasuredLatencyMs = 0;
+
+    std::atomic<uint64_t> mFramesRead{0};       // client frames
+    std::atomic<uint32_t> mOverruns{0};         // on mPcm only
+    TimingHistogram mReadTimes;
 };
 
 }  // namespace audio
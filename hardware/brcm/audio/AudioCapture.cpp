@@ -0,0 +1,299 @@
+// Copyright (C) 2024 The Android Open Source Project
+// Shared capture engine for the Raspberry Pi 5 audio HAL
+
+#define LOG_TAG "AudioHAL"
+
+#include <android-base/logging.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include "AudioCapture.h"
+
+namespace android {
+namespace hardware {
+namespace audio {
+
+// Same priority AudioFlinger gives its FastCapture thread
+static const int CAPTURE_THREAD_PRIORITY = 3;
+
+std::mutex AudioCaptureEngine::sEnginesLock;
+std::map<std::pair<int, int>, std::weak_ptr<AudioCaptureEngine>> AudioCaptureEngine::sEngines;
+
+static bool isPowerOfTwo(uint32_t count) {
+    return (count & (count - 1)) == 0;
+}
+
+// ============================================================================
+// AudioCaptureEngine
+// ============================================================================
+
+std::unique_ptr<AudioCaptureClient> AudioCaptureEngine::connect(
+        int card, int device, const struct pcm_config& config, bool mmap,
+        const AudioPcmFormat& clientFormat) {
+    std::lock_guard<std::mutex> lock(sEnginesLock);
+
+    std::pair<int, int> key = {card, device};
+    std::shared_ptr<AudioCaptureEngine> engine = sEngines[key].lock();
+    if (engine && engine->hasFailed()) {
+        // Its remaining clients still hold the PCM open; they get -EIO from
+        // read() and have to be closed before the device can be reopened
+        LOG(ERROR) << "Capture engine card " << card << " device " << device
+                   << " failed and is still in use";
+        return nullptr;
+    }
+    if (!engine) {
+        engine = std::make_shared<AudioCaptureEngine>(card, device, config, mmap);
+        if (!engine->start()) {
+            sEngines.erase(key);
+            return nullptr;
+        }
+        sEngines[key] = engine;
+    } else if (engine->mConfig.period_size != config.period_size) {
+        LOG(INFO) << "Capture client joins card " << card << " device " << device << " at "
+                  << engine->mConfig.period_size << " frame periods, asked for "
+                  << config.period_size;
+    }
+
+    return std::make_unique<AudioCaptureClient>(engine, clientFormat);
+}
+
+void AudioCaptureEngine::disconnect(std::shared_ptr<AudioCaptureEngine> engine) {
+    std::lock_guard<std::mutex> lock(sEnginesLock);
+    std::pair<int, int> key = {engine->mCard, engine->mDevice};
+    engine.reset();
+    auto it = sEngines.find(key);
+    if (it != sEngines.end() && it->second.expired()) {
+        sEngines.erase(it);
+    }
+}
+
+AudioCaptureEngine::AudioCaptureEngine(int card, int device, const struct pcm_config& config,
+                                       bool mmap)
+    : mCard(card), mDevice(device), mConfig(config), mMmap(mmap) {
+}
+
+AudioCaptureEngine::~AudioCaptureEngine() {
+    mRunning = false;
+    if (mPcm) {
+        // Wakes the capture thread out of a blocking read
+        pcm_stop(mPcm);
+    }
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    if (mPcm) {
+        pcm_close(mPcm);
+    }
+    LOG(INFO) << "Capture engine card " << mCard << " device " << mDevice << " stopped";
+}
+
+bool AudioCaptureEngine::start() {
+    const unsigned int flags = PCM_IN | PCM_MONOTONIC | PCM_NORESTART;
+    if (mMmap) {
+        mPcm = pcm_open(mCard, mDevice, flags | PCM_MMAP, &mConfig);
+        if (!pcm_is_ready(mPcm)) {
+            LOG(WARNING) << "MMAP capture open failed on card " << mCard << " device "
+                         << mDevice << ": " << pcm_get_error(mPcm)
+                         << ", using read transfers";
+            pcm_close(mPcm);
+            mMmap = false;
+        }
+    }
+    if (!mMmap) {
+        mPcm = pcm_open(mCard, mDevice, flags, &mConfig);
+    }
+    if (!pcm_is_ready(mPcm)) {
+        LOG(ERROR) << "Failed to open PCM for capture: " << pcm_get_error(mPcm);
+        pcm_close(mPcm);
+        mPcm = nullptr;
+        return false;
+    }
+
+    mFrameSize = pcm_frames_to_bytes(mPcm, 1);
+    mCapacityFrames = static_cast<uint64_t>(mConfig.period_size) * kRingPeriods;
+    mRing.assign(mCapacityFrames * mFrameSize, 0);
+
+    mRunning = true;
+    mThread = std::thread(&AudioCaptureEngine::captureThreadFunc, this);
+
+    LOG(INFO) << "Capture engine card " << mCard << " device " << mDevice << ": "
+              << mConfig.rate << " Hz " << mConfig.channels << " ch, "
+              << mConfig.period_count << " x " << mConfig.period_size << " frames"
+              << (mMmap ? ", mmap" : "") << ", ring " << mCapacityFrames << " frames";
+    return true;
+}
+
+void AudioCaptureEngine::captureThreadFunc() {
+    struct sched_param param = {};
+    param.sched_priority = CAPTURE_THREAD_PRIORITY;
+    if (sched_setscheduler(gettid(), SCHED_FIFO | SCHED_RESET_ON_FORK, &param) != 0) {
+        PLOG(WARNING) << "Failed to set SCHED_FIFO for capture thread";
+    }
+
+    const size_t periodBytes = mConfig.period_size * mFrameSize;
+
+    while (mRunning) {
+        uint64_t pos = mWritePos.load(std::memory_order_relaxed);
+        uint8_t* slot = &mRing[(pos % mCapacityFrames) * mFrameSize];
+
+        int ret = mMmap ? pcm_mmap_read(mPcm, slot, periodBytes)
+                        : pcm_read(mPcm, slot, periodBytes);
+        if (ret == -EPIPE) {
+            uint32_t overruns = mDeviceOverruns.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (isPowerOfTwo(overruns)) {
+                LOG(WARNING) << "Overrun on card " << mCard << " device " << mDevice
+                             << " (" << overruns << " total)";
+            }
+            if (pcm_prepare(mPcm) != 0) {
+                LOG(ERROR) << "Failed to recover from overrun: " << pcm_get_error(mPcm);
+                mFailed = true;
+                wakeReaders();
+                break;
+            }
+            continue;
+        }
+        if (ret < 0) {
+            if (mRunning) {
+                LOG(ERROR) << "PCM read error: " << pcm_get_error(mPcm);
+                mFailed = true;
+                wakeReaders();
+            }
+            break;
+        }
+
+        // Publish the period; pairs with the acquire loads in the clients
+        mWritePos.store(pos + mConfig.period_size, std::memory_order_release);
+        wakeReaders();
+    }
+}
+
+void AudioCaptureEngine::wakeReaders() {
+    // Taking the lock orders the update before a reader's predicate check,
+    // so the notification cannot fall between its check and its wait
+    { std::lock_guard<std::mutex> lock(mWaitLock); }
+    mDataReady.notify_all();
+}
+
+void AudioCaptureEngine::waitForData(uint64_t cursor, std::chrono::microseconds timeout) {
+    std::unique_lock<std::mutex> lock(mWaitLock);
+    mDataReady.wait_for(lock, timeout, [&] {
+        return mWritePos.load(std::memory_order_acquire) != cursor || hasFailed();
+    });
+}
+
+// ============================================================================
+// AudioCaptureClient
+// ============================================================================
+
+AudioCaptureClient::AudioCaptureClient(std::shared_ptr<AudioCaptureEngine> engine,
+                                       const AudioPcmFormat& clientFormat)
+    : mEngine(std::move(engine)), mFormat(clientFormat) {
+    // New clients start at "now" rather than replaying the ring
+    mCursor = mEngine->mWritePos.load(std::memory_order_acquire);
+
+    AudioPcmFormat native = mEngine->getNativeFormat();
+    if (native != mFormat) {
+        mConverter = std::make_unique<AudioConverter>(native, mFormat,
+                                                      AudioConverter::getDefaultQuality());
+    }
+}
+
+AudioCaptureClient::~AudioCaptureClient() {
+    AudioCaptureEngine::disconnect(std::move(mEngine));
+}
+
+uint64_t AudioCaptureClient::getBacklogFrames() const {
+    return mEngine->mWritePos.load(std::memory_order_acquire) - mCursor;
+}
+
+// Copies up to maxFrames unread frames into mRaw and returns how many. The
+// writer may be refilling the slot after the newest published period, so a
+// reader must stay at least one period clear of a full lap; if it is not,
+// the frames in danger are dropped and counted as an overrun.
+size_t AudioCaptureClient::copyFromRing(size_t maxFrames) {
+    const uint64_t capacity = mEngine->mCapacityFrames;
+    const uint64_t maxLag = capacity - mEngine->mConfig.period_size;
+    const size_t frameSize = mEngine->mFrameSize;
+
+    auto skipLostFrames = [&](uint64_t writePos) {
+        if (writePos - mCursor <= maxLag) {
+            return false;
+        }
+        uint64_t lost = writePos - mCursor - maxLag;
+        mCursor += lost;
+        mLostFrames.fetch_add(lost, std::memory_order_relaxed);
+        uint32_t overruns = mOverruns.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (isPowerOfTwo(overruns)) {
+            LOG(WARNING) << "Capture client fell behind, lost " << lost << " frames ("
+                         << overruns << " overruns)";
+        }
+        return true;
+    };
+
+    uint64_t writePos = mEngine->mWritePos.load(std::memory_order_acquire);
+    skipLostFrames(writePos);
+
+    size_t frames = std::min<uint64_t>(writePos - mCursor, maxFrames);
+    if (frames == 0) {
+        return 0;
+    }
+    if (mRaw.size() < frames * frameSize) {
+        mRaw.resize(frames * frameSize);
+    }
+
+    // At most two segments: up to the end of the ring, then from its start
+    size_t offset = mCursor % capacity;
+    size_t first = std::min<size_t>(frames, capacity - offset);
+    memcpy(mRaw.data(), &mEngine->mRing[offset * frameSize], first * frameSize);
+    if (first < frames) {
+        memcpy(mRaw.data() + first * frameSize, mEngine->mRing.data(),
+               (frames - first) * frameSize);
+    }
+
+    // If the writer lapped us during the copy, part of it may be torn
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (skipLostFrames(mEngine->mWritePos.load(std::memory_order_relaxed))) {
+        return 0;
+    }
+
+    mCursor += frames;
+    return frames;
+}
+
+int AudioCaptureClient::read(void* buffer, size_t bytes) {
+    const struct pcm_config& config = mEngine->mConfig;
+    const size_t clientFrameSize = mFormat.channels *
+            AudioConverter::getBytesPerSample(mFormat.format);
+    // A few periods: only reached if the device stops delivering
+    const std::chrono::microseconds waitTimeout(
+            config.period_size * 4 * 1000000ULL / config.rate);
+
+    while (mPending.size() < bytes) {
+        if (mEngine->hasFailed()) {
+            return -EIO;
+        }
+
+        size_t frames = copyFromRing(config.period_size);
+        if (frames == 0) {
+            mEngine->waitForData(mCursor, waitTimeout);
+            continue;
+        }
+
+        const uint8_t* data = mRaw.data();
+        if (mConverter) {
+            const void* converted;
+            frames = mConverter->convert(mRaw.data(), frames, &converted);
+            data = static_cast<const uint8_t*>(converted);
+        }
+        mPending.insert(mPending.end(), data, data + frames * clientFrameSize);
+    }
+
+    memcpy(buffer, mPending.data(), bytes);
+    mPending.erase(mPending.begin(), mPending.begin() + bytes);
+    return 0;
+}
+
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
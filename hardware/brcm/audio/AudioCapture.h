@@ -0,0 +1,137 @@
+// Copyright (C) 2024 The Android Open Source Project
+// Shared capture engine for the Raspberry Pi 5 audio HAL
+
+#pragma once
+
+#include <tinyalsa/asoundlib.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "AudioConverter.h"
+
+namespace android {
+namespace hardware {
+namespace audio {
+
+class AudioCaptureClient;
+
+// One real-time thread per capture PCM reads whole periods into a ring of
+// native-format frames. The thread is the ring's only writer and never waits
+// on its readers: each AudioCaptureClient keeps its own cursor, copies out
+// what it needs and detects for itself when the writer has lapped it. After
+// each period the thread wakes the readers blocked for data.
+//
+// Engines are shared: every client of the same card/device reads the same
+// ring, and the engine stops when the last client goes away. FAST and
+// MMAP_NOIRQ streams own their PCM instead of sharing one.
+class AudioCaptureEngine {
+public:
+    // Ring depth in periods
+    static constexpr unsigned int kRingPeriods = 32;
+
+    // Connects a client to the engine for card/device, opening the PCM with
+    // config, in mmap mode if requested, when it is not running yet. Clients
+    // joining a running engine get its existing native config, converted to
+    // clientFormat.
+    static std::unique_ptr<AudioCaptureClient> connect(int card, int device,
+                                                       const struct pcm_config& config,
+                                                       bool mmap,
+                                                       const AudioPcmFormat& clientFormat);
+
+    AudioCaptureEngine(int card, int device, const struct pcm_config& config, bool mmap);
+    ~AudioCaptureEngine();
+
+    bool start();
+
+    const struct pcm_config& getConfig() const { return mConfig; }
+    AudioPcmFormat getNativeFormat() const {
+        return {mConfig.rate, mConfig.channels, mConfig.format};
+    }
+    bool hasFailed() const { return mFailed.load(std::memory_order_relaxed); }
+    uint32_t getDeviceOverruns() const { return mDeviceOverruns.load(std::memory_order_relaxed); }
+
+private:
+    friend class AudioCaptureClient;
+
+    // Drops a client's reference; the last one stops the engine while the
+    // engine table is locked, so a new client cannot find the PCM still open
+    static void disconnect(std::shared_ptr<AudioCaptureEngine> engine);
+
+    void captureThreadFunc();
+    void wakeReaders();
+    // Waits until the writer has moved past cursor, or the engine failed
+    void waitForData(uint64_t cursor, std::chrono::microseconds timeout);
+
+    int mCard;
+    int mDevice;
+    struct pcm_config mConfig;
+    bool mMmap;
+    struct pcm* mPcm = nullptr;
+
+    // Ring of kRingPeriods periods; writes are always one whole period, so a
+    // write never wraps.
+    std::vector<uint8_t> mRing;
+    size_t mFrameSize = 0;
+    uint64_t mCapacityFrames = 0;
+    // Total frames written; the frame at position p lives at p % mCapacityFrames
+    std::atomic<uint64_t> mWritePos{0};
+
+    std::thread mThread;
+    std::atomic<bool> mRunning{false};
+    std::atomic<bool> mFailed{false};
+    std::atomic<uint32_t> mDeviceOverruns{0};
+
+    std::mutex mWaitLock;
+    std::condition_variable mDataReady;
+
+    static std::mutex sEnginesLock;
+    static std::map<std::pair<int, int>, std::weak_ptr<AudioCaptureEngine>> sEngines;
+};
+
+// A reader of a shared capture engine with its own cursor, format conversion
+// and overrun accounting. Not thread-safe; owned by one input stream.
+class AudioCaptureClient {
+public:
+    AudioCaptureClient(std::shared_ptr<AudioCaptureEngine> engine,
+                       const AudioPcmFormat& clientFormat);
+    ~AudioCaptureClient();
+    AudioCaptureClient(const AudioCaptureClient&) = delete;
+    AudioCaptureClient& operator=(const AudioCaptureClient&) = delete;
+
+    // Blocks until bytes of client-format data have been read. Returns 0 or
+    // a negative errno.
+    int read(void* buffer, size_t bytes);
+
+    const AudioPcmFormat& getFormat() const { return mFormat; }
+    const AudioCaptureEngine& getEngine() const { return *mEngine; }
+
+    // Native frames captured but not yet read by this client
+    uint64_t getBacklogFrames() const;
+    // Times this client fell behind the writer, and the native frames it lost
+    uint32_t getOverruns() const { return mOverruns.load(std::memory_order_relaxed); }
+    uint64_t getLostFrames() const { return mLostFrames.load(std::memory_order_relaxed); }
+
+private:
+    size_t copyFromRing(size_t maxFrames);
+
+    std::shared_ptr<AudioCaptureEngine> mEngine;
+    AudioPcmFormat mFormat;
+    std::unique_ptr<AudioConverter> mConverter;
+    uint64_t mCursor;
+
+    std::vector<uint8_t> mRaw;          // native frames copied out of the ring
+    std::vector<uint8_t> mPending;      // client frames not yet returned
+
+    std::atomic<uint32_t> mOverruns{0};
+    std::atomic<uint64_t> mLostFrames{0};
+};
+
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,461 @@
+// Copyright (C) 2024 The Android Open Source Project
+// Sample-rate, format and channel conversion for the Raspberry Pi 5 audio HAL
+
+#define LOG_TAG "AudioHAL"
+
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include "AudioConverter.h"
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define CONVERTER_USE_NEON 1
+#endif
+
+namespace android {
+namespace hardware {
+namespace audio {
+
+static const char* RESAMPLER_QUALITY_PROP = "ro.vendor.audio.resampler_quality";
+
+// Rates whose reduced ratio needs more branches than this share the nearest
+// lower branch; 256 keeps the phase error well under the filter's noise floor.
+static const uint32_t MAX_PHASES = 256;
+
+namespace {
+
+struct ResamplerDesign {
+    uint32_t taps;
+    double kaiserBeta;
+    double passband;    // fraction of the lower Nyquist frequency kept
+};
+
+ResamplerDesign getDesign(AudioConverter::Quality quality) {
+    switch (quality) {
+        case AudioConverter::Quality::LOW:
+            return {8, 5.0, 0.80};
+        case AudioConverter::Quality::MEDIUM:
+            return {16, 7.0, 0.90};
+        case AudioConverter::Quality::HIGH:
+        default:
+            return {32, 9.0, 0.95};
+    }
+}
+
+double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+// ============================================================================
+// Sample decode/encode
+// ============================================================================
+
+inline int32_t signExtend24(int32_t value) {
+    return static_cast<int32_t>(static_cast<uint32_t>(value) << 8) >> 8;
+}
+
+void decode(const void* in, enum pcm_format format, float* out, size_t samples) {
+    size_t i = 0;
+    switch (format) {
+        case PCM_FORMAT_S16_LE: {
+            const int16_t* src = static_cast<const int16_t*>(in);
+#ifdef CONVERTER_USE_NEON
+            for (; i + 8 <= samples; i += 8) {
+                int16x8_t s = vld1q_s16(src + i);
+                vst1q_f32(out + i, vcvtq_n_f32_s32(vmovl_s16(vget_low_s16(s)), 15));
+                vst1q_f32(out + i + 4, vcvtq_n_f32_s32(vmovl_s16(vget_high_s16(s)), 15));
+            }
+#endif
+            for (; i < samples; i++) {
+                out[i] = src[i] * (1.0f / 32768.0f);
+            }
+            break;
+        }
+        case PCM_FORMAT_S32_LE: {
+            const int32_t* src = static_cast<const int32_t*>(in);
+#ifdef CONVERTER_USE_NEON
+            for (; i + 4 <= samples; i += 4) {
+                vst1q_f32(out + i, vcvtq_n_f32_s32(vld1q_s32(src + i), 31));
+            }
+#endif
+            for (; i < samples; i++) {
+                out[i] = src[i] * (1.0f / 2147483648.0f);
+            }
+            break;
+        }
+        case PCM_FORMAT_S24_LE: {
+            // 24-bit samples in the low bits of a 32-bit container
+            const int32_t* src = static_cast<const int32_t*>(in);
+#ifdef CONVERTER_USE_NEON
+            for (; i + 4 <= samples; i += 4) {
+                int32x4_t s = vshrq_n_s32(vshlq_n_s32(vld1q_s32(src + i), 8), 8);
+                vst1q_f32(out + i, vcvtq_n_f32_s32(s, 23));
+            }
+#endif
+            for (; i < samples; i++) {
+                out[i] = signExtend24(src[i]) * (1.0f / 8388608.0f);
+            }
+            break;
+        }
+        case PCM_FORMAT_S24_3LE: {
+            const uint8_t* src = static_cast<const uint8_t*>(in);
+            for (; i < samples; i++, src += 3) {
+                int32_t value = src[0] | (src[1] << 8) | (src[2] << 16);
+                out[i] = signExtend24(value) * (1.0f / 8388608.0f);
+            }
+            break;
+        }
+        case PCM_FORMAT_FLOAT_LE:
+            memcpy(out, in, samples * sizeof(float));
+            break;
+        default:
+            memset(out, 0, samples * sizeof(float));
+            break;
+    }
+}
+
+inline int32_t floatToFixed(float sample, float scale, int32_t min, int32_t max) {
+    double value = std::nearbyint(static_cast<double>(sample) * scale);
+    return static_cast<int32_t>(std::clamp<double>(value, min, max));
+}
+
+void encode(const float* in, enum pcm_format format, void* out, size_t samples) {
+    size_t i = 0;
+    switch (format) {
+        case PCM_FORMAT_S16_LE: {
+            int16_t* dst = static_cast<int16_t*>(out);
+#ifdef CONVERTER_USE_NEON
+            const float32x4_t scale = vdupq_n_f32(32768.0f);
+            for (; i + 8 <= samples; i += 8) {
+                int32x4_t lo = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(in + i), scale));
+                int32x4_t hi = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(in + i + 4), scale));
+                vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+            }
+#endif
+            for (; i < samples; i++) {
+                dst[i] = static_cast<int16_t>(floatToFixed(in[i], 32768.0f, -32768, 32767));
+            }
+            break;
+        }
+        case PCM_FORMAT_S32_LE: {
+            int32_t* dst = static_cast<int32_t*>(out);
+#ifdef CONVERTER_USE_NEON
+            // Round to nearest like the scalar path; the conversion saturates
+            // at full scale
+            const float32x4_t scale = vdupq_n_f32(2147483648.0f);
+            for (; i + 4 <= samples; i += 4) {
+                vst1q_s32(dst + i, vcvtnq_s32_f32(vmulq_f32(vld1q_f32(in + i), scale)));
+            }
+#endif
+            for (; i < samples; i++) {
+                dst[i] = floatToFixed(in[i], 2147483648.0f, INT32_MIN, INT32_MAX);
+            }
+            break;
+        }
+        case PCM_FORMAT_S24_LE: {
+            int32_t* dst = static_cast<int32_t*>(out);
+#ifdef CONVERTER_USE_NEON
+            const int32x4_t max = vdupq_n_s32(8388607);
+            const int32x4_t min = vdupq_n_s32(-8388608);
+            const float32x4_t scale = vdupq_n_f32(8388608.0f);
+            for (; i + 4 <= samples; i += 4) {
+                int32x4_t s = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(in + i), scale));
+                vst1q_s32(dst + i, vmaxq_s32(vminq_s32(s, max), min));
+            }
+#endif
+            for (; i < samples; i++) {
+                dst[i] = floatToFixed(in[i], 8388608.0f, -8388608, 8388607);
+            }
+            break;
+        }
+        case PCM_FORMAT_S24_3LE: {
+            uint8_t* dst = static_cast<uint8_t*>(out);
+            for (; i < samples; i++, dst += 3) {
+                int32_t value = floatToFixed(in[i], 8388608.0f, -8388608, 8388607);
+                dst[0] = value & 0xff;
+                dst[1] = (value >> 8) & 0xff;
+                dst[2] = (value >> 16) & 0xff;
+            }
+            break;
+        }
+        case PCM_FORMAT_FLOAT_LE:
+            memcpy(out, in, samples * sizeof(float));
+            break;
+        default:
+            break;
+    }
+}
+
+// ============================================================================
+// Channel mixing
+// ============================================================================
+
+void mixChannels(const float* in, uint32_t inChannels, float* out, uint32_t outChannels,
+                 size_t frames) {
+    size_t f = 0;
+    if (inChannels == 1 && outChannels == 2) {
+#ifdef CONVERTER_USE_NEON
+        for (; f + 4 <= frames; f += 4) {
+            float32x4_t s = vld1q_f32(in + f);
+            float32x4x2_t pair = {{s, s}};
+            vst2q_f32(out + f * 2, pair);
+        }
+#endif
+        for (; f < frames; f++) {
+            out[f * 2] = in[f];
+            out[f * 2 + 1] = in[f];
+        }
+        return;
+    }
+
+    if (inChannels == 2 && outChannels == 1) {
+#ifdef CONVERTER_USE_NEON
+        const float32x4_t half = vdupq_n_f32(0.5f);
+        for (; f + 4 <= frames; f += 4) {
+            float32x4x2_t pair = vld2q_f32(in + f * 2);
+            vst1q_f32(out + f, vmulq_f32(vaddq_f32(pair.val[0], pair.val[1]), half));
+        }
+#endif
+        for (; f < frames; f++) {
+            out[f] = (in[f * 2] + in[f * 2 + 1]) * 0.5f;
+        }
+        return;
+    }
+
+    // General case: upmix repeats the input channels, downmix averages the
+    // input channels that fold onto each output channel.
+    for (; f < frames; f++) {
+        const float* src = in + f * inChannels;
+        float* dst = out + f * outChannels;
+        if (outChannels > inChannels) {
+            for (uint32_t c = 0; c < outChannels; c++) {
+                dst[c] = src[c % inChannels];
+            }
+        } else {
+            for (uint32_t c = 0; c < outChannels; c++) {
+                float sum = 0.0f;
+                uint32_t count = 0;
+                for (uint32_t i = c; i < inChannels; i += outChannels) {
+                    sum += src[i];
+                    count++;
+                }
+                dst[c] = sum / count;
+            }
+        }
+    }
+}
+
+// ============================================================================
+// Resampler inner loop
+// ============================================================================
+
+// n is a multiple of 8
+inline float dotProduct(const float* a, const float* b, uint32_t n) {
+#ifdef CONVERTER_USE_NEON
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (uint32_t i = 0; i < n; i += 8) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    return vaddvq_f32(vaddq_f32(acc0, acc1));
+#else
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+#endif
+}
+
+}  // namespace
+
+AudioConverter::AudioConverter(const AudioPcmFormat& in, const AudioPcmFormat& out,
+                               Quality quality)
+    : mIn(in), mOut(out) {
+    if (mIn.rate != mOut.rate) {
+        initResampler(quality);
+    }
+    LOG(INFO) << "Converter " << mIn.rate << " Hz " << mIn.channels << " ch fmt " << mIn.format
+              << " -> " << mOut.rate << " Hz " << mOut.channels << " ch fmt " << mOut.format
+              << (mTaps ? ", " + std::to_string(mTaps) + " taps x " +
+                                  std::to_string(mPhases) + " phases"
+                        : std::string());
+}
+
+AudioConverter::Quality AudioConverter::getDefaultQuality() {
+    std::string quality = android::base::GetProperty(RESAMPLER_QUALITY_PROP, "high");
+    if (quality == "low") {
+        return Quality::LOW;
+    }
+    if (quality == "medium") {
+        return Quality::MEDIUM;
+    }
+    return Quality::HIGH;
+}
+
+bool AudioConverter::isFormatSupported(enum pcm_format format) {
+    switch (format) {
+        case PCM_FORMAT_S16_LE:
+        case PCM_FORMAT_S32_LE:
+        case PCM_FORMAT_S24_LE:
+        case PCM_FORMAT_S24_3LE:
+        case PCM_FORMAT_FLOAT_LE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+size_t AudioConverter::getBytesPerSample(enum pcm_format format) {
+    switch (format) {
+        case PCM_FORMAT_S16_LE:
+            return 2;
+        case PCM_FORMAT_S24_3LE:
+            return 3;
+        case PCM_FORMAT_S32_LE:
+        case PCM_FORMAT_S24_LE:
+        case PCM_FORMAT_FLOAT_LE:
+            return 4;
+        default:
+            return 1;
+    }
+}
+
+void AudioConverter::initResampler(Quality quality) {
+    ResamplerDesign design = getDesign(quality);
+    uint32_t gcd = std::gcd(mIn.rate, mOut.rate);
+
+    mTaps = design.taps;
+    mPhases = std::min(mOut.rate / gcd, MAX_PHASES);
+    mCoeffs.resize(static_cast<size_t>(mPhases) * mTaps);
+
+    // Cutoff in cycles per input sample, below the lower of the two Nyquists
+    double cutoff = 0.5 * design.passband * std::min(1.0, double(mOut.rate) / mIn.rate);
+    double half = mTaps / 2.0;
+    double i0Beta = besselI0(design.kaiserBeta);
+
+    for (uint32_t p = 0; p < mPhases; p++) {
+        double frac = double(p) / mPhases;
+        float* coeffs = &mCoeffs[static_cast<size_t>(p) * mTaps];
+        double sum = 0.0;
+        for (uint32_t k = 0; k < mTaps; k++) {
+            // Distance from the interpolated position to tap k
+            double t = (1.0 - half + k) - frac;
+            double x = 2.0 * cutoff * t;
+            double sinc = x == 0.0 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+            double r = t / half;
+            double window = std::abs(r) >= 1.0
+                    ? 0.0 : besselI0(design.kaiserBeta * std::sqrt(1.0 - r * r)) / i0Beta;
+            double h = 2.0 * cutoff * sinc * window;
+            coeffs[k] = static_cast<float>(h);
+            sum += h;
+        }
+        // Unity gain at DC for every branch
+        for (uint32_t k = 0; k < mTaps; k++) {
+            coeffs[k] = static_cast<float>(coeffs[k] / sum);
+        }
+    }
+
+    // Prime the history so the first output is centred on the first input frame
+    mHistory.assign(mOut.channels, std::vector<float>(mTaps / 2 - 1, 0.0f));
+    mIndex = mTaps / 2 - 1;
+    mPhaseAcc = 0;
+}
+
+size_t AudioConverter::resample(const float* in, size_t frames) {
+    const uint32_t channels = mOut.channels;
+    const size_t half = mTaps / 2;
+
+    for (uint32_t c = 0; c < channels; c++) {
+        std::vector<float>& history = mHistory[c];
+        size_t base = history.size();
+        history.resize(base + frames);
+        for (size_t f = 0; f < frames; f++) {
+            history[base + f] = in[f * channels + c];
+        }
+    }
+
+    size_t available = mHistory[0].size();
+    size_t maxFrames = (available - mIndex) * mOut.rate / mIn.rate + 2;
+    if (mResampled.size() < maxFrames * channels) {
+        mResampled.resize(maxFrames * channels);
+    }
+
+    size_t produced = 0;
+    while (mIndex + half < available && produced < maxFrames) {
+        uint32_t phase = static_cast<uint64_t>(mPhaseAcc) * mPhases / mOut.rate;
+        const float* coeffs = &mCoeffs[static_cast<size_t>(phase) * mTaps];
+        for (uint32_t c = 0; c < channels; c++) {
+            mResampled[produced * channels + c] =
+                    dotProduct(&mHistory[c][mIndex + 1 - half], coeffs, mTaps);
+        }
+        produced++;
+
+        mPhaseAcc += mIn.rate;
+        while (mPhaseAcc >= mOut.rate) {
+            mPhaseAcc -= mOut.rate;
+            mIndex++;
+        }
+    }
+
+    // Drop input no longer under the filter
+    size_t consumed = std::min(mIndex + 1 - half, available);
+    for (auto& history : mHistory) {
+        history.erase(history.begin(), history.begin() + consumed);
+    }
+    mIndex -= consumed;
+
+    return produced;
+}
+
+size_t AudioConverter::convert(const void* in, size_t frames, const void** out) {
+    size_t inSamples = frames * mIn.channels;
+    if (mDecoded.size() < inSamples) {
+        mDecoded.resize(inSamples);
+    }
+    decode(in, mIn.format, mDecoded.data(), inSamples);
+
+    const float* data = mDecoded.data();
+    if (mIn.channels != mOut.channels) {
+        size_t mixedSamples = frames * mOut.channels;
+        if (mMixed.size() < mixedSamples) {
+            mMixed.resize(mixedSamples);
+        }
+        mixChannels(data, mIn.channels, mMixed.data(), mOut.channels, frames);
+        data = mMixed.data();
+    }
+
+    if (mTaps) {
+        frames = resample(data, frames);
+        data = mResampled.data();
+    }
+
+    size_t outSamples = frames * mOut.channels;
+    size_t outBytes = outSamples * getBytesPerSample(mOut.format);
+    if (mEncoded.size() < outBytes) {
+        mEncoded.resize(outBytes);
+    }
+    encode(data, mOut.format, mEncoded.data(), outSamples);
+
+    *out = mEncoded.data();
+    return frames;
+}
+
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
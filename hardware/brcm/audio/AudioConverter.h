@@ -0,0 +1,75 @@
+// Copyright (C) 2024 The Android Open Source Project
+// Sample-rate, format and channel conversion for the Raspberry Pi 5 audio HAL
+
+#pragma once
+
+#include <tinyalsa/asoundlib.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace audio {
+
+struct AudioPcmFormat {
+    uint32_t rate;
+    uint32_t channels;
+    enum pcm_format format;
+
+    bool operator==(const AudioPcmFormat& other) const {
+        return rate == other.rate && channels == other.channels && format == other.format;
+    }
+    bool operator!=(const AudioPcmFormat& other) const { return !(*this == other); }
+};
+
+// Converts interleaved PCM between two formats. Samples go through a float
+// pipeline: decode, channel up/down-mix, polyphase resample, encode. Stages
+// that are not needed are skipped.
+//
+// Not thread-safe; each stream owns its converter.
+class AudioConverter {
+public:
+    // Taps per polyphase branch: 8, 16 and 32
+    enum class Quality { LOW, MEDIUM, HIGH };
+
+    AudioConverter(const AudioPcmFormat& in, const AudioPcmFormat& out, Quality quality);
+
+    // ro.vendor.audio.resampler_quality: "low", "medium" or "high" (default)
+    static Quality getDefaultQuality();
+
+    static bool isFormatSupported(enum pcm_format format);
+    static size_t getBytesPerSample(enum pcm_format format);
+
+    // Converts frames of input. Returns the number of output frames produced;
+    // *out points at them until the next call.
+    size_t convert(const void* in, size_t frames, const void** out);
+
+    const AudioPcmFormat& getInputFormat() const { return mIn; }
+    const AudioPcmFormat& getOutputFormat() const { return mOut; }
+
+private:
+    void initResampler(Quality quality);
+    size_t resample(const float* in, size_t frames);
+
+    AudioPcmFormat mIn;
+    AudioPcmFormat mOut;
+
+    // Stage buffers, grown on demand and reused
+    std::vector<float> mDecoded;
+    std::vector<float> mMixed;
+    std::vector<float> mResampled;
+    std::vector<uint8_t> mEncoded;
+
+    // Polyphase resampler; an empty coefficient table means no rate change
+    uint32_t mTaps = 0;
+    uint32_t mPhases = 0;
+    std::vector<float> mCoeffs;                 // mPhases x mTaps
+    std::vector<std::vector<float>> mHistory;   // per channel, planar
+    size_t mIndex = 0;                          // input frame the next output is based on
+    uint32_t mPhaseAcc = 0;                     // fractional position, in 1/outRate units
+};
+
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
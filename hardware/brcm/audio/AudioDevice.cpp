@@ -0,0 +1,371 @@
+// Copyright (C) 2024 The Android Open Source Project
+// ALSA device enumeration and hotplug for the Raspberry Pi 5 audio HAL
+
+#define LOG_TAG "AudioHAL"
+
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <cutils/uevent.h>
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <tuple>
+#include "AudioDevice.h"
+
+namespace android {
+namespace hardware {
+namespace audio {
+
+static const char* ASOUND_CARDS_PATH = "/proc/asound/cards";
+static const char* ASOUND_PATH = "/proc/asound";
+
+// Uevents arrive in bursts when a card appears (card, then each PCM and
+// control node); wait for the burst to settle so ueventd has created the
+// /dev/snd nodes before probing them.
+static const int HOTPLUG_SETTLE_MS = 250;
+static const int UEVENT_BUFFER_SIZE = 64 * 1024;
+
+static const enum pcm_format kProbedFormats[] = {
+    PCM_FORMAT_S16_LE, PCM_FORMAT_S24_LE, PCM_FORMAT_S24_3LE,
+    PCM_FORMAT_S32_LE, PCM_FORMAT_FLOAT_LE,
+};
+
+struct CardInfo {
+    int card;
+    std::string id;
+    std::string driver;
+    std::string name;
+};
+
+// Parses /proc/asound/cards, whose entries look like:
+//  0 [vc4hdmi0       ]: vc4-hdmi - vc4-hdmi-0
+//                       vc4-hdmi-0
+static std::vector<CardInfo> readCards() {
+    std::vector<CardInfo> cards;
+    std::ifstream file(ASOUND_CARDS_PATH);
+    std::string line;
+    while (std::getline(file, line)) {
+        int card;
+        char id[64];
+        int consumed = 0;
+        if (sscanf(line.c_str(), " %d [%63[^]]]: %n", &card, id, &consumed) != 2 ||
+            consumed == 0) {
+            continue;
+        }
+        // Driver names may contain '-' themselves, so split on " - "
+        std::string rest = line.substr(consumed);
+        size_t separator = rest.find(" - ");
+        if (separator == std::string::npos) {
+            continue;
+        }
+        cards.push_back({card, android::base::Trim(id),
+                         android::base::Trim(rest.substr(0, separator)),
+                         android::base::Trim(rest.substr(separator + 3))});
+    }
+    return cards;
+}
+
+// Playback and capture PCM devices of a card, from its pcmD[pc] entries
+static void readPcms(int card, std::vector<int>* playback, std::vector<int>* capture) {
+    std::string path = std::string(ASOUND_PATH) + "/card" + std::to_string(card);
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        int device;
+        char direction;
+        if (sscanf(entry->d_name, "pcm%d%c", &device, &direction) != 2) {
+            continue;
+        }
+        if (direction == 'p') {
+            playback->push_back(device);
+        } else if (direction == 'c') {
+            capture->push_back(device);
+        }
+    }
+    closedir(dir);
+}
+
+// Maps a card to the audio device type the policy knows it as. Returns
+// AUDIO_DEVICE_NONE for cards that should not be routed to.
+static audio_devices_t classifyCard(const CardInfo& card, bool output) {
+    const std::string& driver = card.driver;
+
+    if (driver == "USB-Audio") {
+        return output ? AUDIO_DEVICE_OUT_USB_DEVICE : AUDIO_DEVICE_IN_USB_DEVICE;
+    }
+    if (driver == "Loopback") {
+        // snd-aloop is for tooling, never a routing target
+        return AUDIO_DEVICE_NONE;
+    }
+    if (android::base::StartsWith(driver, "vc4-hdmi") ||
+        android::base::StartsWith(card.id, "vc4hdmi")) {
+        return output ? AUDIO_DEVICE_OUT_AUX_DIGITAL : AUDIO_DEVICE_NONE;
+    }
+    if (android::base::StartsWith(driver, "bcm2835")) {
+        return output ? AUDIO_DEVICE_OUT_WIRED_HEADPHONE : AUDIO_DEVICE_NONE;
+    }
+    // I2S HATs (simple-card and the HiFiBerry/IQaudio machine drivers) are
+    // the board's built-in speaker and microphone
+    return output ? AUDIO_DEVICE_OUT_SPEAKER : AUDIO_DEVICE_IN_BUILTIN_MIC;
+}
+
+static bool probeCapabilities(int card, int device, bool output,
+                              AudioDeviceCapabilities* caps) {
+    struct pcm_params* params = pcm_params_get(card, device, output ? PCM_OUT : PCM_IN);
+    if (!params) {
+        return false;
+    }
+    caps->minRate = pcm_params_get_min(params, PCM_PARAM_RATE);
+    caps->maxRate = pcm_params_get_max(params, PCM_PARAM_RATE);
+    caps->minChannels = pcm_params_get_min(params, PCM_PARAM_CHANNELS);
+    caps->maxChannels = pcm_params_get_max(params, PCM_PARAM_CHANNELS);
+    caps->formats.clear();
+    for (enum pcm_format format : kProbedFormats) {
+        if (pcm_params_format_test(params, format)) {
+            caps->formats.push_back(format);
+        }
+    }
+    pcm_params_free(params);
+    return true;
+}
+
+static void logDevice(const char* direction, const AudioDeviceInfo& info) {
+    LOG(INFO) << direction << " " << info.name << " (" << info.cardId << ") card "
+              << info.card << " device " << info.device << " type 0x" << std::hex
+              << info.type << std::dec << ": " << info.caps.minRate << "-"
+              << info.caps.maxRate << " Hz, " << info.caps.minChannels << "-"
+              << info.caps.maxChannels << " ch, " << info.caps.formats.size() << " formats";
+}
+
+AudioDeviceManager::AudioDeviceManager() {
+    scan();
+}
+
+AudioDeviceManager::~AudioDeviceManager() {
+    stopHotplugMonitor();
+}
+
+void AudioDeviceManager::scan() {
+    std::vector<AudioDeviceInfo> outputs;
+    std::vector<AudioDeviceInfo> inputs;
+
+    // PCMs already open (by us or anyone else) cannot be probed; keep what
+    // the previous scan found for them.
+    std::map<std::tuple<std::string, int, bool>, AudioDeviceCapabilities> previous;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        for (const auto& info : mOutputDevices) {
+            previous[{info.cardId, info.device, true}] = info.caps;
+        }
+        for (const auto& info : mInputDevices) {
+            previous[{info.cardId, info.device, false}] = info.caps;
+        }
+    }
+
+    auto addDevices = [&](const CardInfo& card, const std::vector<int>& pcms, bool output,
+                          std::vector<AudioDeviceInfo>* list) {
+        audio_devices_t type = classifyCard(card, output);
+        if (type == AUDIO_DEVICE_NONE) {
+            return;
+        }
+        for (int device : pcms) {
+            AudioDeviceInfo info = {
+                .name = card.name,
+                .card = card.card,
+                .device = device,
+                .type = type,
+                .cardId = card.id,
+                .driver = card.driver,
+            };
+            if (!probeCapabilities(card.card, device, output, &info.caps)) {
+                auto it = previous.find({card.id, device, output});
+                if (it != previous.end()) {
+                    info.caps = it->second;
+                }
+            }
+            list->push_back(std::move(info));
+        }
+    };
+
+    for (const CardInfo& card : readCards()) {
+        std::vector<int> playback;
+        std::vector<int> capture;
+        readPcms(card.card, &playback, &capture);
+        std::sort(playback.begin(), playback.end());
+        std::sort(capture.begin(), capture.end());
+        addDevices(card, playback, true, &outputs);
+        addDevices(card, capture, false, &inputs);
+    }
+
+    for (const auto& info : outputs) {
+        logDevice("Output", info);
+    }
+    for (const auto& info : inputs) {
+        logDevice("Input", info);
+    }
+    LOG(INFO) << "Found " << outputs.size() << " output devices, "
+              << inputs.size() << " input devices";
+
+    std::lock_guard<std::mutex> lock(mLock);
+    mOutputDevices = std::move(outputs);
+    mInputDevices = std::move(inputs);
+}
+
+static bool findDevice(const std::vector<AudioDeviceInfo>& list, audio_devices_t devices,
+                       AudioDeviceInfo* info) {
+    // Device types are enumerated values, not bit masks: input types share
+    // AUDIO_DEVICE_IN_BIT and overlap in their other bits, so only an exact
+    // match is a match
+    for (const auto& dev : list) {
+        if (devices == AUDIO_DEVICE_NONE || dev.type == devices) {
+            *info = dev;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AudioDeviceManager::findOutputDevice(audio_devices_t devices, AudioDeviceInfo* info) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return findDevice(mOutputDevices, devices, info);
+}
+
+bool AudioDeviceManager::findInputDevice(audio_devices_t devices, AudioDeviceInfo* info) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return findDevice(mInputDevices, devices, info);
+}
+
+std::vector<AudioDeviceInfo> AudioDeviceManager::getOutputDevices() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mOutputDevices;
+}
+
+std::vector<AudioDeviceInfo> AudioDeviceManager::getInputDevices() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mInputDevices;
+}
+
+// ============================================================================
+// Hotplug
+// ============================================================================
+
+bool AudioDeviceManager::startHotplugMonitor(ChangeCallback onChange) {
+    if (mRunning) {
+        return true;
+    }
+
+    mUeventFd = uevent_open_socket(UEVENT_BUFFER_SIZE, true);
+    if (mUeventFd < 0) {
+        PLOG(ERROR) << "Failed to open uevent socket";
+        return false;
+    }
+    mWakeFd = eventfd(0, EFD_CLOEXEC);
+    if (mWakeFd < 0) {
+        PLOG(ERROR) << "Failed to create eventfd";
+        close(mUeventFd);
+        mUeventFd = -1;
+        return false;
+    }
+
+    mOnChange = std::move(onChange);
+    mRunning = true;
+    mHotplugThread = std::thread(&AudioDeviceManager::hotplugThreadFunc, this);
+    LOG(INFO) << "Audio hotplug monitor started";
+    return true;
+}
+
+void AudioDeviceManager::stopHotplugMonitor() {
+    if (!mRunning) {
+        return;
+    }
+    mRunning = false;
+    uint64_t value = 1;
+    if (::write(mWakeFd, &value, sizeof(value)) != sizeof(value)) {
+        PLOG(WARNING) << "Failed to wake hotplug thread";
+    }
+    if (mHotplugThread.joinable()) {
+        mHotplugThread.join();
+    }
+    close(mUeventFd);
+    close(mWakeFd);
+    mUeventFd = -1;
+    mWakeFd = -1;
+}
+
+// True for add/remove events of an ALSA control node, which come and go with the card
+static bool isSoundCardEvent(const char* msg, ssize_t length) {
+    bool sound = false;
+    bool control = false;
+    bool addOrRemove = false;
+    for (const char* p = msg; p < msg + length; p += strlen(p) + 1) {
+        if (!strcmp(p, "SUBSYSTEM=sound")) {
+            sound = true;
+        } else if (!strncmp(p, "DEVNAME=snd/controlC", 20)) {
+            control = true;
+        } else if (!strcmp(p, "ACTION=add") || !strcmp(p, "ACTION=remove")) {
+            addOrRemove = true;
+        }
+    }
+    return sound && control && addOrRemove;
+}
+
+void AudioDeviceManager::hotplugThreadFunc() {
+    char msg[2048];
+    bool pending = false;
+
+    struct pollfd fds[2] = {
+        {.fd = mUeventFd, .events = POLLIN},
+        {.fd = mWakeFd, .events = POLLIN},
+    };
+
+    while (mRunning) {
+        int ret = poll(fds, 2, pending ? HOTPLUG_SETTLE_MS : -1);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            PLOG(ERROR) << "Hotplug poll failed";
+            break;
+        }
+
+        if (ret == 0) {
+            // Burst settled
+            pending = false;
+            scan();
+            if (mOnChange) {
+                mOnChange();
+            }
+            continue;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            // Only accepts messages sent by the kernel
+            ssize_t length = uevent_kernel_multicast_recv(mUeventFd, msg, sizeof(msg) - 1);
+            if (length <= 0) {
+                continue;
+            }
+            msg[length] = '\0';
+            if (isSoundCardEvent(msg, length)) {
+                pending = true;
+            }
+        }
+    }
+}
+
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,79 @@
+// Copyright (C) 2024 The Android Open Source Project
+// ALSA device enumeration and hotplug for the Raspberry Pi 5 audio HAL
+
+#pragma once
+
+#include <system/audio.h>
+#include <tinyalsa/asoundlib.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace audio {
+
+// Hardware limits reported by pcm_params; all zero if the PCM could not be probed
+struct AudioDeviceCapabilities {
+    unsigned int minRate = 0;
+    unsigned int maxRate = 0;
+    unsigned int minChannels = 0;
+    unsigned int maxChannels = 0;
+    std::vector<enum pcm_format> formats;
+};
+
+struct AudioDeviceInfo {
+    std::string name;
+    int card;
+    int device;
+    audio_devices_t type;
+    std::string cardId;         // ALSA card id, e.g. "vc4hdmi0"
+    std::string driver;         // ALSA driver name, e.g. "USB-Audio"
+    AudioDeviceCapabilities caps;
+};
+
+// Builds the device list from /proc/asound: one entry per playback or capture
+// PCM of every card, typed from the card driver and probed for capabilities.
+// A uevent listener rescans when sound cards come and go.
+class AudioDeviceManager {
+public:
+    using ChangeCallback = std::function<void()>;
+
+    AudioDeviceManager();
+    ~AudioDeviceManager();
+
+    void scan();
+
+    // Starts the hotplug listener; onChange runs on the listener thread after
+    // each rescan.
+    bool startHotplugMonitor(ChangeCallback onChange);
+    void stopHotplugMonitor();
+
+    // First device of exactly the requested type; AUDIO_DEVICE_NONE takes the
+    // first device present
+    bool findOutputDevice(audio_devices_t devices, AudioDeviceInfo* info) const;
+    bool findInputDevice(audio_devices_t devices, AudioDeviceInfo* info) const;
+
+    std::vector<AudioDeviceInfo> getOutputDevices() const;
+    std::vector<AudioDeviceInfo> getInputDevices() const;
+
+private:
+    void hotplugThreadFunc();
+
+    mutable std::mutex mLock;
+    std::vector<AudioDeviceInfo> mOutputDevices;
+    std::vector<AudioDeviceInfo> mInputDevices;
+
+    std::thread mHotplugThread;
+    std::atomic<bool> mRunning{false};
+    int mUeventFd = -1;
+    int mWakeFd = -1;
+    ChangeCallback mOnChange;
+};
+
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
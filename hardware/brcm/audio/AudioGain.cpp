@@ -0,0 +1,202 @@
+// Copyright (C) 2024 The Android Open Source Project
+// Output gain stage for the Raspberry Pi 5 audio HAL
+
+#define LOG_TAG "AudioHAL"
+
+#include <android-base/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "AudioGain.h"
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define GAIN_USE_NEON 1
+#endif
+
+namespace android {
+namespace hardware {
+namespace audio {
+
+namespace {
+
+inline int16_t applySample(int16_t sample, float gain) {
+    long value = std::lrintf(sample * gain);
+    return static_cast<int16_t>(std::clamp(value, -32768L, 32767L));
+}
+
+inline float applySample(float sample, float gain) {
+    return sample * gain;
+}
+
+// Scalar reference path, also used for the tail the vector loop leaves over.
+// Gain for frame f of channel c is gain[c] + step[c] * f.
+template <typename T>
+void applyGainScalar(const T* in, T* out, size_t firstFrame, size_t frames,
+                     uint32_t channelCount, const float* gain, const float* step) {
+    for (size_t f = firstFrame; f < frames; f++) {
+        for (uint32_t c = 0; c < channelCount; c++) {
+            size_t i = f * channelCount + c;
+            out[i] = applySample(in[i], gain[c] + step[c] * f);
+        }
+    }
+}
+
+#ifdef GAIN_USE_NEON
+// Per-sample gains for the first four samples and their advance per four
+// samples. Interleaved stereo covers two frames per vector, mono four.
+void buildGainVectors(uint32_t channelCount, const float* gain, const float* step,
+                      float32x4_t* g, float32x4_t* inc) {
+    if (channelCount == 1) {
+        const float lanes[4] = {gain[0], gain[0] + step[0], gain[0] + 2 * step[0],
+                                gain[0] + 3 * step[0]};
+        *g = vld1q_f32(lanes);
+        *inc = vdupq_n_f32(4 * step[0]);
+    } else {
+        const float lanes[4] = {gain[0], gain[1], gain[0] + step[0], gain[1] + step[1]};
+        const float steps[4] = {2 * step[0], 2 * step[1], 2 * step[0], 2 * step[1]};
+        *g = vld1q_f32(lanes);
+        *inc = vld1q_f32(steps);
+    }
+}
+
+// Returns the number of samples processed; always a whole number of frames
+size_t applyGainNeon(const int16_t* in, int16_t* out, size_t samples,
+                     float32x4_t g, float32x4_t inc) {
+    const float32x4_t inc2 = vaddq_f32(inc, inc);
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        int16x8_t s = vld1q_s16(in + i);
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+        lo = vmulq_f32(lo, g);
+        hi = vmulq_f32(hi, vaddq_f32(g, inc));
+        g = vaddq_f32(g, inc2);
+        // Round to nearest, then saturate on the narrowing
+        int16x8_t r = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(lo)),
+                                   vqmovn_s32(vcvtnq_s32_f32(hi)));
+        vst1q_s16(out + i, r);
+    }
+    return i;
+}
+
+size_t applyGainNeon(const float* in, float* out, size_t samples,
+                     float32x4_t g, float32x4_t inc) {
+    const float32x4_t inc2 = vaddq_f32(inc, inc);
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        float32x4_t lo = vld1q_f32(in + i);
+        float32x4_t hi = vld1q_f32(in + i + 4);
+        vst1q_f32(out + i, vmulq_f32(lo, g));
+        vst1q_f32(out + i + 4, vmulq_f32(hi, vaddq_f32(g, inc)));
+        g = vaddq_f32(g, inc2);
+    }
+    return i;
+}
+#endif
+
+template <typename T>
+void applyGain(const T* in, T* out, size_t frames, uint32_t channelCount,
+               const float* gain, const float* step) {
+    size_t firstFrame = 0;
+#ifdef GAIN_USE_NEON
+    float32x4_t g;
+    float32x4_t inc;
+    buildGainVectors(channelCount, gain, step, &g, &inc);
+    firstFrame = applyGainNeon(in, out, frames * channelCount, g, inc) / channelCount;
+#endif
+    applyGainScalar(in, out, firstFrame, frames, channelCount, gain, step);
+}
+
+}  // namespace
+
+GainStage::GainStage(uint32_t channelCount, uint32_t sampleRate)
+    : mChannelCount(std::clamp<uint32_t>(channelCount, 1, 2)),
+      mRampFrames(std::max<uint32_t>(sampleRate * kRampMs / 1000, 1)) {
+    if (channelCount != mChannelCount) {
+        LOG(WARNING) << "GainStage supports mono and stereo, got " << channelCount
+                     << " channels";
+    }
+}
+
+void GainStage::setGain(float left, float right) {
+    mTargetLeft.store(left, std::memory_order_relaxed);
+    mTargetRight.store(right, std::memory_order_relaxed);
+}
+
+bool GainStage::isUnity() const {
+    return mRampRemaining == 0 && mCurrent[0] == 1.0f && mCurrent[1] == 1.0f &&
+           mTargetLeft.load(std::memory_order_relaxed) == 1.0f &&
+           (mChannelCount == 1 || mTargetRight.load(std::memory_order_relaxed) == 1.0f);
+}
+
+void GainStage::latchTarget() {
+    float left = mTargetLeft.load(std::memory_order_relaxed);
+    float right = mChannelCount == 1 ? left : mTargetRight.load(std::memory_order_relaxed);
+    if (left == mTarget[0] && right == mTarget[1]) {
+        return;
+    }
+
+    // Ramp from wherever the previous ramp got to
+    mTarget[0] = left;
+    mTarget[1] = right;
+    for (int c = 0; c < 2; c++) {
+        mStep[c] = (mTarget[c] - mCurrent[c]) / mRampFrames;
+    }
+    mRampRemaining = mRampFrames;
+}
+
+template <typename T>
+void GainStage::processFrames(const T* in, T* out, size_t frames) {
+    size_t done = 0;
+
+    if (mRampRemaining > 0) {
+        size_t n = std::min<size_t>(frames, mRampRemaining);
+        applyGain(in, out, n, mChannelCount, mCurrent, mStep);
+        mRampRemaining -= n;
+        for (int c = 0; c < 2; c++) {
+            mCurrent[c] = mRampRemaining == 0 ? mTarget[c] : mCurrent[c] + mStep[c] * n;
+        }
+        done = n;
+    }
+
+    if (done == frames) {
+        return;
+    }
+
+    size_t offset = done * mChannelCount;
+    size_t samples = (frames - done) * mChannelCount;
+    if (mCurrent[0] == 0.0f && mCurrent[1] == 0.0f) {
+        memset(out + offset, 0, samples * sizeof(T));
+    } else if (mCurrent[0] == 1.0f && mCurrent[1] == 1.0f) {
+        // A ramp back to unity finished inside this buffer
+        if (in != out) {
+            memcpy(out + offset, in + offset, samples * sizeof(T));
+        }
+    } else {
+        static const float kNoStep[2] = {0.0f, 0.0f};
+        applyGain(in + offset, out + offset, frames - done, mChannelCount, mCurrent, kNoStep);
+    }
+}
+
+bool GainStage::process(const int16_t* in, int16_t* out, size_t frames) {
+    latchTarget();
+    if (isUnity()) {
+        return false;
+    }
+    processFrames(in, out, frames);
+    return true;
+}
+
+bool GainStage::process(const float* in, float* out, size_t frames) {
+    latchTarget();
+    if (isUnity()) {
+        return false;
+    }
+    processFrames(in, out, frames);
+    return true;
+}
+
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
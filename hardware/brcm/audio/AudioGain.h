@@ -0,0 +1,59 @@
+// Copyright (C) 2024 The Android Open Source Project
+// Output gain stage for the Raspberry Pi 5 audio HAL
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace android {
+namespace hardware {
+namespace audio {
+
+// Applies per-channel gain to interleaved PCM. Gain changes are ramped
+// linearly per sample over a short window to avoid zipper noise; unity and
+// silent gains are detected so the common cases cost no per-sample work.
+//
+// setGain() may be called from any thread; process() from the stream's
+// write thread only.
+class GainStage {
+public:
+    // Ramp length for gain changes
+    static constexpr uint32_t kRampMs = 5;
+
+    GainStage(uint32_t channelCount, uint32_t sampleRate);
+
+    void setGain(float left, float right);
+
+    // True when process() would leave the samples untouched
+    bool isUnity() const;
+
+    // Out-of-place processing; in and out may alias. Returns false when the
+    // stage is at unity and nothing was written, so the caller can use the
+    // input buffer directly.
+    bool process(const int16_t* in, int16_t* out, size_t frames);
+    bool process(const float* in, float* out, size_t frames);
+
+private:
+    void latchTarget();
+
+    template <typename T>
+    void processFrames(const T* in, T* out, size_t frames);
+
+    uint32_t mChannelCount;
+    uint32_t mRampFrames;
+
+    std::atomic<float> mTargetLeft{1.0f};
+    std::atomic<float> mTargetRight{1.0f};
+
+    // Owned by the write thread
+    float mCurrent[2] = {1.0f, 1.0f};
+    float mTarget[2] = {1.0f, 1.0f};
+    float mStep[2] = {0.0f, 0.0f};
+    uint32_t mRampRemaining = 0;
+};
+
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
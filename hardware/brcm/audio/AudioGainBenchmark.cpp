@@ -0,0 +1,63 @@
+// Copyright (C) 2024 The Android Open Source Project
+// Microbenchmark for the audio HAL gain stage
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <vector>
+#include "AudioGain.h"
+
+using android::hardware::audio::GainStage;
+
+static constexpr uint32_t kSampleRate = 48000;
+static constexpr uint32_t kChannels = 2;
+static constexpr size_t kFrames = 192;
+
+// Per-frame cost is reported as the "per_frame" counter, in seconds per frame
+// (so a "12.5n" reading is 12.5 ns per frame)
+static void setPerFrameCounter(benchmark::State& state) {
+    state.counters["per_frame"] = benchmark::Counter(
+            static_cast<double>(kFrames),
+            benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+}
+
+template <typename T>
+static std::vector<T> makeInput() {
+    std::vector<T> input(kFrames * kChannels);
+    for (size_t i = 0; i < input.size(); i++) {
+        input[i] = static_cast<T>((i * 37) % 2000);
+    }
+    return input;
+}
+
+// state.range(0): 0 = unity, 1 = constant gain, 2 = continuous ramping
+template <typename T>
+static void BM_GainStage(benchmark::State& state) {
+    GainStage gain(kChannels, kSampleRate);
+    std::vector<T> input = makeInput<T>();
+    std::vector<T> output(input.size());
+    int mode = state.range(0);
+
+    if (mode == 1) {
+        gain.setGain(0.5f, 0.7f);
+        // Run out the initial ramp
+        for (uint32_t i = 0; i < kSampleRate; i += kFrames) {
+            gain.process(input.data(), output.data(), kFrames);
+        }
+    }
+
+    bool toggle = false;
+    for (auto _ : state) {
+        if (mode == 2) {
+            toggle = !toggle;
+            gain.setGain(toggle ? 0.25f : 0.75f, toggle ? 0.75f : 0.25f);
+        }
+        benchmark::DoNotOptimize(gain.process(input.data(), output.data(), kFrames));
+        benchmark::ClobberMemory();
+    }
+    setPerFrameCounter(state);
+}
+
+BENCHMARK_TEMPLATE(BM_GainStage, int16_t)->Arg(0)->Arg(1)->Arg(2);
+BENCHMARK_TEMPLATE(BM_GainStage, float)->Arg(0)->Arg(1)->Arg(2);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,393 @@
+// Copyright (C) 2024 The Android Open Source Project
+// Round-trip latency benchmark for the Raspberry Pi 5 audio HAL
+//
+// Plays a test signal through AudioStreamOut and captures it back through
+// AudioStreamIn over a loopback: a cable from an output to an input, or the
+// snd-aloop driver (modprobe snd-aloop), whose playback device 0 is captured
+// on device 1 of the same card. Reads and writes run in lockstep in a single
+// thread, so the offset of the signal in the captured stream is the round
+// trip an application doing full-duplex I/O would see.
+//
+// For each period size / period count pair the signal is sent several times
+// on the same open streams; the report gives the mean round trip, its
+// spread (jitter), the xruns seen and bursts that could not be found.
+
+#define LOG_TAG "audio_latency_bench"
+
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Audio.h"
+#include "AudioConverter.h"
+
+using namespace android::hardware::audio;
+
+static const uint32_t SAMPLE_RATE = 48000;
+static const uint32_t OUT_CHANNELS = 2;
+static const int MLS_ORDER = 12;                // 4095-sample sequence
+static const uint32_t MLS_TAPS = 0xE08;         // Galois taps, maximal for 12 bits
+static const float SIGNAL_AMPLITUDE = 0.5f;
+static const uint32_t PREROLL_MS = 300;         // lets both streams settle
+static const uint32_t BURST_GAP_MS = 400;       // longest round trip we look for
+static const double MIN_CORRELATION = 0.5;     // below this a burst counts as missed
+
+struct Options {
+    int outCard = -1;
+    int outDevice = 0;
+    int inCard = -1;
+    int inDevice = 1;
+    bool impulse = false;
+    int trials = 10;
+    std::vector<unsigned int> periodSizes = {48, 96, 192, 256, 512, 1024};
+    std::vector<unsigned int> periodCounts = {2, 3, 4};
+};
+
+struct Result {
+    unsigned int periodSize;
+    unsigned int periodCount;
+    std::vector<double> latenciesMs;
+    int missed = 0;
+    uint32_t underruns = 0;
+    uint32_t overruns = 0;
+    bool failed = false;
+};
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -o CARD:DEVICE   playback PCM (default: snd-aloop card, device 0)\n"
+            "  -i CARD:DEVICE   capture PCM (default: snd-aloop card, device 1)\n"
+            "  -p SIZES         period sizes in frames, comma separated\n"
+            "  -n COUNTS        period counts, comma separated\n"
+            "  -t TRIALS        bursts per configuration (default 10)\n"
+            "  -s mls|impulse   test signal (default mls)\n"
+            "  -l               list the devices the HAL enumerates and exit\n",
+            name);
+}
+
+static bool parsePcm(const char* arg, int* card, int* device) {
+    std::vector<std::string> parts = android::base::Split(arg, ":");
+    return parts.size() == 2 && android::base::ParseInt(parts[0], card, 0) &&
+           android::base::ParseInt(parts[1], device, 0);
+}
+
+static bool parseList(const char* arg, std::vector<unsigned int>* values) {
+    values->clear();
+    for (const std::string& part : android::base::Split(arg, ",")) {
+        unsigned int value;
+        if (!android::base::ParseUint(part, &value, 1u << 16) || value == 0) {
+            return false;
+        }
+        values->push_back(value);
+    }
+    return !values->empty();
+}
+
+// snd-aloop registers its card with the "Loopback" driver name
+static int findLoopbackCard() {
+    std::ifstream file("/proc/asound/cards");
+    std::string line;
+    while (std::getline(file, line)) {
+        int card;
+        if (sscanf(line.c_str(), " %d [", &card) == 1 &&
+            line.find("]: Loopback") != std::string::npos) {
+            return card;
+        }
+    }
+    return -1;
+}
+
+// Inverse of the HAL's getAudioFormat(), for the formats a stream reports
+static enum pcm_format getPcmFormat(audio_format_t format) {
+    switch (format) {
+        case AUDIO_FORMAT_PCM_32_BIT:
+            return PCM_FORMAT_S32_LE;
+        case AUDIO_FORMAT_PCM_8_24_BIT:
+            return PCM_FORMAT_S24_LE;
+        case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+            return PCM_FORMAT_S24_3LE;
+        case AUDIO_FORMAT_PCM_FLOAT:
+            return PCM_FORMAT_FLOAT_LE;
+        case AUDIO_FORMAT_PCM_16_BIT:
+        default:
+            return PCM_FORMAT_S16_LE;
+    }
+}
+
+// Maximum length sequence from a Galois LFSR, as +/-1
+static std::vector<float> makeMls() {
+    uint32_t state = 1;
+    std::vector<float> sequence((1u << MLS_ORDER) - 1);
+    for (float& sample : sequence) {
+        sample = (state & 1) ? 1.0f : -1.0f;
+        state = (state >> 1) ^ ((state & 1) ? MLS_TAPS : 0);
+    }
+    return sequence;
+}
+
+// Offset in window with the highest normalized correlation against signal.
+// An impulse is located by its peak, scored against the level it was sent at.
+static size_t findSignal(const std::vector<float>& window, const std::vector<float>& signal,
+                         double* correlation) {
+    if (signal.size() == 1) {
+        auto peak = std::max_element(window.begin(), window.end(), [](float a, float b) {
+            return std::abs(a) < std::abs(b);
+        });
+        *correlation = std::abs(*peak) / SIGNAL_AMPLITUDE;
+        return peak - window.begin();
+    }
+
+    double signalEnergy = 0.0;
+    for (float s : signal) {
+        signalEnergy += s * s;
+    }
+
+    size_t best = 0;
+    double bestScore = 0.0;
+    for (size_t offset = 0; offset + signal.size() <= window.size(); offset++) {
+        double sum = 0.0;
+        double energy = 0.0;
+        for (size_t i = 0; i < signal.size(); i++) {
+            float x = window[offset + i];
+            sum += x * signal[i];
+            energy += x * x;
+        }
+        double score = energy > 0.0 ? std::abs(sum) / std::sqrt(signalEnergy * energy) : 0.0;
+        if (score > bestScore) {
+            bestScore = score;
+            best = offset;
+        }
+    }
+    *correlation = bestScore;
+    return best;
+}
+
+static Result runConfig(const Options& options, const std::vector<float>& signal,
+                        unsigned int periodSize, unsigned int periodCount) {
+    Result result = {.periodSize = periodSize, .periodCount = periodCount};
+
+    AudioPcmProfile outProfile = AudioHAL::getOutputProfile(AUDIO_OUTPUT_FLAG_FAST);
+    outProfile.periodSize = periodSize;
+    outProfile.periodCount = periodCount;
+    outProfile.startThreshold = periodSize;
+    outProfile.mmap = false;
+
+    AudioPcmProfile inProfile = AudioHAL::getInputProfile(AUDIO_INPUT_FLAG_FAST);
+    inProfile.periodSize = periodSize;
+    inProfile.periodCount = periodCount;
+    inProfile.mmap = false;
+
+    struct audio_config outConfig = {};
+    outConfig.sample_rate = SAMPLE_RATE;
+    struct audio_config inConfig = {};
+    inConfig.sample_rate = SAMPLE_RATE;
+    inConfig.channel_mask = AUDIO_CHANNEL_IN_MONO;
+
+    AudioStreamOut out(options.outCard, options.outDevice, &outConfig, outProfile);
+    AudioStreamIn in(options.inCard, options.inDevice, &inConfig, inProfile);
+
+    // A FAST input owns its PCM and reports the device's native layout, which
+    // on most capture hardware is stereo and may be wider than 16 bits. Blocks
+    // are read in that layout and converted to mono S16 for the correlation.
+    // Reads and writes stay in lockstep only if both sides run at one rate.
+    if (inConfig.sample_rate != SAMPLE_RATE) {
+        fprintf(stderr, "Capture runs at %u Hz, not %u Hz\n", inConfig.sample_rate,
+                SAMPLE_RATE);
+        result.failed = true;
+        return result;
+    }
+    const AudioPcmFormat inFormat = {inConfig.sample_rate,
+                                     audio_channel_count_from_in_mask(inConfig.channel_mask),
+                                     getPcmFormat(inConfig.format)};
+    const AudioPcmFormat monoFormat = {SAMPLE_RATE, 1, PCM_FORMAT_S16_LE};
+    std::unique_ptr<AudioConverter> inConverter;
+    if (inFormat != monoFormat) {
+        inConverter = std::make_unique<AudioConverter>(inFormat, monoFormat,
+                                                       AudioConverter::Quality::LOW);
+    }
+
+    const size_t prerollBlocks = (SAMPLE_RATE * PREROLL_MS / 1000 + periodSize - 1) / periodSize;
+    const size_t burstFrames = signal.size() + SAMPLE_RATE * BURST_GAP_MS / 1000;
+    const size_t burstBlocks = (burstFrames + periodSize - 1) / periodSize;
+    const size_t totalBlocks = prerollBlocks + burstBlocks * options.trials;
+
+    std::vector<int16_t> outBlock(periodSize * OUT_CHANNELS);
+    std::vector<uint8_t> inBlock(periodSize * inFormat.channels *
+                                 audio_bytes_per_sample(inConfig.format));
+    std::vector<float> captured;
+    captured.reserve(totalBlocks * periodSize);
+
+    for (size_t block = 0; block < totalBlocks; block++) {
+        // Output frame index of the start of this block, relative to the first burst
+        std::fill(outBlock.begin(), outBlock.end(), 0);
+        if (block >= prerollBlocks) {
+            size_t frame = (block - prerollBlocks) * periodSize;
+            for (size_t i = 0; i < periodSize; i++) {
+                size_t position = (frame + i) % (burstBlocks * periodSize);
+                if (position < signal.size()) {
+                    int16_t sample = static_cast<int16_t>(
+                            std::lrintf(signal[position] * SIGNAL_AMPLITUDE * 32767.0f));
+                    for (uint32_t c = 0; c < OUT_CHANNELS; c++) {
+                        outBlock[i * OUT_CHANNELS + c] = sample;
+                    }
+                }
+            }
+        }
+
+        if (in.read(inBlock.data(), inBlock.size()) < 0 ||
+            out.write(outBlock.data(), outBlock.size() * sizeof(int16_t)) < 0) {
+            result.failed = true;
+            return result;
+        }
+        const void* mono = inBlock.data();
+        size_t frames = periodSize;
+        if (inConverter) {
+            frames = inConverter->convert(inBlock.data(), periodSize, &mono);
+        }
+        const int16_t* samples = static_cast<const int16_t*>(mono);
+        for (size_t i = 0; i < frames; i++) {
+            captured.push_back(samples[i] / 32768.0f);
+        }
+    }
+
+    for (int trial = 0; trial < options.trials; trial++) {
+        size_t sent = (prerollBlocks + trial * burstBlocks) * periodSize;
+        size_t end = std::min(captured.size(), sent + burstBlocks * periodSize);
+        if (end <= sent + signal.size()) {
+            result.missed++;
+            continue;
+        }
+        std::vector<float> window(captured.begin() + sent, captured.begin() + end);
+        double correlation;
+        size_t lag = findSignal(window, signal, &correlation);
+        if (correlation < MIN_CORRELATION) {
+            result.missed++;
+            continue;
+        }
+        result.latenciesMs.push_back(lag * 1000.0 / SAMPLE_RATE);
+    }
+
+    result.underruns = out.getUnderruns();
+    result.overruns = in.getOverruns();
+    return result;
+}
+
+static void printResult(const Result& result) {
+    if (result.failed) {
+        printf("%7u %6u  %s\n", result.periodSize, result.periodCount, "stream error");
+        return;
+    }
+    if (result.latenciesMs.empty()) {
+        printf("%7u %6u  %8s %8s %8s %8s %7u %7u %6d\n", result.periodSize,
+               result.periodCount, "-", "-", "-", "-", result.underruns, result.overruns,
+               result.missed);
+        return;
+    }
+
+    double sum = 0.0;
+    for (double latency : result.latenciesMs) {
+        sum += latency;
+    }
+    double mean = sum / result.latenciesMs.size();
+    double variance = 0.0;
+    for (double latency : result.latenciesMs) {
+        variance += (latency - mean) * (latency - mean);
+    }
+    double jitter = std::sqrt(variance / result.latenciesMs.size());
+    auto [min, max] = std::minmax_element(result.latenciesMs.begin(), result.latenciesMs.end());
+
+    printf("%7u %6u  %8.2f %8.2f %8.2f %8.3f %7u %7u %6d\n", result.periodSize,
+           result.periodCount, mean, *min, *max, jitter, result.underruns, result.overruns,
+           result.missed);
+}
+
+static void listDevices() {
+    AudioHAL hal;
+    for (const auto& info : hal.getOutputDevices()) {
+        printf("output %d:%d  %s (%s)\n", info.card, info.device, info.name.c_str(),
+               info.driver.c_str());
+    }
+    for (const auto& info : hal.getInputDevices()) {
+        printf("input  %d:%d  %s (%s)\n", info.card, info.device, info.name.c_str(),
+               info.driver.c_str());
+    }
+}
+
+int main(int argc, char** argv) {
+    android::base::InitLogging(argv, android::base::StderrLogger);
+
+    Options options;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:i:p:n:t:s:lh")) != -1) {
+        bool ok = true;
+        switch (opt) {
+            case 'o':
+                ok = parsePcm(optarg, &options.outCard, &options.outDevice);
+                break;
+            case 'i':
+                ok = parsePcm(optarg, &options.inCard, &options.inDevice);
+                break;
+            case 'p':
+                ok = parseList(optarg, &options.periodSizes);
+                break;
+            case 'n':
+                ok = parseList(optarg, &options.periodCounts);
+                break;
+            case 't':
+                ok = android::base::ParseInt(optarg, &options.trials, 1, 1000);
+                break;
+            case 's':
+                ok = !strcmp(optarg, "mls") || !strcmp(optarg, "impulse");
+                options.impulse = !strcmp(optarg, "impulse");
+                break;
+            case 'l':
+                listDevices();
+                return 0;
+            default:
+                ok = false;
+                break;
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.outCard < 0 || options.inCard < 0) {
+        int loopback = findLoopbackCard();
+        if (loopback < 0) {
+            fprintf(stderr, "No snd-aloop card found; load snd-aloop or pass -o and -i\n");
+            return 1;
+        }
+        if (options.outCard < 0) {
+            options.outCard = loopback;
+        }
+        if (options.inCard < 0) {
+            options.inCard = loopback;
+        }
+    }
+
+    std::vector<float> signal = options.impulse ? std::vector<float>{1.0f} : makeMls();
+
+    printf("Playback %d:%d -> capture %d:%d, %s, %d trials, %u Hz\n", options.outCard,
+           options.outDevice, options.inCard, options.inDevice,
+           options.impulse ? "impulse" : "MLS", options.trials, SAMPLE_RATE);
+    printf("%7s %6s  %8s %8s %8s %8s %7s %7s %6s\n", "period", "count", "mean ms", "min ms",
+           "max ms", "jitter", "under", "over", "missed");
+
+    for (unsigned int periodSize : options.periodSizes) {
+        for (unsigned int periodCount : options.periodCounts) {
+            printResult(runConfig(options, signal, periodSize, periodCount));
+        }
+    }
+    return 0;
+}
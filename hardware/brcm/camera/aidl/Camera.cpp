@@ -22,10 +22,42 @@
 #include <regex>
 
 #define LOG_TAG "CameraHAL"
+#define ATRACE_TAG ATRACE_TAG_CAMERA
 #include <log/log.h>
+#include <utils/Trace.h>
 
 namespace aidl::android::hardware::camera::rpi5 {
 
+// Frame rate counter for systrace, updated once a second of capture time.
+// Costs one branch per frame while tracing is off.
+class TraceFps {
+public:
+    explicit TraceFps(const std::string& name) : mName(name) {}
+    
+    void frame(uint64_t timestampNs) {
+        if (!ATRACE_ENABLED()) {
+            mWindowStartNs = 0;
+            return;
+        }
+        if (mWindowStartNs == 0) {
+            mWindowStartNs = timestampNs;
+            mFrames = 0;
+        }
+        mFrames++;
+        uint64_t elapsed = timestampNs - mWindowStartNs;
+        if (elapsed >= 1000000000ULL) {
+            ATRACE_INT(mName.c_str(), static_cast<int32_t>(mFrames * 1000000000ULL / elapsed));
+            mWindowStartNs = timestampNs;
+            mFrames = 0;
+        }
+    }
+    
+private:
+    std::string mName;
+    uint64_t mWindowStartNs = 0;
+    uint64_t mFrames = 0;
+};
+
 // I2C addresses for camera probing
 static const std::map<CameraSensorType, std::vector<uint8_t>> kCameraI2CAddresses = {
     // Sony IMX Series
@@ -259,6 +291,7 @@ CameraSensorInfo CameraManager::getCameraInfo(const std::string& cameraId) {
 }
 
 bool CameraManager::openCamera(const std::string& cameraId) {
+    ATRACE_CALL();
     auto it = mCameras.find(cameraId);
     if (it == mCameras.end()) {
         ALOGE("Camera %s not found", cameraId.c_str());
@@ -301,6 +334,7 @@ bool CameraManager::isOpen(const std::string& cameraId) {
 }
 
 bool CameraManager::setFormat(const std::string& cameraId, const FrameFormat& format) {
+    ATRACE_CALL();
     auto it = mCameraFds.find(cameraId);
     if (it == mCameraFds.end()) {
         return false;
@@ -313,15 +347,8 @@ bool CameraManager::setFormat(const std::string& cameraId, const FrameFormat& fo
     fmt.fmt.pix.height = format.height;
     
     // Map pixel format string to V4L2 fourcc
-    if (format.pixelFormat == "YUYV") {
-        fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
-    } else if (format.pixelFormat == "NV12") {
-        fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_NV12;
-    } else if (format.pixelFormat == "NV21") {
-        fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_NV21;
-    } else if (format.pixelFormat == "MJPEG") {
-        fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_MJPEG;
-    } else {
+    fmt.fmt.pix.pixelformat = pixelFormatToFourcc(format.pixelFormat);
+    if (fmt.fmt.pix.pixelformat == 0) {
         fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
     }
     
@@ -362,13 +389,7 @@ FrameFormat CameraManager::getFormat(const std::string& cameraId) {
         format.bytesPerLine = fmt.fmt.pix.bytesperline;
         format.sizeImage = fmt.fmt.pix.sizeimage;
         
-        // Map fourcc to string
-        char fourcc[5] = {0};
-        fourcc[0] = fmt.fmt.pix.pixelformat & 0xff;
-        fourcc[1] = (fmt.fmt.pix.pixelformat >> 8) & 0xff;
-        fourcc[2] = (fmt.fmt.pix.pixelformat >> 16) & 0xff;
-        fourcc[3] = (fmt.fmt.pix.pixelformat >> 24) & 0xff;
-        format.pixelFormat = fourcc;
+        format.pixelFormat = fourccToPixelFormat(fmt.fmt.pix.pixelformat);
     }
     
     // Get frame rate
@@ -418,12 +439,7 @@ std::vector<FrameFormat> CameraManager::getSupportedFormats(const std::string& c
                     format.width = frmSize.discrete.width;
                     format.height = frmSize.discrete.height;
                     
-                    char fourcc[5] = {0};
-                    fourcc[0] = fmtDesc.pixelformat & 0xff;
-                    fourcc[1] = (fmtDesc.pixelformat >> 8) & 0xff;
-                    fourcc[2] = (fmtDesc.pixelformat >> 16) & 0xff;
-                    fourcc[3] = (fmtDesc.pixelformat >> 24) & 0xff;
-                    format.pixelFormat = fourcc;
+                    format.pixelFormat = fourccToPixelFormat(fmtDesc.pixelformat);
                     
                     if (frmIval.type == V4L2_FRMIVAL_TYPE_DISCRETE) {
                         format.fps = frmIval.discrete.denominator / frmIval.discrete.numerator;
@@ -442,6 +458,7 @@ std::vector<FrameFormat> CameraManager::getSupportedFormats(const std::string& c
 }
 
 bool CameraManager::startStreaming(const std::string& cameraId, FrameCallback callback) {
+    ATRACE_CALL();
     auto it = mCameraFds.find(cameraId);
     if (it == mCameraFds.end()) {
         return false;
@@ -504,43 +521,44 @@ bool CameraManager::startStreaming(const std::string& cameraId, FrameCallback ca
     mStreamingState[cameraId] = true;
     ALOGI("Started streaming on camera %s", cameraId.c_str());
     
-    // Start capture thread
-    std::thread captureThread([this, cameraId, fd, buffers, bufferSizes, callback]() {
-        while (mStreamingState[cameraId]) {
+    // Frames are drained from the shared reactor when the fd turns readable
+    mCaptureHandlers[cameraId] = ::android::hardware::brcm::Reactor::get().addFd(
+            "camera" + cameraId, fd, EPOLLIN,
+            [fd, buffers, callback, fps = TraceFps("camera" + cameraId + " fps")](uint32_t) mutable {
+        while (true) {
             struct v4l2_buffer buf;
             memset(&buf, 0, sizeof(buf));
             buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
             buf.memory = V4L2_MEMORY_MMAP;
             
-            // Dequeue buffer
+            // Dequeue buffer; EAGAIN once every ready frame is consumed
             if (xioctl(fd, VIDIOC_DQBUF, &buf) < 0) {
-                if (errno == EAGAIN) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                    continue;
-                }
-                break;
+                return;
             }
             
             // Call the callback with frame data
+            uint64_t timestamp = buf.timestamp.tv_sec * 1000000000ULL +
+                                buf.timestamp.tv_usec * 1000ULL;
+            fps.frame(timestamp);
             if (callback) {
-                uint64_t timestamp = buf.timestamp.tv_sec * 1000000000ULL +
-                                    buf.timestamp.tv_usec * 1000ULL;
+                ATRACE_NAME("CameraManager::frame");
                 callback(static_cast<uint8_t*>(buffers[buf.index]),
                         buf.bytesused, timestamp);
             }
             
             // Re-queue the buffer
             if (xioctl(fd, VIDIOC_QBUF, &buf) < 0) {
-                break;
+                ALOGE("Failed to re-queue buffer %u: %s", buf.index, strerror(errno));
+                return;
             }
         }
     });
-    captureThread.detach();
     
     return true;
 }
 
 bool CameraManager::stopStreaming(const std::string& cameraId) {
+    ATRACE_CALL();
     auto it = mCameraFds.find(cameraId);
     if (it == mCameraFds.end()) {
         return false;
@@ -548,16 +566,153 @@ bool CameraManager::stopStreaming(const std::string& cameraId) {
     
     mStreamingState[cameraId] = false;
     
+    // Waits out a frame callback in progress
+    auto handler = mCaptureHandlers.find(cameraId);
+    if (handler != mCaptureHandlers.end()) {
+        ::android::hardware::brcm::Reactor::get().remove(handler->second);
+        mCaptureHandlers.erase(handler);
+    }
+    
     enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     if (xioctl(it->second, VIDIOC_STREAMOFF, &type) < 0) {
         ALOGE("Failed to stop streaming: %s", strerror(errno));
         return false;
     }
     
+    // Exported dmabufs stay valid for importers until their last fd closes
+    auto dmabufs = mDmabufFds.find(cameraId);
+    if (dmabufs != mDmabufFds.end()) {
+        for (int fd : dmabufs->second) {
+            close(fd);
+        }
+        mDmabufFds.erase(dmabufs);
+    }
+    
     ALOGI("Stopped streaming on camera %s", cameraId.c_str());
     return true;
 }
 
+bool CameraManager::startStreamingDmabuf(const std::string& cameraId, uint32_t bufferCount,
+                                         DmabufFrameCallback callback) {
+    ATRACE_CALL();
+    auto it = mCameraFds.find(cameraId);
+    if (it == mCameraFds.end()) {
+        return false;
+    }
+    
+    int fd = it->second;
+    
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = bufferCount;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    
+    if (xioctl(fd, VIDIOC_REQBUFS, &req) < 0) {
+        ALOGE("Failed to request buffers: %s", strerror(errno));
+        return false;
+    }
+    
+    // Export every buffer once; consumers import the same fds each frame
+    std::vector<int> dmabufFds;
+    std::vector<uint32_t> lengths;
+    
+    for (uint32_t i = 0; i < req.count; i++) {
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        
+        if (xioctl(fd, VIDIOC_QUERYBUF, &buf) < 0) {
+            ALOGE("Failed to query buffer: %s", strerror(errno));
+            break;
+        }
+        
+        struct v4l2_exportbuffer expbuf;
+        memset(&expbuf, 0, sizeof(expbuf));
+        expbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        expbuf.index = i;
+        expbuf.flags = O_RDWR | O_CLOEXEC;
+        
+        if (xioctl(fd, VIDIOC_EXPBUF, &expbuf) < 0) {
+            ALOGE("Failed to export buffer %u: %s", i, strerror(errno));
+            break;
+        }
+        
+        dmabufFds.push_back(expbuf.fd);
+        lengths.push_back(buf.length);
+        
+        if (xioctl(fd, VIDIOC_QBUF, &buf) < 0) {
+            ALOGE("Failed to queue buffer: %s", strerror(errno));
+            break;
+        }
+    }
+    
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (dmabufFds.size() != req.count || xioctl(fd, VIDIOC_STREAMON, &type) < 0) {
+        ALOGE("Failed to start dmabuf streaming: %s", strerror(errno));
+        for (int dmabufFd : dmabufFds) {
+            close(dmabufFd);
+        }
+        return false;
+    }
+    
+    mDmabufFds[cameraId] = dmabufFds;
+    mStreamingState[cameraId] = true;
+    ALOGI("Started dmabuf streaming on camera %s with %u buffers", cameraId.c_str(), req.count);
+    
+    // Frames are handed over, not re-queued; releaseFrame() re-queues them
+    mCaptureHandlers[cameraId] = ::android::hardware::brcm::Reactor::get().addFd(
+            "camera" + cameraId + "-dmabuf", fd, EPOLLIN,
+            [fd, dmabufFds, lengths, callback,
+             fps = TraceFps("camera" + cameraId + " fps")](uint32_t) mutable {
+        while (true) {
+            struct v4l2_buffer buf;
+            memset(&buf, 0, sizeof(buf));
+            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory = V4L2_MEMORY_MMAP;
+            
+            if (xioctl(fd, VIDIOC_DQBUF, &buf) < 0) {
+                return;
+            }
+            
+            DmabufFrame frame;
+            frame.index = buf.index;
+            frame.fd = dmabufFds[buf.index];
+            frame.bytesUsed = buf.bytesused;
+            frame.length = lengths[buf.index];
+            frame.timestamp = buf.timestamp.tv_sec * 1000000000ULL +
+                              buf.timestamp.tv_usec * 1000ULL;
+            fps.frame(frame.timestamp);
+            ATRACE_NAME("CameraManager::dmabufFrame");
+            callback(frame);
+        }
+    });
+    
+    return true;
+}
+
+bool CameraManager::releaseFrame(const std::string& cameraId, uint32_t index) {
+    ATRACE_CALL();
+    auto it = mCameraFds.find(cameraId);
+    if (it == mCameraFds.end()) {
+        return false;
+    }
+    
+    struct v4l2_buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    
+    if (xioctl(it->second, VIDIOC_QBUF, &buf) < 0) {
+        ALOGE("Failed to re-queue buffer %u: %s", index, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
 bool CameraManager::isStreaming(const std::string& cameraId) {
     auto it = mStreamingState.find(cameraId);
     return it != mStreamingState.end() && it->second;
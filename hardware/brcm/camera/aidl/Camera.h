@@ -20,6 +20,10 @@
 #include <functional>
 #include <cstdint>
 
+#include <Reactor.h>
+
+#include "CameraFormat.h"
+
 namespace aidl::android::hardware::camera::rpi5 {
 
 // Camera sensor types
@@ -177,6 +181,18 @@ struct FrameFormat {
 // Camera frame callback
 using FrameCallback = std::function<void(const uint8_t* data, size_t size, uint64_t timestamp)>;
 
+// Capture buffer exported as a dmabuf. The consumer owns it until it hands
+// the index back with releaseFrame().
+struct DmabufFrame {
+    uint32_t index;
+    int fd;
+    uint32_t bytesUsed;
+    uint32_t length;
+    uint64_t timestamp;         // CLOCK_MONOTONIC, ns
+};
+
+using DmabufFrameCallback = std::function<void(const DmabufFrame& frame)>;
+
 // Camera Manager class
 class CameraManager {
 public:
@@ -206,6 +222,12 @@ public:
     bool stopStreaming(const std::string& cameraId);
     bool isStreaming(const std::string& cameraId);
     
+    // Zero-copy streaming: buffers go out as dmabufs and are only re-queued
+    // once released, so nothing is copied or mapped in userspace
+    bool startStreamingDmabuf(const std::string& cameraId, uint32_t bufferCount,
+                              DmabufFrameCallback callback);
+    bool releaseFrame(const std::string& cameraId, uint32_t index);
+    
     // Controls
     bool setExposure(const std::string& cameraId, int32_t exposure);
     bool setGain(const std::string& cameraId, int32_t gain);
@@ -234,10 +256,16 @@ private:
     bool probeI2CCamera(int bus, uint8_t address, CameraSensorType expectedType);
     bool loadCameraDriver(const std::string& module);
     bool configureCsiPhy(int port, int lanes, uint32_t dataRate);
+    void detectUnicamCameras();
+    void identifySensor(int fd, CameraSensorInfo& info);
+    void queryFormats(int fd, CameraSensorInfo& info);
     
     std::map<std::string, CameraSensorInfo> mCameras;
     std::map<std::string, int> mCameraFds;
     std::map<std::string, bool> mStreamingState;
+    std::map<std::string, std::vector<int>> mDmabufFds;
+    // Capture fds are serviced by the shared reactor thread
+    std::map<std::string, ::android::hardware::brcm::Reactor::Handle> mCaptureHandlers;
     bool mInitialized = false;
     bool mLibcameraReady = false;
 };
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Pixel format names used by CameraManager and their V4L2 fourccs
+ */
+
+#include "CameraFormat.h"
+
+namespace aidl::android::hardware::camera::rpi5 {
+
+struct NamedFormat {
+    const char* name;
+    uint32_t fourcc;
+};
+
+static constexpr NamedFormat kFormats[] = {
+    {"YUYV", makeFourcc('Y', 'U', 'Y', 'V')},
+    {"NV12", makeFourcc('N', 'V', '1', '2')},
+    {"NV21", makeFourcc('N', 'V', '2', '1')},
+    {"MJPEG", makeFourcc('M', 'J', 'P', 'G')},
+};
+
+uint32_t pixelFormatToFourcc(const std::string& pixelFormat) {
+    for (const auto& format : kFormats) {
+        if (pixelFormat == format.name) {
+            return format.fourcc;
+        }
+    }
+    return 0;
+}
+
+std::string fourccToPixelFormat(uint32_t fourcc) {
+    for (const auto& format : kFormats) {
+        if (fourcc == format.fourcc) {
+            return format.name;
+        }
+    }
+    char name[5] = {
+        static_cast<char>(fourcc & 0xff),
+        static_cast<char>((fourcc >> 8) & 0xff),
+        static_cast<char>((fourcc >> 16) & 0xff),
+        static_cast<char>((fourcc >> 24) & 0xff),
+        0,
+    };
+    return name;
+}
+
+}  // namespace aidl::android::hardware::camera::rpi5
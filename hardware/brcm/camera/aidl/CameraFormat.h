@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Pixel format names used by CameraManager and their V4L2 fourccs. No
+ * kernel headers needed, so it builds for the host as libbrcm_camera_format.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace aidl::android::hardware::camera::rpi5 {
+
+constexpr uint32_t makeFourcc(char a, char b, char c, char d) {
+    return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) |
+           (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+}
+
+// 0 for names without a mapping
+uint32_t pixelFormatToFourcc(const std::string& pixelFormat);
+
+// Named formats map back to their CameraManager name (MJPG gives "MJPEG");
+// anything else is spelled out as its four characters
+std::string fourccToPixelFormat(uint32_t fourcc);
+
+}  // namespace aidl::android::hardware::camera::rpi5
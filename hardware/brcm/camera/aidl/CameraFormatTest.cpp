@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Pixel format name <-> V4L2 fourcc mapping.
+ */
+
+#include <gtest/gtest.h>
+
+#include "CameraFormat.h"
+
+using namespace aidl::android::hardware::camera::rpi5;
+
+TEST(CameraFormatTest, NamedFormatsRoundTrip) {
+    for (const char* name : {"YUYV", "NV12", "NV21", "MJPEG"}) {
+        uint32_t fourcc = pixelFormatToFourcc(name);
+        EXPECT_NE(fourcc, 0u) << name;
+        EXPECT_EQ(fourccToPixelFormat(fourcc), name);
+    }
+}
+
+TEST(CameraFormatTest, MjpegUsesTheNameSetFormatTakes) {
+    // V4L2 spells it MJPG; CameraManager calls it MJPEG both ways
+    EXPECT_EQ(pixelFormatToFourcc("MJPEG"), makeFourcc('M', 'J', 'P', 'G'));
+    EXPECT_EQ(fourccToPixelFormat(makeFourcc('M', 'J', 'P', 'G')), "MJPEG");
+    EXPECT_EQ(pixelFormatToFourcc("MJPG"), 0u);
+}
+
+TEST(CameraFormatTest, FourccMatchesV4l2Encoding) {
+    // V4L2_PIX_FMT_YUYV
+    EXPECT_EQ(pixelFormatToFourcc("YUYV"), 0x56595559u);
+}
+
+TEST(CameraFormatTest, UnknownNames) {
+    EXPECT_EQ(pixelFormatToFourcc(""), 0u);
+    EXPECT_EQ(pixelFormatToFourcc("yuyv"), 0u);
+}
+
+TEST(CameraFormatTest, UnknownFourccIsSpelledOut) {
+    EXPECT_EQ(fourccToPixelFormat(makeFourcc('R', 'G', '1', '0')), "RG10");
+}
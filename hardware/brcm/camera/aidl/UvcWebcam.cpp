@@ -0,0 +1,631 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * UVC webcam gadget for Raspberry Pi 5
+ */
+
+#include "UvcWebcam.h"
+
+#include <dirent.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <linux/videodev2.h>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+
+#define LOG_TAG "UvcWebcam"
+#define ATRACE_TAG ATRACE_TAG_CAMERA
+#include <log/log.h>
+#include <utils/Trace.h>
+
+namespace aidl::android::hardware::camera::rpi5 {
+
+static const uint64_t kStatsIntervalNs = 5000000000ULL;
+
+static int xioctl(int fd, unsigned long request, void* arg) {
+    int r;
+    do {
+        r = ioctl(fd, request, arg);
+    } while (r == -1 && errno == EINTR);
+    return r;
+}
+
+static uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static std::string readAttr(const std::string& path) {
+    std::ifstream file(path);
+    std::string value;
+    std::getline(file, value, '\0');
+    return value;
+}
+
+static uint32_t readAttrU32(const std::string& path) {
+    return static_cast<uint32_t>(strtoul(readAttr(path).c_str(), nullptr, 0));
+}
+
+static std::vector<std::string> listDirs(const std::string& path) {
+    std::vector<std::string> names;
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        return names;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_name[0] != '.' && entry->d_type == DT_DIR) {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+    return names;
+}
+
+UvcWebcam::UvcWebcam(const std::string& functionPath) : mFunctionPath(functionPath) {
+    memset(&mProbe, 0, sizeof(mProbe));
+    memset(&mCommit, 0, sizeof(mCommit));
+}
+
+UvcWebcam::~UvcWebcam() {
+    stopStream();
+    if (mFd >= 0) {
+        close(mFd);
+    }
+    if (mWakeFd >= 0) {
+        close(mWakeFd);
+    }
+}
+
+// The frame table comes from the function's configfs descriptors so it
+// always matches what the host was told
+bool UvcWebcam::loadDescriptors() {
+    mDescriptors.clear();
+
+    // Frames go to the host as the camera captured them, so only the
+    // uncompressed class is served; an MJPEG descriptor would need an encoder
+    const std::vector<std::pair<std::string, std::string>> classes = {
+        {"uncompressed", "YUYV"},
+    };
+    for (const auto& [cls, pixelFormat] : classes) {
+        std::string classPath = mFunctionPath + "/streaming/" + cls;
+        for (const std::string& format : listDirs(classPath)) {
+            std::string formatPath = classPath + "/" + format;
+            uint8_t formatIndex = readAttrU32(formatPath + "/bFormatIndex");
+            if (formatIndex == 0) {
+                continue;   // not linked into the streaming header
+            }
+            for (const std::string& frame : listDirs(formatPath)) {
+                std::string framePath = formatPath + "/" + frame;
+                UvcFrameDesc desc;
+                desc.formatIndex = formatIndex;
+                desc.frameIndex = readAttrU32(framePath + "/bFrameIndex");
+                desc.pixelFormat = pixelFormat;
+                desc.width = readAttrU32(framePath + "/wWidth");
+                desc.height = readAttrU32(framePath + "/wHeight");
+                desc.maxFrameSize = readAttrU32(framePath + "/dwMaxVideoFrameBufferSize");
+
+                std::istringstream intervals(readAttr(framePath + "/dwFrameInterval"));
+                uint32_t interval;
+                while (intervals >> interval) {
+                    desc.intervals.push_back(interval);
+                }
+                std::sort(desc.intervals.begin(), desc.intervals.end());
+                if (desc.intervals.empty()) {
+                    continue;
+                }
+                mDescriptors.push_back(desc);
+            }
+        }
+    }
+
+    std::sort(mDescriptors.begin(), mDescriptors.end(),
+              [](const UvcFrameDesc& a, const UvcFrameDesc& b) {
+                  return std::tie(a.formatIndex, a.frameIndex) <
+                         std::tie(b.formatIndex, b.frameIndex);
+              });
+
+    mMaxPayload = readAttrU32(mFunctionPath + "/streaming_maxpacket");
+    mStreamingInterface = readAttrU32(mFunctionPath + "/streaming/bInterfaceNumber");
+
+    for (const auto& desc : mDescriptors) {
+        ALOGI("UVC format %u frame %u: %s %ux%u, %zu intervals", desc.formatIndex,
+              desc.frameIndex, desc.pixelFormat.c_str(), desc.width, desc.height,
+              desc.intervals.size());
+    }
+    return !mDescriptors.empty();
+}
+
+bool UvcWebcam::open() {
+    if (!loadDescriptors()) {
+        ALOGE("No UVC frame descriptors under %s", mFunctionPath.c_str());
+        return false;
+    }
+
+    // The gadget function's video node reports the g_uvc driver
+    DIR* dir = opendir("/dev");
+    if (!dir) {
+        return false;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr && mFd < 0) {
+        std::string name = entry->d_name;
+        if (name.find("video") != 0) {
+            continue;
+        }
+        std::string path = "/dev/" + name;
+        int fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        struct v4l2_capability cap;
+        memset(&cap, 0, sizeof(cap));
+        if (xioctl(fd, VIDIOC_QUERYCAP, &cap) == 0 &&
+            strcmp(reinterpret_cast<const char*>(cap.driver), "g_uvc") == 0 &&
+            (cap.device_caps & V4L2_CAP_VIDEO_OUTPUT)) {
+            mFd = fd;
+            mDevicePath = path;
+        } else {
+            close(fd);
+        }
+    }
+    closedir(dir);
+
+    if (mFd < 0) {
+        ALOGE("UVC gadget video node not found");
+        return false;
+    }
+
+    const uint32_t events[] = {
+        UVC_EVENT_CONNECT, UVC_EVENT_DISCONNECT, UVC_EVENT_STREAMON,
+        UVC_EVENT_STREAMOFF, UVC_EVENT_SETUP, UVC_EVENT_DATA,
+    };
+    for (uint32_t type : events) {
+        struct v4l2_event_subscription sub;
+        memset(&sub, 0, sizeof(sub));
+        sub.type = type;
+        if (xioctl(mFd, VIDIOC_SUBSCRIBE_EVENT, &sub) < 0) {
+            ALOGE("Failed to subscribe to UVC event %#x: %s", type, strerror(errno));
+            return false;
+        }
+    }
+
+    mWakeFd = eventfd(0, EFD_CLOEXEC);
+    if (mWakeFd < 0) {
+        ALOGE("Failed to create eventfd: %s", strerror(errno));
+        return false;
+    }
+
+    const UvcFrameDesc& first = mDescriptors.front();
+    fillStreamingControl(&mProbe, first.formatIndex, first.frameIndex, first.intervals.front());
+    mCommit = mProbe;
+
+    ALOGI("UVC webcam on %s, streaming interface %u", mDevicePath.c_str(), mStreamingInterface);
+    return true;
+}
+
+void UvcWebcam::stop() {
+    mRunning = false;
+    uint64_t value = 1;
+    if (mWakeFd >= 0 && write(mWakeFd, &value, sizeof(value)) != sizeof(value)) {
+        ALOGW("Failed to wake UVC event loop: %s", strerror(errno));
+    }
+}
+
+const UvcFrameDesc* UvcWebcam::findFrame(uint8_t formatIndex, uint8_t frameIndex) const {
+    for (const auto& desc : mDescriptors) {
+        if (desc.formatIndex == formatIndex && desc.frameIndex == frameIndex) {
+            return &desc;
+        }
+    }
+    return nullptr;
+}
+
+// Clamps a host proposal to the nearest descriptor and fills in the fields
+// the device owns
+void UvcWebcam::fillStreamingControl(struct uvc_streaming_control* ctrl, uint8_t formatIndex,
+                                     uint8_t frameIndex, uint32_t interval) const {
+    const UvcFrameDesc* desc = findFrame(formatIndex, frameIndex);
+    if (!desc) {
+        // Unknown frame: first frame of the format, or the first format
+        for (const auto& candidate : mDescriptors) {
+            if (candidate.formatIndex == formatIndex) {
+                desc = &candidate;
+                break;
+            }
+        }
+        if (!desc) {
+            desc = &mDescriptors.front();
+        }
+    }
+
+    // Shortest supported interval at least as long as the one asked for
+    uint32_t chosen = desc->intervals.back();
+    for (uint32_t candidate : desc->intervals) {
+        if (candidate >= interval) {
+            chosen = candidate;
+            break;
+        }
+    }
+
+    memset(ctrl, 0, sizeof(*ctrl));
+    ctrl->bmHint = htole16(1);
+    ctrl->bFormatIndex = desc->formatIndex;
+    ctrl->bFrameIndex = desc->frameIndex;
+    ctrl->dwFrameInterval = htole32(chosen);
+    ctrl->dwMaxVideoFrameSize = htole32(desc->maxFrameSize);
+    ctrl->dwMaxPayloadTransferSize = htole32(mMaxPayload);
+    ctrl->bmFramingInfo = 3;
+    ctrl->bPreferedVersion = 1;
+    ctrl->bMaxVersion = 1;
+}
+
+void UvcWebcam::handleStreamingRequest(uint8_t request, uint8_t selector,
+                                       struct uvc_request_data* resp) {
+    auto* ctrl = reinterpret_cast<struct uvc_streaming_control*>(resp->data);
+
+    switch (request) {
+        case UVC_SET_CUR:
+            // The control value follows in a UVC_EVENT_DATA
+            mPendingSelector = selector;
+            resp->length = sizeof(*ctrl);
+            break;
+        case UVC_GET_CUR:
+            memcpy(ctrl, selector == UVC_VS_PROBE_CONTROL ? &mProbe : &mCommit, sizeof(*ctrl));
+            resp->length = sizeof(*ctrl);
+            break;
+        case UVC_GET_MIN:
+        case UVC_GET_DEF: {
+            const UvcFrameDesc& first = mDescriptors.front();
+            fillStreamingControl(ctrl, first.formatIndex, first.frameIndex,
+                                 first.intervals.front());
+            resp->length = sizeof(*ctrl);
+            break;
+        }
+        case UVC_GET_MAX: {
+            const UvcFrameDesc& last = mDescriptors.back();
+            fillStreamingControl(ctrl, last.formatIndex, last.frameIndex,
+                                 last.intervals.back());
+            resp->length = sizeof(*ctrl);
+            break;
+        }
+        case UVC_GET_RES:
+            memset(ctrl, 0, sizeof(*ctrl));
+            resp->length = sizeof(*ctrl);
+            break;
+        case UVC_GET_LEN:
+            resp->data[0] = sizeof(*ctrl);
+            resp->data[1] = 0;
+            resp->length = 2;
+            break;
+        case UVC_GET_INFO:
+            resp->data[0] = UVC_CONTROL_CAP_GET | UVC_CONTROL_CAP_SET;
+            resp->length = 1;
+            break;
+    }
+}
+
+void UvcWebcam::handleSetup(const struct usb_ctrlrequest& req) {
+    struct uvc_request_data resp;
+    memset(&resp, 0, sizeof(resp));
+    // Stall everything not handled below, including all camera and
+    // processing unit controls
+    resp.length = -EL2HLT;
+
+    uint8_t interface = le16toh(req.wIndex) & 0xff;
+    uint8_t selector = le16toh(req.wValue) >> 8;
+    if ((req.bRequestType & USB_TYPE_MASK) == USB_TYPE_CLASS &&
+        (req.bRequestType & USB_RECIP_MASK) == USB_RECIP_INTERFACE &&
+        interface == mStreamingInterface &&
+        (selector == UVC_VS_PROBE_CONTROL || selector == UVC_VS_COMMIT_CONTROL)) {
+        handleStreamingRequest(req.bRequest, selector, &resp);
+    }
+
+    if (xioctl(mFd, UVCIOC_SEND_RESPONSE, &resp) < 0) {
+        ALOGE("Failed to send UVC response: %s", strerror(errno));
+    }
+}
+
+void UvcWebcam::handleData(const struct uvc_request_data& data) {
+    if (mPendingSelector == 0) {
+        return;
+    }
+
+    struct uvc_streaming_control request;
+    memset(&request, 0, sizeof(request));
+    memcpy(&request, data.data,
+           std::min<size_t>(sizeof(request), std::max<int32_t>(data.length, 0)));
+
+    struct uvc_streaming_control* target =
+            mPendingSelector == UVC_VS_PROBE_CONTROL ? &mProbe : &mCommit;
+    fillStreamingControl(target, request.bFormatIndex, request.bFrameIndex,
+                         le32toh(request.dwFrameInterval));
+
+    if (mPendingSelector == UVC_VS_COMMIT_CONTROL) {
+        const UvcFrameDesc* desc = findFrame(mCommit.bFormatIndex, mCommit.bFrameIndex);
+        ALOGI("Host committed %s %ux%u, interval %u", desc->pixelFormat.c_str(), desc->width,
+              desc->height, le32toh(mCommit.dwFrameInterval));
+    }
+    mPendingSelector = 0;
+}
+
+void UvcWebcam::handleEvent() {
+    struct v4l2_event event;
+    memset(&event, 0, sizeof(event));
+    if (xioctl(mFd, VIDIOC_DQEVENT, &event) < 0) {
+        ALOGE("Failed to dequeue UVC event: %s", strerror(errno));
+        return;
+    }
+
+    auto* uvcEvent = reinterpret_cast<struct uvc_event*>(&event.u.data);
+    switch (event.type) {
+        case UVC_EVENT_CONNECT:
+            ALOGI("Host connected");
+            break;
+        case UVC_EVENT_DISCONNECT:
+            ALOGI("Host disconnected");
+            stopStream();
+            break;
+        case UVC_EVENT_SETUP:
+            handleSetup(uvcEvent->req);
+            break;
+        case UVC_EVENT_DATA:
+            handleData(uvcEvent->data);
+            break;
+        case UVC_EVENT_STREAMON:
+            if (!startStream()) {
+                stopStream();
+            }
+            break;
+        case UVC_EVENT_STREAMOFF:
+            stopStream();
+            break;
+    }
+}
+
+bool UvcWebcam::startStream() {
+    const UvcFrameDesc* desc = findFrame(mCommit.bFormatIndex, mCommit.bFrameIndex);
+    if (!desc) {
+        return false;
+    }
+    uint32_t fps = 10000000 / std::max<uint32_t>(le32toh(mCommit.dwFrameInterval), 1);
+
+    CameraManager& cameras = CameraManager::getInstance();
+    cameras.initialize();
+    std::vector<std::string> ids = cameras.getAvailableCameras();
+    if (ids.empty()) {
+        ALOGE("No camera to stream from");
+        return false;
+    }
+    mCameraId = ids.front();
+    if (!cameras.isOpen(mCameraId) && !cameras.openCamera(mCameraId)) {
+        return false;
+    }
+
+    // Zero-copy only works if the camera produces exactly what the host
+    // committed to; there is no conversion stage to fall back on
+    FrameFormat format = {};
+    format.width = desc->width;
+    format.height = desc->height;
+    format.fps = fps;
+    format.pixelFormat = desc->pixelFormat;
+    uint32_t fourcc = pixelFormatToFourcc(desc->pixelFormat);
+    if (!cameras.setFormat(mCameraId, format)) {
+        return false;
+    }
+    FrameFormat actual = cameras.getFormat(mCameraId);
+    if (actual.width != desc->width || actual.height != desc->height ||
+        actual.pixelFormat != desc->pixelFormat) {
+        ALOGE("Camera gives %s %ux%u, host wants %s %ux%u", actual.pixelFormat.c_str(),
+              actual.width, actual.height, desc->pixelFormat.c_str(), desc->width, desc->height);
+        return false;
+    }
+
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    fmt.fmt.pix.width = desc->width;
+    fmt.fmt.pix.height = desc->height;
+    fmt.fmt.pix.pixelformat = fourcc;
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    fmt.fmt.pix.sizeimage = std::max(desc->maxFrameSize, actual.sizeImage);
+    if (xioctl(mFd, VIDIOC_S_FMT, &fmt) < 0) {
+        ALOGE("Failed to set UVC format: %s", strerror(errno));
+        return false;
+    }
+
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = kBufferCount;
+    req.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    req.memory = V4L2_MEMORY_DMABUF;
+    if (xioctl(mFd, VIDIOC_REQBUFS, &req) < 0 || req.count != kBufferCount) {
+        ALOGE("Failed to request UVC dmabuf buffers: %s", strerror(errno));
+        return false;
+    }
+
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    if (xioctl(mFd, VIDIOC_STREAMON, &type) < 0) {
+        ALOGE("Failed to start UVC stream: %s", strerror(errno));
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStreaming = true;
+        mWindowStartNs = nowNs();
+        mWindowFrames = 0;
+        mWindowLatencyNs = 0;
+        mMaxLatencyNs = 0;
+        mFramesSent = 0;
+        mFramesDropped = 0;
+        mQueued = 0;
+    }
+
+    if (!cameras.startStreamingDmabuf(mCameraId, kBufferCount,
+                                      [this](const DmabufFrame& frame) { onCameraFrame(frame); })) {
+        return false;
+    }
+
+    ALOGI("Streaming %s %ux%u @ %u fps from %s", desc->pixelFormat.c_str(), desc->width,
+          desc->height, fps, mCameraId.c_str());
+    return true;
+}
+
+void UvcWebcam::stopStream() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (!mStreaming) {
+            return;
+        }
+        mStreaming = false;
+    }
+
+    CameraManager& cameras = CameraManager::getInstance();
+    cameras.stopStreaming(mCameraId);
+    cameras.closeCamera(mCameraId);
+
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    xioctl(mFd, VIDIOC_STREAMOFF, &type);
+
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    req.memory = V4L2_MEMORY_DMABUF;
+    xioctl(mFd, VIDIOC_REQBUFS, &req);
+
+    reportStats(true);
+}
+
+// Runs on the camera thread
+void UvcWebcam::onCameraFrame(const DmabufFrame& frame) {
+    ATRACE_CALL();
+    std::lock_guard<std::mutex> lock(mLock);
+
+    if (mStreaming && frame.index < kBufferCount) {
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        buf.memory = V4L2_MEMORY_DMABUF;
+        buf.index = frame.index;
+        buf.m.fd = frame.fd;
+        buf.length = frame.length;
+        buf.bytesused = frame.bytesUsed;
+
+        if (xioctl(mFd, VIDIOC_QBUF, &buf) == 0) {
+            mCaptureTimes[frame.index] = frame.timestamp;
+            ATRACE_INT("uvc queued", ++mQueued);
+            return;
+        }
+        ALOGW("Failed to queue frame to UVC: %s", strerror(errno));
+    }
+
+    mFramesDropped++;
+    CameraManager::getInstance().releaseFrame(mCameraId, frame.index);
+}
+
+// Returns frames the gadget has finished sending to the camera
+void UvcWebcam::completeBuffers() {
+    ATRACE_CALL();
+    std::lock_guard<std::mutex> lock(mLock);
+
+    while (mStreaming) {
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        buf.memory = V4L2_MEMORY_DMABUF;
+        if (xioctl(mFd, VIDIOC_DQBUF, &buf) < 0 || buf.index >= kBufferCount) {
+            break;
+        }
+        ATRACE_INT("uvc queued", --mQueued);
+
+        if (buf.flags & V4L2_BUF_FLAG_ERROR) {
+            mFramesDropped++;
+        } else {
+            // Capture timestamps are CLOCK_MONOTONIC too
+            uint64_t latency = nowNs() - mCaptureTimes[buf.index];
+            mWindowLatencyNs += latency;
+            mMaxLatencyNs = std::max(mMaxLatencyNs, latency);
+            mWindowFrames++;
+            mFramesSent++;
+            ATRACE_INT("uvc latency us", static_cast<int32_t>(latency / 1000));
+        }
+        CameraManager::getInstance().releaseFrame(mCameraId, buf.index);
+    }
+
+    if (nowNs() - mWindowStartNs >= kStatsIntervalNs) {
+        reportStats(false);
+    }
+}
+
+// Caller holds mLock, except for the final report
+void UvcWebcam::reportStats(bool final) {
+    uint64_t now = nowNs();
+    uint64_t elapsed = std::max<uint64_t>(now - mWindowStartNs, 1);
+    double fps = mWindowFrames * 1e9 / elapsed;
+    double meanMs = mWindowFrames ? mWindowLatencyNs / 1e6 / mWindowFrames : 0.0;
+
+    ALOGI("%s%.1f fps, capture-to-USB latency mean %.2f ms max %.2f ms, %llu sent, %llu dropped",
+          final ? "Stream stopped: " : "", fps, meanMs, mMaxLatencyNs / 1e6,
+          static_cast<unsigned long long>(mFramesSent),
+          static_cast<unsigned long long>(mFramesDropped));
+
+    mWindowStartNs = now;
+    mWindowFrames = 0;
+    mWindowLatencyNs = 0;
+    mMaxLatencyNs = 0;
+}
+
+void UvcWebcam::run() {
+    mRunning = true;
+
+    while (mRunning) {
+        bool streaming;
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            streaming = mStreaming;
+        }
+
+        // Only ask for POLLOUT while streaming; an idle output queue
+        // reports POLLERR
+        struct pollfd fds[2] = {
+            {.fd = mFd, .events = static_cast<short>(POLLPRI | (streaming ? POLLOUT : 0))},
+            {.fd = mWakeFd, .events = POLLIN},
+        };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ALOGE("UVC poll failed: %s", strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+        if (fds[0].revents & POLLPRI) {
+            handleEvent();
+        }
+        if (fds[0].revents & POLLOUT) {
+            completeBuffers();
+        }
+        if (fds[0].revents & (POLLERR | POLLHUP) && !(fds[0].revents & (POLLPRI | POLLOUT))) {
+            ALOGE("UVC gadget went away");
+            break;
+        }
+    }
+
+    stopStream();
+}
+
+}  // namespace aidl::android::hardware::camera::rpi5
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * UVC webcam gadget for Raspberry Pi 5
+ */
+
+#pragma once
+
+#include <linux/usb/ch9.h>
+#include <linux/usb/g_uvc.h>
+#include <linux/usb/video.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Camera.h"
+
+namespace aidl::android::hardware::camera::rpi5 {
+
+// One frame descriptor of the UVC function, read back from configfs
+struct UvcFrameDesc {
+    uint8_t formatIndex;
+    uint8_t frameIndex;
+    std::string pixelFormat;        // CameraManager name: YUYV
+    uint32_t width;
+    uint32_t height;
+    uint32_t maxFrameSize;
+    std::vector<uint32_t> intervals;    // 100 ns units, ascending
+};
+
+// Serves the UVC gadget function from CameraManager. Capture buffers are
+// exported as dmabufs and queued on the gadget's V4L2 output as they are, so
+// a frame travels from the CSI receiver to the USB controller without being
+// copied or mapped in userspace. Each capture buffer is imported into the
+// output buffer with the same index and goes back to the camera once the
+// gadget has sent it.
+class UvcWebcam {
+public:
+    static constexpr uint32_t kBufferCount = 4;
+
+    explicit UvcWebcam(const std::string& functionPath);
+    ~UvcWebcam();
+
+    bool open();
+    // Handles host requests until stop() is called or the gadget goes away
+    void run();
+    void stop();
+
+private:
+    bool loadDescriptors();
+    const UvcFrameDesc* findFrame(uint8_t formatIndex, uint8_t frameIndex) const;
+    void fillStreamingControl(struct uvc_streaming_control* ctrl, uint8_t formatIndex,
+                              uint8_t frameIndex, uint32_t interval) const;
+
+    void handleEvent();
+    void handleSetup(const struct usb_ctrlrequest& req);
+    void handleStreamingRequest(uint8_t request, uint8_t selector, struct uvc_request_data* resp);
+    void handleData(const struct uvc_request_data& data);
+
+    bool startStream();
+    void stopStream();
+    void onCameraFrame(const DmabufFrame& frame);
+    void completeBuffers();
+    void reportStats(bool final);
+
+    std::string mFunctionPath;
+    std::string mDevicePath;
+    int mFd = -1;
+    int mWakeFd = -1;
+    std::atomic<bool> mRunning{false};
+
+    std::vector<UvcFrameDesc> mDescriptors;
+    uint32_t mMaxPayload = 0;
+    uint8_t mStreamingInterface = 1;
+
+    struct uvc_streaming_control mProbe;
+    struct uvc_streaming_control mCommit;
+    uint8_t mPendingSelector = 0;   // SET_CUR waiting for its data stage
+
+    std::string mCameraId;
+    std::mutex mLock;
+    bool mStreaming = false;
+    uint64_t mCaptureTimes[kBufferCount] = {};
+    int32_t mQueued = 0;    // buffers owned by the gadget, traced
+
+    // Reported every few seconds and when the host stops streaming
+    uint64_t mWindowStartNs = 0;
+    uint64_t mWindowFrames = 0;
+    uint64_t mWindowLatencyNs = 0;
+    uint64_t mMaxLatencyNs = 0;
+    uint64_t mFramesSent = 0;
+    uint64_t mFramesDropped = 0;
+};
+
+}  // namespace aidl::android::hardware::camera::rpi5
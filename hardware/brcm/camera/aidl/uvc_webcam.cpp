@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * UVC webcam gadget daemon for Raspberry Pi 5
+ */
+
+#include "UvcWebcam.h"
+
+#define LOG_TAG "UvcWebcam"
+#include <log/log.h>
+
+using aidl::android::hardware::camera::rpi5::UvcWebcam;
+
+// Created by init.rpi5.usb.rc
+static const char* kFunctionPath = "/config/usb_gadget/g1/functions/uvc.gs6";
+
+int main() {
+    UvcWebcam webcam(kFunctionPath);
+    if (!webcam.open()) {
+        ALOGE("UVC webcam unavailable");
+        return 1;
+    }
+
+    webcam.run();
+    return 0;
+}
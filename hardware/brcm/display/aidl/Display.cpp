@@ -15,10 +15,12 @@
  */
 
 #define LOG_TAG "DisplayHAL"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
 #include "Display.h"
 
 #include <android-base/logging.h>
+#include <utils/Trace.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
@@ -307,159 +309,20 @@ bool DisplayManager::configureSpiDisplay(const SpiDisplayInfo& display) {
     }
     
     // Send controller-specific initialization
-    if (display.controller == "ILI9341") {
-        // ILI9341 init sequence
-        sendSpiCommand(0x01);  // Software reset
-        usleep(5000);
-        sendSpiCommand(0x28);  // Display off
-        sendSpiCommand(0xCF);  // Power control B
-        sendSpiData({0x00, 0xC1, 0x30});
-        sendSpiCommand(0xED);  // Power on sequence control
-        sendSpiData({0x64, 0x03, 0x12, 0x81});
-        sendSpiCommand(0xE8);  // Driver timing control A
-        sendSpiData({0x85, 0x00, 0x78});
-        sendSpiCommand(0xCB);  // Power control A
-        sendSpiData({0x39, 0x2C, 0x00, 0x34, 0x02});
-        sendSpiCommand(0xF7);  // Pump ratio control
-        sendSpiData({0x20});
-        sendSpiCommand(0xEA);  // Driver timing control B
-        sendSpiData({0x00, 0x00});
-        sendSpiCommand(0xC0);  // Power control 1
-        sendSpiData({0x23});
-        sendSpiCommand(0xC1);  // Power control 2
-        sendSpiData({0x10});
-        sendSpiCommand(0xC5);  // VCOM control 1
-        sendSpiData({0x3E, 0x28});
-        sendSpiCommand(0xC7);  // VCOM control 2
-        sendSpiData({0x86});
-        sendSpiCommand(0x36);  // Memory access control
-        sendSpiData({0x48});
-        sendSpiCommand(0x3A);  // Pixel format
-        sendSpiData({0x55});   // 16-bit
-        sendSpiCommand(0xB1);  // Frame rate control
-        sendSpiData({0x00, 0x18});
-        sendSpiCommand(0xB6);  // Display function control
-        sendSpiData({0x08, 0x82, 0x27});
-        sendSpiCommand(0xF2);  // 3Gamma function disable
-        sendSpiData({0x00});
-        sendSpiCommand(0x26);  // Gamma curve selected
-        sendSpiData({0x01});
-        sendSpiCommand(0x11);  // Sleep out
-        usleep(120000);
-        sendSpiCommand(0x29);  // Display on
-    } else if (display.controller == "ST7789") {
-        // ST7789 init sequence
-        sendSpiCommand(0x01);  // Software reset
-        usleep(150000);
-        sendSpiCommand(0x11);  // Sleep out
-        usleep(500000);
-        sendSpiCommand(0x3A);  // Interface pixel format
-        sendSpiData({0x55});   // 16-bit
-        sendSpiCommand(0x36);  // Memory data access control
-        sendSpiData({0x00});
-        sendSpiCommand(0xB2);  // Porch setting
-        sendSpiData({0x0C, 0x0C, 0x00, 0x33, 0x33});
-        sendSpiCommand(0xB7);  // Gate control
-        sendSpiData({0x35});
-        sendSpiCommand(0xBB);  // VCOM setting
-        sendSpiData({0x19});
-        sendSpiCommand(0xC0);  // LCM control
-        sendSpiData({0x2C});
-        sendSpiCommand(0xC2);  // VDV and VRH command enable
-        sendSpiData({0x01});
-        sendSpiCommand(0xC3);  // VRH set
-        sendSpiData({0x12});
-        sendSpiCommand(0xC4);  // VDV set
-        sendSpiData({0x20});
-        sendSpiCommand(0xC6);  // Frame rate control
-        sendSpiData({0x0F});
-        sendSpiCommand(0xD0);  // Power control 1
-        sendSpiData({0xA4, 0xA1});
-        sendSpiCommand(0x21);  // Display inversion on
-        sendSpiCommand(0x29);  // Display on
-    } else if (display.controller == "ST7735") {
-        // ST7735 init sequence
-        sendSpiCommand(0x01);  // Software reset
-        usleep(150000);
-        sendSpiCommand(0x11);  // Sleep out
-        usleep(500000);
-        sendSpiCommand(0xB1);  // Frame rate control
-        sendSpiData({0x01, 0x2C, 0x2D});
-        sendSpiCommand(0xB2);
-        sendSpiData({0x01, 0x2C, 0x2D});
-        sendSpiCommand(0xB3);
-        sendSpiData({0x01, 0x2C, 0x2D, 0x01, 0x2C, 0x2D});
-        sendSpiCommand(0xB4);  // Display inversion
-        sendSpiData({0x07});
-        sendSpiCommand(0xC0);  // Power control
-        sendSpiData({0xA2, 0x02, 0x84});
-        sendSpiCommand(0xC1);
-        sendSpiData({0xC5});
-        sendSpiCommand(0xC2);
-        sendSpiData({0x0A, 0x00});
-        sendSpiCommand(0xC3);
-        sendSpiData({0x8A, 0x2A});
-        sendSpiCommand(0xC4);
-        sendSpiData({0x8A, 0xEE});
-        sendSpiCommand(0xC5);  // VCOM
-        sendSpiData({0x0E});
-        sendSpiCommand(0x36);  // MX, MY, RGB mode
-        sendSpiData({0xC8});
-        sendSpiCommand(0x3A);  // Color mode
-        sendSpiData({0x05});   // 16-bit
-        sendSpiCommand(0x29);  // Display on
-    } else if (display.controller == "SSD1306") {
-        // SSD1306 OLED init sequence
-        sendSpiCommand(0xAE);  // Display off
-        sendSpiCommand(0xD5);  // Set display clock
-        sendSpiCommand(0x80);
-        sendSpiCommand(0xA8);  // Set multiplex
-        sendSpiCommand(0x3F);
-        sendSpiCommand(0xD3);  // Set display offset
-        sendSpiCommand(0x00);
-        sendSpiCommand(0x40);  // Set start line
-        sendSpiCommand(0x8D);  // Charge pump
-        sendSpiCommand(0x14);
-        sendSpiCommand(0x20);  // Memory mode
-        sendSpiCommand(0x00);
-        sendSpiCommand(0xA1);  // Seg remap
-        sendSpiCommand(0xC8);  // COM scan direction
-        sendSpiCommand(0xDA);  // COM pins
-        sendSpiCommand(0x12);
-        sendSpiCommand(0x81);  // Contrast
-        sendSpiCommand(0xCF);
-        sendSpiCommand(0xD9);  // Pre-charge
-        sendSpiCommand(0xF1);
-        sendSpiCommand(0xDB);  // VCOM detect
-        sendSpiCommand(0x40);
-        sendSpiCommand(0xA4);  // Resume RAM
-        sendSpiCommand(0xA6);  // Normal display
-        sendSpiCommand(0xAF);  // Display on
-    } else if (display.controller == "GC9A01") {
-        // GC9A01 round display init
-        sendSpiCommand(0xEF);
-        sendSpiCommand(0xEB); sendSpiData({0x14});
-        sendSpiCommand(0xFE);
-        sendSpiCommand(0xEF);
-        sendSpiCommand(0xEB); sendSpiData({0x14});
-        sendSpiCommand(0x84); sendSpiData({0x40});
-        sendSpiCommand(0x85); sendSpiData({0xFF});
-        sendSpiCommand(0x86); sendSpiData({0xFF});
-        sendSpiCommand(0x87); sendSpiData({0xFF});
-        sendSpiCommand(0x88); sendSpiData({0x0A});
-        sendSpiCommand(0x89); sendSpiData({0x21});
-        sendSpiCommand(0x8A); sendSpiData({0x00});
-        sendSpiCommand(0x8B); sendSpiData({0x80});
-        sendSpiCommand(0x8C); sendSpiData({0x01});
-        sendSpiCommand(0x8D); sendSpiData({0x01});
-        sendSpiCommand(0x8E); sendSpiData({0xFF});
-        sendSpiCommand(0x8F); sendSpiData({0xFF});
-        sendSpiCommand(0x3A); sendSpiData({0x55});
-        sendSpiCommand(0x11);
-        usleep(120000);
-        sendSpiCommand(0x29);
+    const auto* sequence = getSpiInitSequence(display.controller);
+    if (sequence == nullptr) {
+        LOG(WARNING) << "No init sequence for controller " << display.controller;
+        return true;
+    }
+    for (const auto& step : *sequence) {
+        sendSpiCommand(step.cmd);
+        if (!step.data.empty()) {
+            sendSpiData(step.data);
+        }
+        if (step.delayMs > 0) {
+            usleep(step.delayMs * 1000);
+        }
     }
-    // Add more controllers as needed...
     
     LOG(INFO) << "Display controller " << display.controller << " initialized";
     return true;
@@ -492,6 +355,7 @@ std::vector<std::string> DisplayManager::getSupportedSpiDisplays() {
 }
 
 bool DisplayManager::sendSpiCommand(uint8_t cmd) {
+    ATRACE_CALL();
     if (mSpiFd < 0) return false;
     
     // Set DC low for command
@@ -504,7 +368,9 @@ bool DisplayManager::sendSpiCommand(uint8_t cmd) {
 }
 
 bool DisplayManager::sendSpiData(const std::vector<uint8_t>& data) {
+    ATRACE_CALL();
     if (mSpiFd < 0) return false;
+    ATRACE_INT("spi bytes", static_cast<int32_t>(data.size()));
     
     // Set DC high for data
     if (mDcGpioFd >= 0) {
@@ -524,27 +390,32 @@ bool DisplayManager::setBacklight(uint32_t brightness) {
     
     if (brightness > 255) brightness = 255;
     mBacklightLevel = brightness;
-    
-    // Try various backlight interfaces
-    const char* backlightPaths[] = {
-        "/sys/class/backlight/rpi_backlight/brightness",
-        "/sys/class/backlight/10-0045/brightness",
-        "/sys/class/backlight/backlight/brightness",
-        "/sys/class/leds/lcd-backlight/brightness",
-    };
-    
-    for (const auto& path : backlightPaths) {
-        int fd = open(path, O_WRONLY);
-        if (fd >= 0) {
-            char buf[16];
-            snprintf(buf, sizeof(buf), "%u", brightness);
-            write(fd, buf, strlen(buf));
-            close(fd);
-            LOG(INFO) << "Backlight set to " << brightness << " via " << path;
-            return true;
+    ATRACE_INT("backlight", static_cast<int32_t>(brightness));
+    
+    if (!mBacklight.exists()) {
+        // Try various backlight interfaces
+        const char* backlightPaths[] = {
+            "/sys/class/backlight/rpi_backlight/brightness",
+            "/sys/class/backlight/10-0045/brightness",
+            "/sys/class/backlight/backlight/brightness",
+            "/sys/class/leds/lcd-backlight/brightness",
+        };
+        
+        for (const auto& path : backlightPaths) {
+            ::android::hardware::brcm::sysfs::SysfsFile file(path, O_WRONLY);
+            if (file.exists()) {
+                mBacklight = std::move(file);
+                LOG(INFO) << "Backlight control via " << path;
+                break;
+            }
         }
     }
     
+    if (mBacklight.writeInt(brightness)) {
+        LOG(DEBUG) << "Backlight set to " << brightness;
+        return true;
+    }
+    
     LOG(WARNING) << "No backlight control found";
     return false;
 }
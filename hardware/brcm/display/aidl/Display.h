@@ -17,6 +17,8 @@
 #pragma once
 
 #include <aidl/android/hardware/graphics/composer3/BnComposerClient.h>
+#include <Sysfs.h>
+#include "SpiPanel.h"
 #include <vector>
 #include <map>
 #include <mutex>
@@ -177,6 +179,8 @@ private:
     std::string mActivePanelName;
     bool mDisplayEnabled;
     uint32_t mBacklightLevel;
+    // First backlight interface found, kept open for brightness ramps
+    ::android::hardware::brcm::sysfs::SysfsFile mBacklight;
     
     // MIPI DSI specific
     int mDsiFd;
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SpiPanel.h"
+
+#include <map>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace graphics {
+namespace composer3 {
+namespace implementation {
+
+static const std::vector<SpiInitStep> kIli9341Init = {
+    {0x01, {}, 5},                              // Software reset
+    {0x28, {}},                                 // Display off
+    {0xCF, {0x00, 0xC1, 0x30}},                 // Power control B
+    {0xED, {0x64, 0x03, 0x12, 0x81}},           // Power on sequence control
+    {0xE8, {0x85, 0x00, 0x78}},                 // Driver timing control A
+    {0xCB, {0x39, 0x2C, 0x00, 0x34, 0x02}},     // Power control A
+    {0xF7, {0x20}},                             // Pump ratio control
+    {0xEA, {0x00, 0x00}},                       // Driver timing control B
+    {0xC0, {0x23}},                             // Power control 1
+    {0xC1, {0x10}},                             // Power control 2
+    {0xC5, {0x3E, 0x28}},                       // VCOM control 1
+    {0xC7, {0x86}},                             // VCOM control 2
+    {0x36, {0x48}},                             // Memory access control
+    {0x3A, {0x55}},                             // Pixel format, 16-bit
+    {0xB1, {0x00, 0x18}},                       // Frame rate control
+    {0xB6, {0x08, 0x82, 0x27}},                 // Display function control
+    {0xF2, {0x00}},                             // 3Gamma function disable
+    {0x26, {0x01}},                             // Gamma curve selected
+    {0x11, {}, 120},                            // Sleep out
+    {0x29, {}},                                 // Display on
+};
+
+static const std::vector<SpiInitStep> kSt7789Init = {
+    {0x01, {}, 150},                            // Software reset
+    {0x11, {}, 500},                            // Sleep out
+    {0x3A, {0x55}},                             // Interface pixel format, 16-bit
+    {0x36, {0x00}},                             // Memory data access control
+    {0xB2, {0x0C, 0x0C, 0x00, 0x33, 0x33}},     // Porch setting
+    {0xB7, {0x35}},                             // Gate control
+    {0xBB, {0x19}},                             // VCOM setting
+    {0xC0, {0x2C}},                             // LCM control
+    {0xC2, {0x01}},                             // VDV and VRH command enable
+    {0xC3, {0x12}},                             // VRH set
+    {0xC4, {0x20}},                             // VDV set
+    {0xC6, {0x0F}},                             // Frame rate control
+    {0xD0, {0xA4, 0xA1}},                       // Power control 1
+    {0x21, {}},                                 // Display inversion on
+    {0x29, {}},                                 // Display on
+};
+
+static const std::vector<SpiInitStep> kSt7735Init = {
+    {0x01, {}, 150},                            // Software reset
+    {0x11, {}, 500},                            // Sleep out
+    {0xB1, {0x01, 0x2C, 0x2D}},                 // Frame rate control
+    {0xB2, {0x01, 0x2C, 0x2D}},
+    {0xB3, {0x01, 0x2C, 0x2D, 0x01, 0x2C, 0x2D}},
+    {0xB4, {0x07}},                             // Display inversion
+    {0xC0, {0xA2, 0x02, 0x84}},                 // Power control
+    {0xC1, {0xC5}},
+    {0xC2, {0x0A, 0x00}},
+    {0xC3, {0x8A, 0x2A}},
+    {0xC4, {0x8A, 0xEE}},
+    {0xC5, {0x0E}},                             // VCOM
+    {0x36, {0xC8}},                             // MX, MY, RGB mode
+    {0x3A, {0x05}},                             // Color mode, 16-bit
+    {0x29, {}},                                 // Display on
+};
+
+// The SSD1306 takes its parameters in command mode, one byte per step
+static const std::vector<SpiInitStep> kSsd1306Init = {
+    {0xAE, {}},                                 // Display off
+    {0xD5, {}}, {0x80, {}},                     // Set display clock
+    {0xA8, {}}, {0x3F, {}},                     // Set multiplex
+    {0xD3, {}}, {0x00, {}},                     // Set display offset
+    {0x40, {}},                                 // Set start line
+    {0x8D, {}}, {0x14, {}},                     // Charge pump
+    {0x20, {}}, {0x00, {}},                     // Memory mode
+    {0xA1, {}},                                 // Seg remap
+    {0xC8, {}},                                 // COM scan direction
+    {0xDA, {}}, {0x12, {}},                     // COM pins
+    {0x81, {}}, {0xCF, {}},                     // Contrast
+    {0xD9, {}}, {0xF1, {}},                     // Pre-charge
+    {0xDB, {}}, {0x40, {}},                     // VCOM detect
+    {0xA4, {}},                                 // Resume RAM
+    {0xA6, {}},                                 // Normal display
+    {0xAF, {}},                                 // Display on
+};
+
+// GC9A01 round display
+static const std::vector<SpiInitStep> kGc9a01Init = {
+    {0xEF, {}},
+    {0xEB, {0x14}},
+    {0xFE, {}},
+    {0xEF, {}},
+    {0xEB, {0x14}},
+    {0x84, {0x40}},
+    {0x85, {0xFF}},
+    {0x86, {0xFF}},
+    {0x87, {0xFF}},
+    {0x88, {0x0A}},
+    {0x89, {0x21}},
+    {0x8A, {0x00}},
+    {0x8B, {0x80}},
+    {0x8C, {0x01}},
+    {0x8D, {0x01}},
+    {0x8E, {0xFF}},
+    {0x8F, {0xFF}},
+    {0x3A, {0x55}},
+    {0x11, {}, 120},
+    {0x29, {}},
+};
+
+const std::vector<SpiInitStep>* getSpiInitSequence(const std::string& controller) {
+    static const std::map<std::string, const std::vector<SpiInitStep>*> kSequences = {
+        {"ILI9341", &kIli9341Init},
+        {"ST7789", &kSt7789Init},
+        {"ST7735", &kSt7735Init},
+        {"SSD1306", &kSsd1306Init},
+        {"GC9A01", &kGc9a01Init},
+    };
+    auto it = kSequences.find(controller);
+    return it != kSequences.end() ? it->second : nullptr;
+}
+
+}  // namespace implementation
+}  // namespace composer3
+}  // namespace graphics
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Init sequences for the SPI panel controllers, kept as data so they can be
+// inspected and built on the host as libbrcm_spi_panel.
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace graphics {
+namespace composer3 {
+namespace implementation {
+
+// One command with DC low, its parameters with DC high, then a settle delay
+struct SpiInitStep {
+    uint8_t cmd;
+    std::vector<uint8_t> data;
+    uint32_t delayMs = 0;
+};
+
+// Sequence for a controller name (ILI9341, ST7789, ...), or nullptr when the
+// controller has no table
+const std::vector<SpiInitStep>* getSpiInitSequence(const std::string& controller);
+
+}  // namespace implementation
+}  // namespace composer3
+}  // namespace graphics
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
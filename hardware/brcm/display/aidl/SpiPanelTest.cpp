@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Shape of the SPI panel init tables.
+
+#include <gtest/gtest.h>
+
+#include "SpiPanel.h"
+
+using namespace aidl::android::hardware::graphics::composer3::implementation;
+
+static const char* const kControllers[] = {"ILI9341", "ST7789", "ST7735", "SSD1306", "GC9A01"};
+
+TEST(SpiPanelTest, EveryControllerHasATable) {
+    for (const char* controller : kControllers) {
+        const auto* sequence = getSpiInitSequence(controller);
+        ASSERT_NE(sequence, nullptr) << controller;
+        EXPECT_FALSE(sequence->empty()) << controller;
+    }
+}
+
+TEST(SpiPanelTest, UnknownControllerHasNoTable) {
+    EXPECT_EQ(getSpiInitSequence("ILI9488"), nullptr);
+    EXPECT_EQ(getSpiInitSequence("ili9341"), nullptr);
+    EXPECT_EQ(getSpiInitSequence(""), nullptr);
+}
+
+TEST(SpiPanelTest, SequencesEndWithDisplayOn) {
+    for (const char* controller : kControllers) {
+        const auto& sequence = *getSpiInitSequence(controller);
+        uint8_t displayOn = std::string(controller) == "SSD1306" ? 0xAF : 0x29;
+        EXPECT_EQ(sequence.back().cmd, displayOn) << controller;
+    }
+}
+
+TEST(SpiPanelTest, SleepOutIsFollowedByADelay) {
+    // The MIPI DCS controllers need at least 5 ms after sleep out
+    for (const char* controller : kControllers) {
+        for (const auto& step : *getSpiInitSequence(controller)) {
+            if (step.cmd == 0x11 && std::string(controller) != "SSD1306") {
+                EXPECT_GE(step.delayMs, 5u) << controller;
+            }
+        }
+    }
+}
+
+TEST(SpiPanelTest, SoftwareResetComesFirst) {
+    for (const char* controller : {"ILI9341", "ST7789", "ST7735"}) {
+        const auto& sequence = *getSpiInitSequence(controller);
+        EXPECT_EQ(sequence.front().cmd, 0x01) << controller;
+        EXPECT_GT(sequence.front().delayMs, 0u) << controller;
+    }
+}
+
+TEST(SpiPanelTest, Ssd1306SendsParametersAsCommands) {
+    for (const auto& step : *getSpiInitSequence("SSD1306")) {
+        EXPECT_TRUE(step.data.empty());
+    }
+}
+
+TEST(SpiPanelTest, Ili9341Selects16BitPixels) {
+    bool found = false;
+    for (const auto& step : *getSpiInitSequence("ILI9341")) {
+        if (step.cmd == 0x3A) {
+            ASSERT_EQ(step.data.size(), 1u);
+            EXPECT_EQ(step.data[0], 0x55);
+            found = true;
+        }
+    }
+    EXPECT_TRUE(found);
+}
@@ -10,7 +10,6 @@
 #include "Lights.h"
 
 #include <android-base/logging.h>
-#include <android-base/file.h>
 
 namespace aidl {
 namespace android {
@@ -23,7 +22,10 @@ static constexpr const char* kPwrLedPath = "/sys/class/leds/PWR/brightness";
 static constexpr const char* kActLedPath = "/sys/class/leds/ACT/brightness";
 static constexpr const char* kBacklightPath = "/sys/class/backlight/rpi_backlight/brightness";
 
-Lights::Lights() {
+Lights::Lights()
+    : backlight_(kBacklightPath, O_WRONLY),
+      act_led_(kActLedPath, O_WRONLY),
+      pwr_led_(kPwrLedPath, O_WRONLY) {
     LOG(INFO) << "Raspberry Pi 5 Light HAL AIDL initialized";
 }
 
@@ -34,20 +36,18 @@ ndk::ScopedAStatus Lights::setLightState(int32_t id, const HwLightState& state)
         (state.color & 0xFF) * 0.114f
     );
     
+    std::lock_guard<std::mutex> lock(lock_);
     switch (id) {
         case static_cast<int32_t>(LightType::BACKLIGHT):
-            ::android::base::WriteStringToFile(
-                std::to_string(brightness), kBacklightPath);
+            backlight_.writeInt(brightness);
             break;
             
         case static_cast<int32_t>(LightType::NOTIFICATIONS):
-            ::android::base::WriteStringToFile(
-                brightness > 0 ? "255" : "0", kActLedPath);
+            act_led_.write(brightness > 0 ? "255" : "0");
             break;
             
         case static_cast<int32_t>(LightType::BATTERY):
-            ::android::base::WriteStringToFile(
-                brightness > 0 ? "255" : "0", kPwrLedPath);
+            pwr_led_.write(brightness > 0 ? "255" : "0");
             break;
             
         default:
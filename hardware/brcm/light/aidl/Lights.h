@@ -6,6 +6,9 @@
 #pragma once
 
 #include <aidl/android/hardware/light/BnLights.h>
+#include <Sysfs.h>
+
+#include <mutex>
 
 namespace aidl {
 namespace android {
@@ -20,6 +23,13 @@ class Lights : public BnLights {
     
     ndk::ScopedAStatus setLightState(int32_t id, const HwLightState& state) override;
     ndk::ScopedAStatus getLights(std::vector<HwLight>* _aidl_return) override;
+
+  private:
+    // The framework resends unchanged states on every update
+    std::mutex lock_;
+    ::android::hardware::brcm::sysfs::SysfsFile backlight_;
+    ::android::hardware::brcm::sysfs::SysfsFile act_led_;
+    ::android::hardware::brcm::sysfs::SysfsFile pwr_led_;
 };
 
 }  // namespace rpi5
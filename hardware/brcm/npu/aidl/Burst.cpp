@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * NNAPI burst execution for the Raspberry Pi 5 NPU driver
+ */
+
+#include "Burst.h"
+
+#include "PreparedModel.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// Token the runtime uses for pools it does not want cached
+constexpr int64_t kNoMemoryIdentifier = -1;
+
+Burst::Burst(std::shared_ptr<PreparedModel> preparedModel)
+    : prepared_model_(std::move(preparedModel)) {}
+
+ndk::ScopedAStatus Burst::mapPools(const Request& request,
+                                   const std::vector<int64_t>& memoryIdentifierTokens,
+                                   MappedPools* pools) {
+    if (memoryIdentifierTokens.size() != request.pools.size()) {
+        return toAStatus(ErrorStatus::INVALID_ARGUMENT, "one memory token per pool expected");
+    }
+
+    pools->clear();
+    pools->reserve(request.pools.size());
+    std::lock_guard<std::mutex> lock(lock_);
+    for (size_t i = 0; i < request.pools.size(); i++) {
+        const auto& pool = request.pools[i];
+        const int64_t token = memoryIdentifierTokens[i];
+        if (pool.getTag() != RequestMemoryPool::pool) {
+            return toAStatus(ErrorStatus::INVALID_ARGUMENT, "device buffers are not supported");
+        }
+        if (token < kNoMemoryIdentifier) {
+            return toAStatus(ErrorStatus::INVALID_ARGUMENT, "invalid memory token");
+        }
+
+        if (token != kNoMemoryIdentifier) {
+            auto it = memory_cache_.find(token);
+            if (it != memory_cache_.end()) {
+                pools->push_back(it->second);
+                continue;
+            }
+        }
+        auto memory = MappedMemory::map(pool.get<RequestMemoryPool::pool>());
+        if (memory == nullptr) {
+            return toAStatus(ErrorStatus::GENERAL_FAILURE, "failed to map a request pool");
+        }
+        if (token != kNoMemoryIdentifier) {
+            memory_cache_[token] = memory;
+        }
+        pools->push_back(std::move(memory));
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus Burst::executeSynchronously(const Request& request,
+                                               const std::vector<int64_t>& memoryIdentifierTokens,
+                                               bool measureTiming, int64_t deadlineNs,
+                                               int64_t loopTimeoutDurationNs,
+                                               ExecutionResult* _aidl_return) {
+    MappedPools pools;
+    auto status = mapPools(request, memoryIdentifierTokens, &pools);
+    if (!status.isOk()) {
+        return status;
+    }
+    return prepared_model_->run(request.inputs, request.outputs, pools, measureTiming, deadlineNs,
+                                _aidl_return);
+}
+
+ndk::ScopedAStatus Burst::releaseMemoryResource(int64_t memoryIdentifierToken) {
+    if (memoryIdentifierToken < kNoMemoryIdentifier) {
+        return toAStatus(ErrorStatus::INVALID_ARGUMENT, "invalid memory token");
+    }
+    // Executions still holding the mapping keep it alive until they finish
+    std::lock_guard<std::mutex> lock(lock_);
+    memory_cache_.erase(memoryIdentifierToken);
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus Burst::executeSynchronouslyWithConfig(
+        const Request& request, const std::vector<int64_t>& memoryIdentifierTokens,
+        const ExecutionConfig& config, int64_t deadlineNs, ExecutionResult* _aidl_return) {
+    return executeSynchronously(request, memoryIdentifierTokens, config.measureTiming, deadlineNs,
+                                config.loopTimeoutDurationNs, _aidl_return);
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * NNAPI burst execution for the Raspberry Pi 5 NPU driver
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/neuralnetworks/BnBurst.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "NnapiUtils.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+class PreparedModel;
+
+// Back-to-back executions of one prepared model. Pools the runtime tags with
+// a memory identifier token stay mapped across executions until it calls
+// releaseMemoryResource, so a steady stream of frames costs no mmap/munmap.
+class Burst : public BnBurst {
+  public:
+    explicit Burst(std::shared_ptr<PreparedModel> preparedModel);
+
+    ndk::ScopedAStatus executeSynchronously(const Request& request,
+                                            const std::vector<int64_t>& memoryIdentifierTokens,
+                                            bool measureTiming, int64_t deadlineNs,
+                                            int64_t loopTimeoutDurationNs,
+                                            ExecutionResult* _aidl_return) override;
+    ndk::ScopedAStatus releaseMemoryResource(int64_t memoryIdentifierToken) override;
+    ndk::ScopedAStatus executeSynchronouslyWithConfig(
+            const Request& request, const std::vector<int64_t>& memoryIdentifierTokens,
+            const ExecutionConfig& config, int64_t deadlineNs,
+            ExecutionResult* _aidl_return) override;
+
+  private:
+    ndk::ScopedAStatus mapPools(const Request& request,
+                                const std::vector<int64_t>& memoryIdentifierTokens,
+                                MappedPools* pools);
+
+    const std::shared_ptr<PreparedModel> prepared_model_;
+    std::mutex lock_;
+    std::map<int64_t, std::shared_ptr<MappedMemory>> memory_cache_;
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
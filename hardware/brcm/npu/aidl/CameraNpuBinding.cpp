@@ -0,0 +1,471 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Camera stream to NPU binding for Raspberry Pi 5
+ */
+
+#include "CameraNpuBinding.h"
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/dma-buf.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#define ATRACE_TAG ATRACE_TAG_NNAPI
+#include <log/log.h>
+#include <utils/Trace.h>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+using camera::rpi5::CameraManager;
+using camera::rpi5::DmabufFrame;
+using camera::rpi5::FrameFormat;
+
+static const uint64_t kStatsIntervalNs = 5000000000ULL;
+
+// Default latency budget in frame intervals: readout, conversion and the run
+static const int64_t kDefaultBudgetFrames = 3;
+
+// Capture timestamps are CLOCK_MONOTONIC; NPU deadlines are CLOCK_BOOTTIME
+static uint64_t clockNs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool toSourceLayout(const std::string& pixelFormat, SourceLayout* layout) {
+    if (pixelFormat == "YUYV") {
+        *layout = SourceLayout::YUYV;
+    } else if (pixelFormat == "NV12") {
+        *layout = SourceLayout::NV12;
+    } else if (pixelFormat == "NV21") {
+        *layout = SourceLayout::NV21;
+    } else if (pixelFormat == "GREY") {
+        *layout = SourceLayout::GREY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Brackets CPU reads of a buffer the camera wrote, so caches are coherent
+static int dmabufSync(int fd, uint64_t flags) {
+    struct dma_buf_sync sync;
+    sync.flags = flags;
+    int r;
+    do {
+        r = ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
+    } while (r == -1 && errno == EINTR);
+    return r;
+}
+
+CameraNpuBinding::CameraNpuBinding(const CameraBindingConfig& config,
+                                   BindingResultCallback callback)
+    : mConfig(config), mCallback(std::move(callback)) {}
+
+CameraNpuBinding::~CameraNpuBinding() {
+    stop();
+}
+
+bool CameraNpuBinding::configureInput(const FrameFormat& format) {
+    ModelInfo model = NpuManager::getInstance().getModelInfo(mNpuId, mConfig.modelId);
+    if (model.inputs.empty() || model.inputs[0].second.size() != 4) {
+        ALOGE("Model %s is not loaded on %s or has no NHWC input", mConfig.modelId.c_str(),
+              mNpuId.c_str());
+        return false;
+    }
+    const auto& dims = model.inputs[0].second;
+    if (dims[0] != 1 || (dims[3] != 1 && dims[3] != 3)) {
+        ALOGE("Model %s input is not a single grey or RGB image", mConfig.modelId.c_str());
+        return false;
+    }
+
+    SourceFormat source;
+    if (!toSourceLayout(format.pixelFormat, &source.layout)) {
+        ALOGE("Camera format %s cannot feed a model", format.pixelFormat.c_str());
+        return false;
+    }
+    source.width = format.width;
+    source.height = format.height;
+    source.rowStride = format.bytesPerLine;
+    if (source.rowStride == 0) {
+        source.rowStride = format.width * (source.layout == SourceLayout::YUYV ? 2 : 1);
+    }
+
+    TensorFormat tensor;
+    tensor.height = dims[1];
+    tensor.width = dims[2];
+    tensor.channels = dims[3];
+    tensor.floatOutput = model.graph != nullptr &&
+            model.graph->operands[model.graph->inputIndexes[0]].type ==
+                    NpuOperandType::TENSOR_FLOAT32;
+    tensor.scale = mConfig.inputScale;
+    tensor.offset = mConfig.inputOffset;
+    if (!mPreprocessor.configure(source, tensor)) {
+        ALOGE("Cannot convert %ux%u %s to %ux%ux%u", format.width, format.height,
+              format.pixelFormat.c_str(), tensor.width, tensor.height, tensor.channels);
+        return false;
+    }
+
+    mInputName = model.inputs[0].first;
+    ALOGI("Camera %s %ux%u %s feeds %s as %ux%ux%u %s", mConfig.cameraId.c_str(),
+          format.width, format.height, format.pixelFormat.c_str(), mConfig.modelId.c_str(),
+          tensor.width, tensor.height, tensor.channels, tensor.floatOutput ? "float" : "uint8");
+    return true;
+}
+
+bool CameraNpuBinding::start() {
+    ATRACE_CALL();
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mStreaming) {
+            return true;
+        }
+    }
+
+    NpuManager& npu = NpuManager::getInstance();
+    // The primary NPU may be a Hailo or Coral with no runtime behind it; the
+    // model is only loaded where it can run
+    mNpuId = mConfig.npuId;
+    if (mNpuId.empty()) {
+        mNpuId = npu.getModelNpu(mConfig.modelId);
+    }
+    if (mNpuId.empty()) {
+        mNpuId = kCpuNpuId;
+    }
+
+    CameraManager& cameras = CameraManager::getInstance();
+    mOwnsCamera = !cameras.isOpen(mConfig.cameraId);
+    if (mOwnsCamera && !cameras.openCamera(mConfig.cameraId)) {
+        mOwnsCamera = false;
+        return false;
+    }
+    if (mConfig.format.width != 0 && !cameras.setFormat(mConfig.cameraId, mConfig.format)) {
+        stop();
+        return false;
+    }
+    FrameFormat format = cameras.getFormat(mConfig.cameraId);
+    if (!configureInput(format)) {
+        stop();
+        return false;
+    }
+
+    mBudgetNs = mConfig.latencyBudgetNs;
+    if (mBudgetNs <= 0) {
+        mBudgetNs = kDefaultBudgetFrames * 1000000000LL / std::max<uint32_t>(format.fps, 1);
+    }
+
+    // The gate samples bytes, which only means something for 8-bit inputs
+    if (mConfig.frameGate) {
+        if (mPreprocessor.tensor().floatOutput) {
+            ALOGW("Frame gate needs an 8-bit input; %s runs on every frame",
+                  mConfig.modelId.c_str());
+        } else {
+            FrameGateConfig gate;
+            gate.gate = mConfig.gate;
+            mGated = npu.setFrameGate(mNpuId, mConfig.modelId, gate);
+        }
+    }
+
+    mMappings.assign(mConfig.bufferCount, Mapping());
+    mSequence = 0;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStreaming = true;
+        mStats = BindingStats();
+        mLatencySumNs = 0;
+        mPreprocessSumNs = 0;
+        mWindowStartNs = clockNs(CLOCK_MONOTONIC);
+        mWindowResults = 0;
+        mWindowLatencyNs = 0;
+        mWindowMaxLatencyNs = 0;
+    }
+    mWorker = std::thread(&CameraNpuBinding::workerLoop, this);
+
+    if (!cameras.startStreamingDmabuf(mConfig.cameraId, mConfig.bufferCount,
+                                      [this](const DmabufFrame& frame) { onFrame(frame); })) {
+        stop();
+        return false;
+    }
+
+    ALOGI("Camera %s bound to %s on %s, latency budget %.1f ms", mConfig.cameraId.c_str(),
+          mConfig.modelId.c_str(), mNpuId.c_str(), mBudgetNs / 1e6);
+    return true;
+}
+
+void CameraNpuBinding::stop() {
+    ATRACE_CALL();
+    CameraManager& cameras = CameraManager::getInstance();
+    NpuManager& npu = NpuManager::getInstance();
+
+    bool streaming;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        streaming = mStreaming;
+        mStreaming = false;
+    }
+    // Finishes the frame being converted or submitted; the camera's dmabufs
+    // must outlive it
+    mFrameReady.notify_all();
+    if (mWorker.joinable()) {
+        mWorker.join();
+    }
+
+    if (streaming) {
+        // Waits out a frame being admitted; STREAMOFF takes back the buffers
+        // of frames the worker never got to
+        cameras.stopStreaming(mConfig.cameraId);
+
+        std::vector<InferenceHandle> queued;
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            for (const auto& pending : mFrames) {
+                mHandles.erase(pending.sequence);
+            }
+            mFrames.clear();
+            for (const auto& entry : mHandles) {
+                if (entry.second != 0) {
+                    queued.push_back(entry.second);
+                }
+            }
+        }
+        for (InferenceHandle handle : queued) {
+            npu.cancelInference(mNpuId, handle);
+        }
+
+        std::unique_lock<std::mutex> lock(mLock);
+        mIdle.wait(lock, [this] { return mHandles.empty(); });
+        reportStats(true);
+    }
+
+    if (mGated) {
+        npu.clearFrameGate(mNpuId, mConfig.modelId);
+        mGated = false;
+    }
+    unmapBuffers();
+    if (mOwnsCamera) {
+        cameras.closeCamera(mConfig.cameraId);
+        mOwnsCamera = false;
+    }
+}
+
+BindingStats CameraNpuBinding::getStats() {
+    std::lock_guard<std::mutex> lock(mLock);
+    BindingStats stats = mStats;
+    stats.meanLatencyNs = stats.completed ? mLatencySumNs / stats.completed : 0;
+    stats.meanPreprocessNs = stats.submitted ? mPreprocessSumNs / stats.submitted : 0;
+    return stats;
+}
+
+// Reactor thread, which must not block: only admits the frame
+void CameraNpuBinding::onFrame(const DmabufFrame& frame) {
+    ATRACE_CALL();
+    uint64_t sequence = mSequence++;
+    int64_t remainingNs =
+            mBudgetNs - static_cast<int64_t>(clockNs(CLOCK_MONOTONIC) - frame.timestamp);
+
+    // Admit the frame only if there is room in the queue and time left for
+    // its result; otherwise the buffer goes straight back
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStats.frames++;
+        if (mHandles.size() >= mConfig.maxInFlight) {
+            mStats.busyDrops++;
+        } else if (remainingNs <= 0) {
+            mStats.expired++;
+        } else if (mStreaming) {
+            mHandles[sequence] = 0;
+            mFrames.push_back({frame, sequence});
+            mFrameReady.notify_one();
+            return;
+        }
+    }
+    CameraManager::getInstance().releaseFrame(mConfig.cameraId, frame.index);
+}
+
+void CameraNpuBinding::workerLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (true) {
+        mFrameReady.wait(lock, [this] { return !mStreaming || !mFrames.empty(); });
+        if (!mStreaming) {
+            break;
+        }
+        PendingFrame pending = mFrames.front();
+        mFrames.pop_front();
+        lock.unlock();
+        processFrame(pending);
+        lock.lock();
+    }
+}
+
+void CameraNpuBinding::processFrame(const PendingFrame& pending) {
+    ATRACE_CALL();
+    const DmabufFrame& frame = pending.frame;
+    const uint64_t sequence = pending.sequence;
+    uint64_t startNs = clockNs(CLOCK_MONOTONIC);
+    // Time may have run out while the frame waited for this thread
+    int64_t remainingNs = mBudgetNs - static_cast<int64_t>(startNs - frame.timestamp);
+
+    InferenceRequest request;
+    bool ready = remainingNs > 0;
+    if (ready) {
+        request.modelId = mConfig.modelId;
+        request.measureTiming = false;
+        request.priority = mConfig.priority;
+        request.deadlineNs = static_cast<int64_t>(clockNs(CLOCK_BOOTTIME)) + remainingNs;
+        request.inputs.emplace_back(mInputName, std::vector<uint8_t>());
+        ready = preprocess(frame, &request.inputs[0].second);
+    }
+
+    // The camera gets its buffer back as soon as the pixels are read
+    CameraManager::getInstance().releaseFrame(mConfig.cameraId, frame.index);
+    uint64_t preprocessNs = clockNs(CLOCK_MONOTONIC) - startNs;
+
+    if (!ready) {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (remainingNs <= 0) {
+            mStats.expired++;
+        }
+        if (mHandles.erase(sequence) != 0) {
+            mIdle.notify_all();
+        }
+        return;
+    }
+
+    InferenceHandle handle = NpuManager::getInstance().runInferenceAsync(
+            mNpuId, request, [this, sequence, captureNs = frame.timestamp](
+                                     const InferenceResult& result) {
+        onResult(sequence, captureNs, result);
+    });
+
+    std::lock_guard<std::mutex> lock(mLock);
+    mStats.submitted++;
+    mPreprocessSumNs += preprocessNs;
+    auto it = mHandles.find(sequence);
+    if (handle == 0) {
+        // NPU gone; no callback will come
+        if (it != mHandles.end()) {
+            mHandles.erase(it);
+            mIdle.notify_all();
+        }
+    } else if (it != mHandles.end()) {
+        it->second = handle;
+    }
+    ATRACE_INT("camera-npu inflight", static_cast<int32_t>(mHandles.size()));
+}
+
+bool CameraNpuBinding::preprocess(const DmabufFrame& frame, std::vector<uint8_t>* input) {
+    ATRACE_CALL();
+    if (frame.index >= mMappings.size()) {
+        mMappings.resize(frame.index + 1);
+    }
+
+    // Buffers are exported once per stream, so each is mapped on first use
+    Mapping& mapping = mMappings[frame.index];
+    if (mapping.addr == nullptr) {
+        void* addr = mmap(nullptr, frame.length, PROT_READ, MAP_SHARED, frame.fd, 0);
+        if (addr == MAP_FAILED) {
+            ALOGE("Failed to map camera buffer %u: %s", frame.index, strerror(errno));
+            return false;
+        }
+        mapping.addr = addr;
+        mapping.length = frame.length;
+    }
+
+    if (dmabufSync(frame.fd, DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ) < 0) {
+        ALOGE("Failed to sync camera buffer %u: %s", frame.index, strerror(errno));
+        return false;
+    }
+    input->resize(mPreprocessor.outputSize());
+    bool ok = mPreprocessor.process(static_cast<const uint8_t*>(mapping.addr),
+                                    std::min<size_t>(frame.bytesUsed, mapping.length),
+                                    input->data());
+    dmabufSync(frame.fd, DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ);
+
+    if (!ok) {
+        ALOGW("Camera buffer %u holds %u bytes, %zu needed", frame.index, frame.bytesUsed,
+              mPreprocessor.sourceSize());
+    }
+    return ok;
+}
+
+void CameraNpuBinding::onResult(uint64_t sequence, uint64_t captureNs,
+                                const InferenceResult& result) {
+    uint64_t now = clockNs(CLOCK_MONOTONIC);
+    uint64_t latencyNs = now > captureNs ? now - captureNs : 0;
+
+    // Deadline drops are counted; nothing is delivered once stop() has begun
+    bool deliver;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        deliver = mStreaming && !result.expired;
+        if (result.expired) {
+            mStats.expired++;
+        }
+        if (deliver) {
+            mStats.completed++;
+            if (result.reused) {
+                mStats.reused++;
+            }
+            mLatencySumNs += latencyNs;
+            mStats.maxLatencyNs = std::max(mStats.maxLatencyNs, latencyNs);
+            mWindowResults++;
+            mWindowLatencyNs += latencyNs;
+            mWindowMaxLatencyNs = std::max(mWindowMaxLatencyNs, latencyNs);
+            if (now - mWindowStartNs >= kStatsIntervalNs) {
+                reportStats(false);
+            }
+        }
+    }
+
+    if (deliver) {
+        ATRACE_INT("camera-npu latency us", static_cast<int32_t>(latencyNs / 1000));
+        BindingResult binding;
+        binding.result = result;
+        binding.sequence = sequence;
+        binding.captureTimestampNs = captureNs;
+        binding.latencyNs = latencyNs;
+        mCallback(binding);
+    }
+
+    // Only now may stop() return and the binding go away
+    std::lock_guard<std::mutex> lock(mLock);
+    mHandles.erase(sequence);
+    mIdle.notify_all();
+}
+
+void CameraNpuBinding::unmapBuffers() {
+    for (auto& mapping : mMappings) {
+        if (mapping.addr != nullptr) {
+            munmap(mapping.addr, mapping.length);
+        }
+    }
+    mMappings.clear();
+}
+
+// Caller holds mLock
+void CameraNpuBinding::reportStats(bool final) {
+    uint64_t now = clockNs(CLOCK_MONOTONIC);
+    uint64_t elapsed = std::max<uint64_t>(now - mWindowStartNs, 1);
+    double rate = mWindowResults * 1e9 / elapsed;
+    double meanMs = mWindowResults ? mWindowLatencyNs / 1e6 / mWindowResults : 0.0;
+
+    ALOGI("%s%s: %.1f results/s, capture-to-result latency mean %.2f ms max %.2f ms, "
+          "%llu frames, %llu busy, %llu expired, %llu reused",
+          final ? "Binding stopped: " : "", mConfig.cameraId.c_str(), rate, meanMs,
+          mWindowMaxLatencyNs / 1e6, static_cast<unsigned long long>(mStats.frames),
+          static_cast<unsigned long long>(mStats.busyDrops),
+          static_cast<unsigned long long>(mStats.expired),
+          static_cast<unsigned long long>(mStats.reused));
+
+    mWindowStartNs = now;
+    mWindowResults = 0;
+    mWindowLatencyNs = 0;
+    mWindowMaxLatencyNs = 0;
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
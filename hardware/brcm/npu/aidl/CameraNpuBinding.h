@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Camera stream to NPU binding for Raspberry Pi 5
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Camera.h>
+
+#include "FramePreprocess.h"
+#include "Npu.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+struct CameraBindingConfig {
+    std::string cameraId;
+    // Applied when width is set; otherwise the camera keeps its current format
+    camera::rpi5::FrameFormat format = {};
+    uint32_t bufferCount = 4;
+
+    std::string npuId;          // empty: wherever modelId is loaded, else kCpuNpuId
+    std::string modelId;        // loaded on npuId, first input NHWC with 1 or 3 channels
+    float inputScale = 1.0f / 255.0f;   // float inputs only: pixel * scale + offset
+    float inputOffset = 0.0f;
+
+    InferencePriority priority = InferencePriority::HIGH;
+    // Capture-to-result budget, from the V4L2 start-of-frame timestamp; frames
+    // that cannot make it are dropped instead of being run late. 0: three
+    // frame intervals, one of which passes before the frame is even read out.
+    int64_t latencyBudgetNs = 0;
+    // Frames allowed in the NPU queue at once; newer frames are dropped while
+    // it is full, so a slow model never builds up latency
+    uint32_t maxInFlight = 2;
+
+    bool frameGate = false;
+    FrameGate::Config gate;
+};
+
+// One inferred frame as the application sees it
+struct BindingResult {
+    InferenceResult result;
+    uint64_t sequence;              // capture order, counting dropped frames
+    uint64_t captureTimestampNs;    // CLOCK_MONOTONIC, from the V4L2 buffer
+    uint64_t latencyNs;             // capture to result
+};
+
+using BindingResultCallback = std::function<void(const BindingResult& result)>;
+
+struct BindingStats {
+    uint64_t frames = 0;        // captured
+    uint64_t submitted = 0;     // handed to the NPU, or answered by the frame gate
+    uint64_t completed = 0;     // delivered to the application
+    uint64_t busyDrops = 0;     // NPU queue full when the frame arrived
+    uint64_t expired = 0;       // missed the latency budget
+    uint64_t reused = 0;        // delivered from the frame gate
+    uint64_t meanLatencyNs = 0;
+    uint64_t maxLatencyNs = 0;
+    uint64_t meanPreprocessNs = 0;
+};
+
+// Feeds a camera stream straight into a loaded model. Capture buffers arrive
+// as dmabufs and are mapped once; each frame is synced for CPU reads, scaled
+// and colour-converted into the model input and handed back to the camera
+// before the request is queued, so the application only sees results.
+//
+// Frames arrive on the shared reactor thread, whose handlers must not block,
+// so it only admits or drops them; conversion, the frame gate and submission
+// run on the binding's own thread. The callback runs on the NPU worker.
+//
+// The binding drives the devices from the calling process: CameraManager and
+// NpuManager are that process's own instances, not the provider and NN HAL
+// services. It is for a vendor process that owns the camera and the NPU, with
+// neither service using them at the same time.
+class CameraNpuBinding {
+public:
+    CameraNpuBinding(const CameraBindingConfig& config, BindingResultCallback callback);
+    ~CameraNpuBinding();
+
+    bool start();
+    // Stops capture, cancels queued requests and waits for the ones running
+    void stop();
+
+    BindingStats getStats();
+
+private:
+    struct Mapping {
+        void* addr = nullptr;
+        size_t length = 0;
+    };
+
+    struct PendingFrame {
+        camera::rpi5::DmabufFrame frame;
+        uint64_t sequence;
+    };
+
+    bool configureInput(const camera::rpi5::FrameFormat& format);
+    void onFrame(const camera::rpi5::DmabufFrame& frame);
+    void workerLoop();
+    void processFrame(const PendingFrame& pending);
+    bool preprocess(const camera::rpi5::DmabufFrame& frame, std::vector<uint8_t>* input);
+    void onResult(uint64_t sequence, uint64_t captureNs, const InferenceResult& result);
+    void unmapBuffers();
+    void reportStats(bool final);
+
+    const CameraBindingConfig mConfig;
+    const BindingResultCallback mCallback;
+    std::string mNpuId;
+    std::string mInputName;
+    int64_t mBudgetNs = 0;
+    bool mOwnsCamera = false;   // opened here, closed again on stop
+    bool mGated = false;
+
+    // Worker thread only, once streaming
+    FramePreprocessor mPreprocessor;
+    std::vector<Mapping> mMappings;     // by buffer index
+    // Reactor thread only
+    uint64_t mSequence = 0;
+
+    std::thread mWorker;
+    std::mutex mLock;
+    std::condition_variable mIdle;
+    std::condition_variable mFrameReady;
+    bool mStreaming = false;
+    // Admitted frames the worker has not taken yet, buffers still held
+    std::deque<PendingFrame> mFrames;
+    // Unfinished frames by sequence, with their queue handle for cancelling
+    // on stop. Entered before submitting, since the result can come first.
+    std::map<uint64_t, InferenceHandle> mHandles;
+    BindingStats mStats;
+    uint64_t mLatencySumNs = 0;
+    uint64_t mPreprocessSumNs = 0;
+
+    // Reported every few seconds and on stop
+    uint64_t mWindowStartNs = 0;
+    uint64_t mWindowResults = 0;
+    uint64_t mWindowLatencyNs = 0;
+    uint64_t mWindowMaxLatencyNs = 0;
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,1453 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * CPU inference backend for the Raspberry Pi 5 NPU HAL
+ */
+
+#include "CpuBackend.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "CpuGemm.h"
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define BACKEND_USE_NEON 1
+#endif
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+namespace {
+
+// NNAPI OperationType values the backend runs
+enum : int32_t {
+    kOpAdd = 0,
+    kOpAveragePool2d = 1,
+    kOpConcatenation = 2,
+    kOpConv2d = 3,
+    kOpDepthwiseConv2d = 4,
+    kOpFullyConnected = 9,
+    kOpMaxPool2d = 17,
+    kOpReshape = 22,
+    kOpSoftmax = 25,
+};
+
+// NNAPI FuseCode
+enum : int32_t {
+    kFuseNone = 0,
+    kFuseRelu = 1,
+    kFuseRelu1 = 2,
+    kFuseRelu6 = 3,
+};
+
+// NNAPI PaddingCode; 0 stands for explicit padding here
+constexpr int32_t kPaddingSame = 1;
+constexpr int32_t kPaddingValid = 2;
+
+bool isActivationType(NpuOperandType type) {
+    return type == NpuOperandType::TENSOR_FLOAT32 || type == NpuOperandType::TENSOR_QUANT8_ASYMM;
+}
+
+template <typename T>
+bool readScalar(const NpuGraph& graph, uint32_t index, T* value) {
+    const NpuOperand& operand = graph.operands[index];
+    if (operand.lifetime != NpuOperandLifetime::CONSTANT || operand.value.size() != sizeof(T)) {
+        return false;
+    }
+    memcpy(value, operand.value.data(), sizeof(T));
+    return true;
+}
+
+bool readActivation(const NpuGraph& graph, uint32_t index, int32_t* activation) {
+    return readScalar(graph, index, activation) && *activation >= kFuseNone &&
+           *activation <= kFuseRelu6;
+}
+
+// Layout flag of the convolution and pooling operations; only NHWC runs here
+bool isNhwc(const NpuGraph& graph, const NpuOperation& operation, size_t at) {
+    uint8_t nchw = 0;
+    return at >= operation.inputs.size() || (readScalar(graph, operation.inputs[at], &nchw) &&
+                                             nchw == 0);
+}
+
+struct ConvParams {
+    int32_t padding = 0;    // kPaddingSame, kPaddingValid or 0 for the explicit values
+    int32_t padLeft = 0;
+    int32_t padRight = 0;
+    int32_t padTop = 0;
+    int32_t padBottom = 0;
+    int32_t strideW = 1;
+    int32_t strideH = 1;
+    int32_t multiplier = 1;
+    int32_t activation = kFuseNone;
+    int32_t dilationW = 1;
+    int32_t dilationH = 1;
+};
+
+// Scalar inputs of CONV_2D and DEPTHWISE_CONV_2D. The explicit form has four
+// padding values where the implicit one has a scheme, which is told apart by
+// the type of the operand the layout flag would take in the implicit form.
+bool parseConv(const NpuGraph& graph, const NpuOperation& operation, bool depthwise,
+               ConvParams* params) {
+    const auto& in = operation.inputs;
+    const size_t explicitCount = depthwise ? 11 : 10;
+    const size_t implicitCount = depthwise ? 8 : 7;
+    if (in.size() < implicitCount) {
+        return false;
+    }
+    const bool explicitPadding =
+            in.size() >= explicitCount &&
+            graph.operands[in[explicitCount - 3]].type != NpuOperandType::BOOL;
+
+    size_t at = 3;
+    if (explicitPadding) {
+        if (!readScalar(graph, in[3], &params->padLeft) ||
+            !readScalar(graph, in[4], &params->padRight) ||
+            !readScalar(graph, in[5], &params->padTop) ||
+            !readScalar(graph, in[6], &params->padBottom)) {
+            return false;
+        }
+        at = 7;
+    } else {
+        if (!readScalar(graph, in[3], &params->padding) ||
+            (params->padding != kPaddingSame && params->padding != kPaddingValid)) {
+            return false;
+        }
+        at = 4;
+    }
+    if (!readScalar(graph, in[at], &params->strideW) ||
+        !readScalar(graph, in[at + 1], &params->strideH)) {
+        return false;
+    }
+    at += 2;
+    if (depthwise && !readScalar(graph, in[at++], &params->multiplier)) {
+        return false;
+    }
+    if (!readActivation(graph, in[at++], &params->activation) || !isNhwc(graph, operation, at)) {
+        return false;
+    }
+    if (in.size() > at + 2 && (!readScalar(graph, in[at + 1], &params->dilationW) ||
+                               !readScalar(graph, in[at + 2], &params->dilationH))) {
+        return false;
+    }
+    return params->padLeft >= 0 && params->padRight >= 0 && params->padTop >= 0 &&
+           params->padBottom >= 0 && params->strideW > 0 && params->strideH > 0 &&
+           params->multiplier > 0 && params->dilationW > 0 && params->dilationH > 0;
+}
+
+struct PoolParams {
+    int32_t padding = 0;
+    int32_t padLeft = 0;
+    int32_t padRight = 0;
+    int32_t padTop = 0;
+    int32_t padBottom = 0;
+    int32_t strideW = 1;
+    int32_t strideH = 1;
+    int32_t filterW = 1;
+    int32_t filterH = 1;
+    int32_t activation = kFuseNone;
+};
+
+bool parsePool(const NpuGraph& graph, const NpuOperation& operation, PoolParams* params) {
+    const auto& in = operation.inputs;
+    if (in.size() < 7) {
+        return false;
+    }
+    size_t at = 1;
+    if (in.size() >= 10) {
+        if (!readScalar(graph, in[1], &params->padLeft) ||
+            !readScalar(graph, in[2], &params->padRight) ||
+            !readScalar(graph, in[3], &params->padTop) ||
+            !readScalar(graph, in[4], &params->padBottom)) {
+            return false;
+        }
+        at = 5;
+    } else {
+        if (!readScalar(graph, in[1], &params->padding) ||
+            (params->padding != kPaddingSame && params->padding != kPaddingValid)) {
+            return false;
+        }
+        at = 2;
+    }
+    if (!readScalar(graph, in[at], &params->strideW) ||
+        !readScalar(graph, in[at + 1], &params->strideH) ||
+        !readScalar(graph, in[at + 2], &params->filterW) ||
+        !readScalar(graph, in[at + 3], &params->filterH) ||
+        !readActivation(graph, in[at + 4], &params->activation)) {
+        return false;
+    }
+    return isNhwc(graph, operation, at + 5) && params->padLeft >= 0 && params->padRight >= 0 &&
+           params->padTop >= 0 && params->padBottom >= 0 && params->strideW > 0 &&
+           params->strideH > 0 && params->filterW > 0 && params->filterH > 0;
+}
+
+// Filter of a convolution or fully connected layer against its input type.
+// Per-channel scales must run along the output channels.
+bool validFilter(const NpuOperand& input, const NpuOperand& filter, uint32_t channelDim) {
+    if (filter.lifetime != NpuOperandLifetime::CONSTANT) {
+        return false;
+    }
+    if (input.type == NpuOperandType::TENSOR_FLOAT32) {
+        return filter.type == NpuOperandType::TENSOR_FLOAT32;
+    }
+    return filter.type == NpuOperandType::TENSOR_QUANT8_ASYMM ||
+           (filter.type == NpuOperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL &&
+            filter.channelDim == channelDim);
+}
+
+bool validBias(const NpuOperand& input, const NpuOperand& bias) {
+    const NpuOperandType expected = input.type == NpuOperandType::TENSOR_FLOAT32
+                                            ? NpuOperandType::TENSOR_FLOAT32
+                                            : NpuOperandType::TENSOR_INT32;
+    return bias.lifetime == NpuOperandLifetime::CONSTANT && bias.type == expected;
+}
+
+// Inputs and outputs that carry activations all share one type
+bool sameActivationType(const NpuGraph& graph, const std::vector<uint32_t>& indexes,
+                        NpuOperandType type) {
+    return std::all_of(indexes.begin(), indexes.end(), [&](uint32_t index) {
+        return graph.operands[index].type == type;
+    });
+}
+
+bool checkOperation(const NpuGraph& graph, const NpuOperation& operation) {
+    const size_t count = graph.operands.size();
+    auto inRange = [count](uint32_t index) { return index < count; };
+    if (operation.inputs.empty() || operation.outputs.size() != 1 ||
+        !std::all_of(operation.inputs.begin(), operation.inputs.end(), inRange) ||
+        !inRange(operation.outputs[0])) {
+        return false;
+    }
+    const NpuOperand& input = graph.operands[operation.inputs[0]];
+    const NpuOperand& output = graph.operands[operation.outputs[0]];
+    if (!isActivationType(input.type) || output.type != input.type) {
+        return false;
+    }
+    const auto& in = operation.inputs;
+
+    switch (operation.type) {
+        case kOpConv2d:
+        case kOpDepthwiseConv2d: {
+            const bool depthwise = operation.type == kOpDepthwiseConv2d;
+            ConvParams params;
+            return parseConv(graph, operation, depthwise, &params) &&
+                   validFilter(input, graph.operands[in[1]], depthwise ? 3 : 0) &&
+                   validBias(input, graph.operands[in[2]]);
+        }
+        case kOpFullyConnected: {
+            int32_t activation;
+            return in.size() == 4 && validFilter(input, graph.operands[in[1]], 0) &&
+                   validBias(input, graph.operands[in[2]]) &&
+                   readActivation(graph, in[3], &activation);
+        }
+        case kOpAveragePool2d:
+        case kOpMaxPool2d: {
+            PoolParams params;
+            return parsePool(graph, operation, &params);
+        }
+        case kOpAdd: {
+            int32_t activation;
+            return in.size() == 3 && graph.operands[in[1]].type == input.type &&
+                   readActivation(graph, in[2], &activation);
+        }
+        case kOpReshape:
+            return in.size() == 2;
+        case kOpSoftmax: {
+            float beta;
+            int32_t axis = -1;
+            return (in.size() == 2 || (in.size() == 3 && readScalar(graph, in[2], &axis))) &&
+                   readScalar(graph, in[1], &beta);
+        }
+        case kOpConcatenation: {
+            int32_t axis;
+            std::vector<uint32_t> tensors(in.begin(), in.end() - 1);
+            return in.size() >= 2 && readScalar(graph, in.back(), &axis) &&
+                   sameActivationType(graph, tensors, input.type);
+        }
+        default:
+            return false;
+    }
+}
+
+// Output extent along one axis and the padding in front of the first tap
+bool outputExtent(uint32_t in, uint32_t filter, int32_t stride, int32_t dilation,
+                  int32_t padding, int32_t padBefore, int32_t padAfter, uint32_t* out,
+                  int32_t* pad) {
+    const int64_t effective = static_cast<int64_t>(filter - 1) * dilation + 1;
+    int64_t extent;
+    switch (padding) {
+        case kPaddingSame: {
+            extent = (in + stride - 1) / stride;
+            const int64_t total = std::max<int64_t>((extent - 1) * stride + effective - in, 0);
+            *pad = static_cast<int32_t>(total / 2);
+            break;
+        }
+        case kPaddingValid:
+            extent = in >= effective ? (in - effective) / stride + 1 : 0;
+            *pad = 0;
+            break;
+        default: {
+            const int64_t padded = static_cast<int64_t>(in) + padBefore + padAfter;
+            extent = padded >= effective ? (padded - effective) / stride + 1 : 0;
+            *pad = padBefore;
+            break;
+        }
+    }
+    *out = static_cast<uint32_t>(extent);
+    return extent > 0;
+}
+
+void activationRange(int32_t activation, float* lo, float* hi) {
+    switch (activation) {
+        case kFuseRelu:
+            *lo = 0.0f;
+            *hi = FLT_MAX;
+            break;
+        case kFuseRelu1:
+            *lo = -1.0f;
+            *hi = 1.0f;
+            break;
+        case kFuseRelu6:
+            *lo = 0.0f;
+            *hi = 6.0f;
+            break;
+        default:
+            *lo = -FLT_MAX;
+            *hi = FLT_MAX;
+            break;
+    }
+}
+
+// The fused activation in the output's quantized domain
+void quantActivationRange(int32_t activation, const NpuOperand& output, int32_t* lo,
+                          int32_t* hi) {
+    float low;
+    float high;
+    activationRange(activation, &low, &high);
+    *lo = 0;
+    *hi = 255;
+    if (low > -FLT_MAX) {
+        *lo = std::max<int32_t>(*lo, output.zeroPoint + std::lrint(low / output.scale));
+    }
+    if (high < FLT_MAX) {
+        *hi = std::min<int32_t>(*hi, output.zeroPoint + std::lrint(high / output.scale));
+    }
+}
+
+uint8_t quantize(float value, const NpuOperand& operand) {
+    int32_t q = static_cast<int32_t>(std::lrint(value / operand.scale)) + operand.zeroPoint;
+    return static_cast<uint8_t>(std::clamp(q, 0, 255));
+}
+
+size_t elementCount(const std::vector<uint32_t>& shape) {
+    size_t count = 1;
+    for (uint32_t dim : shape) {
+        count *= dim;
+    }
+    return count;
+}
+
+bool fullySpecified(const std::vector<uint32_t>& shape) {
+    return std::none_of(shape.begin(), shape.end(), [](uint32_t dim) { return dim == 0; });
+}
+
+void parallelRows(size_t rows, CpuThreadPool* pool, const std::function<void(size_t)>& row) {
+    if (pool != nullptr) {
+        pool->parallelFor(rows, row);
+    } else {
+        for (size_t r = 0; r < rows; r++) {
+            row(r);
+        }
+    }
+}
+
+// Spatial layout of a convolution, depthwise convolution or pooling window
+struct Window {
+    uint32_t batches;
+    uint32_t inH;
+    uint32_t inW;
+    uint32_t inC;
+    uint32_t outH;
+    uint32_t outW;
+    uint32_t outC;
+    uint32_t filterH;
+    uint32_t filterW;
+    int32_t strideH;
+    int32_t strideW;
+    int32_t dilationH;
+    int32_t dilationW;
+    int32_t padTop;
+    int32_t padLeft;
+    uint32_t multiplier;
+
+    // Input row of tap |ky| for output row |oy|, -1 if it lands in the padding
+    int32_t inputY(uint32_t oy, uint32_t ky) const {
+        int32_t y = static_cast<int32_t>(oy) * strideH - padTop +
+                    static_cast<int32_t>(ky) * dilationH;
+        return y >= 0 && y < static_cast<int32_t>(inH) ? y : -1;
+    }
+    int32_t inputX(uint32_t ox, uint32_t kx) const {
+        int32_t x = static_cast<int32_t>(ox) * strideW - padLeft +
+                    static_cast<int32_t>(kx) * dilationW;
+        return x >= 0 && x < static_cast<int32_t>(inW) ? x : -1;
+    }
+    // 1x1 convolutions read their input as the GEMM's A directly
+    bool pointwise() const {
+        return filterH == 1 && filterW == 1 && outH == inH && outW == inW && padTop == 0 &&
+               padLeft == 0;
+    }
+};
+
+// One row of A per output pixel, holding its receptive field in the filter's
+// [ky][kx][c] order; taps in the padding take |padValue|
+template <typename T>
+void im2col(const T* input, const Window& w, T padValue, T* rows, CpuThreadPool* pool) {
+    const size_t rowSize = static_cast<size_t>(w.filterH) * w.filterW * w.inC;
+    parallelRows(static_cast<size_t>(w.batches) * w.outH, pool, [&](size_t line) {
+        const uint32_t b = line / w.outH;
+        const uint32_t oy = line % w.outH;
+        T* dst = rows + line * w.outW * rowSize;
+        for (uint32_t ox = 0; ox < w.outW; ox++) {
+            for (uint32_t ky = 0; ky < w.filterH; ky++) {
+                const int32_t iy = w.inputY(oy, ky);
+                for (uint32_t kx = 0; kx < w.filterW; kx++) {
+                    const int32_t ix = w.inputX(ox, kx);
+                    if (iy < 0 || ix < 0) {
+                        std::fill(dst, dst + w.inC, padValue);
+                    } else {
+                        memcpy(dst, input + ((static_cast<size_t>(b) * w.inH + iy) * w.inW + ix) *
+                                                    w.inC,
+                               w.inC * sizeof(T));
+                    }
+                    dst += w.inC;
+                }
+            }
+        }
+    });
+}
+
+// acc[c] += in[c] * filter[c] over one tap of a depthwise convolution
+void depthwiseTapF32(const float* in, const float* filter, uint32_t channels, float* acc) {
+    uint32_t c = 0;
+#ifdef BACKEND_USE_NEON
+    for (; c + 4 <= channels; c += 4) {
+        vst1q_f32(acc + c, vfmaq_f32(vld1q_f32(acc + c), vld1q_f32(in + c),
+                                     vld1q_f32(filter + c)));
+    }
+#endif
+    // Scalar reference path, also used for the tail the vector loop leaves over
+    for (; c < channels; c++) {
+        acc[c] += in[c] * filter[c];
+    }
+}
+
+// As above on uint8 input less its zero point, against filter values that
+// already had theirs taken off
+void depthwiseTapQ8(const uint8_t* in, int16_t inZero, const int16_t* filter, uint32_t channels,
+                    int32_t* acc) {
+    uint32_t c = 0;
+#ifdef BACKEND_USE_NEON
+    const int16x8_t zero = vdupq_n_s16(inZero);
+    for (; c + 8 <= channels; c += 8) {
+        int16x8_t x = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(in + c))), zero);
+        int16x8_t f = vld1q_s16(filter + c);
+        vst1q_s32(acc + c, vmlal_s16(vld1q_s32(acc + c), vget_low_s16(x), vget_low_s16(f)));
+        vst1q_s32(acc + c + 4, vmlal_high_s16(vld1q_s32(acc + c + 4), x, f));
+    }
+#endif
+    for (; c < channels; c++) {
+        acc[c] += (in[c] - inZero) * filter[c];
+    }
+}
+
+// Filter taps are [ky][kx][outC]; each output channel c reads input channel
+// c / multiplier. Rows of the output go to the pool.
+template <typename Acc, typename Tap, typename Store>
+void depthwiseConv(const Window& w, const Acc* bias, CpuThreadPool* pool, const Tap& tap,
+               const Store& store) {
+    parallelRows(static_cast<size_t>(w.batches) * w.outH, pool, [&](size_t line) {
+        const uint32_t b = line / w.outH;
+        const uint32_t oy = line % w.outH;
+        thread_local std::vector<Acc> acc;
+        acc.resize(w.outC);
+        for (uint32_t ox = 0; ox < w.outW; ox++) {
+            std::copy(bias, bias + w.outC, acc.begin());
+            for (uint32_t ky = 0; ky < w.filterH; ky++) {
+                const int32_t iy = w.inputY(oy, ky);
+                if (iy < 0) {
+                    continue;
+                }
+                for (uint32_t kx = 0; kx < w.filterW; kx++) {
+                    const int32_t ix = w.inputX(ox, kx);
+                    if (ix >= 0) {
+                        tap((static_cast<size_t>(b) * w.inH + iy) * w.inW + ix,
+                            ky * w.filterW + kx, acc.data());
+                    }
+                }
+            }
+            store(line * w.outW + ox, acc.data());
+        }
+    });
+}
+
+// Flat offset into an input of |shape| for the output index |out|, with
+// size-1 dimensions broadcast; both shapes are right-aligned to |outShape|
+size_t broadcastOffset(size_t out, const std::vector<uint32_t>& outShape,
+                       const std::vector<uint32_t>& shape) {
+    size_t offset = 0;
+    size_t stride = 1;
+    const size_t skip = outShape.size() - shape.size();
+    for (size_t d = outShape.size(); d-- > skip;) {
+        const uint32_t coordinate = out % outShape[d];
+        out /= outShape[d];
+        const uint32_t dim = shape[d - skip];
+        offset += (dim == 1 ? 0 : coordinate) * stride;
+        stride *= dim;
+    }
+    return offset;
+}
+
+}  // namespace
+
+bool cpuSupportsOperation(const NpuGraph& graph, const NpuOperation& operation) {
+    return checkOperation(graph, operation);
+}
+
+const char* cpuOperationName(int32_t type) {
+    switch (type) {
+        case kOpAdd:
+            return "ADD";
+        case kOpAveragePool2d:
+            return "AVERAGE_POOL_2D";
+        case kOpConcatenation:
+            return "CONCATENATION";
+        case kOpConv2d:
+            return "CONV_2D";
+        case kOpDepthwiseConv2d:
+            return "DEPTHWISE_CONV_2D";
+        case kOpFullyConnected:
+            return "FULLY_CONNECTED";
+        case kOpMaxPool2d:
+            return "MAX_POOL_2D";
+        case kOpReshape:
+            return "RESHAPE";
+        case kOpSoftmax:
+            return "SOFTMAX";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+CpuModel::CpuModel(std::shared_ptr<const NpuGraph> graph) : mGraph(std::move(graph)) {}
+
+std::unique_ptr<CpuModel> CpuModel::create(std::shared_ptr<const NpuGraph> graph,
+                                           std::string* error,
+                                           const std::vector<uint8_t>* packedWeights) {
+    std::unique_ptr<CpuModel> model(new CpuModel(std::move(graph)));
+    model->mPrepacked = packedWeights;
+    const bool planned = model->plan(error);
+    model->mPrepacked = nullptr;
+    if (!planned) {
+        return nullptr;
+    }
+    return model;
+}
+
+namespace {
+
+// Each panel set is tagged with its type, so a blob for another graph stops
+// matching at the first layer that differs
+constexpr uint8_t kPackedQ8 = 0;
+constexpr uint8_t kPackedF32 = 1;
+
+// Reads the panels at *offset if they carry |tag|, and moves past them
+template <typename T>
+bool readTagged(const std::vector<uint8_t>& blob, uint8_t tag, size_t* offset, T* packed) {
+    size_t at = *offset;
+    if (at >= blob.size() || blob[at++] != tag ||
+        !readPackedWeights(blob.data(), blob.size(), &at, packed)) {
+        return false;
+    }
+    *offset = at;
+    return true;
+}
+
+}  // namespace
+
+void CpuModel::packQ8(const uint8_t* weights, bool isSigned, int32_t zeroPoint, uint32_t n,
+                      uint32_t k, PackedWeightsQ8* packed) {
+    if (mPrepacked == nullptr ||
+        !readTagged(*mPrepacked, kPackedQ8, &mPrepackedOffset, packed) || packed->n != n ||
+        packed->k != k || packed->zeroPoint != (isSigned ? zeroPoint : zeroPoint - 128)) {
+        mPrepacked = nullptr;
+        packWeightsQ8(weights, isSigned, zeroPoint, n, k, packed);
+    }
+    addWeights(packed->data);
+    addWeights(packed->sums);
+    mPacked.emplace_back(packed, nullptr);
+}
+
+void CpuModel::packF32(const float* weights, uint32_t n, uint32_t k, bool half,
+                       PackedWeightsF32* packed) {
+    if (mPrepacked == nullptr ||
+        !readTagged(*mPrepacked, kPackedF32, &mPrepackedOffset, packed) || packed->n != n ||
+        packed->k != k || packed->half != (half && gemmHasHalfPrecision())) {
+        mPrepacked = nullptr;
+        packWeightsF32(weights, n, k, half, packed);
+    }
+    addWeights(packed->data);
+    addWeights(packed->halfData);
+    mPacked.emplace_back(nullptr, packed);
+}
+
+void CpuModel::packedWeights(std::vector<uint8_t>* out) const {
+    out->clear();
+    for (const auto& [q8, f32] : mPacked) {
+        if (q8 != nullptr) {
+            out->push_back(kPackedQ8);
+            appendPackedWeights(*q8, out);
+        } else {
+            out->push_back(kPackedF32);
+            appendPackedWeights(*f32, out);
+        }
+    }
+}
+
+const uint8_t* CpuModel::read(uint32_t index) const {
+    const NpuOperand& operand = mGraph->operands[index];
+    return operand.lifetime == NpuOperandLifetime::CONSTANT ? operand.value.data()
+                                                            : mBuffers[index].data();
+}
+
+bool CpuModel::setShape(uint32_t index, const std::vector<uint32_t>& shape,
+                        std::string* error) {
+    std::vector<uint32_t>& known = mShapes[index];
+    if (fullySpecified(known) && !known.empty() && known != shape) {
+        *error = "operand " + std::to_string(index) + " does not have the shape it computes to";
+        return false;
+    }
+    known = shape;
+    return true;
+}
+
+bool CpuModel::plan(std::string* error) {
+    const NpuGraph& graph = *mGraph;
+    mShapes.resize(graph.operands.size());
+    for (size_t i = 0; i < graph.operands.size(); i++) {
+        mShapes[i] = graph.operands[i].dimensions;
+    }
+    for (uint32_t index : graph.inputIndexes) {
+        if (index >= graph.operands.size() || !isActivationType(graph.operands[index].type) ||
+            mShapes[index].empty() || !fullySpecified(mShapes[index])) {
+            *error = "model inputs need a fixed float or uint8 shape";
+            return false;
+        }
+    }
+
+    for (uint32_t index = 0; index < graph.operations.size(); index++) {
+        const NpuOperation& operation = graph.operations[index];
+        if (!checkOperation(graph, operation)) {
+            *error = "operation " + std::to_string(operation.type) + " is not supported";
+            return false;
+        }
+        for (size_t i = 0; i < operation.inputs.size(); i++) {
+            const NpuOperand& operand = graph.operands[operation.inputs[i]];
+            if (operand.lifetime != NpuOperandLifetime::CONSTANT &&
+                (mShapes[operation.inputs[i]].empty() ||
+                 !fullySpecified(mShapes[operation.inputs[i]]))) {
+                *error = "operand " + std::to_string(operation.inputs[i]) + " has no shape";
+                return false;
+            }
+        }
+        const size_t first = mSteps.size();
+        if (!planOperation(operation, error)) {
+            return false;
+        }
+
+        // What the layer reads and writes, for profiles
+        uint64_t bytesIn = 0;
+        uint64_t weightBytes = 0;
+        uint64_t bytesOut = 0;
+        for (uint32_t in : operation.inputs) {
+            const NpuOperand& operand = graph.operands[in];
+            if (operand.lifetime == NpuOperandLifetime::CONSTANT) {
+                weightBytes += operand.value.size();
+            } else {
+                bytesIn += npuOperandSize(operand.type, mShapes[in]);
+            }
+        }
+        for (uint32_t out : operation.outputs) {
+            bytesOut += npuOperandSize(graph.operands[out].type, mShapes[out]);
+        }
+        for (size_t i = first; i < mSteps.size(); i++) {
+            mSteps[i].operation = index;
+            mSteps[i].bytesIn = bytesIn;
+            mSteps[i].bytesOut = bytesOut;
+            mSteps[i].weightBytes = weightBytes;
+        }
+    }
+
+    mBuffers.resize(graph.operands.size());
+    for (size_t i = 0; i < graph.operands.size(); i++) {
+        const NpuOperand& operand = graph.operands[i];
+        if (operand.lifetime == NpuOperandLifetime::CONSTANT ||
+            operand.lifetime == NpuOperandLifetime::NO_VALUE) {
+            continue;
+        }
+        const size_t size = npuOperandSize(operand.type, mShapes[i]);
+        if (size == 0) {
+            *error = "operand " + std::to_string(i) + " has no shape";
+            return false;
+        }
+        mBuffers[i].resize(size);
+    }
+    for (uint32_t index : graph.outputIndexes) {
+        if (index >= graph.operands.size() || mBuffers[index].empty()) {
+            *error = "model output " + std::to_string(index) + " is never written";
+            return false;
+        }
+    }
+    mScratch.resize(mScratchSize);
+    return true;
+}
+
+bool CpuModel::planOperation(const NpuOperation& operation, std::string* error) {
+    switch (operation.type) {
+        case kOpConv2d:
+            return planConv(operation, false, error);
+        case kOpDepthwiseConv2d:
+            return planConv(operation, true, error);
+        case kOpFullyConnected:
+            return planFullyConnected(operation, error);
+        case kOpAveragePool2d:
+            return planPool(operation, false, error);
+        case kOpMaxPool2d:
+            return planPool(operation, true, error);
+        case kOpAdd:
+            return planAdd(operation, error);
+        case kOpReshape:
+            return planReshape(operation, error);
+        case kOpSoftmax:
+            return planSoftmax(operation, error);
+        case kOpConcatenation:
+            return planConcatenation(operation, error);
+        default:
+            *error = "operation " + std::to_string(operation.type) + " is not supported";
+            return false;
+    }
+}
+
+bool CpuModel::planConv(const NpuOperation& operation, bool depthwise, std::string* error) {
+    const NpuGraph& graph = *mGraph;
+    ConvParams params;
+    parseConv(graph, operation, depthwise, &params);
+    const uint32_t in = operation.inputs[0];
+    const uint32_t out = operation.outputs[0];
+    const NpuOperand& input = graph.operands[in];
+    const NpuOperand& filter = graph.operands[operation.inputs[1]];
+    const NpuOperand& bias = graph.operands[operation.inputs[2]];
+    const NpuOperand& output = graph.operands[out];
+
+    const std::vector<uint32_t>& inShape = mShapes[in];
+    const std::vector<uint32_t>& filterShape = filter.dimensions;
+    if (inShape.size() != 4 || filterShape.size() != 4) {
+        *error = "convolutions need 4-D input and filter";
+        return false;
+    }
+    Window w = {};
+    w.batches = inShape[0];
+    w.inH = inShape[1];
+    w.inW = inShape[2];
+    w.inC = inShape[3];
+    w.filterH = filterShape[1];
+    w.filterW = filterShape[2];
+    w.strideH = params.strideH;
+    w.strideW = params.strideW;
+    w.dilationH = params.dilationH;
+    w.dilationW = params.dilationW;
+    w.multiplier = params.multiplier;
+    if (depthwise) {
+        w.outC = filterShape[3];
+        if (filterShape[0] != 1 || w.outC != w.inC * w.multiplier) {
+            *error = "depthwise filter does not match its input channels";
+            return false;
+        }
+    } else {
+        w.outC = filterShape[0];
+        if (filterShape[3] != w.inC) {
+            *error = "convolution filter does not match its input channels";
+            return false;
+        }
+    }
+    if (bias.dimensions.size() != 1 || bias.dimensions[0] != w.outC ||
+        filter.value.size() != npuOperandSize(filter.type, filterShape) ||
+        bias.value.size() != npuOperandSize(bias.type, bias.dimensions)) {
+        *error = "convolution weights are the wrong size";
+        return false;
+    }
+    if (!outputExtent(w.inH, w.filterH, w.strideH, w.dilationH, params.padding, params.padTop,
+                      params.padBottom, &w.outH, &w.padTop) ||
+        !outputExtent(w.inW, w.filterW, w.strideW, w.dilationW, params.padding, params.padLeft,
+                      params.padRight, &w.outW, &w.padLeft)) {
+        *error = "convolution window is larger than its input";
+        return false;
+    }
+    if (!setShape(out, {w.batches, w.outH, w.outW, w.outC}, error)) {
+        return false;
+    }
+
+    const uint32_t taps = w.filterH * w.filterW;
+    const uint32_t depth = taps * w.inC;
+    const uint32_t m = w.batches * w.outH * w.outW;
+    mMacs += static_cast<uint64_t>(m) * w.outC * (depthwise ? taps : depth);
+    const bool quantized = input.type == NpuOperandType::TENSOR_QUANT8_ASYMM;
+    if (!depthwise && !w.pointwise()) {
+        mScratchSize = std::max(mScratchSize, static_cast<size_t>(m) * depth *
+                                                      (quantized ? 1 : sizeof(float)));
+    }
+
+    if (!quantized) {
+        const float* weights = reinterpret_cast<const float*>(filter.value.data());
+        auto biasValues = std::make_shared<std::vector<float>>(
+                reinterpret_cast<const float*>(bias.value.data()),
+                reinterpret_cast<const float*>(bias.value.data()) + w.outC);
+        float lo;
+        float hi;
+        activationRange(params.activation, &lo, &hi);
+
+        if (depthwise) {
+            mSteps.push_back({operation.type, [this, in, out, w, weights, biasValues, lo,
+                                               hi](CpuThreadPool* pool) {
+                const float* src = reinterpret_cast<const float*>(read(in));
+                float* dst = reinterpret_cast<float*>(write(out));
+                depthwiseConv<float>(
+                        w, biasValues->data(), pool,
+                        [&](size_t pixel, uint32_t tap, float* acc) {
+                            const float* px = src + pixel * w.inC;
+                            const float* f = weights + static_cast<size_t>(tap) * w.outC;
+                            if (w.multiplier == 1) {
+                                depthwiseTapF32(px, f, w.outC, acc);
+                                return;
+                            }
+                            for (uint32_t c = 0; c < w.outC; c++) {
+                                acc[c] += px[c / w.multiplier] * f[c];
+                            }
+                        },
+                        [&](size_t pixel, const float* acc) {
+                            float* o = dst + pixel * w.outC;
+                            for (uint32_t c = 0; c < w.outC; c++) {
+                                o[c] = std::clamp(acc[c], lo, hi);
+                            }
+                        });
+            }});
+            return true;
+        }
+
+        auto packed = std::make_shared<PackedWeightsF32>();
+        packF32(weights, w.outC, depth, graph.relaxFloat32toFloat16, packed.get());
+        mSteps.push_back({operation.type, [this, in, out, w, m, depth, packed, biasValues, lo,
+                                           hi](CpuThreadPool* pool) {
+            const float* a = reinterpret_cast<const float*>(read(in));
+            if (!w.pointwise()) {
+                float* rows = reinterpret_cast<float*>(mScratch.data());
+                im2col(a, w, 0.0f, rows, pool);
+                a = rows;
+            }
+            FloatOutput result;
+            result.bias = biasValues->data();
+            result.min = lo;
+            result.max = hi;
+            gemmF32(a, m, depth, *packed, result, reinterpret_cast<float*>(write(out)), w.outC,
+                    pool);
+        }});
+        return true;
+    }
+
+    // Quantized: one multiplier per output channel takes the int32 sums to
+    // the output scale
+    const bool perChannel = filter.type == NpuOperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL;
+    if (perChannel && filter.channelScales.size() != w.outC) {
+        *error = "per-channel filter needs one scale per output channel";
+        return false;
+    }
+    struct QuantLayer {
+        std::vector<int32_t> bias;
+        std::vector<float> multipliers;
+        PackedWeightsQ8 weights;        // convolution
+        std::vector<int16_t> taps;      // depthwise, less the filter zero point
+        QuantOutput output;
+    };
+    auto layer = std::make_shared<QuantLayer>();
+    const int32_t* biasData = reinterpret_cast<const int32_t*>(bias.value.data());
+    layer->bias.assign(biasData, biasData + w.outC);
+    layer->multipliers.resize(w.outC);
+    for (uint32_t c = 0; c < w.outC; c++) {
+        const float filterScale = perChannel ? filter.channelScales[c] : filter.scale;
+        layer->multipliers[c] = input.scale * filterScale / output.scale;
+    }
+    layer->output.bias = layer->bias.data();
+    layer->output.multipliers = layer->multipliers.data();
+    layer->output.zeroPoint = output.zeroPoint;
+    quantActivationRange(params.activation, output, &layer->output.min, &layer->output.max);
+    const int32_t inZero = input.zeroPoint;
+
+    if (depthwise) {
+        layer->taps.resize(static_cast<size_t>(taps) * w.outC);
+        for (size_t i = 0; i < layer->taps.size(); i++) {
+            layer->taps[i] = perChannel ? static_cast<int8_t>(filter.value[i])
+                                        : filter.value[i] - filter.zeroPoint;
+        }
+        addWeights(layer->taps);
+        mSteps.push_back({operation.type, [this, in, out, w, layer, inZero](CpuThreadPool* pool) {
+            const uint8_t* src = read(in);
+            uint8_t* dst = write(out);
+            const QuantOutput& q = layer->output;
+            depthwiseConv<int32_t>(
+                    w, layer->bias.data(), pool,
+                    [&](size_t pixel, uint32_t tap, int32_t* acc) {
+                        const uint8_t* px = src + pixel * w.inC;
+                        const int16_t* f = layer->taps.data() + static_cast<size_t>(tap) * w.outC;
+                        if (w.multiplier == 1) {
+                            depthwiseTapQ8(px, inZero, f, w.outC, acc);
+                            return;
+                        }
+                        for (uint32_t c = 0; c < w.outC; c++) {
+                            acc[c] += (px[c / w.multiplier] - inZero) * f[c];
+                        }
+                    },
+                    [&](size_t pixel, const int32_t* acc) {
+                        uint8_t* o = dst + pixel * w.outC;
+                        for (uint32_t c = 0; c < w.outC; c++) {
+                            int32_t v = q.zeroPoint +
+                                        static_cast<int32_t>(std::lrint(acc[c] * q.multipliers[c]));
+                            o[c] = static_cast<uint8_t>(std::clamp(v, q.min, q.max));
+                        }
+                    });
+        }});
+        return true;
+    }
+
+    packQ8(filter.value.data(), perChannel, perChannel ? 0 : filter.zeroPoint, w.outC, depth,
+           &layer->weights);
+    mSteps.push_back({operation.type, [this, in, out, w, m, depth, layer,
+                                       inZero](CpuThreadPool* pool) {
+        const uint8_t* a = read(in);
+        if (!w.pointwise()) {
+            im2col(a, w, static_cast<uint8_t>(inZero), mScratch.data(), pool);
+            a = mScratch.data();
+        }
+        gemmQ8(a, m, depth, inZero, layer->weights, layer->output, write(out), w.outC, pool);
+    }});
+    return true;
+}
+
+bool CpuModel::planFullyConnected(const NpuOperation& operation, std::string* error) {
+    const NpuGraph& graph = *mGraph;
+    const uint32_t in = operation.inputs[0];
+    const uint32_t out = operation.outputs[0];
+    const NpuOperand& input = graph.operands[in];
+    const NpuOperand& weights = graph.operands[operation.inputs[1]];
+    const NpuOperand& bias = graph.operands[operation.inputs[2]];
+    const NpuOperand& output = graph.operands[out];
+    int32_t activation = kFuseNone;
+    readActivation(graph, operation.inputs[3], &activation);
+
+    if (weights.dimensions.size() != 2 || weights.dimensions[1] == 0 ||
+        weights.value.size() != npuOperandSize(weights.type, weights.dimensions) ||
+        bias.dimensions.size() != 1 || bias.dimensions[0] != weights.dimensions[0] ||
+        bias.value.size() != npuOperandSize(bias.type, bias.dimensions)) {
+        *error = "fully connected weights are the wrong size";
+        return false;
+    }
+    const uint32_t units = weights.dimensions[0];
+    const uint32_t depth = weights.dimensions[1];
+    const size_t elements = elementCount(mShapes[in]);
+    if (elements % depth != 0) {
+        *error = "fully connected input does not divide into rows";
+        return false;
+    }
+    const uint32_t batches = elements / depth;
+    if (!setShape(out, {batches, units}, error)) {
+        return false;
+    }
+    mMacs += static_cast<uint64_t>(batches) * units * depth;
+
+    if (input.type == NpuOperandType::TENSOR_FLOAT32) {
+        auto packed = std::make_shared<PackedWeightsF32>();
+        packF32(reinterpret_cast<const float*>(weights.value.data()), units, depth,
+                graph.relaxFloat32toFloat16, packed.get());
+        const float* biasData = reinterpret_cast<const float*>(bias.value.data());
+        auto biasValues = std::make_shared<std::vector<float>>(biasData, biasData + units);
+        float lo;
+        float hi;
+        activationRange(activation, &lo, &hi);
+        mSteps.push_back({operation.type, [this, in, out, batches, depth, units, packed,
+                                           biasValues, lo, hi](CpuThreadPool* pool) {
+            FloatOutput result;
+            result.bias = biasValues->data();
+            result.min = lo;
+            result.max = hi;
+            gemmF32(reinterpret_cast<const float*>(read(in)), batches, depth, *packed, result,
+                    reinterpret_cast<float*>(write(out)), units, pool);
+        }});
+        return true;
+    }
+
+    const bool perChannel = weights.type == NpuOperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL;
+    if (perChannel && weights.channelScales.size() != units) {
+        *error = "per-channel weights need one scale per unit";
+        return false;
+    }
+    struct QuantLayer {
+        std::vector<int32_t> bias;
+        std::vector<float> multipliers;
+        PackedWeightsQ8 weights;
+        QuantOutput output;
+    };
+    auto layer = std::make_shared<QuantLayer>();
+    const int32_t* biasData = reinterpret_cast<const int32_t*>(bias.value.data());
+    layer->bias.assign(biasData, biasData + units);
+    layer->multipliers.resize(units);
+    for (uint32_t u = 0; u < units; u++) {
+        const float weightScale = perChannel ? weights.channelScales[u] : weights.scale;
+        layer->multipliers[u] = input.scale * weightScale / output.scale;
+    }
+    layer->output.bias = layer->bias.data();
+    layer->output.multipliers = layer->multipliers.data();
+    layer->output.zeroPoint = output.zeroPoint;
+    quantActivationRange(activation, output, &layer->output.min, &layer->output.max);
+    packQ8(weights.value.data(), perChannel, perChannel ? 0 : weights.zeroPoint, units, depth,
+           &layer->weights);
+    const int32_t inZero = input.zeroPoint;
+    mSteps.push_back({operation.type, [this, in, out, batches, depth, units, layer,
+                                       inZero](CpuThreadPool* pool) {
+        gemmQ8(read(in), batches, depth, inZero, layer->weights, layer->output, write(out),
+               units, pool);
+    }});
+    return true;
+}
+
+bool CpuModel::planPool(const NpuOperation& operation, bool max, std::string* error) {
+    const NpuGraph& graph = *mGraph;
+    PoolParams params;
+    parsePool(graph, operation, &params);
+    const uint32_t in = operation.inputs[0];
+    const uint32_t out = operation.outputs[0];
+    const NpuOperand& input = graph.operands[in];
+    const NpuOperand& output = graph.operands[out];
+    const std::vector<uint32_t>& inShape = mShapes[in];
+    if (inShape.size() != 4) {
+        *error = "pooling needs a 4-D input";
+        return false;
+    }
+
+    Window w = {};
+    w.batches = inShape[0];
+    w.inH = inShape[1];
+    w.inW = inShape[2];
+    w.inC = w.outC = inShape[3];
+    w.filterH = params.filterH;
+    w.filterW = params.filterW;
+    w.strideH = params.strideH;
+    w.strideW = params.strideW;
+    w.dilationH = w.dilationW = 1;
+    w.multiplier = 1;
+    if (!outputExtent(w.inH, w.filterH, w.strideH, 1, params.padding, params.padTop,
+                      params.padBottom, &w.outH, &w.padTop) ||
+        !outputExtent(w.inW, w.filterW, w.strideW, 1, params.padding, params.padLeft,
+                      params.padRight, &w.outW, &w.padLeft)) {
+        *error = "pooling window is larger than its input";
+        return false;
+    }
+    if (!setShape(out, {w.batches, w.outH, w.outW, w.outC}, error)) {
+        return false;
+    }
+
+    // Averages count only the taps inside the input, as TFLite does
+    auto pool2d = [w, max](auto* dst, const auto* src, auto lo, auto hi, auto finish,
+                           CpuThreadPool* pool) {
+        using Acc = decltype(finish(0, 0.0f, 0));
+        parallelRows(static_cast<size_t>(w.batches) * w.outH, pool, [&](size_t line) {
+            const uint32_t b = line / w.outH;
+            const uint32_t oy = line % w.outH;
+            thread_local std::vector<float> acc;
+            acc.resize(w.outC);
+            for (uint32_t ox = 0; ox < w.outW; ox++) {
+                std::fill(acc.begin(), acc.end(), max ? -FLT_MAX : 0.0f);
+                uint32_t count = 0;
+                for (uint32_t ky = 0; ky < w.filterH; ky++) {
+                    const int32_t iy = w.inputY(oy, ky);
+                    for (uint32_t kx = 0; kx < w.filterW && iy >= 0; kx++) {
+                        const int32_t ix = w.inputX(ox, kx);
+                        if (ix < 0) {
+                            continue;
+                        }
+                        const auto* px = src + ((static_cast<size_t>(b) * w.inH + iy) * w.inW +
+                                                ix) * w.inC;
+                        for (uint32_t c = 0; c < w.outC; c++) {
+                            acc[c] = max ? std::max<float>(acc[c], px[c]) : acc[c] + px[c];
+                        }
+                        count++;
+                    }
+                }
+                auto* o = dst + (line * w.outW + ox) * w.outC;
+                for (uint32_t c = 0; c < w.outC; c++) {
+                    o[c] = std::clamp<Acc>(finish(c, acc[c], count), lo, hi);
+                }
+            }
+        });
+    };
+
+    if (input.type == NpuOperandType::TENSOR_FLOAT32) {
+        float lo;
+        float hi;
+        activationRange(params.activation, &lo, &hi);
+        mSteps.push_back({operation.type, [this, in, out, max, lo, hi,
+                                           pool2d](CpuThreadPool* pool) {
+            pool2d(reinterpret_cast<float*>(write(out)),
+                   reinterpret_cast<const float*>(read(in)), lo, hi,
+                   [max](uint32_t, float value, uint32_t count) {
+                       return max || count == 0 ? value : value / count;
+                   },
+                   pool);
+        }});
+        return true;
+    }
+
+    // The output shares the input's scale, so only the activation clamps
+    int32_t lo;
+    int32_t hi;
+    quantActivationRange(params.activation, output, &lo, &hi);
+    mSteps.push_back({operation.type, [this, in, out, max, lo, hi, pool2d](CpuThreadPool* pool) {
+        pool2d(write(out), read(in), static_cast<uint8_t>(lo), static_cast<uint8_t>(hi),
+               [max](uint32_t, float value, uint32_t count) -> uint8_t {
+                   return static_cast<uint8_t>(
+                           max || count == 0 ? value : std::lrint(value / count));
+               },
+               pool);
+    }});
+    return true;
+}
+
+bool CpuModel::planAdd(const NpuOperation& operation, std::string* error) {
+    const NpuGraph& graph = *mGraph;
+    const uint32_t a = operation.inputs[0];
+    const uint32_t b = operation.inputs[1];
+    const uint32_t out = operation.outputs[0];
+    int32_t activation = kFuseNone;
+    readActivation(graph, operation.inputs[2], &activation);
+
+    // NNAPI broadcasting: shapes line up from the right, size 1 stretches
+    std::vector<uint32_t> shapeA = mShapes[a];
+    std::vector<uint32_t> shapeB = mShapes[b];
+    std::vector<uint32_t> shape(std::max(shapeA.size(), shapeB.size()), 1);
+    for (size_t i = 0; i < shape.size(); i++) {
+        const uint32_t dimA = i < shapeA.size() ? shapeA[shapeA.size() - 1 - i] : 1;
+        const uint32_t dimB = i < shapeB.size() ? shapeB[shapeB.size() - 1 - i] : 1;
+        if (dimA != dimB && dimA != 1 && dimB != 1) {
+            *error = "ADD inputs do not broadcast";
+            return false;
+        }
+        shape[shape.size() - 1 - i] = std::max(dimA, dimB);
+    }
+    if (!setShape(out, shape, error)) {
+        return false;
+    }
+    const size_t count = elementCount(shape);
+    const bool direct = shapeA == shape && shapeB == shape;
+
+    if (graph.operands[a].type == NpuOperandType::TENSOR_FLOAT32) {
+        float lo;
+        float hi;
+        activationRange(activation, &lo, &hi);
+        mSteps.push_back({operation.type, [this, a, b, out, shape, shapeA, shapeB, count, direct,
+                                           lo, hi](CpuThreadPool*) {
+            const float* x = reinterpret_cast<const float*>(read(a));
+            const float* y = reinterpret_cast<const float*>(read(b));
+            float* dst = reinterpret_cast<float*>(write(out));
+            for (size_t i = 0; i < count; i++) {
+                const float sum = direct ? x[i] + y[i]
+                                         : x[broadcastOffset(i, shape, shapeA)] +
+                                                   y[broadcastOffset(i, shape, shapeB)];
+                dst[i] = std::clamp(sum, lo, hi);
+            }
+        }});
+        return true;
+    }
+
+    // Both inputs come back to real values and go out at the output's scale
+    const NpuOperand& opA = graph.operands[a];
+    const NpuOperand& opB = graph.operands[b];
+    const NpuOperand& result = graph.operands[out];
+    const float scaleA = opA.scale / result.scale;
+    const float scaleB = opB.scale / result.scale;
+    const int32_t zeroA = opA.zeroPoint;
+    const int32_t zeroB = opB.zeroPoint;
+    const int32_t zeroOut = result.zeroPoint;
+    int32_t lo;
+    int32_t hi;
+    quantActivationRange(activation, result, &lo, &hi);
+    mSteps.push_back({operation.type, [this, a, b, out, shape, shapeA, shapeB, count, direct,
+                                       scaleA, scaleB, zeroA, zeroB, zeroOut, lo,
+                                       hi](CpuThreadPool*) {
+        const uint8_t* x = read(a);
+        const uint8_t* y = read(b);
+        uint8_t* dst = write(out);
+        for (size_t i = 0; i < count; i++) {
+            const int32_t qa = direct ? x[i] : x[broadcastOffset(i, shape, shapeA)];
+            const int32_t qb = direct ? y[i] : y[broadcastOffset(i, shape, shapeB)];
+            const int32_t q = static_cast<int32_t>(std::lrint((qa - zeroA) * scaleA +
+                                                              (qb - zeroB) * scaleB)) +
+                              zeroOut;
+            dst[i] = static_cast<uint8_t>(std::clamp(q, lo, hi));
+        }
+    }});
+    return true;
+}
+
+bool CpuModel::planReshape(const NpuOperation& operation, std::string* error) {
+    const NpuGraph& graph = *mGraph;
+    const uint32_t in = operation.inputs[0];
+    const uint32_t out = operation.outputs[0];
+    const size_t count = elementCount(mShapes[in]);
+
+    // The shape operand when it is constant, which may hold one -1
+    std::vector<uint32_t> shape = mShapes[out];
+    const NpuOperand& target = graph.operands[operation.inputs[1]];
+    if (target.lifetime == NpuOperandLifetime::CONSTANT &&
+        target.type == NpuOperandType::TENSOR_INT32) {
+        const size_t rank = target.value.size() / sizeof(int32_t);
+        const int32_t* dims = reinterpret_cast<const int32_t*>(target.value.data());
+        shape.assign(rank, 0);
+        size_t known = 1;
+        int64_t stretch = -1;
+        for (size_t i = 0; i < rank; i++) {
+            if (dims[i] == -1 && stretch < 0) {
+                stretch = i;
+            } else if (dims[i] > 0) {
+                shape[i] = dims[i];
+                known *= dims[i];
+            } else {
+                *error = "RESHAPE has an invalid target shape";
+                return false;
+            }
+        }
+        if (stretch >= 0 && known != 0) {
+            shape[stretch] = count / known;
+        }
+    }
+    if (shape.empty() || !fullySpecified(shape) || elementCount(shape) != count) {
+        *error = "RESHAPE changes the element count";
+        return false;
+    }
+    if (!setShape(out, shape, error)) {
+        return false;
+    }
+    const size_t bytes = npuOperandSize(graph.operands[in].type, mShapes[in]);
+    mSteps.push_back({operation.type, [this, in, out, bytes](CpuThreadPool*) {
+        memcpy(write(out), read(in), bytes);
+    }});
+    return true;
+}
+
+bool CpuModel::planSoftmax(const NpuOperation& operation, std::string* error) {
+    const NpuGraph& graph = *mGraph;
+    const uint32_t in = operation.inputs[0];
+    const uint32_t out = operation.outputs[0];
+    const std::vector<uint32_t>& shape = mShapes[in];
+    float beta = 1.0f;
+    readScalar(graph, operation.inputs[1], &beta);
+    int32_t axis = -1;
+    if (operation.inputs.size() == 3) {
+        readScalar(graph, operation.inputs[2], &axis);
+    }
+    if (axis != -1 && axis != static_cast<int32_t>(shape.size()) - 1) {
+        *error = "SOFTMAX only runs along the last axis";
+        return false;
+    }
+    if (!setShape(out, shape, error)) {
+        return false;
+    }
+    const uint32_t depth = shape.back();
+    const size_t rows = elementCount(shape) / depth;
+    const NpuOperand source = graph.operands[in];
+    const NpuOperand result = graph.operands[out];
+    const bool quantized = source.type == NpuOperandType::TENSOR_QUANT8_ASYMM;
+
+    mSteps.push_back({operation.type, [this, in, out, beta, depth, rows, source, result,
+                                       quantized](CpuThreadPool*) {
+        thread_local std::vector<float> values;
+        values.resize(depth);
+        for (size_t r = 0; r < rows; r++) {
+            if (quantized) {
+                const uint8_t* src = read(in) + r * depth;
+                for (uint32_t i = 0; i < depth; i++) {
+                    values[i] = (src[i] - source.zeroPoint) * source.scale;
+                }
+            } else {
+                const float* src = reinterpret_cast<const float*>(read(in)) + r * depth;
+                std::copy(src, src + depth, values.begin());
+            }
+            const float peak = *std::max_element(values.begin(), values.end());
+            float sum = 0.0f;
+            for (float& value : values) {
+                value = std::exp((value - peak) * beta);
+                sum += value;
+            }
+            if (quantized) {
+                uint8_t* dst = write(out) + r * depth;
+                for (uint32_t i = 0; i < depth; i++) {
+                    dst[i] = quantize(values[i] / sum, result);
+                }
+            } else {
+                float* dst = reinterpret_cast<float*>(write(out)) + r * depth;
+                for (uint32_t i = 0; i < depth; i++) {
+                    dst[i] = values[i] / sum;
+                }
+            }
+        }
+    }});
+    return true;
+}
+
+bool CpuModel::planConcatenation(const NpuOperation& operation, std::string* error) {
+    const NpuGraph& graph = *mGraph;
+    const std::vector<uint32_t> ins(operation.inputs.begin(), operation.inputs.end() - 1);
+    const uint32_t out = operation.outputs[0];
+    const size_t rank = mShapes[ins[0]].size();
+    int32_t axis = 0;
+    readScalar(graph, operation.inputs.back(), &axis);
+    if (axis < 0) {
+        axis += rank;
+    }
+    if (axis < 0 || static_cast<size_t>(axis) >= rank) {
+        *error = "CONCATENATION axis is out of range";
+        return false;
+    }
+
+    const std::vector<uint32_t>& first = mShapes[ins[0]];
+    std::vector<uint32_t> shape = first;
+    shape[axis] = 0;
+    for (uint32_t index : ins) {
+        const std::vector<uint32_t>& other = mShapes[index];
+        for (size_t d = 0; d < rank; d++) {
+            if (other.size() != rank || (d != static_cast<size_t>(axis) && other[d] != first[d])) {
+                *error = "CONCATENATION inputs differ outside the axis";
+                return false;
+            }
+        }
+        shape[axis] += other[axis];
+    }
+    if (!setShape(out, shape, error)) {
+        return false;
+    }
+
+    // Each input contributes one contiguous run per outer index
+    size_t outer = 1;
+    for (int32_t d = 0; d < axis; d++) {
+        outer *= shape[d];
+    }
+    const NpuOperand& result = graph.operands[out];
+    const size_t element = npuElementSize(result.type);
+    const size_t outRun = elementCount(shape) / outer;
+    std::vector<size_t> runs;
+    std::vector<bool> copies;
+    std::vector<float> scales;
+    std::vector<int32_t> zeros;
+    for (uint32_t index : ins) {
+        const NpuOperand& operand = graph.operands[index];
+        runs.push_back(elementCount(mShapes[index]) / outer);
+        copies.push_back(result.type == NpuOperandType::TENSOR_FLOAT32 ||
+                         (operand.scale == result.scale && operand.zeroPoint == result.zeroPoint));
+        scales.push_back(operand.scale);
+        zeros.push_back(operand.zeroPoint);
+    }
+    mSteps.push_back({operation.type, [this, ins, out, outer, element, outRun, runs, copies,
+                                       scales, zeros, result](CpuThreadPool*) {
+        uint8_t* dst = write(out);
+        size_t at = 0;
+        for (size_t i = 0; i < ins.size(); i++) {
+            const uint8_t* src = read(ins[i]);
+            for (size_t o = 0; o < outer; o++) {
+                uint8_t* to = dst + (o * outRun + at) * element;
+                const uint8_t* from = src + o * runs[i] * element;
+                if (copies[i]) {
+                    memcpy(to, from, runs[i] * element);
+                    continue;
+                }
+                for (size_t e = 0; e < runs[i]; e++) {
+                    to[e] = quantize((from[e] - zeros[i]) * scales[i], result);
+                }
+            }
+            at += runs[i];
+        }
+    }});
+    return true;
+}
+
+std::vector<std::pair<const void*, size_t>> CpuModel::memoryRegions() const {
+    std::vector<std::pair<const void*, size_t>> regions = mWeights;
+    for (const auto& buffer : mBuffers) {
+        if (!buffer.empty()) {
+            regions.emplace_back(buffer.data(), buffer.size());
+        }
+    }
+    if (!mScratch.empty()) {
+        regions.emplace_back(mScratch.data(), mScratch.size());
+    }
+    return regions;
+}
+
+bool CpuModel::execute(const std::vector<const std::vector<uint8_t>*>& inputs,
+                       std::vector<std::vector<uint8_t>>* outputs, CpuThreadPool* pool,
+                       std::string* error, std::vector<CpuLayerProfile>* profile) {
+    std::lock_guard<std::mutex> lock(mLock);
+    const NpuGraph& graph = *mGraph;
+    if (inputs.size() != graph.inputIndexes.size()) {
+        *error = "expected " + std::to_string(graph.inputIndexes.size()) + " inputs";
+        return false;
+    }
+    for (size_t i = 0; i < inputs.size(); i++) {
+        std::vector<uint8_t>& buffer = mBuffers[graph.inputIndexes[i]];
+        if (inputs[i] == nullptr || inputs[i]->size() != buffer.size()) {
+            *error = "input " + std::to_string(i) + " should be " +
+                     std::to_string(buffer.size()) + " bytes";
+            return false;
+        }
+        memcpy(buffer.data(), inputs[i]->data(), buffer.size());
+    }
+
+    if (profile == nullptr) {
+        for (const Step& step : mSteps) {
+            step.run(pool);
+        }
+    } else {
+        using Clock = std::chrono::steady_clock;
+        const Clock::time_point begin = Clock::now();
+        profile->clear();
+        for (const Step& step : mSteps) {
+            const Clock::time_point start = Clock::now();
+            step.run(pool);
+            const Clock::time_point end = Clock::now();
+            profile->push_back({step.type, step.operation,
+                                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        start - begin).count(),
+                                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        end - start).count(),
+                                step.bytesIn, step.bytesOut, step.weightBytes});
+        }
+    }
+
+    outputs->resize(graph.outputIndexes.size());
+    for (size_t i = 0; i < graph.outputIndexes.size(); i++) {
+        (*outputs)[i] = mBuffers[graph.outputIndexes[i]];
+    }
+    return true;
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
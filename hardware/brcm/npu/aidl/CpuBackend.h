@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * CPU inference backend for the Raspberry Pi 5 NPU HAL
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CpuThreadPool.h"
+#include "NpuGraph.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+struct PackedWeightsF32;
+struct PackedWeightsQ8;
+
+// True if the CPU backend runs |operation|: the convolution, pooling and
+// elementwise operations of MobileNet and YOLO class models, on float or
+// uint8 NHWC tensors. Shapes are only checked once the model is created.
+bool cpuSupportsOperation(const NpuGraph& graph, const NpuOperation& operation);
+
+// NNAPI name of an operation the backend runs, for profiles
+const char* cpuOperationName(int32_t type);
+
+// One layer of a profiled execution
+struct CpuLayerProfile {
+    int32_t type;           // NNAPI OperationType
+    uint32_t operation;     // index in the graph
+    int64_t startNs;        // since execute() began
+    int64_t durationNs;
+    uint64_t bytesIn;       // activations read
+    uint64_t bytesOut;
+    uint64_t weightBytes;   // constants read
+};
+
+// A graph planned for the Cortex-A76 cores. Shapes are resolved and weights
+// packed for the GEMM kernels up front, so execution only allocates scratch
+// the first time a thread touches a layer. Packing is most of the cost of
+// planning, so the packed panels can be saved and handed back in.
+class CpuModel {
+public:
+    // nullptr with |error| set if an operation is unsupported or a shape
+    // cannot be worked out. |packedWeights|, from packedWeights() of the same
+    // graph, stands in for packing; from the first layer it does not fit on,
+    // the weights are packed from the graph instead.
+    static std::unique_ptr<CpuModel> create(std::shared_ptr<const NpuGraph> graph,
+                                            std::string* error,
+                                            const std::vector<uint8_t>* packedWeights = nullptr);
+
+    // |inputs| and |outputs| are in graph order. Calls are serialised; the
+    // pool, when given, is shared by every layer. Each layer is timed into
+    // |profile| when one is given.
+    bool execute(const std::vector<const std::vector<uint8_t>*>& inputs,
+                 std::vector<std::vector<uint8_t>>* outputs, CpuThreadPool* pool,
+                 std::string* error, std::vector<CpuLayerProfile>* profile = nullptr);
+
+    size_t inputCount() const { return mGraph->inputIndexes.size(); }
+    // Multiply-accumulates for one execution, for logging
+    uint64_t macs() const { return mMacs; }
+    // Packed weights and the planned buffers, to keep resident
+    std::vector<std::pair<const void*, size_t>> memoryRegions() const;
+    // Every packed panel in plan order, for the compilation cache
+    void packedWeights(std::vector<uint8_t>* out) const;
+
+private:
+    struct Step {
+        int32_t type;
+        std::function<void(CpuThreadPool*)> run;
+        // Filled in once the operation is planned, for profiles
+        uint32_t operation = 0;
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+        uint64_t weightBytes = 0;
+    };
+
+    explicit CpuModel(std::shared_ptr<const NpuGraph> graph);
+
+    bool plan(std::string* error);
+    bool planOperation(const NpuOperation& operation, std::string* error);
+    bool setShape(uint32_t index, const std::vector<uint32_t>& shape, std::string* error);
+
+    bool planConv(const NpuOperation& operation, bool depthwise, std::string* error);
+    bool planFullyConnected(const NpuOperation& operation, std::string* error);
+    bool planPool(const NpuOperation& operation, bool max, std::string* error);
+    bool planAdd(const NpuOperation& operation, std::string* error);
+    bool planReshape(const NpuOperation& operation, std::string* error);
+    bool planSoftmax(const NpuOperation& operation, std::string* error);
+    bool planConcatenation(const NpuOperation& operation, std::string* error);
+
+    // Pack, or take the next panels of mPrepacked, and keep them resident
+    void packQ8(const uint8_t* weights, bool isSigned, int32_t zeroPoint, uint32_t n,
+                uint32_t k, PackedWeightsQ8* packed);
+    void packF32(const float* weights, uint32_t n, uint32_t k, bool half,
+                 PackedWeightsF32* packed);
+
+    // Constants are read in place from the graph
+    const uint8_t* read(uint32_t index) const;
+    uint8_t* write(uint32_t index) { return mBuffers[index].data(); }
+    template <typename T>
+    void addWeights(const std::vector<T>& values) {
+        mWeights.emplace_back(values.data(), values.size() * sizeof(T));
+    }
+
+    const std::shared_ptr<const NpuGraph> mGraph;
+    std::vector<std::vector<uint32_t>> mShapes;     // per operand, resolved
+    std::vector<std::vector<uint8_t>> mBuffers;     // per non-constant operand
+    std::vector<Step> mSteps;
+    std::vector<std::pair<const void*, size_t>> mWeights;   // owned by the steps
+    // One of each pair is set, in the order plan() packed them
+    std::vector<std::pair<const PackedWeightsQ8*, const PackedWeightsF32*>> mPacked;
+    const std::vector<uint8_t>* mPrepacked = nullptr;      // only during create()
+    size_t mPrepackedOffset = 0;
+    size_t mScratchSize = 0;                        // im2col rows, largest layer
+    std::vector<uint8_t> mScratch;
+    uint64_t mMacs = 0;
+    std::mutex mLock;
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,564 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * CPU backend layers against a direct NHWC reference, with both padding forms
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CpuBackend.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+namespace {
+
+// NNAPI OperationType, FuseCode and PaddingCode values the graphs use
+constexpr int32_t kAveragePool2d = 1;
+constexpr int32_t kConv2d = 3;
+constexpr int32_t kDepthwiseConv2d = 4;
+constexpr int32_t kMaxPool2d = 17;
+constexpr int32_t kFuseNone = 0;
+constexpr int32_t kFuseRelu6 = 3;
+constexpr int32_t kPaddingSame = 1;
+constexpr int32_t kPaddingValid = 2;
+
+// Implicit padding, or explicit amounts that differ on every side
+struct Padding {
+    int32_t scheme = 0;     // 0: explicit
+    int32_t left = 0;
+    int32_t right = 0;
+    int32_t top = 0;
+    int32_t bottom = 0;
+};
+
+const Padding kSame = {kPaddingSame};
+const Padding kValid = {kPaddingValid};
+const Padding kExplicit = {0, 0, 1, 1, 2};
+
+struct Window {
+    uint32_t inHeight;
+    uint32_t inWidth;
+    uint32_t kernel;
+    uint32_t stride;
+    uint32_t dilation = 1;
+};
+
+struct OutputShape {
+    uint32_t height;
+    uint32_t width;
+    int32_t padTop;
+    int32_t padLeft;
+};
+
+// Output size and leading padding as NNAPI defines them
+OutputShape outputShape(const Window& window, const Padding& padding) {
+    const uint32_t effective = (window.kernel - 1) * window.dilation + 1;
+    OutputShape shape;
+    if (padding.scheme == kPaddingSame) {
+        shape.height = (window.inHeight + window.stride - 1) / window.stride;
+        shape.width = (window.inWidth + window.stride - 1) / window.stride;
+        const int32_t padHeight = std::max<int32_t>(
+                0, (shape.height - 1) * window.stride + effective - window.inHeight);
+        const int32_t padWidth = std::max<int32_t>(
+                0, (shape.width - 1) * window.stride + effective - window.inWidth);
+        shape.padTop = padHeight / 2;
+        shape.padLeft = padWidth / 2;
+    } else if (padding.scheme == kPaddingValid) {
+        shape.height = (window.inHeight - effective) / window.stride + 1;
+        shape.width = (window.inWidth - effective) / window.stride + 1;
+        shape.padTop = 0;
+        shape.padLeft = 0;
+    } else {
+        shape.height = (window.inHeight + padding.top + padding.bottom - effective) /
+                               window.stride + 1;
+        shape.width = (window.inWidth + padding.left + padding.right - effective) /
+                              window.stride + 1;
+        shape.padTop = padding.top;
+        shape.padLeft = padding.left;
+    }
+    return shape;
+}
+
+class GraphBuilder {
+public:
+    uint32_t tensor(NpuOperandType type, NpuOperandLifetime lifetime,
+                    std::vector<uint32_t> dimensions, float scale = 0.0f, int32_t zeroPoint = 0) {
+        NpuOperand operand;
+        operand.type = type;
+        operand.lifetime = lifetime;
+        operand.dimensions = std::move(dimensions);
+        operand.scale = scale;
+        operand.zeroPoint = zeroPoint;
+        mGraph.operands.push_back(operand);
+        return mGraph.operands.size() - 1;
+    }
+
+    template <typename T>
+    uint32_t constant(NpuOperandType type, std::vector<uint32_t> dimensions,
+                      const std::vector<T>& values, float scale = 0.0f, int32_t zeroPoint = 0) {
+        uint32_t index = tensor(type, NpuOperandLifetime::CONSTANT, std::move(dimensions), scale,
+                                zeroPoint);
+        auto& value = mGraph.operands[index].value;
+        value.resize(values.size() * sizeof(T));
+        memcpy(value.data(), values.data(), value.size());
+        return index;
+    }
+
+    void setChannelScales(uint32_t index, std::vector<float> scales, uint32_t channelDim) {
+        mGraph.operands[index].channelScales = std::move(scales);
+        mGraph.operands[index].channelDim = channelDim;
+    }
+
+    uint32_t int32(int32_t value) {
+        return constant(NpuOperandType::INT32, {}, std::vector<int32_t>{value});
+    }
+    uint32_t boolean(bool value) {
+        return constant(NpuOperandType::BOOL, {}, std::vector<uint8_t>{value});
+    }
+
+    // Padding operands in NNAPI order: left, right, top, bottom or the scheme
+    void addPadding(const Padding& padding, std::vector<uint32_t>* inputs) {
+        if (padding.scheme != 0) {
+            inputs->push_back(int32(padding.scheme));
+            return;
+        }
+        for (int32_t value : {padding.left, padding.right, padding.top, padding.bottom}) {
+            inputs->push_back(int32(value));
+        }
+    }
+
+    void operation(int32_t type, std::vector<uint32_t> inputs, uint32_t output) {
+        mGraph.operations.push_back({type, std::move(inputs), {output}});
+    }
+
+    // Plans the graph with |input| and |output| as its only model operands
+    std::unique_ptr<CpuModel> build(uint32_t input, uint32_t output,
+                                    const std::vector<uint8_t>* packedWeights = nullptr) {
+        mGraph.inputIndexes = {input};
+        mGraph.outputIndexes = {output};
+        std::string error;
+        auto model = CpuModel::create(std::make_shared<NpuGraph>(mGraph), &error, packedWeights);
+        if (model == nullptr) {
+            ADD_FAILURE() << "create failed: " << error;
+        }
+        return model;
+    }
+
+    // Runs the graph on |input| and returns its single output
+    std::vector<uint8_t> run(uint32_t input, uint32_t output, const std::vector<uint8_t>& data,
+                             CpuThreadPool* pool) {
+        auto model = build(input, output);
+        return model != nullptr ? execute(model.get(), data, pool) : std::vector<uint8_t>();
+    }
+
+    static std::vector<uint8_t> execute(CpuModel* model, const std::vector<uint8_t>& data,
+                                        CpuThreadPool* pool) {
+        std::string error;
+        std::vector<std::vector<uint8_t>> outputs;
+        if (!model->execute({&data}, &outputs, pool, &error)) {
+            ADD_FAILURE() << "execute failed: " << error;
+            return {};
+        }
+        return outputs[0];
+    }
+
+private:
+    NpuGraph mGraph;
+};
+
+template <typename T>
+std::vector<uint8_t> toBytes(const std::vector<T>& values) {
+    std::vector<uint8_t> bytes(values.size() * sizeof(T));
+    memcpy(bytes.data(), values.data(), bytes.size());
+    return bytes;
+}
+
+std::vector<float> toFloats(const std::vector<uint8_t>& bytes) {
+    std::vector<float> values(bytes.size() / sizeof(float));
+    memcpy(values.data(), bytes.data(), values.size() * sizeof(float));
+    return values;
+}
+
+// Convolution straight from the definition. |filter| is [out][kh][kw][in],
+// or [1][kh][kw][out] for depthwise with out = in * multiplier.
+std::vector<float> referenceConv(const std::vector<float>& input, uint32_t batches,
+                                 uint32_t channels, const Window& window,
+                                 const OutputShape& shape, const std::vector<float>& filter,
+                                 const std::vector<float>& bias, uint32_t outChannels,
+                                 bool depthwise, float min, float max) {
+    const uint32_t multiplier = depthwise ? outChannels / channels : 1;
+    std::vector<float> output(
+            static_cast<size_t>(batches) * shape.height * shape.width * outChannels);
+    for (uint32_t b = 0; b < batches; b++) {
+        for (uint32_t oy = 0; oy < shape.height; oy++) {
+            for (uint32_t ox = 0; ox < shape.width; ox++) {
+                for (uint32_t o = 0; o < outChannels; o++) {
+                    double acc = bias[o];
+                    for (uint32_t ky = 0; ky < window.kernel; ky++) {
+                        for (uint32_t kx = 0; kx < window.kernel; kx++) {
+                            const int32_t iy = static_cast<int32_t>(
+                                    oy * window.stride + ky * window.dilation) - shape.padTop;
+                            const int32_t ix = static_cast<int32_t>(
+                                    ox * window.stride + kx * window.dilation) - shape.padLeft;
+                            if (iy < 0 || iy >= static_cast<int32_t>(window.inHeight) ||
+                                ix < 0 || ix >= static_cast<int32_t>(window.inWidth)) {
+                                continue;
+                            }
+                            const size_t pixel =
+                                    ((static_cast<size_t>(b) * window.inHeight + iy) *
+                                             window.inWidth + ix) * channels;
+                            const size_t tap = static_cast<size_t>(ky) * window.kernel + kx;
+                            if (depthwise) {
+                                acc += input[pixel + o / multiplier] *
+                                       filter[tap * outChannels + o];
+                                continue;
+                            }
+                            for (uint32_t c = 0; c < channels; c++) {
+                                acc += input[pixel + c] *
+                                       filter[(o * window.kernel * window.kernel + tap) *
+                                                      channels + c];
+                            }
+                        }
+                    }
+                    output[((static_cast<size_t>(b) * shape.height + oy) * shape.width + ox) *
+                                   outChannels + o] =
+                            std::clamp(static_cast<float>(acc), min, max);
+                }
+            }
+        }
+    }
+    return output;
+}
+
+struct ConvCase {
+    bool depthwise;
+    Window window;
+    uint32_t channels;
+    uint32_t outChannels;
+    Padding padding;
+};
+
+// Pointwise, strided, dilated and depthwise layers with tails on every axis
+const ConvCase kConvCases[] = {
+        {false, {9, 11, 1, 1}, 19, 21, kSame},
+        {false, {13, 10, 3, 2}, 7, 17, kSame},
+        {false, {12, 12, 3, 1, 2}, 5, 9, kValid},
+        {false, {11, 9, 3, 2}, 6, 10, kExplicit},
+        {true, {10, 10, 3, 1}, 19, 19, kSame},
+        {true, {9, 8, 3, 2}, 4, 8, kValid},
+        {true, {9, 9, 3, 1, 2}, 12, 12, kExplicit},
+};
+
+class CpuBackendTest : public ::testing::TestWithParam<bool> {
+protected:
+    CpuThreadPool* pool() { return GetParam() ? &mPool : nullptr; }
+
+    std::vector<float> randomFloats(size_t count, float lo = -1.0f, float hi = 1.0f) {
+        std::uniform_real_distribution<float> dist(lo, hi);
+        std::vector<float> values(count);
+        for (auto& value : values) {
+            value = dist(mRng);
+        }
+        return values;
+    }
+
+    void addConv(GraphBuilder* graph, const ConvCase& conv, uint32_t input, uint32_t filter,
+                 uint32_t bias, int32_t fuse, uint32_t output) {
+        std::vector<uint32_t> inputs = {input, filter, bias};
+        graph->addPadding(conv.padding, &inputs);
+        inputs.push_back(graph->int32(conv.window.stride));
+        inputs.push_back(graph->int32(conv.window.stride));
+        if (conv.depthwise) {
+            inputs.push_back(graph->int32(conv.outChannels / conv.channels));
+        }
+        inputs.push_back(graph->int32(fuse));
+        inputs.push_back(graph->boolean(false));
+        inputs.push_back(graph->int32(conv.window.dilation));
+        inputs.push_back(graph->int32(conv.window.dilation));
+        graph->operation(conv.depthwise ? kDepthwiseConv2d : kConv2d, inputs, output);
+    }
+
+    std::vector<uint32_t> filterShape(const ConvCase& conv) {
+        const uint32_t k = conv.window.kernel;
+        return conv.depthwise ? std::vector<uint32_t>{1, k, k, conv.outChannels}
+                              : std::vector<uint32_t>{conv.outChannels, k, k, conv.channels};
+    }
+
+    static constexpr uint32_t kBatches = 2;
+
+    CpuThreadPool mPool{3};
+    std::mt19937 mRng{7};
+};
+
+TEST_P(CpuBackendTest, FloatConvolution) {
+    for (const auto& conv : kConvCases) {
+        SCOPED_TRACE(::testing::Message()
+                     << (conv.depthwise ? "depthwise" : "conv") << " k" << conv.window.kernel
+                     << " s" << conv.window.stride << " d" << conv.window.dilation
+                     << " padding " << conv.padding.scheme);
+        const Window& window = conv.window;
+        const OutputShape shape = outputShape(window, conv.padding);
+        auto input = randomFloats(
+                static_cast<size_t>(kBatches) * window.inHeight * window.inWidth * conv.channels,
+                -2.0f, 2.0f);
+        auto filter = randomFloats(conv.depthwise
+                ? window.kernel * window.kernel * conv.outChannels
+                : conv.outChannels * window.kernel * window.kernel * conv.channels);
+        auto bias = randomFloats(conv.outChannels);
+
+        GraphBuilder graph;
+        uint32_t in = graph.tensor(NpuOperandType::TENSOR_FLOAT32, NpuOperandLifetime::INPUT,
+                                   {kBatches, window.inHeight, window.inWidth, conv.channels});
+        uint32_t w = graph.constant(NpuOperandType::TENSOR_FLOAT32, filterShape(conv), filter);
+        uint32_t b = graph.constant(NpuOperandType::TENSOR_FLOAT32, {conv.outChannels}, bias);
+        uint32_t out = graph.tensor(NpuOperandType::TENSOR_FLOAT32, NpuOperandLifetime::OUTPUT,
+                                    {});
+        addConv(&graph, conv, in, w, b, kFuseNone, out);
+        auto got = toFloats(graph.run(in, out, toBytes(input), pool()));
+
+        auto want = referenceConv(input, kBatches, conv.channels, window, shape, filter, bias,
+                                  conv.outChannels, conv.depthwise, -FLT_MAX, FLT_MAX);
+        ASSERT_EQ(got.size(), want.size());
+        for (size_t i = 0; i < want.size(); i++) {
+            ASSERT_NEAR(got[i], want[i], 1e-4f) << "at " << i;
+        }
+    }
+}
+
+// Per-channel int8 filters on uint8 activations, with ReLU6 fused. The
+// reference works on the dequantized values, so it may sit one step away.
+TEST_P(CpuBackendTest, QuantizedConvolution) {
+    const float inScale = 4.0f / 255;
+    const int32_t inZero = 128;
+    const float outScale = 0.05f;
+    const int32_t outZero = 100;
+    for (const auto& conv : kConvCases) {
+        SCOPED_TRACE(::testing::Message()
+                     << (conv.depthwise ? "depthwise" : "conv") << " k" << conv.window.kernel
+                     << " s" << conv.window.stride << " d" << conv.window.dilation
+                     << " padding " << conv.padding.scheme);
+        const Window& window = conv.window;
+        const OutputShape shape = outputShape(window, conv.padding);
+        const size_t inputSize =
+                static_cast<size_t>(kBatches) * window.inHeight * window.inWidth * conv.channels;
+        const size_t filterSize = conv.depthwise
+                ? window.kernel * window.kernel * conv.outChannels
+                : conv.outChannels * window.kernel * window.kernel * conv.channels;
+
+        std::uniform_int_distribution<int> byte(0, 255);
+        std::uniform_int_distribution<int> weight(-127, 127);
+        std::vector<uint8_t> inputQ(inputSize);
+        std::vector<float> input(inputSize);
+        for (size_t i = 0; i < inputSize; i++) {
+            inputQ[i] = byte(mRng);
+            input[i] = (inputQ[i] - inZero) * inScale;
+        }
+        std::vector<float> scales(conv.outChannels);
+        for (uint32_t o = 0; o < conv.outChannels; o++) {
+            scales[o] = (0.5f + o % 3) / 127;
+        }
+        std::vector<int8_t> filterQ(filterSize);
+        std::vector<float> filter(filterSize);
+        for (size_t i = 0; i < filterSize; i++) {
+            const uint32_t o = conv.depthwise
+                    ? i % conv.outChannels
+                    : i / (window.kernel * window.kernel * conv.channels);
+            filterQ[i] = weight(mRng);
+            filter[i] = filterQ[i] * scales[o];
+        }
+        std::vector<int32_t> biasQ(conv.outChannels);
+        std::vector<float> bias(conv.outChannels);
+        for (uint32_t o = 0; o < conv.outChannels; o++) {
+            biasQ[o] = static_cast<int32_t>(mRng() % 2001) - 1000;
+            bias[o] = biasQ[o] * inScale * scales[o];
+        }
+
+        GraphBuilder graph;
+        uint32_t in = graph.tensor(NpuOperandType::TENSOR_QUANT8_ASYMM, NpuOperandLifetime::INPUT,
+                                   {kBatches, window.inHeight, window.inWidth, conv.channels},
+                                   inScale, inZero);
+        uint32_t w = graph.constant(NpuOperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL,
+                                    filterShape(conv), filterQ);
+        graph.setChannelScales(w, scales, conv.depthwise ? 3 : 0);
+        uint32_t b = graph.constant(NpuOperandType::TENSOR_INT32, {conv.outChannels}, biasQ);
+        uint32_t out = graph.tensor(NpuOperandType::TENSOR_QUANT8_ASYMM,
+                                    NpuOperandLifetime::OUTPUT, {}, outScale, outZero);
+        addConv(&graph, conv, in, w, b, kFuseRelu6, out);
+        auto got = graph.run(in, out, inputQ, pool());
+
+        auto want = referenceConv(input, kBatches, conv.channels, window, shape, filter, bias,
+                                  conv.outChannels, conv.depthwise, 0.0f, 6.0f);
+        ASSERT_EQ(got.size(), want.size());
+        for (size_t i = 0; i < want.size(); i++) {
+            const int32_t q = std::clamp<int32_t>(
+                    static_cast<int32_t>(std::lrint(want[i] / outScale)) + outZero, 0, 255);
+            ASSERT_NEAR(got[i], q, 1) << "at " << i;
+        }
+    }
+}
+
+TEST_P(CpuBackendTest, Pooling) {
+    const uint32_t channels = 5;
+    const Window windows[] = {{7, 7, 3, 2}, {8, 9, 2, 2}, {6, 5, 3, 1}};
+    for (bool max : {false, true}) {
+        for (const Window& window : windows) {
+            for (const Padding& padding : {kSame, kValid, kExplicit}) {
+                SCOPED_TRACE(::testing::Message()
+                             << (max ? "max" : "average") << " " << window.inHeight << "x"
+                             << window.inWidth << " k" << window.kernel << " s" << window.stride
+                             << " padding " << padding.scheme);
+                const OutputShape shape = outputShape(window, padding);
+                auto input = randomFloats(
+                        static_cast<size_t>(kBatches) * window.inHeight * window.inWidth *
+                        channels);
+
+                GraphBuilder graph;
+                uint32_t in = graph.tensor(NpuOperandType::TENSOR_FLOAT32,
+                                           NpuOperandLifetime::INPUT,
+                                           {kBatches, window.inHeight, window.inWidth, channels});
+                uint32_t out = graph.tensor(NpuOperandType::TENSOR_FLOAT32,
+                                            NpuOperandLifetime::OUTPUT, {});
+                std::vector<uint32_t> inputs = {in};
+                graph.addPadding(padding, &inputs);
+                for (uint32_t value : {window.stride, window.stride, window.kernel,
+                                       window.kernel}) {
+                    inputs.push_back(graph.int32(value));
+                }
+                inputs.push_back(graph.int32(kFuseNone));
+                graph.operation(max ? kMaxPool2d : kAveragePool2d, inputs, out);
+                auto got = toFloats(graph.run(in, out, toBytes(input), pool()));
+
+                // Padding is left out of both the maximum and the average
+                ASSERT_EQ(got.size(), static_cast<size_t>(kBatches) * shape.height *
+                                              shape.width * channels);
+                size_t at = 0;
+                for (uint32_t b = 0; b < kBatches; b++) {
+                    for (uint32_t oy = 0; oy < shape.height; oy++) {
+                        for (uint32_t ox = 0; ox < shape.width; ox++) {
+                            for (uint32_t c = 0; c < channels; c++, at++) {
+                                float acc = max ? -FLT_MAX : 0.0f;
+                                int count = 0;
+                                for (uint32_t ky = 0; ky < window.kernel; ky++) {
+                                    for (uint32_t kx = 0; kx < window.kernel; kx++) {
+                                        const int32_t iy = static_cast<int32_t>(
+                                                oy * window.stride + ky) - shape.padTop;
+                                        const int32_t ix = static_cast<int32_t>(
+                                                ox * window.stride + kx) - shape.padLeft;
+                                        if (iy < 0 ||
+                                            iy >= static_cast<int32_t>(window.inHeight) ||
+                                            ix < 0 ||
+                                            ix >= static_cast<int32_t>(window.inWidth)) {
+                                            continue;
+                                        }
+                                        const float value = input[
+                                                ((static_cast<size_t>(b) * window.inHeight +
+                                                  iy) * window.inWidth + ix) * channels + c];
+                                        acc = max ? std::max(acc, value) : acc + value;
+                                        count++;
+                                    }
+                                }
+                                const float want = max ? acc : acc / count;
+                                ASSERT_NEAR(got[at], want, 1e-5f) << "at " << at;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Panels saved from one model plan a second one that computes the same bits,
+// and a blob that does not fit the graph is packed over rather than trusted
+TEST_P(CpuBackendTest, ReusesPackedWeights) {
+    const ConvCase& conv = kConvCases[1];
+    const Window& window = conv.window;
+    const uint32_t inShape[] = {kBatches, window.inHeight, window.inWidth, conv.channels};
+    const size_t inputSize =
+            static_cast<size_t>(kBatches) * window.inHeight * window.inWidth * conv.channels;
+    const size_t filterSize =
+            static_cast<size_t>(conv.outChannels) * window.kernel * window.kernel * conv.channels;
+
+    GraphBuilder floatGraph;
+    uint32_t floatIn = floatGraph.tensor(NpuOperandType::TENSOR_FLOAT32,
+                                         NpuOperandLifetime::INPUT,
+                                         {inShape[0], inShape[1], inShape[2], inShape[3]});
+    uint32_t w = floatGraph.constant(NpuOperandType::TENSOR_FLOAT32, filterShape(conv),
+                                     randomFloats(filterSize));
+    uint32_t b = floatGraph.constant(NpuOperandType::TENSOR_FLOAT32, {conv.outChannels},
+                                     randomFloats(conv.outChannels));
+    uint32_t floatOut = floatGraph.tensor(NpuOperandType::TENSOR_FLOAT32,
+                                          NpuOperandLifetime::OUTPUT, {});
+    addConv(&floatGraph, conv, floatIn, w, b, kFuseNone, floatOut);
+    const auto floatInput = toBytes(randomFloats(inputSize));
+
+    std::vector<int8_t> filterQ(filterSize);
+    for (auto& value : filterQ) {
+        value = static_cast<int8_t>(mRng() % 255 - 127);
+    }
+    GraphBuilder quantGraph;
+    uint32_t quantIn = quantGraph.tensor(NpuOperandType::TENSOR_QUANT8_ASYMM,
+                                         NpuOperandLifetime::INPUT,
+                                         {inShape[0], inShape[1], inShape[2], inShape[3]},
+                                         0.02f, 128);
+    w = quantGraph.constant(NpuOperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL, filterShape(conv),
+                            filterQ);
+    quantGraph.setChannelScales(w, std::vector<float>(conv.outChannels, 0.01f), 0);
+    b = quantGraph.constant(NpuOperandType::TENSOR_INT32, {conv.outChannels},
+                            std::vector<int32_t>(conv.outChannels, 25));
+    uint32_t quantOut = quantGraph.tensor(NpuOperandType::TENSOR_QUANT8_ASYMM,
+                                          NpuOperandLifetime::OUTPUT, {}, 0.05f, 100);
+    addConv(&quantGraph, conv, quantIn, w, b, kFuseNone, quantOut);
+    std::vector<uint8_t> quantInput(inputSize);
+    for (auto& value : quantInput) {
+        value = mRng() % 256;
+    }
+
+    auto floatModel = floatGraph.build(floatIn, floatOut);
+    auto quantModel = quantGraph.build(quantIn, quantOut);
+    ASSERT_NE(floatModel, nullptr);
+    ASSERT_NE(quantModel, nullptr);
+    std::vector<uint8_t> floatPacked;
+    std::vector<uint8_t> quantPacked;
+    floatModel->packedWeights(&floatPacked);
+    quantModel->packedWeights(&quantPacked);
+    ASSERT_FALSE(floatPacked.empty());
+    ASSERT_FALSE(quantPacked.empty());
+    const auto floatWant = GraphBuilder::execute(floatModel.get(), floatInput, pool());
+    const auto quantWant = GraphBuilder::execute(quantModel.get(), quantInput, pool());
+
+    // Restored from its own panels, which it hands back unchanged
+    auto restored = floatGraph.build(floatIn, floatOut, &floatPacked);
+    ASSERT_NE(restored, nullptr);
+    EXPECT_EQ(GraphBuilder::execute(restored.get(), floatInput, pool()), floatWant);
+    std::vector<uint8_t> again;
+    restored->packedWeights(&again);
+    EXPECT_EQ(again, floatPacked);
+    restored = quantGraph.build(quantIn, quantOut, &quantPacked);
+    ASSERT_NE(restored, nullptr);
+    EXPECT_EQ(GraphBuilder::execute(restored.get(), quantInput, pool()), quantWant);
+
+    // Another graph's panels, and a truncated blob, fall back to packing
+    std::vector<uint8_t> truncated(quantPacked.begin(), quantPacked.end() - 1);
+    for (const auto* blob : {&floatPacked, &truncated}) {
+        restored = quantGraph.build(quantIn, quantOut, blob);
+        ASSERT_NE(restored, nullptr);
+        EXPECT_EQ(GraphBuilder::execute(restored.get(), quantInput, pool()), quantWant);
+        restored->packedWeights(&again);
+        EXPECT_EQ(again, quantPacked);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Threads, CpuBackendTest, ::testing::Bool());
+
+}  // namespace
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,644 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Matrix multiply kernels for the Raspberry Pi 5 CPU inference backend
+ */
+
+#include "CpuGemm.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// The cortex-a76 CPU variant builds with both extensions; other targets fall
+// back to the scalar kernels, which read the same packed layout
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define GEMM_USE_NEON 1
+#if defined(__ARM_FEATURE_DOTPROD)
+#define GEMM_USE_DOTPROD 1
+#endif
+#if defined(__ARM_FEATURE_FP16_VECTOR_ARITHMETIC)
+#define GEMM_USE_FP16 1
+#endif
+#endif
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// Values one SDOT lane accumulates
+constexpr uint32_t kDotDepth = 4;
+// Bytes of packed weights one task works through: half the A76's L2, so the
+// block stays resident while the task's row panels stream past it
+constexpr size_t kWeightBlockBytes = 256 * 1024;
+// Row panels one task packs and multiplies
+constexpr uint32_t kRowPanelsPerTask = 4;
+constexpr uint32_t kTileSize = kGemmTile * kGemmTile;
+
+namespace {
+
+uint32_t panelsFor(uint32_t count) {
+    return (count + kGemmTile - 1) / kGemmTile;
+}
+
+// Cuts C into tasks of a few row panels by a block of column panels. Tasks
+// sharing a weight block are adjacent, so the stealing pool hands each core
+// runs that reuse the block.
+template <typename Tile>
+void forEachTile(uint32_t m, uint32_t n, size_t panelBytes, CpuThreadPool* pool,
+                 const Tile& tile) {
+    const uint32_t rowPanels = panelsFor(m);
+    const uint32_t colPanels = panelsFor(n);
+    const uint32_t rowTasks = (rowPanels + kRowPanelsPerTask - 1) / kRowPanelsPerTask;
+
+    uint32_t blockPanels = std::max<size_t>(kWeightBlockBytes / std::max<size_t>(panelBytes, 1),
+                                            1);
+    // Layers with few rows (fully connected, the last convolutions) split
+    // their columns finer so every core has something to do
+    const size_t wanted = (pool != nullptr ? pool->threads() : 1) * 4;
+    if (rowTasks < wanted) {
+        const size_t colTasks = (wanted + rowTasks - 1) / rowTasks;
+        const size_t split = (colPanels + colTasks - 1) / colTasks;
+        blockPanels = std::min<uint32_t>(blockPanels, std::max<size_t>(split, 1));
+    }
+    blockPanels = std::min(blockPanels, colPanels);
+    const uint32_t colTasks = (colPanels + blockPanels - 1) / blockPanels;
+
+    auto run = [&](size_t task) {
+        const uint32_t rowTask = task % rowTasks;
+        const uint32_t colTask = task / rowTasks;
+        const uint32_t row0 = rowTask * kRowPanelsPerTask * kGemmTile;
+        const uint32_t panel0 = colTask * blockPanels;
+        tile(row0, std::min(m - row0, kRowPanelsPerTask * kGemmTile), panel0,
+             std::min(colPanels - panel0, blockPanels));
+    };
+    const size_t tasks = static_cast<size_t>(rowTasks) * colTasks;
+    if (pool != nullptr) {
+        pool->parallelFor(tasks, run);
+    } else {
+        for (size_t task = 0; task < tasks; task++) {
+            run(task);
+        }
+    }
+}
+
+// Offset of row or column |lane| within one kDotDepth group of a panel:
+// lanes 0-3 fill the first 16 bytes, lanes 4-7 the next
+uint32_t dotLaneOffset(uint32_t lane) {
+    return (lane / 4) * 16 + (lane % 4) * kDotDepth;
+}
+
+// Activation rows into int8 panels, summing each row on the way
+void packRowsQ8(const uint8_t* a, uint32_t rows, uint32_t lda, uint32_t k, uint32_t kPadded,
+                int8_t* packed, int32_t* rowSums) {
+    const uint32_t padded = panelsFor(rows) * kGemmTile;
+    const uint32_t groupBytes = kGemmTile * kDotDepth;
+    for (uint32_t r = 0; r < padded; r++) {
+        int8_t* dst = packed + static_cast<size_t>(r / kGemmTile) * kGemmTile * kPadded +
+                      dotLaneOffset(r % kGemmTile);
+        auto at = [dst, groupBytes](uint32_t kk) -> int8_t& {
+            return dst[(kk / kDotDepth) * groupBytes + kk % kDotDepth];
+        };
+        int32_t sum = 0;
+        uint32_t kk = 0;
+        if (r < rows) {
+            const uint8_t* src = a + static_cast<size_t>(r) * lda;
+            for (; kk < k; kk++) {
+                int8_t value = static_cast<int8_t>(src[kk] ^ 0x80);
+                at(kk) = value;
+                sum += value;
+            }
+        }
+        for (; kk < kPadded; kk++) {
+            at(kk) = 0;
+        }
+        rowSums[r] = sum;
+    }
+}
+
+// Scalar reference path for the 8x8 block
+void kernelQ8Scalar(const int8_t* a, const int8_t* b, uint32_t groups, int32_t* acc) {
+    std::fill(acc, acc + kTileSize, 0);
+    for (uint32_t g = 0; g < groups; g++) {
+        for (uint32_t r = 0; r < kGemmTile; r++) {
+            const int8_t* ar = a + dotLaneOffset(r);
+            for (uint32_t c = 0; c < kGemmTile; c++) {
+                const int8_t* bc = b + dotLaneOffset(c);
+                int32_t dot = 0;
+                for (uint32_t j = 0; j < kDotDepth; j++) {
+                    dot += ar[j] * bc[j];
+                }
+                acc[r * kGemmTile + c] += dot;
+            }
+        }
+        a += kGemmTile * kDotDepth;
+        b += kGemmTile * kDotDepth;
+    }
+}
+
+#ifdef GEMM_USE_DOTPROD
+// Four rows from one A register; the lane picks the row, the two B
+// registers hold columns 0-3 and 4-7
+#define GEMM_DOT_ROWS(av, base)                                          \
+    acc[(base) + 0][0] = vdotq_laneq_s32(acc[(base) + 0][0], b0, av, 0); \
+    acc[(base) + 0][1] = vdotq_laneq_s32(acc[(base) + 0][1], b1, av, 0); \
+    acc[(base) + 1][0] = vdotq_laneq_s32(acc[(base) + 1][0], b0, av, 1); \
+    acc[(base) + 1][1] = vdotq_laneq_s32(acc[(base) + 1][1], b1, av, 1); \
+    acc[(base) + 2][0] = vdotq_laneq_s32(acc[(base) + 2][0], b0, av, 2); \
+    acc[(base) + 2][1] = vdotq_laneq_s32(acc[(base) + 2][1], b1, av, 2); \
+    acc[(base) + 3][0] = vdotq_laneq_s32(acc[(base) + 3][0], b0, av, 3); \
+    acc[(base) + 3][1] = vdotq_laneq_s32(acc[(base) + 3][1], b1, av, 3)
+
+// 16 SDOTs per four loads, the whole block in 16 registers
+void kernelQ8Dot(const int8_t* a, const int8_t* b, uint32_t groups, int32_t* out) {
+    int32x4_t acc[kGemmTile][2];
+    for (uint32_t r = 0; r < kGemmTile; r++) {
+        acc[r][0] = vdupq_n_s32(0);
+        acc[r][1] = vdupq_n_s32(0);
+    }
+    for (uint32_t g = 0; g < groups; g++) {
+        int8x16_t a0 = vld1q_s8(a);
+        int8x16_t a1 = vld1q_s8(a + 16);
+        int8x16_t b0 = vld1q_s8(b);
+        int8x16_t b1 = vld1q_s8(b + 16);
+        GEMM_DOT_ROWS(a0, 0);
+        GEMM_DOT_ROWS(a1, 4);
+        a += kGemmTile * kDotDepth;
+        b += kGemmTile * kDotDepth;
+    }
+    for (uint32_t r = 0; r < kGemmTile; r++) {
+        vst1q_s32(out + r * kGemmTile, acc[r][0]);
+        vst1q_s32(out + r * kGemmTile + 4, acc[r][1]);
+    }
+}
+#undef GEMM_DOT_ROWS
+#endif
+
+void kernelQ8(const int8_t* a, const int8_t* b, uint32_t groups, int32_t* acc) {
+#ifdef GEMM_USE_DOTPROD
+    kernelQ8Dot(a, b, groups, acc);
+#else
+    kernelQ8Scalar(a, b, groups, acc);
+#endif
+}
+
+// Per-column values of one requantization
+struct QuantColumns {
+    const int32_t* terms;       // bias and the zero-point terms that only depend on the column
+    const float* multipliers;
+};
+
+void requantizeScalar(const int32_t* acc, const int32_t* rowSums, int32_t weightZero,
+                      const QuantColumns& columns, const QuantOutput& output, uint32_t rows,
+                      uint32_t cols, uint8_t* c, uint32_t ldc) {
+    for (uint32_t r = 0; r < rows; r++) {
+        const int32_t rowTerm = weightZero * rowSums[r];
+        for (uint32_t col = 0; col < cols; col++) {
+            int32_t value = acc[r * kGemmTile + col] - rowTerm + columns.terms[col];
+            int32_t q = static_cast<int32_t>(std::lrint(value * columns.multipliers[col])) +
+                        output.zeroPoint;
+            c[static_cast<size_t>(r) * ldc + col] =
+                    static_cast<uint8_t>(std::clamp(q, output.min, output.max));
+        }
+    }
+}
+
+#ifdef GEMM_USE_NEON
+void requantizeNeon(const int32_t* acc, const int32_t* rowSums, int32_t weightZero,
+                    const QuantColumns& columns, const QuantOutput& output, uint32_t rows,
+                    uint32_t cols, uint8_t* c, uint32_t ldc) {
+    const int32x4_t terms0 = vld1q_s32(columns.terms);
+    const int32x4_t terms1 = vld1q_s32(columns.terms + 4);
+    const float32x4_t mult0 = vld1q_f32(columns.multipliers);
+    const float32x4_t mult1 = vld1q_f32(columns.multipliers + 4);
+    const int32x4_t zero = vdupq_n_s32(output.zeroPoint);
+    const int32x4_t lo = vdupq_n_s32(output.min);
+    const int32x4_t hi = vdupq_n_s32(output.max);
+
+    auto quantize = [&](int32x4_t value, float32x4_t mult) {
+        int32x4_t q = vaddq_s32(vcvtnq_s32_f32(vmulq_f32(vcvtq_f32_s32(value), mult)), zero);
+        return vminq_s32(vmaxq_s32(q, lo), hi);
+    };
+
+    for (uint32_t r = 0; r < rows; r++) {
+        const int32x4_t rowTerm = vdupq_n_s32(weightZero * rowSums[r]);
+        int32x4_t v0 = vaddq_s32(vsubq_s32(vld1q_s32(acc + r * kGemmTile), rowTerm), terms0);
+        int32x4_t v1 = vaddq_s32(vsubq_s32(vld1q_s32(acc + r * kGemmTile + 4), rowTerm), terms1);
+        uint16x8_t wide = vcombine_u16(vqmovun_s32(quantize(v0, mult0)),
+                                       vqmovun_s32(quantize(v1, mult1)));
+        uint8x8_t bytes = vqmovn_u16(wide);
+        uint8_t* dst = c + static_cast<size_t>(r) * ldc;
+        if (cols == kGemmTile) {
+            vst1_u8(dst, bytes);
+        } else {
+            uint8_t tmp[kGemmTile];
+            vst1_u8(tmp, bytes);
+            memcpy(dst, tmp, cols);
+        }
+    }
+}
+#endif
+
+void requantize(const int32_t* acc, const int32_t* rowSums, int32_t weightZero,
+                const QuantColumns& columns, const QuantOutput& output, uint32_t rows,
+                uint32_t cols, uint8_t* c, uint32_t ldc) {
+#ifdef GEMM_USE_NEON
+    requantizeNeon(acc, rowSums, weightZero, columns, output, rows, cols, c, ldc);
+#else
+    requantizeScalar(acc, rowSums, weightZero, columns, output, rows, cols, c, ldc);
+#endif
+}
+
+#ifdef GEMM_USE_FP16
+using HalfFloat = float16_t;
+#endif
+
+// Activation rows into panels of kGemmTile rows, one column of the panel
+// per k. T is float, or fp16 for relaxed weights.
+template <typename T>
+void packRowsF32(const float* a, uint32_t rows, uint32_t lda, uint32_t k, T* packed) {
+    const uint32_t padded = panelsFor(rows) * kGemmTile;
+    for (uint32_t r = 0; r < padded; r++) {
+        T* dst = packed + static_cast<size_t>(r / kGemmTile) * kGemmTile * k + r % kGemmTile;
+        if (r >= rows) {
+            for (uint32_t kk = 0; kk < k; kk++) {
+                dst[kk * kGemmTile] = static_cast<T>(0.0f);
+            }
+            continue;
+        }
+        const float* src = a + static_cast<size_t>(r) * lda;
+        for (uint32_t kk = 0; kk < k; kk++) {
+            dst[kk * kGemmTile] = static_cast<T>(src[kk]);
+        }
+    }
+}
+
+void kernelF32Scalar(const float* a, const float* b, uint32_t k, float* acc) {
+    std::fill(acc, acc + kTileSize, 0.0f);
+    for (uint32_t kk = 0; kk < k; kk++) {
+        for (uint32_t r = 0; r < kGemmTile; r++) {
+            for (uint32_t c = 0; c < kGemmTile; c++) {
+                acc[r * kGemmTile + c] += a[r] * b[c];
+            }
+        }
+        a += kGemmTile;
+        b += kGemmTile;
+    }
+}
+
+#ifdef GEMM_USE_NEON
+#define GEMM_FMA_ROWS(av, base)                                          \
+    acc[(base) + 0][0] = vfmaq_laneq_f32(acc[(base) + 0][0], b0, av, 0); \
+    acc[(base) + 0][1] = vfmaq_laneq_f32(acc[(base) + 0][1], b1, av, 0); \
+    acc[(base) + 1][0] = vfmaq_laneq_f32(acc[(base) + 1][0], b0, av, 1); \
+    acc[(base) + 1][1] = vfmaq_laneq_f32(acc[(base) + 1][1], b1, av, 1); \
+    acc[(base) + 2][0] = vfmaq_laneq_f32(acc[(base) + 2][0], b0, av, 2); \
+    acc[(base) + 2][1] = vfmaq_laneq_f32(acc[(base) + 2][1], b1, av, 2); \
+    acc[(base) + 3][0] = vfmaq_laneq_f32(acc[(base) + 3][0], b0, av, 3); \
+    acc[(base) + 3][1] = vfmaq_laneq_f32(acc[(base) + 3][1], b1, av, 3)
+
+void kernelF32Neon(const float* a, const float* b, uint32_t k, float* out) {
+    float32x4_t acc[kGemmTile][2];
+    for (uint32_t r = 0; r < kGemmTile; r++) {
+        acc[r][0] = vdupq_n_f32(0.0f);
+        acc[r][1] = vdupq_n_f32(0.0f);
+    }
+    for (uint32_t kk = 0; kk < k; kk++) {
+        float32x4_t a0 = vld1q_f32(a);
+        float32x4_t a1 = vld1q_f32(a + 4);
+        float32x4_t b0 = vld1q_f32(b);
+        float32x4_t b1 = vld1q_f32(b + 4);
+        GEMM_FMA_ROWS(a0, 0);
+        GEMM_FMA_ROWS(a1, 4);
+        a += kGemmTile;
+        b += kGemmTile;
+    }
+    for (uint32_t r = 0; r < kGemmTile; r++) {
+        vst1q_f32(out + r * kGemmTile, acc[r][0]);
+        vst1q_f32(out + r * kGemmTile + 4, acc[r][1]);
+    }
+}
+#undef GEMM_FMA_ROWS
+#endif
+
+#ifdef GEMM_USE_FP16
+// Eight fp16 lanes cover a whole row of the block, so one FMLA per row
+void kernelF16(const HalfFloat* a, const HalfFloat* b, uint32_t k, float* out) {
+    float16x8_t acc[kGemmTile];
+    for (uint32_t r = 0; r < kGemmTile; r++) {
+        acc[r] = vdupq_n_f16(0.0f);
+    }
+    for (uint32_t kk = 0; kk < k; kk++) {
+        float16x8_t av = vld1q_f16(a);
+        float16x8_t bv = vld1q_f16(b);
+        acc[0] = vfmaq_laneq_f16(acc[0], bv, av, 0);
+        acc[1] = vfmaq_laneq_f16(acc[1], bv, av, 1);
+        acc[2] = vfmaq_laneq_f16(acc[2], bv, av, 2);
+        acc[3] = vfmaq_laneq_f16(acc[3], bv, av, 3);
+        acc[4] = vfmaq_laneq_f16(acc[4], bv, av, 4);
+        acc[5] = vfmaq_laneq_f16(acc[5], bv, av, 5);
+        acc[6] = vfmaq_laneq_f16(acc[6], bv, av, 6);
+        acc[7] = vfmaq_laneq_f16(acc[7], bv, av, 7);
+        a += kGemmTile;
+        b += kGemmTile;
+    }
+    for (uint32_t r = 0; r < kGemmTile; r++) {
+        vst1q_f32(out + r * kGemmTile, vcvt_f32_f16(vget_low_f16(acc[r])));
+        vst1q_f32(out + r * kGemmTile + 4, vcvt_high_f32_f16(acc[r]));
+    }
+}
+#endif
+
+void kernelF32(const float* a, const float* b, uint32_t k, float* acc) {
+#ifdef GEMM_USE_NEON
+    kernelF32Neon(a, b, k, acc);
+#else
+    kernelF32Scalar(a, b, k, acc);
+#endif
+}
+
+void storeF32(const float* acc, const float* bias, const FloatOutput& output, uint32_t rows,
+              uint32_t cols, float* c, uint32_t ldc) {
+    for (uint32_t r = 0; r < rows; r++) {
+        float* dst = c + static_cast<size_t>(r) * ldc;
+        for (uint32_t col = 0; col < cols; col++) {
+            dst[col] = std::clamp(acc[r * kGemmTile + col] + bias[col], output.min, output.max);
+        }
+    }
+}
+
+}  // namespace
+
+void packWeightsQ8(const uint8_t* weights, bool isSigned, int32_t zeroPoint, uint32_t n,
+                   uint32_t k, PackedWeightsQ8* packed) {
+    packed->n = n;
+    packed->k = k;
+    packed->kPadded = (k + kDotDepth - 1) / kDotDepth * kDotDepth;
+    packed->zeroPoint = isSigned ? zeroPoint : zeroPoint - 128;
+
+    const uint32_t padded = panelsFor(n) * kGemmTile;
+    const uint32_t groupBytes = kGemmTile * kDotDepth;
+    packed->data.assign(static_cast<size_t>(padded) * packed->kPadded, 0);
+    packed->sums.assign(padded, 0);
+    for (uint32_t col = 0; col < n; col++) {
+        int8_t* dst = packed->data.data() +
+                      static_cast<size_t>(col / kGemmTile) * kGemmTile * packed->kPadded +
+                      dotLaneOffset(col % kGemmTile);
+        const uint8_t* src = weights + static_cast<size_t>(col) * k;
+        int32_t sum = 0;
+        for (uint32_t kk = 0; kk < k; kk++) {
+            int8_t value = static_cast<int8_t>(isSigned ? src[kk] : src[kk] ^ 0x80);
+            dst[(kk / kDotDepth) * groupBytes + kk % kDotDepth] = value;
+            sum += value;
+        }
+        packed->sums[col] = sum;
+    }
+}
+
+void gemmQ8(const uint8_t* a, uint32_t m, uint32_t lda, int32_t aZero,
+            const PackedWeightsQ8& weights, const QuantOutput& output, uint8_t* c,
+            uint32_t ldc, CpuThreadPool* pool) {
+    if (m == 0 || weights.n == 0) {
+        return;
+    }
+    const uint32_t n = weights.n;
+    const uint32_t kPadded = weights.kPadded;
+    const int32_t activationZero = aZero - 128;
+    const int32_t weightZero = weights.zeroPoint;
+
+    // Sum of (a - za)(w - zw) is the raw dot product less the row term,
+    // which waits for the packed row sums, and these column terms
+    const uint32_t padded = panelsFor(n) * kGemmTile;
+    std::vector<int32_t> terms(padded, 0);
+    std::vector<float> multipliers(padded, 0.0f);
+    for (uint32_t col = 0; col < n; col++) {
+        terms[col] = (output.bias != nullptr ? output.bias[col] : 0) -
+                     activationZero * weights.sums[col] +
+                     static_cast<int32_t>(weights.k) * activationZero * weightZero;
+        multipliers[col] = output.multipliers[col];
+    }
+
+    forEachTile(m, n, static_cast<size_t>(kGemmTile) * kPadded, pool,
+                [&](uint32_t row0, uint32_t rows, uint32_t panel0, uint32_t panels) {
+        thread_local std::vector<int8_t> packedRows;
+        thread_local std::vector<int32_t> rowSums;
+        const uint32_t rowPanels = panelsFor(rows);
+        packedRows.resize(static_cast<size_t>(rowPanels) * kGemmTile * kPadded);
+        rowSums.resize(rowPanels * kGemmTile);
+        packRowsQ8(a + static_cast<size_t>(row0) * lda, rows, lda, weights.k, kPadded,
+                   packedRows.data(), rowSums.data());
+
+        int32_t acc[kTileSize];
+        for (uint32_t p = panel0; p < panel0 + panels; p++) {
+            const int8_t* panel =
+                    weights.data.data() + static_cast<size_t>(p) * kGemmTile * kPadded;
+            const uint32_t col0 = p * kGemmTile;
+            const uint32_t cols = std::min(n - col0, kGemmTile);
+            const QuantColumns columns = {terms.data() + col0, multipliers.data() + col0};
+            for (uint32_t rp = 0; rp < rowPanels; rp++) {
+                kernelQ8(packedRows.data() + static_cast<size_t>(rp) * kGemmTile * kPadded, panel,
+                         kPadded / kDotDepth, acc);
+                const uint32_t r0 = rp * kGemmTile;
+                requantize(acc, rowSums.data() + r0, weightZero, columns, output,
+                           std::min(rows - r0, kGemmTile), cols,
+                           c + static_cast<size_t>(row0 + r0) * ldc + col0, ldc);
+            }
+        }
+    });
+}
+
+void packWeightsF32(const float* weights, uint32_t n, uint32_t k, bool half,
+                    PackedWeightsF32* packed) {
+    packed->n = n;
+    packed->k = k;
+#ifdef GEMM_USE_FP16
+    packed->half = half;
+#else
+    packed->half = false;
+#endif
+
+    const uint32_t padded = panelsFor(n) * kGemmTile;
+    packed->data.assign(static_cast<size_t>(padded) * k, 0.0f);
+    for (uint32_t col = 0; col < n; col++) {
+        float* dst = packed->data.data() + static_cast<size_t>(col / kGemmTile) * kGemmTile * k +
+                     col % kGemmTile;
+        const float* src = weights + static_cast<size_t>(col) * k;
+        for (uint32_t kk = 0; kk < k; kk++) {
+            dst[kk * kGemmTile] = src[kk];
+        }
+    }
+
+    packed->halfData.clear();
+#ifdef GEMM_USE_FP16
+    if (packed->half) {
+        packed->halfData.resize(packed->data.size());
+        for (size_t i = 0; i < packed->data.size(); i++) {
+            HalfFloat value = static_cast<HalfFloat>(packed->data[i]);
+            memcpy(&packed->halfData[i], &value, sizeof(value));
+        }
+        packed->data.clear();
+        packed->data.shrink_to_fit();
+    }
+#endif
+}
+
+void gemmF32(const float* a, uint32_t m, uint32_t lda, const PackedWeightsF32& weights,
+             const FloatOutput& output, float* c, uint32_t ldc, CpuThreadPool* pool) {
+    if (m == 0 || weights.n == 0) {
+        return;
+    }
+    const uint32_t n = weights.n;
+    const uint32_t k = weights.k;
+    std::vector<float> bias(panelsFor(n) * kGemmTile, 0.0f);
+    if (output.bias != nullptr) {
+        std::copy(output.bias, output.bias + n, bias.begin());
+    }
+    const size_t elementBytes = weights.half ? sizeof(uint16_t) : sizeof(float);
+
+    forEachTile(m, n, kGemmTile * k * elementBytes, pool,
+                [&](uint32_t row0, uint32_t rows, uint32_t panel0, uint32_t panels) {
+        const uint32_t rowPanels = panelsFor(rows);
+        const size_t packedSize = static_cast<size_t>(rowPanels) * kGemmTile * k;
+        const float* rowsIn = a + static_cast<size_t>(row0) * lda;
+        float acc[kTileSize];
+
+        auto store = [&](uint32_t p, uint32_t rp) {
+            const uint32_t col0 = p * kGemmTile;
+            const uint32_t r0 = rp * kGemmTile;
+            storeF32(acc, bias.data() + col0, output, std::min(rows - r0, kGemmTile),
+                     std::min(n - col0, kGemmTile),
+                     c + static_cast<size_t>(row0 + r0) * ldc + col0, ldc);
+        };
+
+#ifdef GEMM_USE_FP16
+        if (weights.half) {
+            thread_local std::vector<HalfFloat> packedRows;
+            packedRows.resize(packedSize);
+            packRowsF32(rowsIn, rows, lda, k, packedRows.data());
+            const HalfFloat* halfWeights =
+                    reinterpret_cast<const HalfFloat*>(weights.halfData.data());
+            for (uint32_t p = panel0; p < panel0 + panels; p++) {
+                for (uint32_t rp = 0; rp < rowPanels; rp++) {
+                    kernelF16(packedRows.data() + static_cast<size_t>(rp) * kGemmTile * k,
+                              halfWeights + static_cast<size_t>(p) * kGemmTile * k, k, acc);
+                    store(p, rp);
+                }
+            }
+            return;
+        }
+#endif
+        thread_local std::vector<float> packedRows;
+        packedRows.resize(packedSize);
+        packRowsF32(rowsIn, rows, lda, k, packedRows.data());
+        for (uint32_t p = panel0; p < panel0 + panels; p++) {
+            for (uint32_t rp = 0; rp < rowPanels; rp++) {
+                kernelF32(packedRows.data() + static_cast<size_t>(rp) * kGemmTile * k,
+                          weights.data.data() + static_cast<size_t>(p) * kGemmTile * k, k, acc);
+                store(p, rp);
+            }
+        }
+    });
+}
+
+namespace {
+
+template <typename T>
+void appendValue(T value, std::vector<uint8_t>* out) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out->insert(out->end(), bytes, bytes + sizeof(T));
+}
+
+// Count, then the elements in one block
+template <typename T>
+void appendArray(const std::vector<T>& values, std::vector<uint8_t>* out) {
+    appendValue<uint64_t>(values.size(), out);
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values.data());
+    out->insert(out->end(), bytes, bytes + values.size() * sizeof(T));
+}
+
+template <typename T>
+bool readValue(const uint8_t* data, size_t size, size_t* offset, T* value) {
+    if (size - *offset < sizeof(T)) {
+        return false;
+    }
+    memcpy(value, data + *offset, sizeof(T));
+    *offset += sizeof(T);
+    return true;
+}
+
+// Fails unless the array holds exactly |expected| elements
+template <typename T>
+bool readArray(const uint8_t* data, size_t size, size_t* offset, size_t expected,
+               std::vector<T>* values) {
+    uint64_t count;
+    if (!readValue(data, size, offset, &count) || count != expected ||
+        count > (size - *offset) / sizeof(T)) {
+        return false;
+    }
+    values->resize(count);
+    memcpy(values->data(), data + *offset, count * sizeof(T));
+    *offset += count * sizeof(T);
+    return true;
+}
+
+}  // namespace
+
+void appendPackedWeights(const PackedWeightsQ8& packed, std::vector<uint8_t>* out) {
+    appendValue(packed.n, out);
+    appendValue(packed.k, out);
+    appendValue(packed.zeroPoint, out);
+    appendArray(packed.data, out);
+    appendArray(packed.sums, out);
+}
+
+void appendPackedWeights(const PackedWeightsF32& packed, std::vector<uint8_t>* out) {
+    appendValue(packed.n, out);
+    appendValue(packed.k, out);
+    appendValue<uint8_t>(packed.half, out);
+    appendArray(packed.data, out);
+    appendArray(packed.halfData, out);
+}
+
+bool readPackedWeights(const uint8_t* data, size_t size, size_t* offset,
+                       PackedWeightsQ8* packed) {
+    if (!readValue(data, size, offset, &packed->n) || !readValue(data, size, offset, &packed->k) ||
+        !readValue(data, size, offset, &packed->zeroPoint)) {
+        return false;
+    }
+    packed->kPadded = (packed->k + kDotDepth - 1) / kDotDepth * kDotDepth;
+    const size_t padded = static_cast<size_t>(panelsFor(packed->n)) * kGemmTile;
+    return readArray(data, size, offset, padded * packed->kPadded, &packed->data) &&
+           readArray(data, size, offset, padded, &packed->sums);
+}
+
+bool readPackedWeights(const uint8_t* data, size_t size, size_t* offset,
+                       PackedWeightsF32* packed) {
+    uint8_t half;
+    if (!readValue(data, size, offset, &packed->n) || !readValue(data, size, offset, &packed->k) ||
+        !readValue(data, size, offset, &half) || half > 1 ||
+        (half && !gemmHasHalfPrecision())) {
+        return false;
+    }
+    packed->half = half != 0;
+    const size_t values = static_cast<size_t>(panelsFor(packed->n)) * kGemmTile * packed->k;
+    return readArray(data, size, offset, packed->half ? 0 : values, &packed->data) &&
+           readArray(data, size, offset, packed->half ? values : 0, &packed->halfData);
+}
+
+bool gemmHasDotProduct() {
+#ifdef GEMM_USE_DOTPROD
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool gemmHasHalfPrecision() {
+#ifdef GEMM_USE_FP16
+    return true;
+#else
+    return false;
+#endif
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Matrix multiply kernels for the Raspberry Pi 5 CPU inference backend
+ */
+
+#pragma once
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "CpuThreadPool.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// Both GEMMs compute C[m][n] from activations A[m][k] and weights W[n][k],
+// the layout of NNAPI fully connected and NHWC convolution filters. Weights
+// are packed once into panels of kGemmTile columns; rows of A are packed per
+// call into panels of kGemmTile rows, so the inner kernel reads both
+// sequentially and keeps an 8x8 block of C in registers.
+constexpr uint32_t kGemmTile = 8;
+
+// Quantized weights, stored as int8 in groups of four along k for the
+// SDOT instruction. Unsigned weights are shifted down by 128 on the way in,
+// and so are the activations while they are packed, which lets one signed
+// dot product serve uint8, int8 and per-channel symmetric tensors.
+struct PackedWeightsQ8 {
+    uint32_t n = 0;
+    uint32_t k = 0;
+    uint32_t kPadded = 0;           // k rounded up to the dot product depth
+    int32_t zeroPoint = 0;          // after the shift
+    std::vector<int8_t> data;
+    std::vector<int32_t> sums;      // per column, of the shifted values
+};
+
+// |weights| holds n rows of k values. |zeroPoint| is the tensor's own, 0 for
+// symmetric weights.
+void packWeightsQ8(const uint8_t* weights, bool isSigned, int32_t zeroPoint, uint32_t n,
+                   uint32_t k, PackedWeightsQ8* packed);
+
+// Requantization of the int32 sums: out = acc * multiplier + zeroPoint,
+// rounded and clamped to the fused activation's range
+struct QuantOutput {
+    const int32_t* bias = nullptr;          // n values, or none
+    const float* multipliers = nullptr;     // n values: input * weight / output scale
+    int32_t zeroPoint = 0;
+    int32_t min = 0;
+    int32_t max = 255;
+};
+
+// A is uint8 with |aZero|; rows are |lda| bytes apart and C rows |ldc|
+void gemmQ8(const uint8_t* a, uint32_t m, uint32_t lda, int32_t aZero,
+            const PackedWeightsQ8& weights, const QuantOutput& output, uint8_t* c,
+            uint32_t ldc, CpuThreadPool* pool);
+
+// Float weights. With |half| the panels are stored and multiplied as fp16,
+// for models that allow relaxed precision, where the cores support it.
+struct PackedWeightsF32 {
+    uint32_t n = 0;
+    uint32_t k = 0;
+    bool half = false;
+    std::vector<float> data;
+    std::vector<uint16_t> halfData;     // fp16 bit patterns
+};
+
+void packWeightsF32(const float* weights, uint32_t n, uint32_t k, bool half,
+                    PackedWeightsF32* packed);
+
+struct FloatOutput {
+    const float* bias = nullptr;            // n values, or none
+    float min = -FLT_MAX;
+    float max = FLT_MAX;
+};
+
+void gemmF32(const float* a, uint32_t m, uint32_t lda, const PackedWeightsF32& weights,
+             const FloatOutput& output, float* c, uint32_t ldc, CpuThreadPool* pool);
+
+// Flat form of packed weights for the compilation cache, so a model restored
+// from it skips packing. append* adds to the end of |out|; read* starts at
+// *offset, advances it and fails on a truncated blob or one whose sizes do
+// not match its dimensions. Panels are stored as packed, so a blob only
+// reads back on a build with the same kernels, which the cache's device
+// version already ensures.
+void appendPackedWeights(const PackedWeightsQ8& packed, std::vector<uint8_t>* out);
+void appendPackedWeights(const PackedWeightsF32& packed, std::vector<uint8_t>* out);
+bool readPackedWeights(const uint8_t* data, size_t size, size_t* offset,
+                       PackedWeightsQ8* packed);
+bool readPackedWeights(const uint8_t* data, size_t size, size_t* offset,
+                       PackedWeightsF32* packed);
+
+// True if the build runs quantized GEMMs on SDOT and relaxed float ones in fp16
+bool gemmHasDotProduct();
+bool gemmHasHalfPrecision();
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
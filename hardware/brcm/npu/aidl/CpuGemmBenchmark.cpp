@@ -0,0 +1,132 @@
+// Copyright (C) 2025 The Android Open Source Project
+
+// Single layers of MobileNet v1 and YOLOv3-tiny on the CPU backend, int8 and
+// float, with the pool on every core. The NPU stub these replace slept 10 ms
+// per inference whatever the model.
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "CpuBackend.h"
+
+using namespace aidl::android::hardware::neuralnetworks::rpi5;
+
+namespace {
+
+struct LayerGraph {
+    NpuGraph graph;
+    std::mt19937 rng{7};
+
+    uint32_t addOperand(NpuOperandType type, NpuOperandLifetime lifetime,
+                        std::vector<uint32_t> dims, float scale = 0.0f, int32_t zeroPoint = 0) {
+        NpuOperand operand;
+        operand.type = type;
+        operand.lifetime = lifetime;
+        operand.dimensions = std::move(dims);
+        operand.scale = scale;
+        operand.zeroPoint = zeroPoint;
+        graph.operands.push_back(std::move(operand));
+        return static_cast<uint32_t>(graph.operands.size() - 1);
+    }
+
+    uint32_t addInt(int32_t value) {
+        uint32_t index = addOperand(NpuOperandType::INT32, NpuOperandLifetime::CONSTANT, {});
+        graph.operands[index].value.resize(sizeof(value));
+        memcpy(graph.operands[index].value.data(), &value, sizeof(value));
+        return index;
+    }
+
+    // Random bytes; small enough as floats or int32 biases to stay finite
+    uint32_t addConstant(NpuOperandType type, std::vector<uint32_t> dims) {
+        uint32_t index = addOperand(type, NpuOperandLifetime::CONSTANT, dims, 0.01f, 0);
+        NpuOperand& operand = graph.operands[index];
+        operand.value.resize(npuOperandSize(type, dims));
+        if (type == NpuOperandType::TENSOR_FLOAT32) {
+            std::uniform_real_distribution<float> dist(-0.1f, 0.1f);
+            for (size_t i = 0; i < operand.value.size(); i += sizeof(float)) {
+                float value = dist(rng);
+                memcpy(&operand.value[i], &value, sizeof(value));
+            }
+        } else if (type == NpuOperandType::TENSOR_INT32) {
+            std::fill(operand.value.begin(), operand.value.end(), 0);
+        } else {
+            for (auto& byte : operand.value) {
+                byte = rng();
+            }
+        }
+        return index;
+    }
+};
+
+// args: input side, input channels, output channels, kernel, stride, depthwise, int8
+std::shared_ptr<NpuGraph> makeLayer(const benchmark::State& state) {
+    const uint32_t side = state.range(0);
+    const uint32_t inC = state.range(1);
+    const uint32_t outC = state.range(2);
+    const uint32_t kernel = state.range(3);
+    const bool depthwise = state.range(5) != 0;
+    const bool quantized = state.range(6) != 0;
+    const NpuOperandType type = quantized ? NpuOperandType::TENSOR_QUANT8_ASYMM
+                                          : NpuOperandType::TENSOR_FLOAT32;
+
+    LayerGraph layer;
+    uint32_t input = layer.addOperand(type, NpuOperandLifetime::INPUT, {1, side, side, inC},
+                                      0.02f, 128);
+    uint32_t filter = layer.addConstant(quantized ? NpuOperandType::TENSOR_QUANT8_ASYMM : type,
+                                        depthwise ? std::vector<uint32_t>{1, kernel, kernel, outC}
+                                                  : std::vector<uint32_t>{outC, kernel, kernel,
+                                                                          inC});
+    layer.graph.operands[filter].zeroPoint = quantized ? 128 : 0;
+    uint32_t bias = layer.addConstant(quantized ? NpuOperandType::TENSOR_INT32 : type, {outC});
+    uint32_t output = layer.addOperand(type, NpuOperandLifetime::OUTPUT, {}, 0.05f, 128);
+
+    std::vector<uint32_t> inputs = {input, filter, bias, layer.addInt(1 /* SAME */),
+                                    layer.addInt(state.range(4)), layer.addInt(state.range(4))};
+    if (depthwise) {
+        inputs.push_back(layer.addInt(1));
+    }
+    inputs.push_back(layer.addInt(3 /* RELU6 */));
+    layer.graph.operations.push_back({depthwise ? 4 : 3, inputs, {output}});
+    layer.graph.inputIndexes = {input};
+    layer.graph.outputIndexes = {output};
+    return std::make_shared<NpuGraph>(std::move(layer.graph));
+}
+
+}  // namespace
+
+static void BM_Layer(benchmark::State& state) {
+    std::string error;
+    std::unique_ptr<CpuModel> model = CpuModel::create(makeLayer(state), &error);
+    if (model == nullptr) {
+        state.SkipWithError(error.c_str());
+        return;
+    }
+    const uint32_t side = state.range(0);
+    const size_t element = state.range(6) != 0 ? 1 : sizeof(float);
+    std::vector<uint8_t> input(static_cast<size_t>(side) * side * state.range(1) * element, 0x40);
+    std::vector<const std::vector<uint8_t>*> inputs = {&input};
+    std::vector<std::vector<uint8_t>> outputs;
+
+    CpuThreadPool pool;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(model->execute(inputs, &outputs, &pool, &error));
+    }
+    state.counters["GMAC"] = benchmark::Counter(model->macs() / 1e9,
+                                                benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_Layer)
+        // MobileNet v1: first pointwise, a 3x3 depthwise, a late pointwise
+        ->Args({112, 32, 64, 1, 1, 0, 1})
+        ->Args({112, 32, 32, 3, 1, 1, 1})
+        ->Args({14, 512, 512, 1, 1, 0, 1})
+        // YOLOv3-tiny: a mid 3x3, the widest 3x3
+        ->Args({52, 128, 256, 3, 1, 0, 1})
+        ->Args({13, 512, 1024, 3, 1, 0, 1})
+        // The same in float
+        ->Args({112, 32, 64, 1, 1, 0, 0})
+        ->Args({112, 32, 32, 3, 1, 1, 0})
+        ->Args({52, 128, 256, 3, 1, 0, 0})
+        ->Unit(benchmark::kMillisecond);
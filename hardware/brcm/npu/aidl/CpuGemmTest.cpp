@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * CPU GEMM kernels against a scalar reference, at sizes that leave tails
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "CpuGemm.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+namespace {
+
+// Rows and columns past the 8x8 tiles, and depths past the 4-deep dot product
+const uint32_t kRows[] = {1, 7, 9, 17};
+const uint32_t kColumns[] = {1, 5, 8, 13};
+const uint32_t kDepths[] = {1, 3, 5, 37};
+
+// Extra bytes or floats at the end of every row, so strides are exercised
+constexpr uint32_t kRowPadding = 3;
+
+std::vector<uint8_t> randomBytes(std::mt19937* rng, size_t count) {
+    std::uniform_int_distribution<int> dist(0, 255);
+    std::vector<uint8_t> values(count);
+    for (auto& value : values) {
+        value = dist(*rng);
+    }
+    return values;
+}
+
+std::vector<float> randomFloats(std::mt19937* rng, size_t count) {
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> values(count);
+    for (auto& value : values) {
+        value = dist(*rng);
+    }
+    return values;
+}
+
+// What gemmQ8 must produce: the exact integer sum, then the same float
+// multiply and round-to-nearest-even the kernels use
+std::vector<uint8_t> referenceQ8(const std::vector<uint8_t>& a, uint32_t m, uint32_t lda,
+                                 int32_t aZero, const std::vector<uint8_t>& w, bool isSigned,
+                                 int32_t wZero, uint32_t n, uint32_t k,
+                                 const QuantOutput& output) {
+    std::vector<uint8_t> c(static_cast<size_t>(m) * n);
+    for (uint32_t r = 0; r < m; r++) {
+        for (uint32_t col = 0; col < n; col++) {
+            int32_t acc = output.bias != nullptr ? output.bias[col] : 0;
+            for (uint32_t i = 0; i < k; i++) {
+                const uint8_t raw = w[static_cast<size_t>(col) * k + i];
+                const int32_t weight = isSigned ? static_cast<int8_t>(raw) : raw;
+                acc += (a[static_cast<size_t>(r) * lda + i] - aZero) * (weight - wZero);
+            }
+            const int32_t q = static_cast<int32_t>(std::lrint(acc * output.multipliers[col])) +
+                              output.zeroPoint;
+            c[static_cast<size_t>(r) * n + col] = std::clamp(q, output.min, output.max);
+        }
+    }
+    return c;
+}
+
+class CpuGemmTest : public ::testing::TestWithParam<bool> {
+protected:
+    // nullptr for the single-threaded runs
+    CpuThreadPool* pool() { return GetParam() ? &mPool : nullptr; }
+
+    CpuThreadPool mPool{3};
+    std::mt19937 mRng{7};
+};
+
+TEST_P(CpuGemmTest, Q8MatchesReference) {
+    for (bool isSigned : {false, true}) {
+        for (uint32_t m : kRows) {
+            for (uint32_t n : kColumns) {
+                for (uint32_t k : kDepths) {
+                    SCOPED_TRACE(::testing::Message() << (isSigned ? "int8" : "uint8")
+                                                      << " m=" << m << " n=" << n << " k=" << k);
+                    const uint32_t lda = k + kRowPadding;
+                    const uint32_t ldc = n + kRowPadding;
+                    const int32_t aZero = 118;
+                    const int32_t wZero = isSigned ? 0 : 131;
+                    auto a = randomBytes(&mRng, static_cast<size_t>(m) * lda);
+                    auto w = randomBytes(&mRng, static_cast<size_t>(n) * k);
+                    std::vector<int32_t> bias(n);
+                    std::vector<float> multipliers(n);
+                    for (uint32_t col = 0; col < n; col++) {
+                        bias[col] = static_cast<int32_t>(mRng() % 4001) - 2000;
+                        multipliers[col] = 0.5f / (k * (8 + col));
+                    }
+                    QuantOutput output;
+                    output.bias = bias.data();
+                    output.multipliers = multipliers.data();
+                    output.zeroPoint = 97;
+                    output.min = 10;
+                    output.max = 240;
+
+                    PackedWeightsQ8 packed;
+                    packWeightsQ8(w.data(), isSigned, wZero, n, k, &packed);
+                    std::vector<uint8_t> c(static_cast<size_t>(m) * ldc, 0xAB);
+                    gemmQ8(a.data(), m, lda, aZero, packed, output, c.data(), ldc, pool());
+
+                    auto want = referenceQ8(a, m, lda, aZero, w, isSigned, wZero, n, k, output);
+                    for (uint32_t r = 0; r < m; r++) {
+                        for (uint32_t col = 0; col < n; col++) {
+                            ASSERT_EQ(c[static_cast<size_t>(r) * ldc + col],
+                                      want[static_cast<size_t>(r) * n + col])
+                                    << "at " << r << "," << col;
+                        }
+                        // Nothing written past the row
+                        for (uint32_t col = n; col < ldc; col++) {
+                            ASSERT_EQ(c[static_cast<size_t>(r) * ldc + col], 0xAB);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_P(CpuGemmTest, F32MatchesReference) {
+    for (uint32_t m : kRows) {
+        for (uint32_t n : kColumns) {
+            for (uint32_t k : kDepths) {
+                SCOPED_TRACE(::testing::Message() << "m=" << m << " n=" << n << " k=" << k);
+                const uint32_t lda = k + kRowPadding;
+                const uint32_t ldc = n + kRowPadding;
+                auto a = randomFloats(&mRng, static_cast<size_t>(m) * lda);
+                auto w = randomFloats(&mRng, static_cast<size_t>(n) * k);
+                auto bias = randomFloats(&mRng, n);
+                FloatOutput output;
+                output.bias = bias.data();
+                output.min = -0.75f;
+                output.max = 2.0f;
+
+                PackedWeightsF32 packed;
+                packWeightsF32(w.data(), n, k, false, &packed);
+                std::vector<float> c(static_cast<size_t>(m) * ldc, 99.0f);
+                gemmF32(a.data(), m, lda, packed, output, c.data(), ldc, pool());
+
+                for (uint32_t r = 0; r < m; r++) {
+                    for (uint32_t col = 0; col < n; col++) {
+                        double acc = bias[col];
+                        for (uint32_t i = 0; i < k; i++) {
+                            acc += static_cast<double>(a[static_cast<size_t>(r) * lda + i]) *
+                                   w[static_cast<size_t>(col) * k + i];
+                        }
+                        const float want = std::clamp(static_cast<float>(acc), output.min,
+                                                      output.max);
+                        ASSERT_NEAR(c[static_cast<size_t>(r) * ldc + col], want, 1e-5f * k)
+                                << "at " << r << "," << col;
+                    }
+                    for (uint32_t col = n; col < ldc; col++) {
+                        ASSERT_EQ(c[static_cast<size_t>(r) * ldc + col], 99.0f);
+                    }
+                }
+            }
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Threads, CpuGemmTest, ::testing::Bool());
+
+// Ties round to even, as NNAPI's reference and the vector conversion do, and
+// the result clamps to the fused activation's range
+TEST(CpuGemmRequantTest, RoundsHalfToEvenAndClamps) {
+    // One column of depth 1 with weight 1: each row's sum is its activation
+    // less the zero point, here -6 to 9
+    const uint32_t m = 16;
+    const int32_t aZero = 6;
+    std::vector<uint8_t> a(m);
+    for (uint32_t r = 0; r < m; r++) {
+        a[r] = r;
+    }
+    const uint8_t one = 1;
+    PackedWeightsQ8 packed;
+    packWeightsQ8(&one, true, 0, 1, 1, &packed);
+
+    const float half = 0.5f;
+    QuantOutput output;
+    output.multipliers = &half;
+    output.zeroPoint = 2;
+    output.min = 0;
+    output.max = 6;
+    std::vector<uint8_t> c(m);
+    gemmQ8(a.data(), m, 1, aZero, packed, output, c.data(), 1, nullptr);
+
+    // sum:         -6 -5 -4 -3 -2 -1  0  1  2  3  4  5  6  7  8  9
+    // sum / 2:     -3 -2.5 -2 -1.5 -1 -0.5 0 0.5 1 1.5 2 2.5 3 3.5 4 4.5
+    // rounded + 2: -1  0  0  0  1  2  2  2  3  4  4  4  5  6  6  6 (clamped)
+    const std::vector<uint8_t> want = {0, 0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6};
+    EXPECT_EQ(c, want);
+}
+
+TEST(CpuGemmRequantTest, BiasAndZeroPointsCancel) {
+    // (a - za)(w - zw) + bias with every activation at its zero point is the
+    // bias alone, whatever the weights
+    const uint32_t m = 3;
+    const uint32_t n = 11;
+    const uint32_t k = 9;
+    std::vector<uint8_t> a(m * k, 77);
+    std::vector<uint8_t> w(n * k);
+    for (size_t i = 0; i < w.size(); i++) {
+        w[i] = static_cast<uint8_t>(i * 37);
+    }
+    std::vector<int32_t> bias(n);
+    std::vector<float> multipliers(n, 1.0f);
+    for (uint32_t col = 0; col < n; col++) {
+        bias[col] = static_cast<int32_t>(col) * 10 - 50;
+    }
+    PackedWeightsQ8 packed;
+    packWeightsQ8(w.data(), false, 200, n, k, &packed);
+    QuantOutput output;
+    output.bias = bias.data();
+    output.multipliers = multipliers.data();
+    output.zeroPoint = 128;
+    std::vector<uint8_t> c(m * n);
+    gemmQ8(a.data(), m, k, 77, packed, output, c.data(), n, nullptr);
+    for (uint32_t r = 0; r < m; r++) {
+        for (uint32_t col = 0; col < n; col++) {
+            EXPECT_EQ(c[r * n + col], 128 + bias[col]) << "at " << r << "," << col;
+        }
+    }
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Work-stealing thread pool for the Raspberry Pi 5 CPU inference backend
+ */
+
+#include "CpuThreadPool.h"
+
+#include <algorithm>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+CpuThreadPool::CpuThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    for (size_t i = 0; i < threads; i++) {
+        mQueues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 1; i < threads; i++) {
+        mWorkers.emplace_back(&CpuThreadPool::workerLoop, this, i);
+    }
+}
+
+CpuThreadPool::~CpuThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopping = true;
+    }
+    mWake.notify_all();
+    for (auto& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+void CpuThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> call(mCallLock);
+    const size_t threads = mQueues.size();
+    if (threads == 1 || count == 1) {
+        for (size_t i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    // Workers only read mTask after taking an index, which the queue locks
+    // order after this store
+    mTask = &task;
+    mRemaining = count;
+    {
+        // All at once: a worker still looking for work from the last call
+        // could otherwise steal into its own queue before it is filled, and
+        // have the stolen range overwritten
+        std::vector<std::unique_lock<std::mutex>> locks;
+        for (auto& queue : mQueues) {
+            locks.emplace_back(queue->lock);
+        }
+        for (size_t q = 0; q < threads; q++) {
+            mQueues[q]->begin = count * q / threads;
+            mQueues[q]->end = count * (q + 1) / threads;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mGeneration++;
+    }
+    mWake.notify_all();
+
+    run(0);
+
+    std::unique_lock<std::mutex> lock(mLock);
+    mDone.wait(lock, [this] { return mRemaining.load() == 0; });
+}
+
+bool CpuThreadPool::take(size_t self, size_t* index) {
+    Queue& own = *mQueues[self];
+    {
+        std::lock_guard<std::mutex> lock(own.lock);
+        if (own.begin < own.end) {
+            *index = own.begin++;
+            return true;
+        }
+    }
+
+    const size_t threads = mQueues.size();
+    for (size_t offset = 1; offset < threads; offset++) {
+        Queue& victim = *mQueues[(self + offset) % threads];
+        // Both at once: the caller may refill our own queue for the next call
+        // while we look, and a stolen range must not overwrite that
+        std::scoped_lock lock(own.lock, victim.lock);
+        if (own.begin < own.end) {
+            *index = own.begin++;
+            return true;
+        }
+        if (victim.begin >= victim.end) {
+            continue;
+        }
+        const size_t first = victim.begin + (victim.end - victim.begin) / 2;
+        own.begin = first + 1;
+        own.end = victim.end;
+        victim.end = first;
+        *index = first;
+        return true;
+    }
+    return false;
+}
+
+void CpuThreadPool::run(size_t self) {
+    size_t index;
+    while (take(self, &index)) {
+        (*mTask)(index);
+        if (mRemaining.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(mLock);
+            mDone.notify_all();
+        }
+    }
+}
+
+void CpuThreadPool::workerLoop(size_t self) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mLock);
+            mWake.wait(lock, [this, seen] { return mStopping || mGeneration != seen; });
+            if (mStopping) {
+                return;
+            }
+            seen = mGeneration;
+        }
+        run(self);
+    }
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Work-stealing thread pool for the Raspberry Pi 5 CPU inference backend
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// Runs index ranges across the cores. Each thread starts on an even share
+// of the range and, once it runs dry, steals the upper half of whatever
+// another thread has left, so uneven tiles and a core busy with something
+// else do not hold up the whole layer. The calling thread works too.
+class CpuThreadPool {
+public:
+    // 0: one thread per core, the caller included
+    explicit CpuThreadPool(size_t threads = 0);
+    ~CpuThreadPool();
+
+    CpuThreadPool(const CpuThreadPool&) = delete;
+    CpuThreadPool& operator=(const CpuThreadPool&) = delete;
+
+    size_t threads() const { return mQueues.size(); }
+
+    // Calls task(i) for every i below count and returns when all are done.
+    // Callers are serialised; tasks must not call back into the pool.
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    struct Queue {
+        std::mutex lock;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    bool take(size_t self, size_t* index);
+    void run(size_t self);
+    void workerLoop(size_t self);
+
+    std::vector<std::unique_ptr<Queue>> mQueues;    // [0] belongs to the caller
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mCallLock;
+    std::mutex mLock;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+    const std::function<void(size_t)>* mTask = nullptr;
+    std::atomic<size_t> mRemaining{0};
+    uint64_t mGeneration = 0;   // guarded by mLock
+    bool mStopping = false;     // guarded by mLock
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * NNAPI device for the Raspberry Pi 5 NPU driver
+ */
+
+#include "Device.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+
+#include <android-base/chrono_utils.h>
+#include <android-base/file.h>
+#include <log/log.h>
+
+#include "CpuBackend.h"
+#include "NnapiUtils.h"
+#include "NpuCache.h"
+#include "PreparedModel.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// Rough INT8 throughput of the four Cortex-A76 cores; NNAPI performance
+// figures are relative to the CPU fallback
+constexpr float kCpuReferenceTops = 0.5f;
+
+// Name the operation goes by in kNpuCapabilities, nullptr if no NPU runs it
+static const char* capabilityName(OperationType type) {
+    switch (type) {
+        case OperationType::CONV_2D:
+            return "Conv2D";
+        case OperationType::DEPTHWISE_CONV_2D:
+            return "DepthwiseConv2D";
+        case OperationType::FULLY_CONNECTED:
+            return "FullyConnected";
+        case OperationType::AVERAGE_POOL_2D:
+        case OperationType::MAX_POOL_2D:
+        case OperationType::L2_POOL_2D:
+            return "Pooling";
+        case OperationType::SOFTMAX:
+            return "Softmax";
+        case OperationType::ADD:
+            return "Add";
+        case OperationType::MUL:
+            return "Mul";
+        case OperationType::RELU:
+        case OperationType::RELU1:
+        case OperationType::RELU6:
+            return "ReLU";
+        case OperationType::PRELU:
+            return "PReLU";
+        case OperationType::LOGISTIC:
+            return "Sigmoid";
+        case OperationType::CONCATENATION:
+            return "Concat";
+        case OperationType::SPLIT:
+            return "Split";
+        case OperationType::RESHAPE:
+            return "Reshape";
+        case OperationType::TRANSPOSE:
+            return "Transpose";
+        default:
+            return nullptr;
+    }
+}
+
+// One file for the graph structure, one for the weights
+constexpr int32_t kNumModelCache = 1;
+constexpr int32_t kNumDataCache = 1;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            ::android::base::boot_clock::now().time_since_epoch()).count();
+}
+
+static InferencePriority toInferencePriority(Priority priority) {
+    switch (priority) {
+        case Priority::LOW:
+            return InferencePriority::LOW;
+        case Priority::HIGH:
+            return InferencePriority::HIGH;
+        default:
+            return InferencePriority::NORMAL;
+    }
+}
+
+static PerformanceInfo performanceFor(float tops) {
+    if (tops <= 0.0f) {
+        return {FLT_MAX, FLT_MAX};
+    }
+    const float ratio = kCpuReferenceTops / tops;
+    return {ratio, ratio};
+}
+
+Device::Device(const std::string& npuId)
+    : npu_id_(npuId), info_(NpuManager::getInstance().getNpuInfo(npuId)) {
+    // Also keys the compilation cache, so a different accelerator or firmware
+    // never picks up another one's cache
+    version_ = "rpi5-npu";
+    if (!info_.name.empty()) {
+        version_ += " " + info_.name;
+    }
+    if (!info_.firmware.empty()) {
+        version_ += " " + info_.firmware;
+    }
+}
+
+bool Device::supportsOperandType(OperandType type, bool relaxed) const {
+    const NpuCapabilities& caps = info_.capabilities;
+    switch (type) {
+        case OperandType::TENSOR_QUANT8_ASYMM:
+        case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
+        case OperandType::TENSOR_QUANT8_SYMM:
+        case OperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL:
+            return caps.supportsInt8;
+        case OperandType::TENSOR_QUANT16_SYMM:
+        case OperandType::TENSOR_QUANT16_ASYMM:
+            return caps.supportsInt16;
+        case OperandType::TENSOR_FLOAT16:
+            return caps.supportsFp16;
+        case OperandType::TENSOR_FLOAT32:
+            return caps.supportsFp32 || (relaxed && caps.supportsFp16);
+        // Biases and scalar parameters
+        case OperandType::TENSOR_INT32:
+        case OperandType::FLOAT32:
+        case OperandType::INT32:
+        case OperandType::UINT32:
+        case OperandType::BOOL:
+        case OperandType::FLOAT16:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Device::isSupported(const Model& model, const Operation& operation) const {
+    // Accelerators have no inference runtime behind them yet and would
+    // return no outputs; claiming their operations would fail every execution
+    if (info_.type != NpuType::CPU_FALLBACK) {
+        return false;
+    }
+    const char* name = capabilityName(operation.type);
+    const auto& ops = info_.capabilities.supportedOperations;
+    if (name == nullptr || std::find(ops.begin(), ops.end(), name) == ops.end()) {
+        return false;
+    }
+
+    const auto& operands = model.main.operands;
+    auto supported = [&](int32_t index) {
+        return index >= 0 && static_cast<size_t>(index) < operands.size() &&
+               supportsOperandType(operands[index].type, model.relaxComputationFloat32toFloat16);
+    };
+    return std::all_of(operation.inputs.begin(), operation.inputs.end(), supported) &&
+           std::all_of(operation.outputs.begin(), operation.outputs.end(), supported);
+}
+
+ndk::ScopedAStatus Device::allocate(const BufferDesc& desc,
+                                    const std::vector<IPreparedModelParcel>& preparedModels,
+                                    const std::vector<BufferRole>& inputRoles,
+                                    const std::vector<BufferRole>& outputRoles,
+                                    DeviceBuffer* _aidl_return) {
+    return toAStatus(ErrorStatus::GENERAL_FAILURE, "device memory is not supported");
+}
+
+ndk::ScopedAStatus Device::getCapabilities(Capabilities* _aidl_return) {
+    const NpuCapabilities& caps = info_.capabilities;
+    const PerformanceInfo unsupported = {FLT_MAX, FLT_MAX};
+
+    _aidl_return->relaxedFloat32toFloat16PerformanceScalar = performanceFor(caps.topsFp16);
+    _aidl_return->relaxedFloat32toFloat16PerformanceTensor = performanceFor(caps.topsFp16);
+    _aidl_return->ifPerformance = unsupported;
+    _aidl_return->whilePerformance = unsupported;
+
+    // Sorted by type, as the runtime requires
+    _aidl_return->operandPerformance.clear();
+    for (int32_t i = static_cast<int32_t>(OperandType::FLOAT32);
+         i <= static_cast<int32_t>(OperandType::TENSOR_QUANT8_ASYMM_SIGNED); i++) {
+        const OperandType type = static_cast<OperandType>(i);
+        if (!supportsOperandType(type, false)) {
+            continue;
+        }
+        float tops;
+        switch (type) {
+            case OperandType::TENSOR_QUANT16_SYMM:
+            case OperandType::TENSOR_QUANT16_ASYMM:
+                tops = caps.topsInt16;
+                break;
+            case OperandType::TENSOR_FLOAT16:
+                tops = caps.topsFp16;
+                break;
+            case OperandType::TENSOR_FLOAT32:
+                tops = caps.topsFp32;
+                break;
+            default:
+                tops = caps.topsInt8;
+                break;
+        }
+        _aidl_return->operandPerformance.push_back({type, performanceFor(tops)});
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus Device::getNumberOfCacheFilesNeeded(NumberOfCacheFiles* _aidl_return) {
+    const bool caching = !npu_id_.empty();
+    _aidl_return->numModelCache = caching ? kNumModelCache : 0;
+    _aidl_return->numDataCache = caching ? kNumDataCache : 0;
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus Device::getSupportedExtensions(std::vector<Extension>* _aidl_return) {
+    _aidl_return->clear();
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus Device::getSupportedOperations(const Model& model,
+                                                  std::vector<bool>* _aidl_return) {
+    _aidl_return->clear();
+    // The CPU backend goes by operand types and parameters, not just by name,
+    // so it answers from the converted graph
+    if (info_.type == NpuType::CPU_FALLBACK) {
+        NpuGraph graph;
+        std::string error;
+        const bool converted = convertModel(model, &graph, &error);
+        for (size_t i = 0; i < model.main.operations.size(); i++) {
+            _aidl_return->push_back(converted &&
+                                    cpuSupportsOperation(graph, graph.operations[i]));
+        }
+        return ndk::ScopedAStatus::ok();
+    }
+    for (const Operation& operation : model.main.operations) {
+        _aidl_return->push_back(!npu_id_.empty() && isSupported(model, operation));
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus Device::getType(DeviceType* _aidl_return) {
+    *_aidl_return = info_.type == NpuType::CPU_FALLBACK ? DeviceType::CPU
+                                                        : DeviceType::ACCELERATOR;
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus Device::getVersionString(std::string* _aidl_return) {
+    *_aidl_return = version_;
+    return ndk::ScopedAStatus::ok();
+}
+
+binder_status_t Device::dump(int fd, const char** /*args*/, uint32_t /*numArgs*/) {
+    NpuManager& npu = NpuManager::getInstance();
+    std::string out = "rpi5 NNAPI device: " + version_ + "\n";
+    if (!npu.isProfiling()) {
+        out += "  profiling off; set persist.vendor.npu.profile and restart the service\n";
+    } else if (npu.writeChromeTrace(kChromeTracePath)) {
+        out += std::string("  Chrome trace written to ") + kChromeTracePath + "\n";
+    } else {
+        out += std::string("  failed to write ") + kChromeTracePath + "\n";
+    }
+    ::android::base::WriteStringToFd(out, fd);
+    return STATUS_OK;
+}
+
+bool Device::validCacheFiles(const std::vector<ndk::ScopedFileDescriptor>& modelCache,
+                             const std::vector<ndk::ScopedFileDescriptor>& dataCache) const {
+    if (modelCache.empty() && dataCache.empty()) {
+        return true;
+    }
+    return !npu_id_.empty() && modelCache.size() == kNumModelCache &&
+           dataCache.size() == kNumDataCache && modelCache[0].get() >= 0 &&
+           dataCache[0].get() >= 0;
+}
+
+ndk::ScopedAStatus Device::finishPrepare(const std::string& modelId,
+                                         std::shared_ptr<const NpuGraph> graph,
+                                         InferencePriority priority, int64_t startNs,
+                                         bool fromCache,
+                                         const std::shared_ptr<IPreparedModelCallback>& callback) {
+    if (modelId.empty()) {
+        callback->notify(ErrorStatus::GENERAL_FAILURE, nullptr);
+        return toAStatus(ErrorStatus::GENERAL_FAILURE, "NPU " + npu_id_ + " rejected the model");
+    }
+    ALOGI("Prepared %s on %s in %.2f ms (%s)", modelId.c_str(), npu_id_.c_str(),
+          (nowNs() - startNs) / 1e6, fromCache ? "from cache" : "compiled");
+    callback->notify(ErrorStatus::NONE,
+                     ndk::SharedRefBase::make<PreparedModel>(npu_id_, modelId, std::move(graph),
+                                                            priority));
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus Device::prepare(const Model& model, Priority priority, int64_t deadlineNs,
+                                   const std::vector<ndk::ScopedFileDescriptor>& modelCache,
+                                   const std::vector<ndk::ScopedFileDescriptor>& dataCache,
+                                   const uint8_t* token, size_t tokenSize,
+                                   const std::shared_ptr<IPreparedModelCallback>& callback) {
+    const int64_t startNs = nowNs();
+    if (callback == nullptr) {
+        return toAStatus(ErrorStatus::INVALID_ARGUMENT, "no callback for prepared model");
+    }
+    auto fail = [&callback](ErrorStatus status, const std::string& message) {
+        callback->notify(status, nullptr);
+        return toAStatus(status, message);
+    };
+
+    if (npu_id_.empty()) {
+        return fail(ErrorStatus::DEVICE_UNAVAILABLE, "no NPU present");
+    }
+    if (!validCacheFiles(modelCache, dataCache)) {
+        return fail(ErrorStatus::INVALID_ARGUMENT, "unexpected number of cache files");
+    }
+    if (deadlinePassed(deadlineNs)) {
+        return fail(ErrorStatus::MISSED_DEADLINE_PERSISTENT, "deadline passed before preparation");
+    }
+    for (const Operation& operation : model.main.operations) {
+        if (!isSupported(model, operation)) {
+            return fail(ErrorStatus::INVALID_ARGUMENT,
+                        "operation " + toString(operation.type) + " is not supported");
+        }
+    }
+
+    auto graph = std::make_shared<NpuGraph>();
+    std::string error;
+    if (!convertModel(model, graph.get(), &error)) {
+        return fail(ErrorStatus::INVALID_ARGUMENT, "invalid model: " + error);
+    }
+
+    NpuManager& npus = NpuManager::getInstance();
+    const std::string modelId = npus.loadModel(npu_id_, "nnapi", graph);
+
+    // Written once the model is loaded, so the CPU backend's packed weights
+    // go in with the graph and a restore skips packing. A failed cache write
+    // only costs the next launch a full preparation.
+    if (!modelId.empty() && !modelCache.empty() && tokenSize == kCacheTokenSize) {
+        std::vector<uint8_t> packedWeights;
+        npus.getPackedWeights(modelId, &packedWeights);
+        if (!writeGraphCache(modelCache[0].get(), dataCache[0].get(), token, version_, *graph,
+                             packedWeights)) {
+            ALOGW("Failed to write the compilation cache");
+        }
+    }
+    return finishPrepare(modelId, std::move(graph), toInferencePriority(priority), startNs, false,
+                         callback);
+}
+
+ndk::ScopedAStatus Device::prepareModel(const Model& model, ExecutionPreference preference,
+                                        Priority priority, int64_t deadlineNs,
+                                        const std::vector<ndk::ScopedFileDescriptor>& modelCache,
+                                        const std::vector<ndk::ScopedFileDescriptor>& dataCache,
+                                        const std::vector<uint8_t>& token,
+                                        const std::shared_ptr<IPreparedModelCallback>& callback) {
+    return prepare(model, priority, deadlineNs, modelCache, dataCache, token.data(), token.size(),
+                   callback);
+}
+
+ndk::ScopedAStatus Device::prepareModelFromCache(
+        int64_t deadlineNs, const std::vector<ndk::ScopedFileDescriptor>& modelCache,
+        const std::vector<ndk::ScopedFileDescriptor>& dataCache,
+        const std::vector<uint8_t>& token,
+        const std::shared_ptr<IPreparedModelCallback>& callback) {
+    const int64_t startNs = nowNs();
+    if (callback == nullptr) {
+        return toAStatus(ErrorStatus::INVALID_ARGUMENT, "no callback for prepared model");
+    }
+    auto fail = [&callback](ErrorStatus status, const std::string& message) {
+        callback->notify(status, nullptr);
+        return toAStatus(status, message);
+    };
+
+    if (npu_id_.empty() || modelCache.empty() || !validCacheFiles(modelCache, dataCache) ||
+        token.size() != kCacheTokenSize) {
+        return fail(ErrorStatus::INVALID_ARGUMENT, "unexpected cache files or token");
+    }
+    if (deadlinePassed(deadlineNs)) {
+        return fail(ErrorStatus::MISSED_DEADLINE_PERSISTENT, "deadline passed before preparation");
+    }
+
+    // The runtime compiles from the model again when this fails. The cache
+    // call carries no priority, so the model runs in the default class.
+    auto graph = std::make_shared<NpuGraph>();
+    std::vector<uint8_t> packedWeights;
+    if (!readGraphCache(modelCache[0].get(), dataCache[0].get(), token.data(), version_,
+                        graph.get(), &packedWeights)) {
+        return fail(ErrorStatus::GENERAL_FAILURE, "compilation cache is stale or corrupt");
+    }
+    const std::string modelId =
+            NpuManager::getInstance().loadModel(npu_id_, "nnapi", graph, &packedWeights);
+    return finishPrepare(modelId, std::move(graph), InferencePriority::NORMAL, startNs, true,
+                         callback);
+}
+
+ndk::ScopedAStatus Device::prepareModelWithConfig(
+        const Model& model, const PrepareModelConfig& config,
+        const std::shared_ptr<IPreparedModelCallback>& callback) {
+    return prepare(model, config.priority, config.deadlineNs, config.modelCache, config.dataCache,
+                   config.cacheToken.data(), config.cacheToken.size(), callback);
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
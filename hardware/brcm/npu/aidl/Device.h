@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * NNAPI device for the Raspberry Pi 5 NPU driver
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/neuralnetworks/BnDevice.h>
+
+#include <string>
+#include <vector>
+
+#include "Npu.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// Where dump() leaves the inference trace, for chrome://tracing or Perfetto
+constexpr char kChromeTracePath[] = "/data/vendor/npu/trace.json";
+
+// Exposes one NpuManager accelerator as an NNAPI device. Supported operations
+// come from the accelerator's entry in kNpuCapabilities, or for the CPU
+// backend from what it can plan.
+class Device : public BnDevice {
+  public:
+    // |npuId| is empty when no accelerator was found; nothing is supported then
+    explicit Device(const std::string& npuId);
+
+    ndk::ScopedAStatus allocate(const BufferDesc& desc,
+                                const std::vector<IPreparedModelParcel>& preparedModels,
+                                const std::vector<BufferRole>& inputRoles,
+                                const std::vector<BufferRole>& outputRoles,
+                                DeviceBuffer* _aidl_return) override;
+    ndk::ScopedAStatus getCapabilities(Capabilities* _aidl_return) override;
+    ndk::ScopedAStatus getNumberOfCacheFilesNeeded(NumberOfCacheFiles* _aidl_return) override;
+    ndk::ScopedAStatus getSupportedExtensions(std::vector<Extension>* _aidl_return) override;
+    ndk::ScopedAStatus getSupportedOperations(const Model& model,
+                                              std::vector<bool>* _aidl_return) override;
+    ndk::ScopedAStatus getType(DeviceType* _aidl_return) override;
+    ndk::ScopedAStatus getVersionString(std::string* _aidl_return) override;
+    ndk::ScopedAStatus prepareModel(
+            const Model& model, ExecutionPreference preference, Priority priority,
+            int64_t deadlineNs, const std::vector<ndk::ScopedFileDescriptor>& modelCache,
+            const std::vector<ndk::ScopedFileDescriptor>& dataCache,
+            const std::vector<uint8_t>& token,
+            const std::shared_ptr<IPreparedModelCallback>& callback) override;
+    ndk::ScopedAStatus prepareModelFromCache(
+            int64_t deadlineNs, const std::vector<ndk::ScopedFileDescriptor>& modelCache,
+            const std::vector<ndk::ScopedFileDescriptor>& dataCache,
+            const std::vector<uint8_t>& token,
+            const std::shared_ptr<IPreparedModelCallback>& callback) override;
+    ndk::ScopedAStatus prepareModelWithConfig(
+            const Model& model, const PrepareModelConfig& config,
+            const std::shared_ptr<IPreparedModelCallback>& callback) override;
+
+    // dumpsys: while profiling is on (persist.vendor.npu.profile at service
+    // start), also writes the Chrome trace to kChromeTracePath
+    binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
+
+  private:
+    bool isSupported(const Model& model, const Operation& operation) const;
+    bool supportsOperandType(OperandType type, bool relaxed) const;
+    ndk::ScopedAStatus prepare(const Model& model, Priority priority, int64_t deadlineNs,
+                               const std::vector<ndk::ScopedFileDescriptor>& modelCache,
+                               const std::vector<ndk::ScopedFileDescriptor>& dataCache,
+                               const uint8_t* token, size_t tokenSize,
+                               const std::shared_ptr<IPreparedModelCallback>& callback);
+    // Hands the model NpuManager loaded as |modelId| to |callback|, or fails
+    // it if the NPU rejected the graph and |modelId| is empty
+    ndk::ScopedAStatus finishPrepare(const std::string& modelId,
+                                     std::shared_ptr<const NpuGraph> graph,
+                                     InferencePriority priority, int64_t startNs, bool fromCache,
+                                     const std::shared_ptr<IPreparedModelCallback>& callback);
+    // Cache vectors must be empty (no caching) or hold exactly the files we asked for
+    bool validCacheFiles(const std::vector<ndk::ScopedFileDescriptor>& modelCache,
+                         const std::vector<ndk::ScopedFileDescriptor>& dataCache) const;
+
+    const std::string npu_id_;
+    const NpuDeviceInfo info_;
+    std::string version_;
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Edge TPU parameter cache tracking for the Raspberry Pi 5 NPU HAL
+ */
+
+#include "EdgeTpuCache.h"
+
+#include <algorithm>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+void EdgeTpuCache::addModel(const std::string& model, size_t parameterBytes) {
+    removeModel(model);
+    mModels[model] = {parameterBytes, mNextToken++, {}};
+}
+
+void EdgeTpuCache::removeModel(const std::string& model) {
+    mModels.erase(model);
+    mResident.erase(model);
+}
+
+size_t EdgeTpuCache::cachedBytes(const Model& model) const {
+    return std::min(model.parameterBytes, mCapacity);
+}
+
+bool EdgeTpuCache::setModelSet(const std::vector<std::string>& models) {
+    size_t total = 0;
+    for (const auto& name : models) {
+        auto it = mModels.find(name);
+        if (it == mModels.end()) {
+            return false;
+        }
+        total += it->second.parameterBytes;
+    }
+    if (total > mCapacity) {
+        return false;
+    }
+
+    // Recompiled together the parameters are laid out anew, so whatever
+    // the chip holds for them is stale
+    const uint64_t token = mNextToken++;
+    for (const auto& name : models) {
+        mModels[name].token = token;
+        mResident.erase(name);
+    }
+    return true;
+}
+
+size_t EdgeTpuCache::run(const std::string& model) {
+    auto it = mModels.find(model);
+    if (it == mModels.end()) {
+        return 0;
+    }
+    Model& entry = it->second;
+    const size_t cached = cachedBytes(entry);
+    const size_t streamed = entry.parameterBytes - cached;
+    entry.stats.streamedBytes += streamed;
+
+    if (entry.token == mToken && mResident.count(model) != 0) {
+        entry.stats.hits++;
+        return streamed;
+    }
+    if (entry.token != mToken) {
+        mResident.clear();
+        mToken = entry.token;
+    }
+    mResident.insert(model);
+    entry.stats.uploads++;
+    entry.stats.uploadedBytes += cached;
+    return cached + streamed;
+}
+
+std::vector<std::vector<std::string>> EdgeTpuCache::planSets(
+        const std::map<std::string, size_t>& parameterBytes,
+        const std::map<std::string, uint64_t>& runs, size_t capacityBytes) {
+    std::vector<std::string> order;
+    for (const auto& pair : parameterBytes) {
+        order.push_back(pair.first);
+    }
+    auto runCount = [&runs](const std::string& model) {
+        auto it = runs.find(model);
+        return it != runs.end() ? it->second : 0;
+    };
+    std::stable_sort(order.begin(), order.end(),
+                     [&runCount](const std::string& a, const std::string& b) {
+                         return runCount(a) > runCount(b);
+                     });
+
+    // First fit; a model too big for the chip gets a set of its own
+    std::vector<std::vector<std::string>> sets;
+    std::vector<size_t> used;
+    for (const auto& model : order) {
+        const size_t bytes = parameterBytes.at(model);
+        size_t set = 0;
+        while (set < sets.size() && used[set] + bytes > capacityBytes) {
+            set++;
+        }
+        if (set == sets.size()) {
+            sets.emplace_back();
+            used.push_back(0);
+        }
+        sets[set].push_back(model);
+        used[set] += bytes;
+    }
+    return sets;
+}
+
+std::map<std::string, EdgeTpuCacheStats> EdgeTpuCache::stats() const {
+    std::map<std::string, EdgeTpuCacheStats> stats;
+    for (const auto& pair : mModels) {
+        stats[pair.first] = pair.second.stats;
+    }
+    return stats;
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
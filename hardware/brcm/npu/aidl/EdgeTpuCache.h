@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Edge TPU parameter cache tracking for the Raspberry Pi 5 NPU HAL
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+struct EdgeTpuCacheStats {
+    uint64_t hits = 0;          // parameters were already on chip
+    uint64_t uploads = 0;       // parameters had to be streamed in first
+    uint64_t uploadedBytes = 0;
+    uint64_t streamedBytes = 0; // parameters that never fit, sent every run
+};
+
+// The Edge TPU keeps model parameters in its on-chip SRAM between runs, but
+// only for models sharing a caching token, which the compiler gives to
+// models compiled together. Running a model with another token discards the
+// whole cache and its parameters come over PCIe or USB again. This mirrors
+// that state so the HAL can tell which runs re-upload, and which models to
+// compile together. Not thread-safe; the owner holds its lock.
+class EdgeTpuCache {
+public:
+    explicit EdgeTpuCache(size_t capacityBytes) : mCapacity(capacityBytes) {}
+
+    // Models start in a set of their own; parameters beyond the capacity
+    // are streamed on every run
+    void addModel(const std::string& model, size_t parameterBytes);
+    void removeModel(const std::string& model);
+
+    // Puts |models| under one caching token. False, changing nothing, if a
+    // model is unknown or their parameters together do not fit on chip.
+    bool setModelSet(const std::vector<std::string>& models);
+
+    // Bytes to send over the bus before |model| can run; updates the stats
+    size_t run(const std::string& model);
+
+    // Splits |models| into sets that fit on chip, most-used first so hot
+    // models share a token. Input to the Edge TPU compiler.
+    static std::vector<std::vector<std::string>> planSets(
+            const std::map<std::string, size_t>& parameterBytes,
+            const std::map<std::string, uint64_t>& runs, size_t capacityBytes);
+
+    std::map<std::string, EdgeTpuCacheStats> stats() const;
+    size_t capacity() const { return mCapacity; }
+
+private:
+    struct Model {
+        size_t parameterBytes;
+        uint64_t token;
+        EdgeTpuCacheStats stats;
+    };
+
+    size_t cachedBytes(const Model& model) const;
+
+    const size_t mCapacity;
+    std::map<std::string, Model> mModels;
+    uint64_t mNextToken = 1;
+    uint64_t mToken = 0;                // of the parameters on chip, 0 if none
+    std::set<std::string> mResident;    // models whose parameters are on chip
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,52 @@
+// Copyright (C) 2025 The Android Open Source Project
+
+// Round robin over a detector and a classifier on one Edge TPU, compiled
+// separately or together. Reports the parameter bytes each inference puts
+// on the bus; at the Coral's ~400 MB/s over PCIe that is the time the
+// switch costs.
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include "EdgeTpuCache.h"
+
+using namespace aidl::android::hardware::neuralnetworks::rpi5;
+
+static constexpr size_t kSramBytes = 8 << 20;
+static constexpr size_t kBusBytesPerMs = 400 << 10;
+
+// args: compiled together
+static void BM_RoundRobin(benchmark::State& state) {
+    EdgeTpuCache cache(kSramBytes);
+    cache.addModel("ssd_mobilenet_v2", 4300 << 10);
+    cache.addModel("mobilenet_v2", 3400 << 10);
+    if (state.range(0) != 0) {
+        cache.setModelSet({"ssd_mobilenet_v2", "mobilenet_v2"});
+    }
+
+    uint64_t bytes = 0;
+    uint64_t runs = 0;
+    for (auto _ : state) {
+        bytes += cache.run(runs % 2 == 0 ? "ssd_mobilenet_v2" : "mobilenet_v2");
+        runs++;
+    }
+    state.counters["bus KB/inference"] = static_cast<double>(bytes) / runs / 1024;
+    state.counters["bus ms/inference"] = static_cast<double>(bytes) / runs / kBusBytesPerMs;
+}
+BENCHMARK(BM_RoundRobin)->Arg(0)->Arg(1);
+
+// Planning sets for |range(0)| models of 1-4 MB
+static void BM_PlanSets(benchmark::State& state) {
+    std::map<std::string, size_t> parameterBytes;
+    std::map<std::string, uint64_t> runs;
+    for (int i = 0; i < state.range(0); i++) {
+        const std::string model = "model" + std::to_string(i);
+        parameterBytes[model] = static_cast<size_t>(1 + i % 4) << 20;
+        runs[model] = (i * 7919) % 100;
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(EdgeTpuCache::planSets(parameterBytes, runs, kSramBytes));
+    }
+}
+BENCHMARK(BM_PlanSets)->Arg(4)->Arg(32);
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Edge TPU parameter cache accounting and caching token planning
+ */
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "EdgeTpuCache.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+namespace {
+
+constexpr size_t kMiB = 1024 * 1024;
+constexpr size_t kCapacity = 8 * kMiB;
+
+TEST(EdgeTpuCacheTest, UploadsOnceThenHits) {
+    EdgeTpuCache cache(kCapacity);
+    cache.addModel("mobilenet", 3 * kMiB);
+    EXPECT_EQ(cache.run("mobilenet"), 3 * kMiB);
+    EXPECT_EQ(cache.run("mobilenet"), 0u);
+    EXPECT_EQ(cache.run("mobilenet"), 0u);
+
+    auto stats = cache.stats()["mobilenet"];
+    EXPECT_EQ(stats.uploads, 1u);
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.uploadedBytes, 3 * kMiB);
+    EXPECT_EQ(stats.streamedBytes, 0u);
+}
+
+TEST(EdgeTpuCacheTest, ParametersBeyondCapacityStreamEveryRun) {
+    EdgeTpuCache cache(kCapacity);
+    cache.addModel("yolo", 11 * kMiB);
+    EXPECT_EQ(cache.run("yolo"), 11 * kMiB);
+    EXPECT_EQ(cache.run("yolo"), 3 * kMiB);
+
+    auto stats = cache.stats()["yolo"];
+    EXPECT_EQ(stats.uploads, 1u);
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.uploadedBytes, kCapacity);
+    EXPECT_EQ(stats.streamedBytes, 6 * kMiB);
+}
+
+TEST(EdgeTpuCacheTest, SeparateTokensEvictEachOther) {
+    EdgeTpuCache cache(kCapacity);
+    cache.addModel("detector", 2 * kMiB);
+    cache.addModel("classifier", 1 * kMiB);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(cache.run("detector"), 2 * kMiB);
+        EXPECT_EQ(cache.run("classifier"), 1 * kMiB);
+    }
+    auto stats = cache.stats();
+    EXPECT_EQ(stats["detector"].uploads, 3u);
+    EXPECT_EQ(stats["detector"].hits, 0u);
+    EXPECT_EQ(stats["classifier"].uploadedBytes, 3 * kMiB);
+}
+
+TEST(EdgeTpuCacheTest, SharedTokenKeepsTheSetResident) {
+    EdgeTpuCache cache(kCapacity);
+    cache.addModel("detector", 2 * kMiB);
+    cache.addModel("classifier", 1 * kMiB);
+    cache.addModel("pose", 4 * kMiB);
+    ASSERT_TRUE(cache.setModelSet({"detector", "classifier"}));
+
+    EXPECT_EQ(cache.run("detector"), 2 * kMiB);
+    EXPECT_EQ(cache.run("classifier"), 1 * kMiB);
+    EXPECT_EQ(cache.run("detector"), 0u);
+    EXPECT_EQ(cache.run("classifier"), 0u);
+
+    // A model outside the set discards all of it
+    EXPECT_EQ(cache.run("pose"), 4 * kMiB);
+    EXPECT_EQ(cache.run("classifier"), 1 * kMiB);
+    EXPECT_EQ(cache.run("detector"), 2 * kMiB);
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats["detector"].uploads, 2u);
+    EXPECT_EQ(stats["detector"].hits, 1u);
+    EXPECT_EQ(stats["classifier"].uploads, 2u);
+    EXPECT_EQ(stats["classifier"].hits, 1u);
+}
+
+TEST(EdgeTpuCacheTest, RejectedSetChangesNothing) {
+    EdgeTpuCache cache(kCapacity);
+    cache.addModel("detector", 5 * kMiB);
+    cache.addModel("pose", 4 * kMiB);
+    EXPECT_EQ(cache.run("detector"), 5 * kMiB);
+
+    EXPECT_FALSE(cache.setModelSet({"detector", "pose"}));
+    EXPECT_FALSE(cache.setModelSet({"detector", "missing"}));
+    // Still resident under its old token
+    EXPECT_EQ(cache.run("detector"), 0u);
+}
+
+TEST(EdgeTpuCacheTest, NewSetInvalidatesResidentParameters) {
+    EdgeTpuCache cache(kCapacity);
+    cache.addModel("detector", 2 * kMiB);
+    cache.addModel("classifier", 1 * kMiB);
+    EXPECT_EQ(cache.run("detector"), 2 * kMiB);
+    ASSERT_TRUE(cache.setModelSet({"detector", "classifier"}));
+    EXPECT_EQ(cache.run("detector"), 2 * kMiB);
+    EXPECT_EQ(cache.run("detector"), 0u);
+}
+
+TEST(EdgeTpuCacheTest, ReloadedModelStartsCold) {
+    EdgeTpuCache cache(kCapacity);
+    cache.addModel("detector", 2 * kMiB);
+    EXPECT_EQ(cache.run("detector"), 2 * kMiB);
+    cache.addModel("detector", 3 * kMiB);
+    EXPECT_EQ(cache.stats()["detector"].uploads, 0u);
+    EXPECT_EQ(cache.run("detector"), 3 * kMiB);
+
+    cache.removeModel("detector");
+    EXPECT_EQ(cache.run("detector"), 0u);
+    EXPECT_TRUE(cache.stats().empty());
+}
+
+TEST(EdgeTpuCacheTest, PlanSetsPutsHotModelsTogether) {
+    const std::map<std::string, size_t> bytes = {
+            {"a", 5 * kMiB}, {"b", 4 * kMiB}, {"c", 3 * kMiB}, {"d", 2 * kMiB}, {"e", 9 * kMiB}};
+    const std::map<std::string, uint64_t> runs = {{"b", 100}, {"c", 90}, {"a", 10}, {"e", 50}};
+    auto sets = EdgeTpuCache::planSets(bytes, runs, kCapacity);
+
+    // Most run first, first fit; e is too big and goes alone, d never ran
+    const std::vector<std::vector<std::string>> want = {{"b", "c"}, {"e"}, {"a", "d"}};
+    EXPECT_EQ(sets, want);
+
+    EdgeTpuCache cache(kCapacity);
+    for (const auto& pair : bytes) {
+        cache.addModel(pair.first, pair.second);
+    }
+    EXPECT_TRUE(cache.setModelSet(sets[0]));
+    EXPECT_TRUE(cache.setModelSet(sets[2]));
+    // Alone it still streams what does not fit, but takes no token
+    EXPECT_FALSE(cache.setModelSet(sets[1]));
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
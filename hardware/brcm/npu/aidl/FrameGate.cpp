@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Frame-difference gate for the Raspberry Pi 5 NPU HAL
+ */
+
+#include "FrameGate.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define GATE_USE_NEON 1
+#endif
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// Rows sampled per cell
+constexpr uint32_t kRowsPerCell = 4;
+
+namespace {
+
+// Scalar reference path, also used for the tail the vector loop leaves over
+uint32_t sumSpanScalar(const uint8_t* row, uint32_t first, uint32_t count,
+                       uint32_t pixelStride) {
+    uint32_t sum = 0;
+    for (uint32_t x = first; x < count; x++) {
+        sum += row[x * pixelStride];
+    }
+    return sum;
+}
+
+#ifdef GATE_USE_NEON
+// Sixteen pixels per step, keeping lane 0 of the de-interleaving loads.
+// 16-bit accumulators take 128 steps of 2 x 255 before they could overflow;
+// flush every 64.
+template <uint32_t kStride>
+uint32_t sumSpanNeon(const uint8_t* row, uint32_t count, uint32_t* done) {
+    uint32_t sum = 0;
+    uint32_t x = 0;
+    while (x + 16 <= count) {
+        uint16x8_t acc = vdupq_n_u16(0);
+        for (uint32_t step = 0; step < 64 && x + 16 <= count; step++, x += 16) {
+            const uint8_t* p = row + x * kStride;
+            uint8x16_t luma;
+            if constexpr (kStride == 1) {
+                luma = vld1q_u8(p);
+            } else if constexpr (kStride == 2) {
+                luma = vld2q_u8(p).val[0];
+            } else if constexpr (kStride == 3) {
+                luma = vld3q_u8(p).val[0];
+            } else {
+                luma = vld4q_u8(p).val[0];
+            }
+            acc = vpadalq_u8(acc, luma);
+        }
+        sum += vaddlvq_u16(acc);
+    }
+    *done = x;
+    return sum;
+}
+#endif
+
+uint32_t sumSpan(const uint8_t* row, uint32_t count, uint32_t pixelStride) {
+    uint32_t done = 0;
+    uint32_t sum = 0;
+#ifdef GATE_USE_NEON
+    switch (pixelStride) {
+        case 1: sum = sumSpanNeon<1>(row, count, &done); break;
+        case 2: sum = sumSpanNeon<2>(row, count, &done); break;
+        case 3: sum = sumSpanNeon<3>(row, count, &done); break;
+        case 4: sum = sumSpanNeon<4>(row, count, &done); break;
+        default: break;
+    }
+#endif
+    return sum + sumSpanScalar(row, done, count, pixelStride);
+}
+
+}  // namespace
+
+bool computeSignature(const uint8_t* frame, size_t size, const FrameGeometry& geometry,
+                      FrameSignature* signature) {
+    const uint32_t width = geometry.width;
+    const uint32_t height = geometry.height;
+    if (width < kSignatureGrid || height < kSignatureGrid || geometry.pixelStride == 0 ||
+        geometry.rowStride < static_cast<uint64_t>(width) * geometry.pixelStride ||
+        size < static_cast<uint64_t>(height - 1) * geometry.rowStride +
+                       static_cast<uint64_t>(width - 1) * geometry.pixelStride + 1) {
+        return false;
+    }
+
+    for (size_t cy = 0; cy < kSignatureGrid; cy++) {
+        const uint32_t y0 = cy * height / kSignatureGrid;
+        const uint32_t y1 = (cy + 1) * height / kSignatureGrid;
+        const uint32_t rows = std::min(kRowsPerCell, y1 - y0);
+        uint32_t sums[kSignatureGrid] = {};
+        for (uint32_t r = 0; r < rows; r++) {
+            const uint8_t* row = frame + static_cast<size_t>(y0 + r * (y1 - y0) / rows) *
+                                                 geometry.rowStride;
+            for (size_t cx = 0; cx < kSignatureGrid; cx++) {
+                const uint32_t x0 = cx * width / kSignatureGrid;
+                const uint32_t x1 = (cx + 1) * width / kSignatureGrid;
+                sums[cx] += sumSpan(row + static_cast<size_t>(x0) * geometry.pixelStride,
+                                    x1 - x0, geometry.pixelStride);
+            }
+        }
+        for (size_t cx = 0; cx < kSignatureGrid; cx++) {
+            const uint32_t cellWidth =
+                    (cx + 1) * width / kSignatureGrid - cx * width / kSignatureGrid;
+            (*signature)[cy * kSignatureGrid + cx] = sums[cx] / (cellWidth * rows);
+        }
+    }
+    return true;
+}
+
+float signatureDistance(const FrameSignature& a, const FrameSignature& b) {
+    uint32_t total = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        total += std::abs(a[i] - b[i]);
+    }
+    return static_cast<float>(total) / a.size();
+}
+
+bool FrameGate::check(const uint8_t* frame, size_t size, const FrameGeometry& geometry,
+                      int64_t nowNs, uint64_t id) {
+    mStats.frames++;
+    FrameSignature signature;
+    if (!computeSignature(frame, size, geometry, &signature)) {
+        return false;
+    }
+
+    // The frame in flight stands for the scene its result will describe;
+    // until that arrives the last completed result is the freshest there is
+    const int64_t staleNs = nowNs - mCompleted.ns;
+    if (mHaveCompleted && mStaleFrames < mConfig.maxStaleFrames &&
+        staleNs < mConfig.maxStaleNs &&
+        (signatureDistance(signature, mCompleted.signature) < mConfig.threshold ||
+         (mHaveLatest && signatureDistance(signature, mLatest.signature) < mConfig.threshold))) {
+        mStaleFrames++;
+        mStats.skipped++;
+        mStats.maxStaleFrames = std::max(mStats.maxStaleFrames, mStaleFrames);
+        mStats.maxStaleNs = std::max(mStats.maxStaleNs, staleNs);
+        return true;
+    }
+
+    mLatest = {signature, nowNs, ++mSequence};
+    mHaveLatest = true;
+    mInFlight[id] = mLatest;
+    mStaleFrames = 0;
+    return false;
+}
+
+bool FrameGate::complete(uint64_t id, bool success) {
+    auto it = mInFlight.find(id);
+    if (it == mInFlight.end()) {
+        return false;
+    }
+    const Reference reference = it->second;
+    mInFlight.erase(it);
+    if (!success) {
+        // Nothing will describe that scene; stop matching frames against it
+        if (mHaveLatest && reference.sequence == mLatest.sequence) {
+            mHaveLatest = false;
+        }
+        return false;
+    }
+    if (mHaveCompleted && reference.sequence < mCompleted.sequence) {
+        return false;
+    }
+    mCompleted = reference;
+    mHaveCompleted = true;
+    return true;
+}
+
+void FrameGate::reset() {
+    mInFlight.clear();
+    mHaveLatest = false;
+    mHaveCompleted = false;
+    mStaleFrames = 0;
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Frame-difference gate for the Raspberry Pi 5 NPU HAL
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// Layout of an 8-bit frame. Only the first byte of each pixel is sampled:
+// Y for grey, NV12/NV21 or YUYV, R for RGB; either tracks scene changes.
+struct FrameGeometry {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t rowStride = 0;     // bytes
+    uint32_t pixelStride = 1;   // bytes
+};
+
+// Cells per side of the downsampled frame
+constexpr size_t kSignatureGrid = 16;
+using FrameSignature = std::array<uint8_t, kSignatureGrid * kSignatureGrid>;
+
+// Block-averages the frame down to the signature grid. Each cell averages a
+// few evenly spaced rows, so the cost barely grows with resolution.
+bool computeSignature(const uint8_t* frame, size_t size, const FrameGeometry& geometry,
+                      FrameSignature* signature);
+
+// Mean absolute difference between two signatures, 0 to 255
+float signatureDistance(const FrameSignature& a, const FrameSignature& b);
+
+struct FrameGateStats {
+    uint64_t frames = 0;
+    uint64_t skipped = 0;
+    uint32_t maxStaleFrames = 0;    // longest run of reused results
+    int64_t maxStaleNs = 0;         // oldest result handed out again
+
+    float skipRatio() const { return frames ? static_cast<float>(skipped) / frames : 0.0f; }
+};
+
+// Decides per frame whether a completed inference is close enough for its
+// result to be reused. Frames that are run stay tracked by the caller's id
+// until complete() reports their result, so a stream faster than inference
+// keeps skipping: a frame matching the one in flight gets the last completed
+// result until that frame's own arrives. Not thread-safe; the owner holds
+// its lock.
+class FrameGate {
+public:
+    struct Config {
+        float threshold = 2.0f;         // signatureDistance below which frames match
+        uint32_t maxStaleFrames = 30;   // force a fresh inference after this many skips
+        int64_t maxStaleNs = 1000000000;
+    };
+
+    explicit FrameGate(const Config& config) : mConfig(config) {}
+
+    // True to reuse the last completed result. Otherwise the frame is to be
+    // run, and is tracked under |id| if it could be sampled. Ids are the
+    // caller's, unique while in flight.
+    bool check(const uint8_t* frame, size_t size, const FrameGeometry& geometry, int64_t nowNs,
+               uint64_t id);
+
+    // The inference of frame |id| finished. True if its result is now the
+    // one to reuse: it succeeded and no later frame's result beat it here.
+    bool complete(uint64_t id, bool success);
+
+    // Forget every reference and frame in flight
+    void reset();
+
+    size_t inFlight() const { return mInFlight.size(); }
+    const FrameGateStats& stats() const { return mStats; }
+
+private:
+    struct Reference {
+        FrameSignature signature;
+        int64_t ns = 0;             // when the frame was checked
+        uint64_t sequence = 0;      // order the frames were run in
+    };
+
+    const Config mConfig;
+    std::map<uint64_t, Reference> mInFlight;
+    Reference mLatest;              // most recently run frame
+    bool mHaveLatest = false;
+    Reference mCompleted;           // frame the reusable result belongs to
+    bool mHaveCompleted = false;
+    uint64_t mSequence = 0;
+    uint32_t mStaleFrames = 0;
+    FrameGateStats mStats;
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Frame signatures and the gate's reuse decisions, including frames that
+ * arrive faster than their inferences complete
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "FrameGate.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+namespace {
+
+constexpr int64_t kFrameNs = 33333333;
+const FrameGeometry kGeometry = {64, 48, 64, 1};
+
+std::vector<uint8_t> flatFrame(uint8_t level) {
+    return std::vector<uint8_t>(static_cast<size_t>(kGeometry.rowStride) * kGeometry.height,
+                                level);
+}
+
+class FrameGateTest : public ::testing::Test {
+protected:
+    bool check(const std::vector<uint8_t>& frame, uint64_t id) {
+        mNowNs += kFrameNs;
+        return mGate->check(frame.data(), frame.size(), kGeometry, mNowNs, id);
+    }
+
+    std::unique_ptr<FrameGate> mGate = std::make_unique<FrameGate>(FrameGate::Config{});
+    int64_t mNowNs = 0;
+};
+
+TEST(FrameSignatureTest, AveragesCells) {
+    FrameGeometry geometry = {32, 32, 64, 2};
+    std::vector<uint8_t> frame(geometry.rowStride * geometry.height, 0);
+    for (uint32_t y = 0; y < geometry.height; y++) {
+        for (uint32_t x = 0; x < geometry.width; x++) {
+            // Left half bright; the interleaved chroma bytes must be ignored
+            frame[y * geometry.rowStride + x * 2] = x < 16 ? 200 : 40;
+            frame[y * geometry.rowStride + x * 2 + 1] = 255;
+        }
+    }
+    FrameSignature signature;
+    ASSERT_TRUE(computeSignature(frame.data(), frame.size(), geometry, &signature));
+    EXPECT_EQ(signature[0], 200);
+    EXPECT_EQ(signature[kSignatureGrid - 1], 40);
+    EXPECT_EQ(signature[kSignatureGrid * kSignatureGrid - 1], 40);
+}
+
+TEST(FrameSignatureTest, RejectsShortAndTinyFrames) {
+    FrameSignature signature;
+    auto frame = flatFrame(0);
+    EXPECT_FALSE(computeSignature(frame.data(), frame.size() - 1, kGeometry, &signature));
+    FrameGeometry tiny = {8, 8, 8, 1};
+    EXPECT_FALSE(computeSignature(frame.data(), frame.size(), tiny, &signature));
+}
+
+TEST(FrameSignatureTest, Distance) {
+    FrameSignature a;
+    FrameSignature b;
+    a.fill(10);
+    b.fill(13);
+    EXPECT_FLOAT_EQ(signatureDistance(a, b), 3.0f);
+    EXPECT_FLOAT_EQ(signatureDistance(b, a), 3.0f);
+}
+
+TEST_F(FrameGateTest, ReusesOnlyAfterAResultCompletes) {
+    auto scene = flatFrame(100);
+    EXPECT_FALSE(check(scene, 1));
+    // Nothing completed yet, so there is nothing to hand out
+    EXPECT_FALSE(check(scene, 2));
+    EXPECT_TRUE(mGate->complete(1, true));
+    EXPECT_TRUE(check(scene, 3));
+    EXPECT_EQ(mGate->stats().skipped, 1u);
+}
+
+TEST_F(FrameGateTest, FramesFasterThanInferenceKeepSkipping) {
+    auto first = flatFrame(100);
+    auto second = flatFrame(150);
+    ASSERT_FALSE(check(first, 1));
+    ASSERT_TRUE(mGate->complete(1, true));
+
+    // The scene changes; its inference takes three frame intervals
+    EXPECT_FALSE(check(second, 2));
+    EXPECT_TRUE(check(second, 3));
+    EXPECT_TRUE(check(second, 4));
+    EXPECT_TRUE(check(second, 5));
+    EXPECT_EQ(mGate->inFlight(), 1u);
+
+    // Its result lands and takes over as the one to reuse
+    EXPECT_TRUE(mGate->complete(2, true));
+    EXPECT_TRUE(check(second, 6));
+    EXPECT_FALSE(check(first, 7));
+    EXPECT_EQ(mGate->stats().frames, 7u);
+    EXPECT_EQ(mGate->stats().skipped, 4u);
+}
+
+TEST_F(FrameGateTest, ResultOfAnOlderFrameStillCounts) {
+    auto a = flatFrame(50);
+    auto b = flatFrame(100);
+    auto c = flatFrame(150);
+    ASSERT_FALSE(check(a, 1));
+    ASSERT_FALSE(check(b, 2));
+    ASSERT_FALSE(check(c, 3));
+
+    // b was superseded by c while running, but is still newer than nothing
+    EXPECT_TRUE(mGate->complete(2, true));
+    EXPECT_TRUE(check(b, 4));
+    // c is newer again; a finishing last is older than both
+    EXPECT_TRUE(mGate->complete(3, true));
+    EXPECT_FALSE(mGate->complete(1, true));
+    EXPECT_TRUE(check(c, 5));
+    EXPECT_FALSE(check(a, 6));
+    EXPECT_FALSE(mGate->complete(42, true));
+}
+
+TEST_F(FrameGateTest, FailedInferenceIsNotReused) {
+    auto first = flatFrame(100);
+    auto second = flatFrame(150);
+    ASSERT_FALSE(check(first, 1));
+    ASSERT_TRUE(mGate->complete(1, true));
+    ASSERT_FALSE(check(second, 2));
+    EXPECT_FALSE(mGate->complete(2, false));
+    // The second scene has no result and no inference coming; run it again
+    EXPECT_FALSE(check(second, 3));
+    EXPECT_TRUE(check(first, 4));
+}
+
+TEST_F(FrameGateTest, StaleLimits) {
+    FrameGate::Config config;
+    config.maxStaleFrames = 2;
+    config.maxStaleNs = 10 * kFrameNs;
+    mGate = std::make_unique<FrameGate>(config);
+
+    auto scene = flatFrame(100);
+    ASSERT_FALSE(check(scene, 1));
+    ASSERT_TRUE(mGate->complete(1, true));
+    EXPECT_TRUE(check(scene, 2));
+    EXPECT_TRUE(check(scene, 3));
+    EXPECT_FALSE(check(scene, 4));
+    ASSERT_TRUE(mGate->complete(4, true));
+    EXPECT_EQ(mGate->stats().maxStaleFrames, 2u);
+
+    mNowNs += 10 * kFrameNs;
+    EXPECT_FALSE(check(scene, 5));
+}
+
+TEST_F(FrameGateTest, UnreadableFramesAlwaysRun) {
+    auto scene = flatFrame(100);
+    ASSERT_FALSE(check(scene, 1));
+    ASSERT_TRUE(mGate->complete(1, true));
+    mNowNs += kFrameNs;
+    EXPECT_FALSE(mGate->check(scene.data(), 10, kGeometry, mNowNs, 2));
+    EXPECT_EQ(mGate->inFlight(), 0u);
+    EXPECT_TRUE(check(scene, 3));
+}
+
+TEST_F(FrameGateTest, Reset) {
+    auto scene = flatFrame(100);
+    ASSERT_FALSE(check(scene, 1));
+    ASSERT_TRUE(mGate->complete(1, true));
+    ASSERT_FALSE(check(flatFrame(200), 2));
+    mGate->reset();
+    EXPECT_EQ(mGate->inFlight(), 0u);
+    EXPECT_FALSE(mGate->complete(2, true));
+    EXPECT_FALSE(check(scene, 3));
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Camera frame to model input conversion for the Raspberry Pi 5 NPU HAL
+ */
+
+#include "FramePreprocess.h"
+
+#include <algorithm>
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define PREPROCESS_USE_NEON 1
+#endif
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// BT.601 limited range in 6-bit fixed point. Only the blue sum can leave the
+// 16-bit range, and only when it saturates anyway, so the vector path keeps
+// every lane in int16 and both paths give the same bytes.
+constexpr int32_t kYScale = 75;     // 1.164
+constexpr int32_t kVToR = 102;      // 1.596
+constexpr int32_t kUToG = 25;       // 0.391
+constexpr int32_t kVToG = 52;       // 0.813
+constexpr int32_t kUToB = 129;      // 2.018
+
+namespace {
+
+uint8_t clampPixel(int32_t value) {
+    return static_cast<uint8_t>(std::clamp((value + 32) >> 6, 0, 255));
+}
+
+// Scalar reference path, also used for the tail the vector loop leaves over
+void yuvToRgbScalar(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t first,
+                    uint32_t count, uint8_t* out) {
+    for (uint32_t x = first; x < count; x++) {
+        int32_t c = kYScale * (y[x] - 16);
+        int32_t d = u[x] - 128;
+        int32_t e = v[x] - 128;
+        out[x * 3] = clampPixel(c + kVToR * e);
+        out[x * 3 + 1] = clampPixel(c - kUToG * d - kVToG * e);
+        out[x * 3 + 2] = clampPixel(c + kUToB * d);
+    }
+}
+
+void toFloatScalar(const uint8_t* in, uint32_t first, uint32_t count, float scale, float offset,
+                   float* out) {
+    for (uint32_t i = first; i < count; i++) {
+        out[i] = in[i] * scale + offset;
+    }
+}
+
+#ifdef PREPROCESS_USE_NEON
+uint8x8x3_t yuvToRgbHalf(uint8x8_t y, uint8x8_t u, uint8x8_t v) {
+    int16x8_t c = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(y)), vdupq_n_s16(16));
+    int16x8_t d = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u)), vdupq_n_s16(128));
+    int16x8_t e = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v)), vdupq_n_s16(128));
+    int16x8_t luma = vmulq_n_s16(c, kYScale);
+
+    uint8x8x3_t rgb;
+    rgb.val[0] = vqrshrun_n_s16(vmlaq_n_s16(luma, e, kVToR), 6);
+    rgb.val[1] = vqrshrun_n_s16(vmlsq_n_s16(vmlsq_n_s16(luma, d, kUToG), e, kVToG), 6);
+    rgb.val[2] = vqrshrun_n_s16(vqaddq_s16(luma, vmulq_n_s16(d, kUToB)), 6);
+    return rgb;
+}
+
+// Sixteen pixels per step, stored interleaved
+uint32_t yuvToRgbNeon(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t count,
+                      uint8_t* out) {
+    uint32_t x = 0;
+    for (; x + 16 <= count; x += 16) {
+        uint8x16_t ys = vld1q_u8(y + x);
+        uint8x16_t us = vld1q_u8(u + x);
+        uint8x16_t vs = vld1q_u8(v + x);
+        uint8x8x3_t low = yuvToRgbHalf(vget_low_u8(ys), vget_low_u8(us), vget_low_u8(vs));
+        uint8x8x3_t high = yuvToRgbHalf(vget_high_u8(ys), vget_high_u8(us), vget_high_u8(vs));
+
+        uint8x16x3_t rgb;
+        for (int i = 0; i < 3; i++) {
+            rgb.val[i] = vcombine_u8(low.val[i], high.val[i]);
+        }
+        vst3q_u8(out + x * 3, rgb);
+    }
+    return x;
+}
+
+uint32_t toFloatNeon(const uint8_t* in, uint32_t count, float scale, float offset, float* out) {
+    float32x4_t base = vdupq_n_f32(offset);
+    uint32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t bytes = vld1q_u8(in + i);
+        uint16x8_t low = vmovl_u8(vget_low_u8(bytes));
+        uint16x8_t high = vmovl_u8(vget_high_u8(bytes));
+        uint32x4_t words[4] = {
+            vmovl_u16(vget_low_u16(low)), vmovl_u16(vget_high_u16(low)),
+            vmovl_u16(vget_low_u16(high)), vmovl_u16(vget_high_u16(high)),
+        };
+        for (int j = 0; j < 4; j++) {
+            vst1q_f32(out + i + j * 4, vmlaq_n_f32(base, vcvtq_f32_u32(words[j]), scale));
+        }
+    }
+    return i;
+}
+#endif
+
+void yuvToRgb(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t count,
+              uint8_t* out) {
+    uint32_t done = 0;
+#ifdef PREPROCESS_USE_NEON
+    done = yuvToRgbNeon(y, u, v, count, out);
+#endif
+    yuvToRgbScalar(y, u, v, done, count, out);
+}
+
+void toFloat(const uint8_t* in, uint32_t count, float scale, float offset, float* out) {
+    uint32_t done = 0;
+#ifdef PREPROCESS_USE_NEON
+    done = toFloatNeon(in, count, scale, offset, out);
+#endif
+    toFloatScalar(in, done, count, scale, offset, out);
+}
+
+uint32_t bytesPerPixel(SourceLayout layout) {
+    return layout == SourceLayout::YUYV ? 2 : 1;
+}
+
+bool isSemiPlanar(SourceLayout layout) {
+    return layout == SourceLayout::NV12 || layout == SourceLayout::NV21;
+}
+
+}  // namespace
+
+bool FramePreprocessor::configure(const SourceFormat& source, const TensorFormat& tensor) {
+    mConfigured = false;
+    if (source.width == 0 || source.height == 0 || tensor.width == 0 || tensor.height == 0 ||
+        (tensor.channels != 1 && tensor.channels != 3) ||
+        source.rowStride < source.width * bytesPerPixel(source.layout)) {
+        return false;
+    }
+    mSource = source;
+    mTensor = tensor;
+
+    // Sample at the centre of each output pixel
+    auto sample = [](uint32_t i, uint32_t from, uint32_t to) {
+        return static_cast<uint32_t>((2 * static_cast<uint64_t>(i) + 1) * from / (2 * to));
+    };
+
+    mSourceRows.resize(tensor.height);
+    for (uint32_t y = 0; y < tensor.height; y++) {
+        mSourceRows[y] = sample(y, source.height, tensor.height);
+    }
+
+    mLumaOffsets.resize(tensor.width);
+    mChromaOffsets.resize(tensor.width);
+    for (uint32_t x = 0; x < tensor.width; x++) {
+        uint32_t sx = sample(x, source.width, tensor.width);
+        switch (source.layout) {
+            case SourceLayout::GREY:
+                mLumaOffsets[x] = sx;
+                mChromaOffsets[x] = 0;
+                break;
+            case SourceLayout::YUYV:
+                mLumaOffsets[x] = sx * 2;
+                mChromaOffsets[x] = (sx / 2) * 4 + 1;
+                break;
+            case SourceLayout::NV12:
+                mLumaOffsets[x] = sx;
+                mChromaOffsets[x] = sx & ~1u;
+                break;
+            case SourceLayout::NV21:
+                mLumaOffsets[x] = sx;
+                mChromaOffsets[x] = (sx & ~1u) + 1;
+                break;
+        }
+    }
+    switch (source.layout) {
+        case SourceLayout::YUYV: mVOffset = 2; break;
+        case SourceLayout::NV12: mVOffset = 1; break;
+        case SourceLayout::NV21: mVOffset = -1; break;
+        default: mVOffset = 0; break;
+    }
+
+    // Grey sources convert with neutral chroma, which leaves R = G = B
+    mY.assign(tensor.width, 0);
+    mU.assign(tensor.width, 128);
+    mV.assign(tensor.width, 128);
+    mPixels.resize(static_cast<size_t>(tensor.width) * tensor.channels);
+    mConfigured = true;
+    return true;
+}
+
+size_t FramePreprocessor::sourceSize() const {
+    size_t luma = static_cast<size_t>(mSource.rowStride) * mSource.height;
+    if (isSemiPlanar(mSource.layout)) {
+        return luma + static_cast<size_t>(mSource.rowStride) * ((mSource.height + 1) / 2);
+    }
+    return luma;
+}
+
+size_t FramePreprocessor::outputSize() const {
+    size_t elements = static_cast<size_t>(mTensor.width) * mTensor.height * mTensor.channels;
+    return elements * (mTensor.floatOutput ? sizeof(float) : 1);
+}
+
+void FramePreprocessor::gatherRow(const uint8_t* frame, uint32_t y) {
+    uint32_t sy = mSourceRows[y];
+    const uint8_t* row = frame + static_cast<size_t>(sy) * mSource.rowStride;
+    for (uint32_t x = 0; x < mTensor.width; x++) {
+        mY[x] = row[mLumaOffsets[x]];
+    }
+    if (mTensor.channels == 1 || mSource.layout == SourceLayout::GREY) {
+        return;
+    }
+
+    const uint8_t* chroma = row;
+    if (isSemiPlanar(mSource.layout)) {
+        chroma = frame + static_cast<size_t>(mSource.rowStride) * (mSource.height + sy / 2);
+    }
+    for (uint32_t x = 0; x < mTensor.width; x++) {
+        mU[x] = chroma[mChromaOffsets[x]];
+        mV[x] = chroma[mChromaOffsets[x] + mVOffset];
+    }
+}
+
+void FramePreprocessor::convertRow(uint8_t* out) {
+    if (mTensor.channels == 1) {
+        std::copy(mY.begin(), mY.end(), out);
+    } else {
+        yuvToRgb(mY.data(), mU.data(), mV.data(), mTensor.width, out);
+    }
+}
+
+bool FramePreprocessor::process(const uint8_t* frame, size_t size, uint8_t* output) {
+    if (!mConfigured || size < sourceSize()) {
+        return false;
+    }
+
+    uint32_t rowElements = mTensor.width * mTensor.channels;
+    for (uint32_t y = 0; y < mTensor.height; y++) {
+        gatherRow(frame, y);
+        if (!mTensor.floatOutput) {
+            convertRow(output + static_cast<size_t>(y) * rowElements);
+            continue;
+        }
+        convertRow(mPixels.data());
+        float* out = reinterpret_cast<float*>(output) + static_cast<size_t>(y) * rowElements;
+        toFloat(mPixels.data(), rowElements, mTensor.scale, mTensor.offset, out);
+    }
+    return true;
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
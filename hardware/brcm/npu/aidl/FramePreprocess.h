@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Camera frame to model input conversion for the Raspberry Pi 5 NPU HAL
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// Camera buffer layouts the preprocessor reads
+enum class SourceLayout {
+    GREY,
+    YUYV,
+    NV12,
+    NV21,
+};
+
+struct SourceFormat {
+    SourceLayout layout = SourceLayout::YUYV;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t rowStride = 0;     // bytes; the chroma plane of NV12/NV21 uses the same stride
+};
+
+// NHWC input of one image, batch 1
+struct TensorFormat {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t channels = 3;      // 1 for luma only, 3 for RGB
+    bool floatOutput = false;   // TENSOR_FLOAT32 input, written as pixel * scale + offset
+    float scale = 1.0f / 255.0f;
+    float offset = 0.0f;
+};
+
+// Scales a camera frame to a model input with nearest-neighbour sampling and
+// converts it to RGB (BT.601, limited range). Sample positions are worked out
+// once by configure(), so a frame costs one gather per output pixel plus the
+// vector colour conversion. Not thread-safe: process() reuses row buffers.
+class FramePreprocessor {
+public:
+    bool configure(const SourceFormat& source, const TensorFormat& tensor);
+
+    // Bytes a source frame must have, and bytes process() writes
+    size_t sourceSize() const;
+    size_t outputSize() const;
+    const TensorFormat& tensor() const { return mTensor; }
+
+    bool process(const uint8_t* frame, size_t size, uint8_t* output);
+
+private:
+    void gatherRow(const uint8_t* frame, uint32_t y);
+    void convertRow(uint8_t* out);
+
+    SourceFormat mSource;
+    TensorFormat mTensor;
+    bool mConfigured = false;
+
+    std::vector<uint32_t> mSourceRows;      // source row of each output row
+    std::vector<uint32_t> mLumaOffsets;     // byte offset of Y within a source row
+    std::vector<uint32_t> mChromaOffsets;   // byte offset of U within its row
+    int32_t mVOffset = 0;                   // V relative to U
+
+    std::vector<uint8_t> mY;
+    std::vector<uint8_t> mU;
+    std::vector<uint8_t> mV;
+    std::vector<uint8_t> mPixels;   // converted row ahead of the float stage
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
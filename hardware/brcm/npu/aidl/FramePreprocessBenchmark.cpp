@@ -0,0 +1,48 @@
+// Copyright (C) 2025 The Android Open Source Project
+
+// Per-frame cost of turning a camera buffer into a model input, which the
+// camera binding pays on its worker thread before the buffer goes back.
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+#include "FramePreprocess.h"
+
+using namespace aidl::android::hardware::neuralnetworks::rpi5;
+
+// args: source layout, source width, source height, tensor side, float output
+static void BM_Preprocess(benchmark::State& state) {
+    SourceFormat source;
+    source.layout = static_cast<SourceLayout>(state.range(0));
+    source.width = state.range(1);
+    source.height = state.range(2);
+    source.rowStride = source.width * (source.layout == SourceLayout::YUYV ? 2 : 1);
+
+    TensorFormat tensor;
+    tensor.width = state.range(3);
+    tensor.height = state.range(3);
+    tensor.floatOutput = state.range(4) != 0;
+
+    FramePreprocessor preprocessor;
+    if (!preprocessor.configure(source, tensor)) {
+        state.SkipWithError("configure failed");
+        return;
+    }
+
+    std::mt19937 rng(7);
+    std::vector<uint8_t> frame(preprocessor.sourceSize());
+    for (auto& byte : frame) {
+        byte = rng();
+    }
+    std::vector<uint8_t> output(preprocessor.outputSize());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(preprocessor.process(frame.data(), frame.size(), output.data()));
+    }
+}
+BENCHMARK(BM_Preprocess)
+        ->Args({static_cast<int>(SourceLayout::YUYV), 640, 480, 224, 0})
+        ->Args({static_cast<int>(SourceLayout::YUYV), 1280, 720, 300, 0})
+        ->Args({static_cast<int>(SourceLayout::NV12), 1920, 1080, 320, 0})
+        ->Args({static_cast<int>(SourceLayout::NV12), 1920, 1080, 224, 1});
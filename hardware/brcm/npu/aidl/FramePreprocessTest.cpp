@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Camera frame preprocessing against a per-pixel scalar reference
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "FramePreprocess.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+namespace {
+
+// Source sizes with padded strides, and model inputs that shrink, stretch
+// and leave tails past the 16-pixel vector loop
+struct Size {
+    uint32_t width;
+    uint32_t height;
+};
+const Size kSources[] = {{64, 48}, {38, 23}};
+const Size kTensors[] = {{32, 32}, {17, 13}, {80, 50}};
+constexpr uint32_t kStridePadding = 6;
+
+const SourceLayout kLayouts[] = {SourceLayout::GREY, SourceLayout::YUYV, SourceLayout::NV12,
+                                 SourceLayout::NV21};
+
+const char* layoutName(SourceLayout layout) {
+    switch (layout) {
+        case SourceLayout::GREY: return "GREY";
+        case SourceLayout::YUYV: return "YUYV";
+        case SourceLayout::NV12: return "NV12";
+        case SourceLayout::NV21: return "NV21";
+    }
+    return "?";
+}
+
+uint8_t clampPixel(int32_t value) {
+    return static_cast<uint8_t>(std::clamp((value + 32) >> 6, 0, 255));
+}
+
+// One output pixel from the definition: nearest source pixel to the centre
+// of the output pixel, its Y and the U and V of its 2x1 or 2x2 block, then
+// BT.601 limited range in 6-bit fixed point
+void referencePixel(const std::vector<uint8_t>& frame, const SourceFormat& source,
+                    const TensorFormat& tensor, uint32_t x, uint32_t y, uint8_t* out) {
+    const uint32_t sx = (2 * x + 1) * source.width / (2 * tensor.width);
+    const uint32_t sy = (2 * y + 1) * source.height / (2 * tensor.height);
+    const uint8_t* row = frame.data() + static_cast<size_t>(sy) * source.rowStride;
+    const uint8_t* chroma = frame.data() +
+            static_cast<size_t>(source.rowStride) * (source.height + sy / 2);
+    int32_t luma = 0;
+    int32_t u = 128;
+    int32_t v = 128;
+    switch (source.layout) {
+        case SourceLayout::GREY:
+            luma = row[sx];
+            break;
+        case SourceLayout::YUYV:
+            luma = row[sx * 2];
+            u = row[(sx / 2) * 4 + 1];
+            v = row[(sx / 2) * 4 + 3];
+            break;
+        case SourceLayout::NV12:
+            luma = row[sx];
+            u = chroma[sx & ~1u];
+            v = chroma[(sx & ~1u) + 1];
+            break;
+        case SourceLayout::NV21:
+            luma = row[sx];
+            v = chroma[sx & ~1u];
+            u = chroma[(sx & ~1u) + 1];
+            break;
+    }
+    if (tensor.channels == 1) {
+        out[0] = luma;
+        return;
+    }
+    const int32_t c = 75 * (luma - 16);
+    out[0] = clampPixel(c + 102 * (v - 128));
+    out[1] = clampPixel(c - 25 * (u - 128) - 52 * (v - 128));
+    out[2] = clampPixel(c + 129 * (u - 128));
+}
+
+class FramePreprocessTest : public ::testing::Test {
+protected:
+    std::vector<uint8_t> randomFrame(size_t size) {
+        std::uniform_int_distribution<int> byte(0, 255);
+        std::vector<uint8_t> frame(size);
+        for (auto& value : frame) {
+            value = byte(mRng);
+        }
+        return frame;
+    }
+
+    static SourceFormat sourceFormat(SourceLayout layout, const Size& size) {
+        SourceFormat source;
+        source.layout = layout;
+        source.width = size.width;
+        source.height = size.height;
+        source.rowStride = size.width * (layout == SourceLayout::YUYV ? 2 : 1) + kStridePadding;
+        return source;
+    }
+
+    std::mt19937 mRng{11};
+};
+
+TEST_F(FramePreprocessTest, MatchesReference) {
+    for (SourceLayout layout : kLayouts) {
+        for (const Size& from : kSources) {
+            for (const Size& to : kTensors) {
+                for (uint32_t channels : {1u, 3u}) {
+                    SCOPED_TRACE(::testing::Message()
+                                 << layoutName(layout) << " " << from.width << "x"
+                                 << from.height << " to " << to.width << "x" << to.height
+                                 << "x" << channels);
+                    const SourceFormat source = sourceFormat(layout, from);
+                    TensorFormat tensor;
+                    tensor.width = to.width;
+                    tensor.height = to.height;
+                    tensor.channels = channels;
+
+                    FramePreprocessor preprocessor;
+                    ASSERT_TRUE(preprocessor.configure(source, tensor));
+                    ASSERT_EQ(preprocessor.outputSize(),
+                              static_cast<size_t>(to.width) * to.height * channels);
+                    auto frame = randomFrame(preprocessor.sourceSize());
+                    std::vector<uint8_t> got(preprocessor.outputSize());
+                    ASSERT_TRUE(preprocessor.process(frame.data(), frame.size(), got.data()));
+
+                    uint8_t want[3];
+                    for (uint32_t y = 0; y < to.height; y++) {
+                        for (uint32_t x = 0; x < to.width; x++) {
+                            referencePixel(frame, source, tensor, x, y, want);
+                            const size_t at = (static_cast<size_t>(y) * to.width + x) * channels;
+                            for (uint32_t c = 0; c < channels; c++) {
+                                ASSERT_EQ(got[at + c], want[c])
+                                        << "at " << x << "," << y << " channel " << c;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// The float stage is pixel * scale + offset over the same bytes
+TEST_F(FramePreprocessTest, FloatOutputScalesBytes) {
+    const SourceFormat source = sourceFormat(SourceLayout::NV12, kSources[1]);
+    TensorFormat tensor;
+    tensor.width = kTensors[1].width;
+    tensor.height = kTensors[1].height;
+    FramePreprocessor bytes;
+    ASSERT_TRUE(bytes.configure(source, tensor));
+    tensor.floatOutput = true;
+    tensor.scale = 2.0f / 255;
+    tensor.offset = -1.0f;
+    FramePreprocessor floats;
+    ASSERT_TRUE(floats.configure(source, tensor));
+    ASSERT_EQ(floats.outputSize(), bytes.outputSize() * sizeof(float));
+
+    auto frame = randomFrame(bytes.sourceSize());
+    std::vector<uint8_t> want(bytes.outputSize());
+    std::vector<float> got(want.size());
+    ASSERT_TRUE(bytes.process(frame.data(), frame.size(), want.data()));
+    ASSERT_TRUE(floats.process(frame.data(), frame.size(),
+                               reinterpret_cast<uint8_t*>(got.data())));
+    for (size_t i = 0; i < want.size(); i++) {
+        ASSERT_FLOAT_EQ(got[i], want[i] * tensor.scale + tensor.offset) << "at " << i;
+    }
+}
+
+TEST_F(FramePreprocessTest, RejectsBadFormatsAndShortFrames) {
+    FramePreprocessor preprocessor;
+    SourceFormat source = sourceFormat(SourceLayout::YUYV, kSources[0]);
+    TensorFormat tensor;
+    tensor.width = 16;
+    tensor.height = 16;
+    std::vector<uint8_t> output(16 * 16 * 3);
+    EXPECT_FALSE(preprocessor.process(output.data(), output.size(), output.data()));
+
+    tensor.channels = 2;
+    EXPECT_FALSE(preprocessor.configure(source, tensor));
+    tensor.channels = 3;
+    source.rowStride = source.width;   // YUYV needs two bytes a pixel
+    EXPECT_FALSE(preprocessor.configure(source, tensor));
+    source.rowStride = source.width * 2;
+    ASSERT_TRUE(preprocessor.configure(source, tensor));
+
+    std::vector<uint8_t> frame(preprocessor.sourceSize() - 1);
+    EXPECT_FALSE(preprocessor.process(frame.data(), frame.size(), output.data()));
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Service order of the inference queue: classes, deadlines, expiry
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+
+#include "NpuScheduler.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+namespace {
+
+// Handles in the order the queue serves them at |nowNs|
+std::vector<InferenceHandle> drain(InferenceQueue* queue, int64_t nowNs,
+                                   std::vector<InferenceHandle>* expired = nullptr) {
+    std::vector<InferenceHandle> order;
+    std::vector<InferenceHandle> dropped;
+    InferenceHandle handle;
+    while (queue->pop(nowNs, &handle, &dropped)) {
+        order.push_back(handle);
+    }
+    if (expired != nullptr) {
+        *expired = dropped;
+    }
+    return order;
+}
+
+TEST(InferenceQueueTest, EarliestDeadlineFirst) {
+    InferenceQueue queue;
+    queue.push(1, InferencePriority::NORMAL, 300);
+    queue.push(2, InferencePriority::NORMAL, 100);
+    queue.push(3, InferencePriority::NORMAL, 200);
+    EXPECT_EQ(drain(&queue, 0), (std::vector<InferenceHandle>{2, 3, 1}));
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(InferenceQueueTest, EqualDeadlinesStayFifo) {
+    InferenceQueue queue;
+    queue.push(3, InferencePriority::NORMAL, 100);
+    queue.push(1, InferencePriority::NORMAL, 100);
+    queue.push(2, InferencePriority::NORMAL, 100);
+    EXPECT_EQ(drain(&queue, 0), (std::vector<InferenceHandle>{3, 1, 2}));
+}
+
+TEST(InferenceQueueTest, NoDeadlineRunsLastInFifoOrder) {
+    InferenceQueue queue;
+    queue.push(1, InferencePriority::NORMAL, kNoDeadline);
+    queue.push(2, InferencePriority::NORMAL, 1000);
+    queue.push(3, InferencePriority::NORMAL, kNoDeadline);
+    queue.push(4, InferencePriority::NORMAL, 500);
+    EXPECT_EQ(drain(&queue, 0), (std::vector<InferenceHandle>{4, 2, 1, 3}));
+}
+
+TEST(InferenceQueueTest, NoDeadlineNeverExpires) {
+    InferenceQueue queue;
+    queue.push(1, InferencePriority::LOW, kNoDeadline);
+    std::vector<InferenceHandle> expired;
+    EXPECT_EQ(drain(&queue, INT64_MAX, &expired), (std::vector<InferenceHandle>{1}));
+    EXPECT_TRUE(expired.empty());
+}
+
+TEST(InferenceQueueTest, HigherClassesFirstWhateverTheDeadline) {
+    InferenceQueue queue;
+    queue.push(1, InferencePriority::LOW, 100);
+    queue.push(2, InferencePriority::NORMAL, kNoDeadline);
+    queue.push(3, InferencePriority::HIGH, 900);
+    queue.push(4, InferencePriority::NORMAL, 200);
+    queue.push(5, InferencePriority::HIGH, 800);
+    EXPECT_EQ(drain(&queue, 0), (std::vector<InferenceHandle>{5, 3, 4, 2, 1}));
+}
+
+TEST(InferenceQueueTest, ExpiredRequestsAreDroppedNotRun) {
+    InferenceQueue queue;
+    queue.push(1, InferencePriority::HIGH, 100);
+    queue.push(2, InferencePriority::LOW, 50);
+    queue.push(3, InferencePriority::NORMAL, 300);
+    queue.push(4, InferencePriority::NORMAL, 200);
+
+    std::vector<InferenceHandle> expired;
+    EXPECT_EQ(drain(&queue, 200, &expired), (std::vector<InferenceHandle>{3}));
+    std::sort(expired.begin(), expired.end());
+    EXPECT_EQ(expired, (std::vector<InferenceHandle>{1, 2, 4}));
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(InferenceQueueTest, PopReportsExpiryWithNothingRunnable) {
+    InferenceQueue queue;
+    queue.push(1, InferencePriority::NORMAL, 10);
+    InferenceHandle handle = 0;
+    std::vector<InferenceHandle> expired;
+    EXPECT_FALSE(queue.pop(20, &handle, &expired));
+    EXPECT_EQ(expired, (std::vector<InferenceHandle>{1}));
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(InferenceQueueTest, Cancel) {
+    InferenceQueue queue;
+    queue.push(1, InferencePriority::NORMAL, 100);
+    queue.push(2, InferencePriority::HIGH, 200);
+    queue.push(3, InferencePriority::NORMAL, 300);
+    EXPECT_TRUE(queue.cancel(2));
+    EXPECT_FALSE(queue.cancel(2));
+    EXPECT_FALSE(queue.cancel(42));
+    EXPECT_EQ(queue.size(), 2u);
+    EXPECT_EQ(drain(&queue, 0), (std::vector<InferenceHandle>{1, 3}));
+    EXPECT_FALSE(queue.cancel(1));
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
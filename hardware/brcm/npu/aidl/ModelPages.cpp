@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Resident model memory for the Raspberry Pi 5 NPU HAL
+ */
+
+#include "ModelPages.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#define LOG_TAG "NpuHAL"
+#include <log/log.h>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+ModelPages::~ModelPages() {
+    for (const auto& region : mLocked) {
+        munlock(region.first, region.second);
+    }
+    for (const auto& mapping : mMappings) {
+        munmap(mapping.first, mapping.second);
+    }
+}
+
+bool ModelPages::mapFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ALOGE("Failed to open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    const size_t size = st.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        ALOGE("Failed to map %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    mMappings.emplace_back(data, size);
+    lock(data, size);
+    return true;
+}
+
+void ModelPages::lock(const void* data, size_t size) {
+    if (data == nullptr || size == 0) {
+        return;
+    }
+    mResidentBytes += size;
+    if (mlock(data, size) == 0) {
+        mLocked.emplace_back(data, size);
+        mLockedBytes += size;
+        return;
+    }
+
+    // Over the limit: fault the pages in anyway, one read per page
+    const size_t page = sysconf(_SC_PAGESIZE);
+    const volatile uint8_t* bytes = static_cast<const volatile uint8_t*>(data);
+    for (size_t offset = 0; offset < size; offset += page) {
+        (void)bytes[offset];
+    }
+    (void)bytes[size - 1];
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
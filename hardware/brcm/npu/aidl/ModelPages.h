@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Resident model memory for the Raspberry Pi 5 NPU HAL
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// Memory of one loaded model, faulted in up front and locked against
+// reclaim until the model is unloaded. Locking stops at RLIMIT_MEMLOCK; what
+// does not fit is still faulted in, just not locked.
+class ModelPages {
+public:
+    ModelPages() = default;
+    ~ModelPages();
+    ModelPages(const ModelPages&) = delete;
+    ModelPages& operator=(const ModelPages&) = delete;
+
+    // Maps |path| read-only with every page read in, so the runtime finds
+    // the model in the page cache. False if it cannot be mapped.
+    bool mapFile(const std::string& path);
+    // |data| must stay allocated until this is destroyed
+    void lock(const void* data, size_t size);
+
+    size_t residentBytes() const { return mResidentBytes; }
+    size_t lockedBytes() const { return mLockedBytes; }
+
+private:
+    std::vector<std::pair<void*, size_t>> mMappings;
+    std::vector<std::pair<const void*, size_t>> mLocked;
+    size_t mResidentBytes = 0;
+    size_t mLockedBytes = 0;
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Network group switching policy for Hailo NPUs in the Raspberry Pi 5 NPU HAL
+ */
+
+#include "NetworkGroupScheduler.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+void NetworkGroupScheduler::push(const std::string& group, InferenceHandle handle,
+                                 InferencePriority priority, int64_t deadlineNs,
+                                 int64_t nowNs) {
+    const size_t level = std::min<size_t>(static_cast<size_t>(priority),
+                                          kInferencePriorityCount - 1);
+    const uint64_t deadline = deadlineNs < 0 ? std::numeric_limits<uint64_t>::max()
+                                             : static_cast<uint64_t>(deadlineNs);
+    const Entry entry = {kInferencePriorityCount - 1 - level, deadline, mSequence++, handle,
+                         nowNs};
+    Group& queued = mGroups[group];
+    queued.arrivals.emplace(nowNs, entry.sequence);
+    mIndex[handle] = {group, queued.queue.insert(entry).first};
+}
+
+bool NetworkGroupScheduler::due(const Group& group, int64_t nowNs) const {
+    return !group.queue.empty() &&
+           (group.queue.size() >= mConfig.switchThreshold ||
+            nowNs - oldestNs(group) >= mConfig.quantumNs);
+}
+
+bool NetworkGroupScheduler::next(int64_t nowNs, NetworkGroupBatch* batch, int64_t* wakeNs) {
+    *wakeNs = kNoDeadline;
+    if (mIndex.empty()) {
+        return false;
+    }
+
+    // The group due the longest goes next when the active one gives way
+    auto candidate = mGroups.end();
+    for (auto it = mGroups.begin(); it != mGroups.end(); ++it) {
+        if (it->first == mActive || it->second.queue.empty()) {
+            continue;
+        }
+        if (mActive.empty() || due(it->second, nowNs)) {
+            if (candidate == mGroups.end() || oldestNs(it->second) < oldestNs(candidate->second)) {
+                candidate = it;
+            }
+        } else {
+            const int64_t dueNs = oldestNs(it->second) + mConfig.quantumNs;
+            *wakeNs = *wakeNs == kNoDeadline ? dueNs : std::min(*wakeNs, dueNs);
+        }
+    }
+
+    auto active = mGroups.find(mActive);
+    const bool activeReady = active != mGroups.end() && !active->second.queue.empty();
+    bool stay = activeReady;
+    if (activeReady && candidate != mGroups.end()) {
+        // A deep queue elsewhere cuts the quantum short
+        stay = nowNs - mActiveSinceNs < mConfig.quantumNs &&
+               candidate->second.queue.size() < mConfig.switchThreshold;
+    }
+    if (!stay && candidate == mGroups.end()) {
+        // Hold the device for the active group until a waiting one is due;
+        // switching for every lone request is what thrashes
+        return false;
+    }
+
+    if (mIdleSinceNs != kNoDeadline && active != mGroups.end()) {
+        active->second.stats.idleNs += nowNs - mIdleSinceNs;
+    }
+    mIdleSinceNs = kNoDeadline;
+
+    batch->switched = !stay;
+    if (!stay) {
+        activate(candidate->first, nowNs);
+        active = candidate;
+    }
+
+    Group& group = active->second;
+    const size_t count = std::min(group.queue.size(), std::max<size_t>(mConfig.maxBatch, 1));
+    batch->group = mActive;
+    batch->handles.clear();
+    for (size_t i = 0; i < count; i++) {
+        const Entry& entry = *group.queue.begin();
+        batch->handles.push_back(entry.handle);
+        group.stats.waitNs += nowNs - entry.enqueuedNs;
+        group.arrivals.erase({entry.enqueuedNs, entry.sequence});
+        mIndex.erase(entry.handle);
+        group.queue.erase(group.queue.begin());
+    }
+    group.stats.batches++;
+    group.stats.requests += count;
+    return true;
+}
+
+void NetworkGroupScheduler::activate(const std::string& name, int64_t nowNs) {
+    auto previous = mGroups.find(mActive);
+    if (previous != mGroups.end()) {
+        previous->second.stats.activeNs += nowNs - mActiveSinceNs;
+    }
+    mActive = name;
+    mActiveSinceNs = nowNs;
+    mGroups[name].stats.switches++;
+}
+
+void NetworkGroupScheduler::finished(int64_t nowNs) {
+    mIdleSinceNs = nowNs;
+}
+
+bool NetworkGroupScheduler::cancel(InferenceHandle handle) {
+    auto it = mIndex.find(handle);
+    if (it == mIndex.end()) {
+        return false;
+    }
+    Group& group = mGroups[it->second.group];
+    group.arrivals.erase({it->second.entry->enqueuedNs, it->second.entry->sequence});
+    group.queue.erase(it->second.entry);
+    mIndex.erase(it);
+    return true;
+}
+
+void NetworkGroupScheduler::removeGroup(const std::string& group) {
+    auto it = mGroups.find(group);
+    if (it == mGroups.end() || !it->second.queue.empty()) {
+        return;
+    }
+    if (group == mActive) {
+        // The device keeps it configured, but nothing is left to account
+        mActive.clear();
+        mIdleSinceNs = kNoDeadline;
+    }
+    mGroups.erase(it);
+}
+
+std::map<std::string, NetworkGroupStats> NetworkGroupScheduler::stats(int64_t nowNs) const {
+    std::map<std::string, NetworkGroupStats> stats;
+    for (const auto& pair : mGroups) {
+        NetworkGroupStats& group = stats[pair.first];
+        group = pair.second.stats;
+        if (pair.first == mActive) {
+            group.activeNs += nowNs - mActiveSinceNs;
+            if (mIdleSinceNs != kNoDeadline) {
+                group.idleNs += nowNs - mIdleSinceNs;
+            }
+        }
+    }
+    return stats;
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Network group switching policy for Hailo NPUs in the Raspberry Pi 5 NPU HAL
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "NpuScheduler.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+struct NetworkGroupStats {
+    uint64_t switches = 0;      // times the group was activated
+    uint64_t batches = 0;
+    uint64_t requests = 0;
+    int64_t activeNs = 0;       // time the group held the device
+    int64_t idleNs = 0;         // part of activeNs with nothing running
+    int64_t waitNs = 0;         // queueing time of its requests, summed
+};
+
+// Requests picked to run together on one network group
+struct NetworkGroupBatch {
+    std::string group;
+    std::vector<InferenceHandle> handles;
+    bool switched = false;      // the group has to be activated first
+};
+
+// Every HEF loaded on a Hailo device stays configured, but only one network
+// group is active at a time and switching reloads the device's contexts,
+// which costs more than a small inference. Requests are queued per group and
+// the active group keeps the device until its quantum runs out or another
+// group's queue reaches the threshold, and then only if that group has work.
+// Within a group, batches are taken in InferenceQueue order: higher priority
+// classes first, then earliest deadline. Not thread-safe; the owner holds
+// its lock.
+class NetworkGroupScheduler {
+public:
+    struct Config {
+        // Longest the active group keeps the device while others wait, and
+        // longest a request waits before its group may take the device over
+        int64_t quantumNs = 20000000;
+        // Queued requests that let a group take the device before that
+        size_t switchThreshold = 8;
+        size_t maxBatch = 8;
+    };
+
+    NetworkGroupScheduler() = default;
+    explicit NetworkGroupScheduler(const Config& config) : mConfig(config) {}
+
+    // Applies from the next batch
+    void setConfig(const Config& config) { mConfig = config; }
+    const Config& config() const { return mConfig; }
+
+    void push(const std::string& group, InferenceHandle handle, InferencePriority priority,
+              int64_t deadlineNs, int64_t nowNs);
+
+    // Next batch to run at |nowNs|. False if nothing should run yet; then
+    // |wakeNs| is when a waiting group becomes due, or kNoDeadline if
+    // nothing is queued. Call finished() once a batch is done.
+    bool next(int64_t nowNs, NetworkGroupBatch* batch, int64_t* wakeNs);
+    void finished(int64_t nowNs);
+
+    // False if |handle| is not queued
+    bool cancel(InferenceHandle handle);
+
+    // Forgets a group with nothing queued, e.g. once its model is unloaded
+    void removeGroup(const std::string& group);
+
+    std::map<std::string, NetworkGroupStats> stats(int64_t nowNs) const;
+    const std::string& active() const { return mActive; }
+    size_t size() const { return mIndex.size(); }
+    bool empty() const { return mIndex.empty(); }
+
+private:
+    struct Entry {
+        size_t rank;            // 0 for the highest priority class
+        uint64_t deadline;      // kNoDeadline sorts last
+        uint64_t sequence;      // FIFO among equals
+        InferenceHandle handle;
+        int64_t enqueuedNs;
+
+        bool operator<(const Entry& other) const {
+            if (rank != other.rank) {
+                return rank < other.rank;
+            }
+            return deadline != other.deadline ? deadline < other.deadline
+                                              : sequence < other.sequence;
+        }
+    };
+
+    struct Group {
+        std::set<Entry> queue;      // service order
+        // Enqueue time and sequence of every queued request, oldest first,
+        // since waiting time and not service order decides when a group is due
+        std::set<std::pair<int64_t, uint64_t>> arrivals;
+        NetworkGroupStats stats;
+    };
+
+    struct Location {
+        std::string group;
+        std::set<Entry>::iterator entry;
+    };
+
+    // Queued long or deep enough to take the device from the active group
+    bool due(const Group& group, int64_t nowNs) const;
+    static int64_t oldestNs(const Group& group) { return group.arrivals.begin()->first; }
+    void activate(const std::string& name, int64_t nowNs);
+
+    Config mConfig;
+    std::map<std::string, Group> mGroups;
+    std::unordered_map<InferenceHandle, Location> mIndex;
+    std::string mActive;            // empty until the first batch
+    int64_t mActiveSinceNs = 0;
+    int64_t mIdleSinceNs = kNoDeadline;     // last batch finished, none since
+    uint64_t mSequence = 0;
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,72 @@
+// Copyright (C) 2025 The Android Open Source Project
+
+// One simulated second of three camera models sharing a Hailo-8: each sends
+// a frame every 5 ms, an inference takes 1 ms plus 0.25 ms per extra frame
+// in the batch, and switching network groups costs 8 ms. Reports simulated
+// throughput and switches; the first case switches for every request.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <string>
+
+#include "NetworkGroupScheduler.h"
+
+using namespace aidl::android::hardware::neuralnetworks::rpi5;
+
+static constexpr int64_t kMs = 1000000;
+static constexpr int64_t kPeriodNs = 5 * kMs;
+static constexpr int64_t kInferenceNs = 1 * kMs;
+static constexpr int64_t kBatchStepNs = kMs / 4;
+static constexpr int64_t kSwitchNs = 8 * kMs;
+static constexpr int64_t kSimulatedNs = 1000 * kMs;
+static const std::string kModels[] = {"detector", "classifier", "pose"};
+
+// args: quantum in ms, switch threshold, largest batch
+static void BM_ThreeModels(benchmark::State& state) {
+    NetworkGroupScheduler::Config config;
+    config.quantumNs = state.range(0) * kMs;
+    config.switchThreshold = state.range(1);
+    config.maxBatch = state.range(2);
+
+    uint64_t completed = 0;
+    uint64_t switches = 0;
+    for (auto _ : state) {
+        NetworkGroupScheduler scheduler(config);
+        InferenceHandle next = 1;
+        int64_t arrivalNs = 0;
+        int64_t nowNs = 0;
+        completed = 0;
+        switches = 0;
+        NetworkGroupBatch batch;
+        while (nowNs < kSimulatedNs) {
+            // Models are staggered across the frame period
+            for (; arrivalNs <= nowNs; arrivalNs += kPeriodNs / 3) {
+                scheduler.push(kModels[next % 3], next, InferencePriority::NORMAL, kNoDeadline,
+                               arrivalNs);
+                next++;
+            }
+            int64_t wakeNs;
+            if (!scheduler.next(nowNs, &batch, &wakeNs)) {
+                nowNs = wakeNs == kNoDeadline ? arrivalNs : std::min(arrivalNs, wakeNs);
+                continue;
+            }
+            if (batch.switched) {
+                nowNs += kSwitchNs;
+                switches++;
+            }
+            nowNs += kInferenceNs + (batch.handles.size() - 1) * kBatchStepNs;
+            completed += batch.handles.size();
+            scheduler.finished(nowNs);
+        }
+        benchmark::DoNotOptimize(completed);
+    }
+    state.counters["simulated fps"] = completed;
+    state.counters["switches/s"] = switches;
+}
+BENCHMARK(BM_ThreeModels)
+        ->Args({0, 1, 1})
+        ->Args({0, 1, 8})
+        ->Args({10, 8, 8})
+        ->Args({20, 8, 8})
+        ->Args({40, 16, 16});
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Network group switching: quantum, switch threshold and order within a group
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "NetworkGroupScheduler.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+namespace {
+
+constexpr int64_t kMs = 1000000;
+
+NetworkGroupScheduler::Config oneAtATime() {
+    NetworkGroupScheduler::Config config;
+    config.quantumNs = 20 * kMs;
+    config.switchThreshold = 8;
+    config.maxBatch = 1;
+    return config;
+}
+
+class NetworkGroupSchedulerTest : public ::testing::Test {
+protected:
+    void push(const std::string& group, InferenceHandle handle, int64_t nowNs,
+              InferencePriority priority = InferencePriority::NORMAL,
+              int64_t deadlineNs = kNoDeadline) {
+        mScheduler.push(group, handle, priority, deadlineNs, nowNs);
+    }
+
+    // Runs the next batch at |nowNs|, which must be from |group|
+    void expectBatch(int64_t nowNs, const std::string& group, bool switched,
+                     const std::vector<InferenceHandle>& handles) {
+        NetworkGroupBatch batch;
+        int64_t wakeNs;
+        ASSERT_TRUE(mScheduler.next(nowNs, &batch, &wakeNs)) << "at " << nowNs;
+        EXPECT_EQ(batch.group, group);
+        EXPECT_EQ(batch.switched, switched);
+        EXPECT_EQ(batch.handles, handles);
+        mScheduler.finished(nowNs);
+    }
+
+    void expectIdle(int64_t nowNs, int64_t wantWakeNs) {
+        NetworkGroupBatch batch;
+        int64_t wakeNs;
+        EXPECT_FALSE(mScheduler.next(nowNs, &batch, &wakeNs)) << "at " << nowNs;
+        EXPECT_EQ(wakeNs, wantWakeNs);
+    }
+
+    NetworkGroupScheduler mScheduler{oneAtATime()};
+};
+
+TEST_F(NetworkGroupSchedulerTest, BatchesFollowPriorityThenDeadline) {
+    mScheduler.setConfig(NetworkGroupScheduler::Config());
+    push("detector", 1, 0, InferencePriority::LOW);
+    push("detector", 2, 0, InferencePriority::NORMAL, 500);
+    push("detector", 3, 0, InferencePriority::NORMAL, 300);
+    push("detector", 4, 0, InferencePriority::HIGH);
+    push("detector", 5, 0, InferencePriority::NORMAL, 300);
+    push("detector", 6, 0, InferencePriority::NORMAL);
+    expectBatch(0, "detector", true, {4, 3, 5, 2, 6, 1});
+    EXPECT_TRUE(mScheduler.empty());
+}
+
+TEST_F(NetworkGroupSchedulerTest, LaterUrgentRequestOvertakesQueuedOnes) {
+    push("detector", 1, 0);
+    push("detector", 2, 1 * kMs);
+    push("detector", 3, 2 * kMs, InferencePriority::NORMAL, 10 * kMs);
+    push("detector", 4, 3 * kMs, InferencePriority::HIGH);
+    expectBatch(3 * kMs, "detector", true, {4});
+    expectBatch(4 * kMs, "detector", false, {3});
+    expectBatch(5 * kMs, "detector", false, {1});
+    expectBatch(6 * kMs, "detector", false, {2});
+}
+
+TEST_F(NetworkGroupSchedulerTest, ActiveGroupKeepsTheDeviceWithinItsQuantum) {
+    push("detector", 1, 0);
+    expectBatch(0, "detector", true, {1});
+
+    push("detector", 2, 1 * kMs);
+    push("classifier", 3, 1 * kMs);
+    expectBatch(1 * kMs, "detector", false, {2});
+
+    // Nothing left for the active group, but a lone request elsewhere only
+    // takes the device once it has waited a quantum
+    expectIdle(2 * kMs, 21 * kMs);
+    expectBatch(21 * kMs, "classifier", true, {3});
+}
+
+TEST_F(NetworkGroupSchedulerTest, QuantumExpiryHandsTheDeviceOver) {
+    for (InferenceHandle handle = 1; handle <= 5; handle++) {
+        push("detector", handle, 0);
+    }
+    push("pose", 10, 0);
+    expectBatch(0, "detector", true, {1});
+    expectBatch(5 * kMs, "detector", false, {2});
+    expectBatch(19 * kMs, "detector", false, {3});
+    expectBatch(20 * kMs, "pose", true, {10});
+    // The detector has waited past its quantum by now, so it comes back
+    expectBatch(21 * kMs, "detector", true, {4});
+}
+
+TEST_F(NetworkGroupSchedulerTest, DeepQueueCutsTheQuantumShort) {
+    NetworkGroupScheduler::Config config = oneAtATime();
+    config.switchThreshold = 3;
+    mScheduler.setConfig(config);
+    push("detector", 1, 0);
+    push("detector", 2, 0);
+    expectBatch(0, "detector", true, {1});
+
+    push("pose", 10, 1 * kMs);
+    push("pose", 11, 1 * kMs);
+    expectBatch(1 * kMs, "detector", false, {2});
+    push("detector", 3, 2 * kMs);
+    push("pose", 12, 2 * kMs);
+    expectBatch(2 * kMs, "pose", true, {10});
+}
+
+TEST_F(NetworkGroupSchedulerTest, CancelledRequestNoLongerCountsAsWaiting) {
+    push("detector", 1, 0);
+    expectBatch(0, "detector", true, {1});
+
+    push("pose", 10, 0);
+    push("pose", 11, 10 * kMs);
+    EXPECT_TRUE(mScheduler.cancel(10));
+    EXPECT_FALSE(mScheduler.cancel(10));
+    EXPECT_FALSE(mScheduler.cancel(42));
+    EXPECT_EQ(mScheduler.size(), 1u);
+
+    // Due a quantum after the oldest request still queued
+    expectIdle(10 * kMs, 30 * kMs);
+    expectBatch(30 * kMs, "pose", true, {11});
+    expectIdle(31 * kMs, kNoDeadline);
+}
+
+TEST_F(NetworkGroupSchedulerTest, StatsAndRemoveGroup) {
+    push("detector", 1, 0);
+    push("pose", 2, 0);
+    expectBatch(0, "detector", true, {1});
+    expectBatch(20 * kMs, "pose", true, {2});
+
+    auto stats = mScheduler.stats(30 * kMs);
+    EXPECT_EQ(stats["detector"].switches, 1u);
+    EXPECT_EQ(stats["detector"].activeNs, 20 * kMs);
+    EXPECT_EQ(stats["pose"].switches, 1u);
+    EXPECT_EQ(stats["pose"].requests, 1u);
+    EXPECT_EQ(stats["pose"].waitNs, 20 * kMs);
+    EXPECT_EQ(stats["pose"].activeNs, 10 * kMs);
+    EXPECT_EQ(stats["pose"].idleNs, 10 * kMs);
+
+    // Only a group with nothing queued can go
+    push("detector", 3, 30 * kMs);
+    mScheduler.removeGroup("detector");
+    EXPECT_EQ(mScheduler.stats(30 * kMs).count("detector"), 1u);
+    EXPECT_TRUE(mScheduler.cancel(3));
+    mScheduler.removeGroup("detector");
+    mScheduler.removeGroup("pose");
+    EXPECT_TRUE(mScheduler.stats(30 * kMs).empty());
+    EXPECT_EQ(mScheduler.active(), "");
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
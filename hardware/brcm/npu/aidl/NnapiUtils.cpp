@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * NNAPI model and memory helpers for the Raspberry Pi 5 NPU driver
+ */
+
+#include "NnapiUtils.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+
+#include <android-base/chrono_utils.h>
+
+#include <log/log.h>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+std::shared_ptr<MappedMemory> MappedMemory::map(const Memory& memory) {
+    int fd;
+    int prot;
+    int64_t offset;
+    int64_t size;
+    switch (memory.getTag()) {
+        case Memory::ashmem: {
+            const auto& ashmem = memory.get<Memory::ashmem>();
+            fd = ashmem.fd.get();
+            prot = PROT_READ | PROT_WRITE;
+            offset = 0;
+            size = ashmem.size;
+            break;
+        }
+        case Memory::mappableFile: {
+            const auto& file = memory.get<Memory::mappableFile>();
+            fd = file.fd.get();
+            prot = file.prot;
+            offset = file.offset;
+            size = file.length;
+            break;
+        }
+        default:
+            ALOGE("Unsupported memory pool type %d", static_cast<int>(memory.getTag()));
+            return nullptr;
+    }
+    if (fd < 0 || offset < 0 || size <= 0) {
+        return nullptr;
+    }
+
+    // mmap wants a page-aligned offset; keep the remainder as a data offset
+    const int64_t pageSize = sysconf(_SC_PAGESIZE);
+    const int64_t slack = offset % pageSize;
+    const size_t mapSize = size + slack;
+    void* base = mmap(nullptr, mapSize, prot, MAP_SHARED, fd, offset - slack);
+    if (base == MAP_FAILED) {
+        ALOGE("Failed to map %" PRId64 " byte pool: %s", size, strerror(errno));
+        return nullptr;
+    }
+    return std::shared_ptr<MappedMemory>(
+            new MappedMemory(base, mapSize, static_cast<uint8_t*>(base) + slack, size));
+}
+
+MappedMemory::~MappedMemory() {
+    munmap(mBase, mMapSize);
+}
+
+uint8_t* MappedMemory::at(const DataLocation& location) const {
+    if (location.offset < 0 || location.length < 0 ||
+        static_cast<uint64_t>(location.offset) + location.length > mSize) {
+        return nullptr;
+    }
+    return mData + location.offset;
+}
+
+ndk::ScopedAStatus toAStatus(ErrorStatus status, const std::string& message) {
+    ALOGE("%s", message.c_str());
+    return ndk::ScopedAStatus::fromServiceSpecificErrorWithMessage(
+            static_cast<int32_t>(status), message.c_str());
+}
+
+bool deadlinePassed(int64_t deadlineNs) {
+    if (deadlineNs < 0) {
+        return false;
+    }
+    auto now = ::android::base::boot_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count() >= deadlineNs;
+}
+
+static bool convertOperand(const Operand& operand, const Model& model, MappedPools* modelPools,
+                           NpuOperand* out, std::string* error) {
+    if (operand.type == OperandType::SUBGRAPH) {
+        *error = "control flow is not supported";
+        return false;
+    }
+    out->type = static_cast<NpuOperandType>(operand.type);
+    out->scale = operand.scale;
+    out->zeroPoint = operand.zeroPoint;
+    for (int32_t dim : operand.dimensions) {
+        if (dim < 0) {
+            *error = "negative operand dimension";
+            return false;
+        }
+        out->dimensions.push_back(dim);
+    }
+    if (operand.extraParams &&
+        operand.extraParams->getTag() == OperandExtraParams::channelQuant) {
+        const auto& quant = operand.extraParams->get<OperandExtraParams::channelQuant>();
+        out->channelScales = quant.scales;
+        out->channelDim = quant.channelDim;
+    }
+
+    const DataLocation& location = operand.location;
+    switch (operand.lifetime) {
+        case OperandLifeTime::TEMPORARY_VARIABLE:
+            out->lifetime = NpuOperandLifetime::TEMPORARY;
+            return true;
+        case OperandLifeTime::SUBGRAPH_INPUT:
+            out->lifetime = NpuOperandLifetime::INPUT;
+            return true;
+        case OperandLifeTime::SUBGRAPH_OUTPUT:
+            out->lifetime = NpuOperandLifetime::OUTPUT;
+            return true;
+        case OperandLifeTime::NO_VALUE:
+            out->lifetime = NpuOperandLifetime::NO_VALUE;
+            return true;
+        case OperandLifeTime::CONSTANT_COPY: {
+            if (location.offset < 0 || location.length < 0 ||
+                static_cast<uint64_t>(location.offset) + location.length >
+                        model.operandValues.size()) {
+                *error = "constant outside of the operand values";
+                return false;
+            }
+            auto begin = model.operandValues.begin() + location.offset;
+            out->lifetime = NpuOperandLifetime::CONSTANT;
+            out->value.assign(begin, begin + location.length);
+            return true;
+        }
+        case OperandLifeTime::CONSTANT_POOL: {
+            if (location.poolIndex < 0 ||
+                static_cast<size_t>(location.poolIndex) >= model.pools.size()) {
+                *error = "constant in a missing pool";
+                return false;
+            }
+            auto& pool = (*modelPools)[location.poolIndex];
+            if (pool == nullptr) {
+                pool = MappedMemory::map(model.pools[location.poolIndex]);
+            }
+            const uint8_t* data = pool ? pool->at(location) : nullptr;
+            if (data == nullptr) {
+                *error = "constant outside of its pool";
+                return false;
+            }
+            out->lifetime = NpuOperandLifetime::CONSTANT;
+            out->value.assign(data, data + location.length);
+            return true;
+        }
+        default:
+            *error = "unsupported operand lifetime";
+            return false;
+    }
+}
+
+static bool convertIndexes(const std::vector<int32_t>& indexes, size_t count,
+                           std::vector<uint32_t>* out) {
+    for (int32_t index : indexes) {
+        if (index < 0 || static_cast<size_t>(index) >= count) {
+            return false;
+        }
+        out->push_back(index);
+    }
+    return true;
+}
+
+bool convertModel(const Model& model, NpuGraph* graph, std::string* error) {
+    if (!model.referenced.empty()) {
+        *error = "control flow is not supported";
+        return false;
+    }
+    if (!model.extensionNameToPrefix.empty()) {
+        *error = "extensions are not supported";
+        return false;
+    }
+
+    const Subgraph& main = model.main;
+    // Pools are mapped on first use and dropped once the constants are copied
+    MappedPools modelPools(model.pools.size());
+    graph->operands.resize(main.operands.size());
+    for (size_t i = 0; i < main.operands.size(); i++) {
+        if (!convertOperand(main.operands[i], model, &modelPools, &graph->operands[i], error)) {
+            *error = "operand " + std::to_string(i) + ": " + *error;
+            return false;
+        }
+    }
+
+    const size_t operandCount = main.operands.size();
+    for (const Operation& operation : main.operations) {
+        NpuOperation op;
+        op.type = static_cast<int32_t>(operation.type);
+        if (!convertIndexes(operation.inputs, operandCount, &op.inputs) ||
+            !convertIndexes(operation.outputs, operandCount, &op.outputs)) {
+            *error = "operation refers to a missing operand";
+            return false;
+        }
+        graph->operations.push_back(std::move(op));
+    }
+    if (!convertIndexes(main.inputIndexes, operandCount, &graph->inputIndexes) ||
+        !convertIndexes(main.outputIndexes, operandCount, &graph->outputIndexes)) {
+        *error = "model input or output refers to a missing operand";
+        return false;
+    }
+    graph->relaxFloat32toFloat16 = model.relaxComputationFloat32toFloat16;
+    return true;
+}
+
+ndk::ScopedAStatus mapRequestPools(const Request& request, MappedPools* pools) {
+    pools->clear();
+    pools->reserve(request.pools.size());
+    for (const auto& pool : request.pools) {
+        if (pool.getTag() != RequestMemoryPool::pool) {
+            return toAStatus(ErrorStatus::INVALID_ARGUMENT, "device buffers are not supported");
+        }
+        auto memory = MappedMemory::map(pool.get<RequestMemoryPool::pool>());
+        if (memory == nullptr) {
+            return toAStatus(ErrorStatus::GENERAL_FAILURE, "failed to map a request pool");
+        }
+        pools->push_back(std::move(memory));
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
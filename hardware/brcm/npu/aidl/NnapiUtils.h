@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * NNAPI model and memory helpers for the Raspberry Pi 5 NPU driver
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/neuralnetworks/BnDevice.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "NpuGraph.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// Timing value reported when measurement was not requested
+constexpr int64_t kNoTiming = -1;
+
+// Read-write mapping of one ashmem or mappable-file pool
+class MappedMemory {
+public:
+    // nullptr if the memory cannot be mapped
+    static std::shared_ptr<MappedMemory> map(const Memory& memory);
+    ~MappedMemory();
+
+    // nullptr unless |location| lies inside the mapping
+    uint8_t* at(const DataLocation& location) const;
+    size_t size() const { return mSize; }
+
+private:
+    MappedMemory(void* base, size_t mapSize, uint8_t* data, size_t size)
+        : mBase(base), mMapSize(mapSize), mData(data), mSize(size) {}
+
+    void* mBase;
+    size_t mMapSize;
+    uint8_t* mData;     // mBase moved up to the pool offset
+    size_t mSize;
+};
+
+using MappedPools = std::vector<std::shared_ptr<MappedMemory>>;
+
+// Service-specific error carrying an ErrorStatus, as the runtime expects
+ndk::ScopedAStatus toAStatus(ErrorStatus status, const std::string& message);
+
+// True once a deadline (boot clock, -1 for none) has passed
+bool deadlinePassed(int64_t deadlineNs);
+
+// Converts the main subgraph. Constants are copied, so the model pools can be
+// released as soon as preparation returns.
+bool convertModel(const Model& model, NpuGraph* graph, std::string* error);
+
+// Pools of a request; token pools refer to device buffers, which are not
+// supported
+ndk::ScopedAStatus mapRequestPools(const Request& request, MappedPools* pools);
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -13,37 +13,34 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <atomic>
 #include <cstring>
-#include <fstream>
+#include <cinttypes>
+#include <ctime>
+#include <future>
 #include <sstream>
 #include <thread>
 #include <chrono>
 #include <regex>
 
+#include <Sysfs.h>
+
+#include "CpuGemm.h"
+
 #define LOG_TAG "NpuHAL"
+#define ATRACE_TAG ATRACE_TAG_NNAPI
 #include <log/log.h>
+#include <utils/Trace.h>
 
 namespace aidl::android::hardware::neuralnetworks::rpi5 {
 
-// Helper to read sysfs file
-static std::string readSysfs(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        return "";
-    }
-    std::string content;
-    std::getline(file, content);
-    return content;
-}
+namespace sysfs = ::android::hardware::brcm::sysfs;
 
-// Helper to write sysfs file
-static bool writeSysfs(const std::string& path, const std::string& value) {
-    std::ofstream file(path);
-    if (!file.is_open()) {
-        return false;
-    }
-    file << value;
-    return file.good();
+// Empty if the attribute is missing
+static std::string readSysfs(const std::string& path) {
+    std::string value;
+    sysfs::readString(path, &value);
+    return value;
 }
 
 // PCIe Manager Implementation
@@ -100,23 +97,14 @@ std::vector<PcieDeviceInfo> PcieManager::enumerateDevices() {
         }
         
         // Read vendor and device IDs
-        std::string vendorStr = readSysfs(basePath + "/vendor");
-        std::string deviceStr = readSysfs(basePath + "/device");
-        
-        if (vendorStr.empty() || deviceStr.empty()) continue;
-        
-        info.vendorId = std::stoul(vendorStr, nullptr, 16);
-        info.deviceId = std::stoul(deviceStr, nullptr, 16);
+        if (!sysfs::readInt(basePath + "/vendor", &info.vendorId, 16) ||
+            !sysfs::readInt(basePath + "/device", &info.deviceId, 16)) {
+            continue;
+        }
         
         // Read subsystem IDs
-        std::string subVendorStr = readSysfs(basePath + "/subsystem_vendor");
-        std::string subDeviceStr = readSysfs(basePath + "/subsystem_device");
-        if (!subVendorStr.empty()) {
-            info.subsystemVendorId = std::stoul(subVendorStr, nullptr, 16);
-        }
-        if (!subDeviceStr.empty()) {
-            info.subsystemDeviceId = std::stoul(subDeviceStr, nullptr, 16);
-        }
+        sysfs::readInt(basePath + "/subsystem_vendor", &info.subsystemVendorId, 16);
+        sysfs::readInt(basePath + "/subsystem_device", &info.subsystemDeviceId, 16);
         
         // Try to identify device
         auto key = std::make_pair(info.vendorId, info.deviceId);
@@ -128,9 +116,8 @@ std::vector<PcieDeviceInfo> PcieManager::enumerateDevices() {
         }
         
         // Determine device type
-        std::string classStr = readSysfs(basePath + "/class");
-        if (!classStr.empty()) {
-            uint32_t classCode = std::stoul(classStr, nullptr, 16);
+        uint32_t classCode;
+        if (sysfs::readInt(basePath + "/class", &classCode, 16)) {
             uint8_t baseClass = (classCode >> 16) & 0xFF;
             
             switch (baseClass) {
@@ -175,7 +162,6 @@ std::vector<PcieDeviceInfo> PcieManager::enumerateDevices() {
         
         // Read link info
         std::string linkSpeed = readSysfs(basePath + "/current_link_speed");
-        std::string linkWidth = readSysfs(basePath + "/current_link_width");
         
         if (!linkSpeed.empty()) {
             // Parse "8.0 GT/s PCIe" format
@@ -184,9 +170,7 @@ std::vector<PcieDeviceInfo> PcieManager::enumerateDevices() {
                 info.linkSpeed = static_cast<uint32_t>(speed);
             }
         }
-        if (!linkWidth.empty()) {
-            info.linkWidth = std::stoul(linkWidth);
-        }
+        sysfs::readInt(basePath + "/current_link_width", &info.linkWidth);
         
         // Determine manufacturer from vendor ID
         switch (info.vendorId) {
@@ -223,12 +207,12 @@ PcieDeviceInfo PcieManager::getDeviceInfo(uint8_t bus, uint8_t device, uint8_t f
 
 bool PcieManager::resetDevice(const PcieDeviceInfo& device) {
     std::string resetPath = device.sysfsPath + "/reset";
-    return writeSysfs(resetPath, "1");
+    return sysfs::writeString(resetPath, "1");
 }
 
 bool PcieManager::setPowerState(const PcieDeviceInfo& device, int state) {
     std::string powerPath = device.sysfsPath + "/power/control";
-    return writeSysfs(powerPath, state == 0 ? "on" : "auto");
+    return sysfs::writeString(powerPath, state == 0 ? "on" : "auto");
 }
 
 int PcieManager::getPowerState(const PcieDeviceInfo& device) {
@@ -266,12 +250,17 @@ bool NpuManager::initialize() {
 }
 
 void NpuManager::shutdown() {
+    stopWorkers();
+    
     // Close all open NPUs
     for (auto& pair : mNpus) {
         closeNpu(pair.first);
     }
     mNpus.clear();
-    mLoadedModels.clear();
+    {
+        std::lock_guard<std::mutex> lock(mModelLock);
+        mLoadedModels.clear();
+    }
     mInitialized = false;
     ALOGI("NPU Manager shutdown complete");
 }
@@ -346,8 +335,25 @@ bool NpuManager::detectNpus() {
     
     // Also check for USB NPUs (Coral USB, Intel NCS2)
     detectUsbNpus();
+    const bool found = !mNpus.empty();
     
-    return !mNpus.empty();
+    // The cores run whatever no accelerator is there for
+    NpuDeviceInfo cpuInfo;
+    cpuInfo.name = "Raspberry Pi 5 CPU";
+    cpuInfo.manufacturer = "Arm";
+    cpuInfo.type = NpuType::CPU_FALLBACK;
+    cpuInfo.capabilities = kNpuCapabilities.at(NpuType::CPU_FALLBACK);
+    cpuInfo.temperatureCelsius = 0.0f;
+    cpuInfo.powerWatts = 0.0f;
+    cpuInfo.utilizationPercent = 0.0f;
+    mNpus[kCpuNpuId] = cpuInfo;
+    if (!mCpuPool) {
+        mCpuPool = std::make_unique<CpuThreadPool>();
+    }
+    ALOGI("CPU backend on %zu threads (dot product %s, fp16 %s)", mCpuPool->threads(),
+          gemmHasDotProduct() ? "yes" : "no", gemmHasHalfPrecision() ? "yes" : "no");
+    
+    return found;
 }
 
 void NpuManager::detectUsbNpus() {
@@ -361,13 +367,12 @@ void NpuManager::detectUsbNpus() {
         if (name[0] == '.') continue;
         
         std::string basePath = "/sys/bus/usb/devices/" + name;
-        std::string vendorStr = readSysfs(basePath + "/idVendor");
-        std::string productStr = readSysfs(basePath + "/idProduct");
-        
-        if (vendorStr.empty() || productStr.empty()) continue;
-        
-        uint16_t vendor = std::stoul(vendorStr, nullptr, 16);
-        uint16_t product = std::stoul(productStr, nullptr, 16);
+        uint16_t vendor;
+        uint16_t product;
+        if (!sysfs::readInt(basePath + "/idVendor", &vendor, 16) ||
+            !sysfs::readInt(basePath + "/idProduct", &product, 16)) {
+            continue;
+        }
         
         // Google Coral USB (18d1:9302)
         if (vendor == 0x18D1 && product == 0x9302) {
@@ -419,6 +424,24 @@ NpuDeviceInfo NpuManager::getNpuInfo(const std::string& npuId) {
     return NpuDeviceInfo();
 }
 
+std::string NpuManager::getPrimaryNpu() {
+    std::string primary;
+    float bestTops = -1.0f;
+    for (const auto& pair : mNpus) {
+        if (pair.second.type == NpuType::CPU_FALLBACK) {
+            continue;
+        }
+        if (pair.second.capabilities.topsInt8 > bestTops) {
+            bestTops = pair.second.capabilities.topsInt8;
+            primary = pair.first;
+        }
+    }
+    if (primary.empty() && mNpus.count(kCpuNpuId) != 0) {
+        return kCpuNpuId;
+    }
+    return primary;
+}
+
 bool NpuManager::openNpu(const std::string& npuId) {
     auto it = mNpus.find(npuId);
     if (it == mNpus.end()) {
@@ -430,6 +453,8 @@ bool NpuManager::openNpu(const std::string& npuId) {
     switch (it->second.type) {
         case NpuType::CORAL_TPU_PCIE:
         case NpuType::CORAL_TPU_USB:
+        case NpuType::CORAL_TPU_MINI_PCIE:
+        case NpuType::CORAL_TPU_DUAL_EDGE:
             return initCoralTpu(npuId);
             
         case NpuType::HAILO_8:
@@ -443,6 +468,9 @@ bool NpuManager::openNpu(const std::string& npuId) {
         case NpuType::INTEL_MYRIAD_X:
             return initMyriad(npuId);
             
+        case NpuType::CPU_FALLBACK:
+            return true;
+            
         default:
             ALOGI("Generic NPU initialization for %s", npuId.c_str());
             return true;
@@ -451,11 +479,26 @@ bool NpuManager::openNpu(const std::string& npuId) {
 
 bool NpuManager::closeNpu(const std::string& npuId) {
     // Unload all models
+    std::lock_guard<std::mutex> lock(mModelLock);
     auto modelIt = mLoadedModels.find(npuId);
     if (modelIt != mLoadedModels.end()) {
+        for (const auto& model : modelIt->second) {
+            mModelPages.erase(model.first);
+            mCpuModels.erase(model.first);
+        }
         modelIt->second.clear();
     }
     
+    auto cacheIt = mCoralCaches.find(npuId);
+    if (cacheIt != mCoralCaches.end()) {
+        for (const auto& model : cacheIt->second->stats()) {
+            ALOGI("NPU %s model %s: %" PRIu64 " parameter cache hits, %" PRIu64 " re-uploads "
+                  "(%" PRIu64 " KB)", npuId.c_str(), model.first.c_str(), model.second.hits,
+                  model.second.uploads, model.second.uploadedBytes / 1024);
+        }
+        mCoralCaches.erase(cacheIt);
+    }
+    
     ALOGI("Closed NPU %s", npuId.c_str());
     return true;
 }
@@ -508,15 +551,115 @@ std::string NpuManager::loadModel(const std::string& npuId, const std::string& m
     std::string modelId = "model_" + std::to_string(
         std::hash<std::string>{}(modelPath) & 0xFFFF);
     
-    mLoadedModels[npuId][modelId] = model;
+    WarmupConfig warmup;
+    {
+        std::lock_guard<std::mutex> lock(mModelLock);
+        mLoadedModels[npuId][modelId] = model;
+        EdgeTpuCache* coralCache = getCoralCache(npuId);
+        if (coralCache != nullptr) {
+            coralCache->addModel(modelId, model.sizeBytes);
+        }
+        warmup = mWarmupConfigs[npuId];
+    }
     
     ALOGI("Loaded model %s on NPU %s (format: %s, size: %zu bytes)",
           model.name.c_str(), npuId.c_str(), model.format.c_str(), model.sizeBytes);
     
+    warmUpModel(npuId, modelId, warmup);
+    return modelId;
+}
+
+std::string NpuManager::loadModel(const std::string& npuId, const std::string& name,
+                                  std::shared_ptr<const NpuGraph> graph,
+                                  const std::vector<uint8_t>* packedWeights) {
+    auto npuIt = mNpus.find(npuId);
+    if (npuIt == mNpus.end()) {
+        ALOGE("NPU %s not found", npuId.c_str());
+        return "";
+    }
+    
+    // Shapes are planned and weights packed here, not on the first request
+    std::shared_ptr<CpuModel> cpuModel;
+    if (npuIt->second.type == NpuType::CPU_FALLBACK) {
+        std::string error;
+        cpuModel = CpuModel::create(graph, &error, packedWeights);
+        if (cpuModel == nullptr) {
+            ALOGE("CPU backend cannot run %s: %s", name.c_str(), error.c_str());
+            return "";
+        }
+    }
+    
+    ModelInfo model;
+    model.name = name;
+    model.format = "NNAPI";
+    model.sizeBytes = 0;
+    for (const auto& operand : graph->operands) {
+        model.sizeBytes += operand.value.size();
+    }
+    
+    auto shapeOf = [&graph](uint32_t index) {
+        const auto& dims = graph->operands[index].dimensions;
+        return std::vector<int>(dims.begin(), dims.end());
+    };
+    for (size_t i = 0; i < graph->inputIndexes.size(); i++) {
+        model.inputs.emplace_back("input" + std::to_string(i), shapeOf(graph->inputIndexes[i]));
+    }
+    for (size_t i = 0; i < graph->outputIndexes.size(); i++) {
+        model.outputs.emplace_back("output" + std::to_string(i),
+                                   shapeOf(graph->outputIndexes[i]));
+    }
+    model.graph = std::move(graph);
+    
+    std::string modelId;
+    WarmupConfig warmup;
+    {
+        std::lock_guard<std::mutex> lock(mModelLock);
+        modelId = "nnapi_" + std::to_string(mNextGraphId++);
+        mLoadedModels[npuId][modelId] = model;
+        EdgeTpuCache* coralCache = getCoralCache(npuId);
+        if (coralCache != nullptr) {
+            coralCache->addModel(modelId, model.sizeBytes);
+        }
+        if (cpuModel != nullptr) {
+            mCpuModels[modelId] = std::move(cpuModel);
+        }
+        warmup = mWarmupConfigs[npuId];
+    }
+    
+    ALOGI("Loaded model %s on NPU %s (%zu operations, %zu bytes of constants)",
+          name.c_str(), npuId.c_str(), model.graph->operations.size(), model.sizeBytes);
+    
+    warmUpModel(npuId, modelId, warmup);
     return modelId;
 }
 
+bool NpuManager::getPackedWeights(const std::string& modelId, std::vector<uint8_t>* data) {
+    data->clear();
+    std::shared_ptr<CpuModel> cpuModel;
+    {
+        std::lock_guard<std::mutex> lock(mModelLock);
+        auto it = mCpuModels.find(modelId);
+        if (it == mCpuModels.end()) {
+            return false;
+        }
+        cpuModel = it->second;
+    }
+    cpuModel->packedWeights(data);
+    return true;
+}
+
 bool NpuManager::unloadModel(const std::string& npuId, const std::string& modelId) {
+    clearFrameGate(npuId, modelId);
+    {
+        std::lock_guard<std::mutex> lock(mWorkerLock);
+        auto workerIt = mWorkers.find(npuId);
+        if (workerIt != mWorkers.end() && workerIt->second->groups != nullptr) {
+            std::lock_guard<std::mutex> groupLock(workerIt->second->lock);
+            workerIt->second->groups->removeGroup(modelId);
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(mModelLock);
     auto npuIt = mLoadedModels.find(npuId);
     if (npuIt == mLoadedModels.end()) {
         return false;
@@ -528,23 +671,34 @@ bool NpuManager::unloadModel(const std::string& npuId, const std::string& modelI
     }
     
     npuIt->second.erase(modelIt);
+    mModelPages.erase(modelId);
+    mCpuModels.erase(modelId);
+    auto cacheIt = mCoralCaches.find(npuId);
+    if (cacheIt != mCoralCaches.end()) {
+        cacheIt->second->removeModel(modelId);
+    }
     ALOGI("Unloaded model %s from NPU %s", modelId.c_str(), npuId.c_str());
     return true;
 }
 
 ModelInfo NpuManager::getModelInfo(const std::string& npuId, const std::string& modelId) {
+    std::lock_guard<std::mutex> lock(mModelLock);
+    ModelInfo* info = findLoadedModel(npuId, modelId);
+    return info != nullptr ? *info : ModelInfo();
+}
+
+ModelInfo* NpuManager::findLoadedModel(const std::string& npuId, const std::string& modelId) {
     auto npuIt = mLoadedModels.find(npuId);
-    if (npuIt != mLoadedModels.end()) {
-        auto modelIt = npuIt->second.find(modelId);
-        if (modelIt != npuIt->second.end()) {
-            return modelIt->second;
-        }
+    if (npuIt == mLoadedModels.end()) {
+        return nullptr;
     }
-    return ModelInfo();
+    auto modelIt = npuIt->second.find(modelId);
+    return modelIt != npuIt->second.end() ? &modelIt->second : nullptr;
 }
 
 std::vector<std::string> NpuManager::getLoadedModels(const std::string& npuId) {
     std::vector<std::string> models;
+    std::lock_guard<std::mutex> lock(mModelLock);
     auto npuIt = mLoadedModels.find(npuId);
     if (npuIt != mLoadedModels.end()) {
         for (const auto& pair : npuIt->second) {
@@ -554,59 +708,701 @@ std::vector<std::string> NpuManager::getLoadedModels(const std::string& npuId) {
     return models;
 }
 
+std::string NpuManager::getModelNpu(const std::string& modelId) {
+    std::lock_guard<std::mutex> lock(mModelLock);
+    for (const auto& [npuId, models] : mLoadedModels) {
+        if (models.count(modelId) != 0) {
+            return npuId;
+        }
+    }
+    return "";
+}
+
+void NpuManager::setWarmupConfig(const std::string& npuId, const WarmupConfig& config) {
+    std::lock_guard<std::mutex> lock(mModelLock);
+    mWarmupConfigs[npuId] = config;
+}
+
+void NpuManager::warmUpModel(const std::string& npuId, const std::string& modelId,
+                             const WarmupConfig& config) {
+    if (config.inferences == 0 && !config.lockPages) {
+        return;
+    }
+    ATRACE_CALL();
+    
+    // Kept alive past the lock; faulting in megabytes must not stall
+    // requests for other models
+    std::string path;
+    std::shared_ptr<const NpuGraph> graph;
+    std::shared_ptr<CpuModel> cpuModel;
+    {
+        std::lock_guard<std::mutex> lock(mModelLock);
+        ModelInfo* info = findLoadedModel(npuId, modelId);
+        if (info == nullptr) {
+            return;
+        }
+        info->warmupInferences = config.inferences;
+        path = info->path;
+        graph = info->graph;
+        auto cpuIt = mCpuModels.find(modelId);
+        if (cpuIt != mCpuModels.end()) {
+            cpuModel = cpuIt->second;
+        }
+    }
+    
+    if (config.lockPages) {
+        auto pages = std::make_unique<ModelPages>();
+        if (!path.empty()) {
+            pages->mapFile(path);
+        }
+        if (graph != nullptr) {
+            for (const auto& operand : graph->operands) {
+                if (operand.lifetime == NpuOperandLifetime::CONSTANT) {
+                    pages->lock(operand.value.data(), operand.value.size());
+                }
+            }
+        }
+        if (cpuModel != nullptr) {
+            for (const auto& region : cpuModel->memoryRegions()) {
+                pages->lock(region.first, region.second);
+            }
+        }
+        if (pages->lockedBytes() < pages->residentBytes()) {
+            ALOGW("Model %s: locked %zu of %zu KB, the rest may be reclaimed", modelId.c_str(),
+                  pages->lockedBytes() / 1024, pages->residentBytes() / 1024);
+        }
+        
+        // Unloaded meanwhile: the pages are released here instead
+        std::lock_guard<std::mutex> lock(mModelLock);
+        ModelInfo* info = findLoadedModel(npuId, modelId);
+        if (info == nullptr) {
+            return;
+        }
+        info->lockedBytes = pages->lockedBytes();
+        mModelPages[modelId] = std::move(pages);
+    }
+    
+    // Zeroed inputs of the model's own sizes; file models take none yet
+    InferenceRequest request;
+    request.modelId = modelId;
+    request.measureTiming = false;
+    if (graph != nullptr) {
+        for (size_t i = 0; i < graph->inputIndexes.size(); i++) {
+            const NpuOperand& operand = graph->operands[graph->inputIndexes[i]];
+            request.inputs.emplace_back(
+                    "input" + std::to_string(i),
+                    std::vector<uint8_t>(npuOperandSize(operand.type, operand.dimensions)));
+        }
+    }
+    for (uint32_t i = 0; i < config.inferences; i++) {
+        InferenceResult result = runInference(npuId, request);
+        if (!result.success) {
+            ALOGW("Warm-up of model %s failed: %s", modelId.c_str(), result.error.c_str());
+            break;
+        }
+    }
+}
+
+void NpuManager::recordInference(const std::string& npuId, const std::string& modelId,
+                                 float timeMs) {
+    std::lock_guard<std::mutex> lock(mModelLock);
+    auto npuIt = mLoadedModels.find(npuId);
+    if (npuIt == mLoadedModels.end()) {
+        return;
+    }
+    auto modelIt = npuIt->second.find(modelId);
+    if (modelIt == npuIt->second.end()) {
+        return;
+    }
+    
+    ModelInfo& info = modelIt->second;
+    if (++info.inferences == 1) {
+        info.coldInferenceMs = timeMs;
+    }
+    if (info.inferences == info.warmupInferences + 1) {
+        info.firstInferenceMs = timeMs;
+        ALOGI("Model %s on NPU %s: first inference %.2f ms, %.2f ms cold "
+              "(%u warm-up runs, %zu KB locked)", modelId.c_str(), npuId.c_str(), timeMs,
+              info.coldInferenceMs, info.warmupInferences, info.lockedBytes / 1024);
+    }
+}
+
+// Same clock as NNAPI deadlines
+static int64_t bootTimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+static bool isCoral(NpuType type) {
+    return type == NpuType::CORAL_TPU_USB || type == NpuType::CORAL_TPU_PCIE ||
+           type == NpuType::CORAL_TPU_MINI_PCIE || type == NpuType::CORAL_TPU_DUAL_EDGE;
+}
+
+static bool isHailo(NpuType type) {
+    return type == NpuType::HAILO_8 || type == NpuType::HAILO_8L ||
+           type == NpuType::HAILO_15H || type == NpuType::HAILO_15M ||
+           type == NpuType::HAILO_15L;
+}
+
+static InferenceResult failedResult(const std::string& error) {
+    InferenceResult result = {};
+    result.success = false;
+    result.error = error;
+    return result;
+}
+
+// Requests queued or running in a worker, as seen by the trace
+static std::atomic<int32_t> sInflight{0};
+
+// The worker whose loop runs on this thread, if any
+static thread_local const void* tWorker = nullptr;
+
 InferenceResult NpuManager::runInference(const std::string& npuId,
                                          const InferenceRequest& request) {
-    InferenceResult result;
-    result.success = false;
+    // From a callback on the NPU's own worker, queueing would wait on itself
+    if (tWorker != nullptr && tWorker == getWorker(npuId)) {
+        if (request.deadlineNs >= 0 && bootTimeNs() > request.deadlineNs) {
+            InferenceResult result = failedResult("Deadline expired before execution");
+            result.expired = true;
+            return result;
+        }
+        return executeInference(npuId, request);
+    }
+    
+    std::promise<InferenceResult> done;
+    auto future = done.get_future();
+    if (runInferenceAsync(npuId, request, [&done](const InferenceResult& result) {
+            done.set_value(result);
+        }) == 0) {
+        return failedResult("NPU not found");
+    }
+    return future.get();
+}
+
+InferenceHandle NpuManager::runInferenceAsync(const std::string& npuId,
+                                              const InferenceRequest& request,
+                                              InferenceCallback callback) {
+    NpuWorker* worker = getWorker(npuId);
+    if (worker == nullptr) {
+        return 0;
+    }
+    
+    // Reused results never take a queue slot; the handle is simply done
+    InferenceHandle handle;
+    {
+        std::lock_guard<std::mutex> lock(mWorkerLock);
+        handle = mNextHandle++;
+    }
+    if (applyFrameGate(npuId, request, handle, &callback)) {
+        return handle;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(worker->lock);
+        worker->queue.push(handle, request.priority, request.deadlineNs);
+        worker->pending[handle] = {request, std::move(callback)};
+    }
+    ATRACE_INT("npu inflight", ++sInflight);
+    worker->cv.notify_one();
+    return handle;
+}
+
+bool NpuManager::cancelInference(const std::string& npuId, InferenceHandle handle) {
+    NpuWorker* worker = getWorker(npuId);
+    if (worker == nullptr) {
+        return false;
+    }
+    
+    PendingInference cancelled;
+    {
+        std::lock_guard<std::mutex> lock(worker->lock);
+        if (!worker->queue.cancel(handle) &&
+            (worker->groups == nullptr || !worker->groups->cancel(handle))) {
+            return false;
+        }
+        auto it = worker->pending.find(handle);
+        cancelled = std::move(it->second);
+        worker->pending.erase(it);
+        worker->stats.cancelled++;
+    }
+    
+    ATRACE_INT("npu inflight", --sInflight);
+    if (cancelled.callback) {
+        cancelled.callback(failedResult("Cancelled"));
+    }
+    return true;
+}
+
+SchedulerStats NpuManager::getSchedulerStats(const std::string& npuId) {
+    NpuWorker* worker = getWorker(npuId);
+    if (worker == nullptr) {
+        return SchedulerStats();
+    }
+    std::lock_guard<std::mutex> lock(worker->lock);
+    return worker->stats;
+}
+
+bool NpuManager::setFrameGate(const std::string& npuId, const std::string& modelId,
+                              const FrameGateConfig& config) {
+    FrameGateConfig resolved = config;
+    if (resolved.geometry.width == 0) {
+        ModelInfo model = getModelInfo(npuId, modelId);
+        if (model.inputs.empty() || model.inputs[0].second.size() != 4) {
+            ALOGE("Frame gate for %s needs a geometry: first input is not NHWC",
+                  modelId.c_str());
+            return false;
+        }
+        const auto& dims = model.inputs[0].second;
+        resolved.geometry.height = dims[1];
+        resolved.geometry.width = dims[2];
+        resolved.geometry.pixelStride = dims[3];
+        resolved.geometry.rowStride = dims[2] * dims[3];
+    }
+    
+    std::lock_guard<std::mutex> lock(mGateLock);
+    mGates[{npuId, modelId}] = std::make_unique<GateState>(resolved);
+    ALOGI("Frame gate on %s/%s: %ux%u, threshold %.1f", npuId.c_str(), modelId.c_str(),
+          resolved.geometry.width, resolved.geometry.height, resolved.gate.threshold);
+    return true;
+}
+
+void NpuManager::clearFrameGate(const std::string& npuId, const std::string& modelId) {
+    std::lock_guard<std::mutex> lock(mGateLock);
+    auto it = mGates.find({npuId, modelId});
+    if (it == mGates.end()) {
+        return;
+    }
+    const FrameGateStats& stats = it->second->gate.stats();
+    ALOGI("Frame gate on %s/%s: skipped %" PRIu64 " of %" PRIu64 " frames, "
+          "results reused up to %u frames / %" PRId64 " ms", npuId.c_str(), modelId.c_str(),
+          stats.skipped, stats.frames, stats.maxStaleFrames, stats.maxStaleNs / 1000000);
+    mGates.erase(it);
+}
+
+FrameGateStats NpuManager::getFrameGateStats(const std::string& npuId,
+                                             const std::string& modelId) {
+    std::lock_guard<std::mutex> lock(mGateLock);
+    auto it = mGates.find({npuId, modelId});
+    return it != mGates.end() ? it->second->gate.stats() : FrameGateStats();
+}
+
+void NpuManager::setProfiling(bool enabled) {
+    mProfiling.store(enabled, std::memory_order_relaxed);
+    ALOGI("Inference profiling %s", enabled ? "on" : "off");
+}
+
+std::string NpuManager::getChromeTrace() {
+    std::lock_guard<std::mutex> lock(mProfileLock);
+    if (mProfiler.dropped() > 0) {
+        ALOGW("Profile lost its oldest %" PRIu64 " events", mProfiler.dropped());
+    }
+    return mProfiler.chromeTrace();
+}
+
+bool NpuManager::writeChromeTrace(const std::string& path) {
+    const std::string trace = getChromeTrace();
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ALOGE("Failed to create %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    size_t written = 0;
+    while (written < trace.size()) {
+        ssize_t n = write(fd, trace.data() + written, trace.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            ALOGE("Failed to write %s: %s", path.c_str(), strerror(errno));
+            close(fd);
+            return false;
+        }
+        written += n;
+    }
+    close(fd);
+    return true;
+}
+
+void NpuManager::clearProfile() {
+    std::lock_guard<std::mutex> lock(mProfileLock);
+    mProfiler.clear();
+}
+
+void NpuManager::recordProfile(const std::vector<ProfileEvent>& events) {
+    std::lock_guard<std::mutex> lock(mProfileLock);
+    for (const auto& event : events) {
+        mProfiler.record(event);
+    }
+}
+
+bool NpuManager::applyFrameGate(const std::string& npuId, const InferenceRequest& request,
+                                InferenceHandle handle, InferenceCallback* callback) {
+    GateKey key(npuId, request.modelId);
+    std::unique_lock<std::mutex> lock(mGateLock);
+    auto it = mGates.find(key);
+    if (it == mGates.end() || request.inputs.empty()) {
+        return false;
+    }
+    
+    GateState* state = it->second.get();
+    const auto& input = request.inputs[0].second;
+    if (state->gate.check(input.data(), input.size(), state->geometry, bootTimeNs(), handle)) {
+        InferenceResult result = state->lastResult;
+        result.reused = true;
+        lock.unlock();
+        if (*callback) {
+            (*callback)(result);
+        }
+        return true;
+    }
+    lock.unlock();
     
+    *callback = [this, key, handle, inner = std::move(*callback)](
+            const InferenceResult& result) {
+        storeGateResult(key, handle, result);
+        if (inner) {
+            inner(result);
+        }
+    };
+    return false;
+}
+
+void NpuManager::storeGateResult(const GateKey& key, InferenceHandle handle,
+                                 const InferenceResult& result) {
+    std::lock_guard<std::mutex> lock(mGateLock);
+    auto it = mGates.find(key);
+    if (it != mGates.end() && it->second->gate.complete(handle, result.success)) {
+        it->second->lastResult = result;
+    }
+}
+
+NpuManager::NpuWorker* NpuManager::getWorker(const std::string& npuId) {
     auto npuIt = mNpus.find(npuId);
     if (npuIt == mNpus.end()) {
-        result.error = "NPU not found";
-        return result;
+        return nullptr;
     }
     
-    auto modelMapIt = mLoadedModels.find(npuId);
-    if (modelMapIt == mLoadedModels.end()) {
-        result.error = "No models loaded on NPU";
-        return result;
+    std::lock_guard<std::mutex> lock(mWorkerLock);
+    auto& worker = mWorkers[npuId];
+    if (worker == nullptr) {
+        worker = std::make_unique<NpuWorker>();
+        if (isHailo(npuIt->second.type)) {
+            worker->groups = std::make_unique<NetworkGroupScheduler>();
+            worker->thread = std::thread(&NpuManager::hailoWorkerLoop, this, npuId,
+                                         worker.get());
+        } else {
+            worker->thread = std::thread(&NpuManager::workerLoop, this, npuId, worker.get());
+        }
+    }
+    return worker.get();
+}
+
+void NpuManager::workerLoop(const std::string& npuId, NpuWorker* worker) {
+    tWorker = worker;
+    std::unique_lock<std::mutex> lock(worker->lock);
+    while (true) {
+        worker->cv.wait(lock, [worker] { return worker->stopping || !worker->queue.empty(); });
+        if (worker->stopping) {
+            break;
+        }
+        
+        InferenceHandle handle;
+        std::vector<InferenceHandle> expired;
+        const bool runnable = worker->queue.pop(bootTimeNs(), &handle, &expired);
+        
+        std::vector<PendingInference> dropped;
+        for (InferenceHandle h : expired) {
+            dropped.push_back(std::move(worker->pending[h]));
+            worker->pending.erase(h);
+        }
+        worker->stats.dropped += dropped.size();
+        PendingInference next;
+        if (runnable) {
+            next = std::move(worker->pending[handle]);
+            worker->pending.erase(handle);
+        }
+        lock.unlock();
+        
+        // Late frames are worthless; tell their owners without running them
+        for (auto& pending : dropped) {
+            ATRACE_INT("npu inflight", --sInflight);
+            InferenceResult result = failedResult("Deadline expired before execution");
+            result.expired = true;
+            if (pending.callback) {
+                pending.callback(result);
+            }
+        }
+        
+        bool missed = false;
+        if (runnable) {
+            InferenceResult result = executeInference(npuId, next.request);
+            missed = next.request.deadlineNs >= 0 && bootTimeNs() > next.request.deadlineNs;
+            ATRACE_INT("npu inflight", --sInflight);
+            if (next.callback) {
+                next.callback(result);
+            }
+        }
+        
+        lock.lock();
+        if (runnable) {
+            worker->stats.completed++;
+            worker->stats.deadlineMisses += missed;
+        }
+    }
+}
+
+void NpuManager::hailoWorkerLoop(const std::string& npuId, NpuWorker* worker) {
+    tWorker = worker;
+    NetworkGroupScheduler& groups = *worker->groups;
+    std::unique_lock<std::mutex> lock(worker->lock);
+    int64_t wakeNs = kNoDeadline;
+    bool ran = false;
+    while (true) {
+        auto ready = [worker] { return worker->stopping || !worker->queue.empty(); };
+        // After a batch the active group may have more queued; look again first
+        if (ran) {
+            ran = false;
+        } else if (wakeNs == kNoDeadline) {
+            worker->cv.wait(lock, ready);
+        } else {
+            // A waiting group falls due even if nothing new arrives
+            worker->cv.wait_for(lock, std::chrono::nanoseconds(wakeNs - bootTimeNs()), ready);
+        }
+        if (worker->stopping) {
+            break;
+        }
+        
+        // Each group orders its own requests by priority and deadline
+        const int64_t now = bootTimeNs();
+        InferenceHandle handle;
+        std::vector<InferenceHandle> expired;
+        while (worker->queue.pop(now, &handle, &expired)) {
+            const InferenceRequest& request = worker->pending[handle].request;
+            groups.push(request.modelId, handle, request.priority, request.deadlineNs, now);
+        }
+        NetworkGroupBatch batch;
+        const bool runnable = groups.next(now, &batch, &wakeNs);
+        
+        std::vector<PendingInference> next;
+        if (runnable) {
+            for (InferenceHandle h : batch.handles) {
+                PendingInference& pending = worker->pending[h];
+                // Deadlines may pass while the group waits for the device
+                if (pending.request.deadlineNs >= 0 && pending.request.deadlineNs <= now) {
+                    expired.push_back(h);
+                } else {
+                    next.push_back(std::move(pending));
+                    worker->pending.erase(h);
+                }
+            }
+        }
+        std::vector<PendingInference> dropped;
+        for (InferenceHandle h : expired) {
+            dropped.push_back(std::move(worker->pending[h]));
+            worker->pending.erase(h);
+        }
+        worker->stats.dropped += dropped.size();
+        if (!runnable && dropped.empty()) {
+            continue;
+        }
+        lock.unlock();
+        
+        for (auto& pending : dropped) {
+            ATRACE_INT("npu inflight", --sInflight);
+            InferenceResult result = failedResult("Deadline expired before execution");
+            result.expired = true;
+            if (pending.callback) {
+                pending.callback(result);
+            }
+        }
+        
+        std::vector<InferenceResult> results;
+        uint64_t missed = 0;
+        if (!next.empty()) {
+            if (batch.switched && !activateNetworkGroup(npuId, batch.group)) {
+                results.assign(next.size(), failedResult("Network group activation failed"));
+            } else {
+                results = executeHailoBatch(npuId, next);
+            }
+            const int64_t end = bootTimeNs();
+            for (size_t i = 0; i < next.size(); i++) {
+                missed += next[i].request.deadlineNs >= 0 && end > next[i].request.deadlineNs;
+                ATRACE_INT("npu inflight", --sInflight);
+                if (next[i].callback) {
+                    next[i].callback(results[i]);
+                }
+            }
+        }
+        
+        lock.lock();
+        if (runnable) {
+            groups.finished(bootTimeNs());
+            ran = true;
+        }
+        worker->stats.completed += next.size();
+        worker->stats.deadlineMisses += missed;
+    }
+}
+
+void NpuManager::stopWorkers() {
+    std::map<std::string, std::unique_ptr<NpuWorker>> workers;
+    {
+        std::lock_guard<std::mutex> lock(mWorkerLock);
+        workers.swap(mWorkers);
     }
     
-    auto modelIt = modelMapIt->second.find(request.modelId);
-    if (modelIt == modelMapIt->second.end()) {
-        result.error = "Model not found";
-        return result;
+    for (auto& pair : workers) {
+        NpuWorker* worker = pair.second.get();
+        std::map<InferenceHandle, PendingInference> pending;
+        {
+            std::lock_guard<std::mutex> lock(worker->lock);
+            worker->stopping = true;
+            pending.swap(worker->pending);
+            ALOGI("NPU %s: %" PRIu64 " completed, %" PRIu64 " missed their deadline, "
+                  "%" PRIu64 " dropped, %" PRIu64 " cancelled", pair.first.c_str(),
+                  worker->stats.completed, worker->stats.deadlineMisses,
+                  worker->stats.dropped, worker->stats.cancelled);
+            if (worker->groups != nullptr) {
+                for (const auto& group : worker->groups->stats(bootTimeNs())) {
+                    ALOGI("NPU %s group %s: %" PRIu64 " switches, %" PRIu64 " batches, "
+                          "%" PRIu64 " requests, idle %" PRId64 " of %" PRId64 " ms active",
+                          pair.first.c_str(), group.first.c_str(), group.second.switches,
+                          group.second.batches, group.second.requests,
+                          group.second.idleNs / 1000000, group.second.activeNs / 1000000);
+                }
+            }
+        }
+        worker->cv.notify_one();
+        worker->thread.join();
+        
+        for (auto& request : pending) {
+            ATRACE_INT("npu inflight", --sInflight);
+            if (request.second.callback) {
+                request.second.callback(failedResult("NPU shut down"));
+            }
+        }
     }
+}
+
+InferenceResult NpuManager::executeInference(const std::string& npuId,
+                                             const InferenceRequest& request) {
+    ATRACE_CALL();
+    InferenceResult result;
+    result.success = false;
+    // Held across the run, so an unload meanwhile cannot free the plan
+    std::shared_ptr<CpuModel> cpuModel;
+    size_t uploadBytes = 0;     // Edge TPU parameters to stream in first
     
-    auto startTime = std::chrono::high_resolution_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mModelLock);
+        auto modelMapIt = mLoadedModels.find(npuId);
+        if (modelMapIt == mLoadedModels.end()) {
+            result.error = "No models loaded on NPU";
+            return result;
+        }
+        
+        if (modelMapIt->second.find(request.modelId) == modelMapIt->second.end()) {
+            result.error = "Model not found";
+            return result;
+        }
+        auto cpuIt = mCpuModels.find(request.modelId);
+        if (cpuIt != mCpuModels.end()) {
+            cpuModel = cpuIt->second;
+        }
+        auto cacheIt = mCoralCaches.find(npuId);
+        if (cacheIt != mCoralCaches.end()) {
+            uploadBytes = cacheIt->second->run(request.modelId);
+        }
+    }
+    if (uploadBytes > 0) {
+        ALOGV("Streaming %zu KB of parameters to NPU %s for model %s", uploadBytes / 1024,
+              npuId.c_str(), request.modelId.c_str());
+    }
     
-    // Placeholder for actual inference
-    // In real implementation, this would call the specific NPU runtime
-    // (libedgetpu for Coral, HailoRT for Hailo, OpenVINO for Intel, etc.)
+    auto startTime = std::chrono::high_resolution_clock::now();
+    const bool profiling = mProfiling.load(std::memory_order_relaxed);
+    const int64_t profileStartNs = profiling ? bootTimeNs() : 0;
     
-    ALOGI("Running inference on NPU %s with model %s",
+    ALOGV("Running inference on NPU %s with model %s",
           npuId.c_str(), request.modelId.c_str());
     
-    // Simulate inference time based on NPU type
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (cpuModel != nullptr) {
+        if (!executeOnCpu(cpuModel.get(), request, &result, profiling)) {
+            return result;
+        }
+    } else {
+        // No accelerator runtime (libedgetpu, HailoRT, OpenVINO, ...) is
+        // linked in yet. Fail rather than report a run that produced nothing.
+        result.error = "No inference runtime for " + mNpus.at(npuId).name;
+        return result;
+    }
     
     auto endTime = std::chrono::high_resolution_clock::now();
     result.inferenceTimeMs = std::chrono::duration<float, std::milli>(
         endTime - startTime).count();
     
     result.success = true;
+    recordInference(npuId, request.modelId, result.inferenceTimeMs);
+    
+    if (profiling) {
+        ProfileEvent run;
+        run.name = "inference";
+        run.startNs = profileStartNs;
+        run.durationNs = bootTimeNs() - profileStartNs;
+        // Parameters streamed to an Edge TPU count as sent to the device
+        run.bytesIn = uploadBytes;
+        for (const auto& input : request.inputs) {
+            run.bytesIn += input.second.size();
+        }
+        for (const auto& output : result.outputs) {
+            run.bytesOut += output.second.size();
+        }
+        result.profile.insert(result.profile.begin(), std::move(run));
+        for (auto& event : result.profile) {
+            event.backend = mNpus.at(npuId).name;
+            event.npuId = npuId;
+            event.modelId = request.modelId;
+        }
+        recordProfile(result.profile);
+    }
     return result;
 }
 
-bool NpuManager::runInferenceAsync(const std::string& npuId,
-                                   const InferenceRequest& request,
-                                   InferenceCallback callback) {
-    std::thread([this, npuId, request, callback]() {
-        InferenceResult result = runInference(npuId, request);
-        if (callback) {
-            callback(result);
+bool NpuManager::executeOnCpu(CpuModel* model, const InferenceRequest& request,
+                              InferenceResult* result, bool profile) {
+    ATRACE_CALL();
+    // Inputs come named input<i>; one left out fails the size check
+    std::vector<const std::vector<uint8_t>*> inputs(model->inputCount(), nullptr);
+    for (const auto& input : request.inputs) {
+        for (size_t i = 0; i < inputs.size(); i++) {
+            if (input.first == "input" + std::to_string(i)) {
+                inputs[i] = &input.second;
+            }
         }
-    }).detach();
+    }
     
+    std::vector<std::vector<uint8_t>> outputs;
+    std::vector<CpuLayerProfile> layers;
+    const int64_t startNs = profile ? bootTimeNs() : 0;
+    if (!model->execute(inputs, &outputs, mCpuPool.get(), &result->error,
+                        profile ? &layers : nullptr)) {
+        return false;
+    }
+    for (const auto& layer : layers) {
+        ProfileEvent event;
+        event.name = cpuOperationName(layer.type);
+        event.startNs = startNs + layer.startNs;
+        event.durationNs = layer.durationNs;
+        event.bytesIn = layer.bytesIn;
+        event.bytesOut = layer.bytesOut;
+        event.weightBytes = layer.weightBytes;
+        event.operation = layer.operation;
+        result->profile.push_back(std::move(event));
+    }
+    for (size_t i = 0; i < outputs.size(); i++) {
+        result->outputs.emplace_back("output" + std::to_string(i), std::move(outputs[i]));
+    }
     return true;
 }
 
@@ -616,9 +1412,12 @@ float NpuManager::getTemperature(const std::string& npuId) {
     
     // Try to read temperature from sysfs
     std::string tempPath = it->second.pcieInfo.sysfsPath + "/hwmon/hwmon0/temp1_input";
-    std::string tempStr = readSysfs(tempPath);
-    if (!tempStr.empty()) {
-        return std::stof(tempStr) / 1000.0f;
+    float milliCelsius;
+    if (sysfs::readFloat(tempPath, &milliCelsius)) {
+        if (ATRACE_ENABLED()) {
+            ATRACE_INT((npuId + " temp mC").c_str(), static_cast<int32_t>(milliCelsius));
+        }
+        return milliCelsius / 1000.0f;
     }
     
     return it->second.temperatureCelsius;
@@ -648,13 +1447,77 @@ bool NpuManager::initCoralTpu(const std::string& npuId) {
     }
     close(fd);
     
+    std::lock_guard<std::mutex> lock(mModelLock);
+    EdgeTpuCache* cache = getCoralCache(npuId);
+    ALOGI("Coral TPU %s caches up to %zu MB of parameters on chip", npuId.c_str(),
+          cache->capacity() >> 20);
     return true;
 }
 
 std::string NpuManager::getCoralTpuVersion(const std::string& npuId) {
+    // The apex driver reports its own version; the USB accelerator has none
+    std::string version = readSysfs("/sys/module/apex/version");
+    if (!version.empty()) {
+        return "Coral Edge TPU (apex " + version + ")";
+    }
     return "Coral Edge TPU v1.0";
 }
 
+EdgeTpuCache* NpuManager::getCoralCache(const std::string& npuId) {
+    auto npuIt = mNpus.find(npuId);
+    if (npuIt == mNpus.end() || !isCoral(npuIt->second.type)) {
+        return nullptr;
+    }
+    auto& cache = mCoralCaches[npuId];
+    if (cache == nullptr) {
+        size_t memoryMB = npuIt->second.capabilities.memoryMB;
+        if (memoryMB == 0) {
+            memoryMB = kNpuCapabilities.at(NpuType::CORAL_TPU_PCIE).memoryMB;
+        }
+        cache = std::make_unique<EdgeTpuCache>(memoryMB << 20);
+    }
+    return cache.get();
+}
+
+bool NpuManager::setCoralModelSet(const std::string& npuId,
+                                  const std::vector<std::string>& modelIds) {
+    std::lock_guard<std::mutex> lock(mModelLock);
+    EdgeTpuCache* cache = getCoralCache(npuId);
+    if (cache == nullptr || !cache->setModelSet(modelIds)) {
+        ALOGE("Cannot cache %zu models together on NPU %s", modelIds.size(), npuId.c_str());
+        return false;
+    }
+    ALOGI("NPU %s caches %zu models together", npuId.c_str(), modelIds.size());
+    return true;
+}
+
+std::vector<std::vector<std::string>> NpuManager::planCoralModelSets(const std::string& npuId) {
+    std::lock_guard<std::mutex> lock(mModelLock);
+    EdgeTpuCache* cache = getCoralCache(npuId);
+    auto npuIt = mLoadedModels.find(npuId);
+    if (cache == nullptr || npuIt == mLoadedModels.end()) {
+        return {};
+    }
+    
+    std::map<std::string, size_t> parameterBytes;
+    for (const auto& model : npuIt->second) {
+        parameterBytes[model.first] = model.second.sizeBytes;
+    }
+    std::map<std::string, uint64_t> runs;
+    for (const auto& model : cache->stats()) {
+        runs[model.first] = model.second.hits + model.second.uploads;
+    }
+    return EdgeTpuCache::planSets(parameterBytes, runs, cache->capacity());
+}
+
+std::map<std::string, EdgeTpuCacheStats> NpuManager::getCoralCacheStats(
+        const std::string& npuId) {
+    std::lock_guard<std::mutex> lock(mModelLock);
+    auto it = mCoralCaches.find(npuId);
+    return it != mCoralCaches.end() ? it->second->stats()
+                                    : std::map<std::string, EdgeTpuCacheStats>();
+}
+
 bool NpuManager::detectCoralTpu() {
     return access("/dev/apex_0", F_OK) == 0;
 }
@@ -687,12 +1550,77 @@ std::string NpuManager::getHailoVersion(const std::string& npuId) {
     return "Unknown";
 }
 
-bool NpuManager::configureHailoDataflow(const std::string& npuId, const std::string& hef) {
+std::string NpuManager::configureHailoDataflow(const std::string& npuId, const std::string& hef) {
+    auto it = mNpus.find(npuId);
+    if (it == mNpus.end() || !isHailo(it->second.type)) {
+        ALOGE("NPU %s is not a Hailo device", npuId.c_str());
+        return "";
+    }
+    
     ALOGI("Configuring Hailo dataflow with HEF: %s", hef.c_str());
-    // In real implementation, this would use HailoRT API
+    // In real implementation, this would use HailoRT API to configure the
+    // HEF's network group on the device, leaving the others configured
+    return loadModel(npuId, hef);
+}
+
+bool NpuManager::setNetworkGroupConfig(const std::string& npuId,
+                                       const NetworkGroupScheduler::Config& config) {
+    NpuWorker* worker = getWorker(npuId);
+    if (worker == nullptr || worker->groups == nullptr) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(worker->lock);
+        worker->groups->setConfig(config);
+    }
+    worker->cv.notify_one();
+    return true;
+}
+
+std::map<std::string, NetworkGroupStats> NpuManager::getNetworkGroupStats(
+        const std::string& npuId) {
+    NpuWorker* worker = getWorker(npuId);
+    if (worker == nullptr || worker->groups == nullptr) {
+        return {};
+    }
+    std::lock_guard<std::mutex> lock(worker->lock);
+    return worker->groups->stats(bootTimeNs());
+}
+
+bool NpuManager::activateNetworkGroup(const std::string& npuId, const std::string& modelId) {
+    ATRACE_CALL();
+    const int64_t startNs = bootTimeNs();
+    ALOGV("Activating network group %s on NPU %s", modelId.c_str(), npuId.c_str());
+    // In real implementation, this would deactivate the current network
+    // group and activate this one through HailoRT, which reloads the
+    // device's contexts
+    
+    if (mProfiling.load(std::memory_order_relaxed)) {
+        ProfileEvent event;
+        event.name = "network group switch";
+        event.backend = mNpus.at(npuId).name;
+        event.npuId = npuId;
+        event.modelId = modelId;
+        event.startNs = startNs;
+        event.durationNs = bootTimeNs() - startNs;
+        recordProfile({event});
+    }
     return true;
 }
 
+std::vector<InferenceResult> NpuManager::executeHailoBatch(
+        const std::string& npuId, const std::vector<PendingInference>& batch) {
+    ATRACE_CALL();
+    // In real implementation, the whole batch would be written to the input
+    // vstreams before reading the outputs back, so the device pipelines it
+    std::vector<InferenceResult> results;
+    results.reserve(batch.size());
+    for (const auto& pending : batch) {
+        results.push_back(executeInference(npuId, pending.request));
+    }
+    return results;
+}
+
 bool NpuManager::detectHailo() {
     return access("/dev/hailo0", F_OK) == 0;
 }
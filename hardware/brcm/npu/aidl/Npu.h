@@ -12,9 +12,23 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <functional>
+#include <atomic>
 #include <cstdint>
 
+#include "CpuBackend.h"
+#include "CpuThreadPool.h"
+#include "EdgeTpuCache.h"
+#include "FrameGate.h"
+#include "ModelPages.h"
+#include "NetworkGroupScheduler.h"
+#include "NpuGraph.h"
+#include "NpuProfiler.h"
+#include "NpuScheduler.h"
+
 namespace aidl::android::hardware::neuralnetworks::rpi5 {
 
 // Neural accelerator types
@@ -63,6 +77,9 @@ enum class NpuType {
     SYNTIANT_NDP120,        // NDP120
     SYNTIANT_NDP200,        // NDP200
     
+    // The board's own Cortex-A76 cores, when no accelerator is present
+    CPU_FALLBACK,
+    
     // Generic PCIe AI Accelerator
     GENERIC_NPU,
     UNKNOWN
@@ -162,6 +179,21 @@ struct ModelInfo {
     size_t sizeBytes;
     std::vector<std::pair<std::string, std::vector<int>>> inputs;
     std::vector<std::pair<std::string, std::vector<int>>> outputs;
+    std::shared_ptr<const NpuGraph> graph;  // set for models prepared through NNAPI
+    // First-inference latency straight after load, and of the first request
+    // once warm-up is done; the same without warm-up, 0 until run
+    float coldInferenceMs = 0.0f;
+    float firstInferenceMs = 0.0f;
+    uint32_t warmupInferences = 0;
+    uint64_t inferences = 0;    // successful runs, warm-up included
+    size_t lockedBytes = 0;     // weights and buffers held in RAM
+};
+
+// Work moved into loadModel so the first request does not pay for page
+// faults, buffer allocation and backend setup
+struct WarmupConfig {
+    uint32_t inferences = 0;    // on zeroed inputs, results discarded
+    bool lockPages = false;     // fault in and mlock weights and buffers
 };
 
 // Inference request
@@ -169,6 +201,8 @@ struct InferenceRequest {
     std::string modelId;
     std::vector<std::pair<std::string, std::vector<uint8_t>>> inputs;
     bool measureTiming;
+    InferencePriority priority = InferencePriority::NORMAL;
+    int64_t deadlineNs = kNoDeadline;   // CLOCK_BOOTTIME, as NNAPI deadlines
 };
 
 // Inference result
@@ -179,6 +213,18 @@ struct InferenceResult {
     float inferenceTimeMs;
     float preprocessTimeMs;
     float postprocessTimeMs;
+    bool expired = false;   // dropped unrun, its deadline had passed
+    bool reused = false;    // earlier frame's result, handed back by the frame gate
+    // With profiling on: the run on the device first, then its layers where
+    // the backend reports them (the CPU backend does)
+    std::vector<ProfileEvent> profile;
+};
+
+// Frame gate for one model. When the first input is close enough to the last
+// inferred frame, that frame's result is returned without queueing.
+struct FrameGateConfig {
+    FrameGate::Config gate;
+    FrameGeometry geometry;     // zero width: from the model's NHWC first input
 };
 
 // Callback types
@@ -224,6 +270,8 @@ public:
     std::vector<NpuDeviceInfo> getAvailableNpus();
     bool detectNpus();
     NpuDeviceInfo getNpuInfo(const std::string& npuId);
+    // Highest INT8 throughput; the CPU backend if no NPU was detected
+    std::string getPrimaryNpu();
     
     // NPU operations
     bool openNpu(const std::string& npuId);
@@ -232,14 +280,51 @@ public:
     
     // Model management
     std::string loadModel(const std::string& npuId, const std::string& modelPath);
+    // Graph handed in through the NNAPI driver; inputs and outputs are named
+    // input<i> and output<i> in graph order. |packedWeights| comes from
+    // getPackedWeights() for the same graph, by way of the compilation cache,
+    // and spares the CPU backend packing the weights again.
+    std::string loadModel(const std::string& npuId, const std::string& name,
+                          std::shared_ptr<const NpuGraph> graph,
+                          const std::vector<uint8_t>* packedWeights = nullptr);
+    // The CPU backend's packed weights for a loaded graph; false, with
+    // |data| empty, for models that run elsewhere
+    bool getPackedWeights(const std::string& modelId, std::vector<uint8_t>* data);
     bool unloadModel(const std::string& npuId, const std::string& modelId);
     ModelInfo getModelInfo(const std::string& npuId, const std::string& modelId);
     std::vector<std::string> getLoadedModels(const std::string& npuId);
-    
-    // Inference
+    // The NPU |modelId| is loaded on; empty if none
+    std::string getModelNpu(const std::string& modelId);
+    // Applies to models loaded on |npuId| from now on; off by default
+    void setWarmupConfig(const std::string& npuId, const WarmupConfig& config);
+    
+    // Inference. Requests queue per NPU: higher priority classes first, then
+    // earliest deadline. A request whose deadline passes while queued is
+    // dropped with result.expired set instead of being run late. Called from
+    // an inference callback for the same NPU, it runs inline on the worker.
     InferenceResult runInference(const std::string& npuId, const InferenceRequest& request);
-    bool runInferenceAsync(const std::string& npuId, const InferenceRequest& request,
-                          InferenceCallback callback);
+    // Handle for cancelInference; 0 if the NPU does not exist
+    InferenceHandle runInferenceAsync(const std::string& npuId, const InferenceRequest& request,
+                                      InferenceCallback callback);
+    // Removes a queued request, whose callback then reports it cancelled;
+    // false once it has started running
+    bool cancelInference(const std::string& npuId, InferenceHandle handle);
+    SchedulerStats getSchedulerStats(const std::string& npuId);
+    
+    // Frame-difference gating, off until configured for a model
+    bool setFrameGate(const std::string& npuId, const std::string& modelId,
+                      const FrameGateConfig& config);
+    void clearFrameGate(const std::string& npuId, const std::string& modelId);
+    FrameGateStats getFrameGateStats(const std::string& npuId, const std::string& modelId);
+    
+    // Profiling, off by default. While on, each inference fills in
+    // InferenceResult::profile and is kept for a Chrome trace, along with
+    // Hailo network group switches.
+    void setProfiling(bool enabled);
+    bool isProfiling() const { return mProfiling.load(std::memory_order_relaxed); }
+    std::string getChromeTrace();
+    bool writeChromeTrace(const std::string& path);
+    void clearProfile();
     
     // Monitoring
     float getTemperature(const std::string& npuId);
@@ -249,11 +334,26 @@ public:
     // Coral TPU specific
     bool initCoralTpu(const std::string& npuId);
     std::string getCoralTpuVersion(const std::string& npuId);
+    // Declares loaded models the Edge TPU compiler compiled together, so
+    // they share the on-chip parameter cache instead of evicting each
+    // other. False if one is not loaded or they do not fit in SRAM.
+    bool setCoralModelSet(const std::string& npuId, const std::vector<std::string>& modelIds);
+    // Loaded models split into sets that fit on chip, busiest together;
+    // what to hand the compiler next
+    std::vector<std::vector<std::string>> planCoralModelSets(const std::string& npuId);
+    // Per model: runs with parameters already on chip vs. re-uploads
+    std::map<std::string, EdgeTpuCacheStats> getCoralCacheStats(const std::string& npuId);
     
     // Hailo specific
     bool initHailo(const std::string& npuId);
     std::string getHailoVersion(const std::string& npuId);
-    bool configureHailoDataflow(const std::string& npuId, const std::string& hef);
+    // Configures |hef| as a network group next to the ones already on the
+    // device; requests for its model ID are then batched per group and the
+    // active group switched per NetworkGroupScheduler. Empty on failure.
+    std::string configureHailoDataflow(const std::string& npuId, const std::string& hef);
+    bool setNetworkGroupConfig(const std::string& npuId,
+                               const NetworkGroupScheduler::Config& config);
+    std::map<std::string, NetworkGroupStats> getNetworkGroupStats(const std::string& npuId);
     
     // Intel NCS/Myriad specific
     bool initMyriad(const std::string& npuId);
@@ -268,9 +368,92 @@ private:
     bool detectHailo();
     bool detectIntelNcs();
     bool detectKneron();
+    void detectUsbNpus();
+    
+    struct PendingInference {
+        InferenceRequest request;
+        InferenceCallback callback;
+    };
+    
+    // One thread per NPU runs its queue, so the device only ever sees one
+    // request at a time and ordering is decided here
+    struct NpuWorker {
+        std::mutex lock;
+        std::condition_variable cv;
+        InferenceQueue queue;
+        std::map<InferenceHandle, PendingInference> pending;
+        // Hailo only: requests leave |queue| in its order and wait here for
+        // their model's network group to be active
+        std::unique_ptr<NetworkGroupScheduler> groups;
+        SchedulerStats stats;
+        bool stopping = false;
+        std::thread thread;
+    };
+    
+    struct GateState {
+        explicit GateState(const FrameGateConfig& config)
+            : gate(config.gate), geometry(config.geometry) {}
+        
+        FrameGate gate;
+        FrameGeometry geometry;
+        InferenceResult lastResult;     // of the gate's completed reference
+    };
+    using GateKey = std::pair<std::string, std::string>;    // NPU, model
+    
+    // True if |callback| was answered with a reused result. Otherwise wraps
+    // it so the result of this frame is kept for the frames after it.
+    bool applyFrameGate(const std::string& npuId, const InferenceRequest& request,
+                        InferenceHandle handle, InferenceCallback* callback);
+    void storeGateResult(const GateKey& key, InferenceHandle handle, const InferenceResult& result);
+    
+    // nullptr if |modelId| is not loaded on |npuId|; caller holds mModelLock
+    ModelInfo* findLoadedModel(const std::string& npuId, const std::string& modelId);
+    // Runs before loadModel hands out |modelId|, but model IDs can be
+    // guessed; stops early if the model is unloaded in the meantime
+    void warmUpModel(const std::string& npuId, const std::string& modelId,
+                     const WarmupConfig& config);
+    void recordInference(const std::string& npuId, const std::string& modelId, float timeMs);
+    
+    NpuWorker* getWorker(const std::string& npuId);
+    void workerLoop(const std::string& npuId, NpuWorker* worker);
+    void hailoWorkerLoop(const std::string& npuId, NpuWorker* worker);
+    void stopWorkers();
+    InferenceResult executeInference(const std::string& npuId, const InferenceRequest& request);
+    // Layers go to result->profile when |profile| is set
+    bool executeOnCpu(CpuModel* model, const InferenceRequest& request, InferenceResult* result,
+                      bool profile);
+    void recordProfile(const std::vector<ProfileEvent>& events);
+    // Created on first use for Coral NPUs, nullptr otherwise; mModelLock held
+    EdgeTpuCache* getCoralCache(const std::string& npuId);
+    bool activateNetworkGroup(const std::string& npuId, const std::string& modelId);
+    std::vector<InferenceResult> executeHailoBatch(const std::string& npuId,
+                                                   const std::vector<PendingInference>& batch);
     
     std::map<std::string, NpuDeviceInfo> mNpus;
+    // Guards mLoadedModels and mCpuModels; the NNAPI service loads and runs
+    // from binder threads
+    std::mutex mModelLock;
     std::map<std::string, std::map<std::string, ModelInfo>> mLoadedModels;
+    uint32_t mNextGraphId = 0;
+    // Planned graphs of the models loaded on the CPU backend, by model ID
+    std::map<std::string, std::shared_ptr<CpuModel>> mCpuModels;
+    std::unique_ptr<CpuThreadPool> mCpuPool;
+    // What each Edge TPU holds on chip, by NPU ID; guarded by mModelLock
+    std::map<std::string, std::unique_ptr<EdgeTpuCache>> mCoralCaches;
+    // Warm-up by NPU ID, locked memory by model ID; guarded by mModelLock
+    std::map<std::string, WarmupConfig> mWarmupConfigs;
+    std::map<std::string, std::unique_ptr<ModelPages>> mModelPages;
+    
+    std::mutex mWorkerLock;
+    std::map<std::string, std::unique_ptr<NpuWorker>> mWorkers;
+    InferenceHandle mNextHandle = 1;    // guarded by mWorkerLock
+    
+    std::atomic<bool> mProfiling{false};
+    std::mutex mProfileLock;
+    NpuProfiler mProfiler;      // guarded by mProfileLock
+    
+    std::mutex mGateLock;
+    std::map<GateKey, std::unique_ptr<GateState>> mGates;
     bool mInitialized = false;
 };
 
@@ -333,6 +516,9 @@ static const std::map<std::pair<uint16_t, uint16_t>, std::string> kKnownPcieDevi
     {{0x8086, 0x9A1B}, "Intel USB4/Thunderbolt"},
 };
 
+// NPU ID of the CPU backend, registered alongside any accelerators
+static const std::string kCpuNpuId = "cpu0";
+
 // NPU Capabilities Database
 static const std::map<NpuType, NpuCapabilities> kNpuCapabilities = {
     {NpuType::CORAL_TPU_PCIE, {
@@ -370,6 +556,14 @@ static const std::map<NpuType, NpuCapabilities> kNpuCapabilities = {
         {"Conv2D", "DepthwiseConv2D", "FullyConnected", "Pooling", "BatchNorm", "ReLU", "Softmax"},
         {"Kneron Toolchain", "ONNX", "TensorFlow Lite"}
     }},
+    // SDOT int8 and NEON fp32 on four cores at 2.4 GHz; fp16 only for relaxed fp32 models
+    {NpuType::CPU_FALLBACK, {
+        0.5f, 0.0f, 0.3f, 0.15f, 0,
+        false, true, false, false, false, true,
+        false, true, false,
+        {"Conv2D", "DepthwiseConv2D", "FullyConnected", "Pooling", "Softmax", "Add", "Concat", "Reshape"},
+        {"NNAPI"}
+    }},
 };
 
 }  // namespace aidl::android::hardware::neuralnetworks::rpi5
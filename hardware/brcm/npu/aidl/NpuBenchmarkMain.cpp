@@ -0,0 +1,8 @@
+// Copyright (C) 2025 The Android Open Source Project
+
+// Entry point of brcm_npu_benchmark; the benchmarks register themselves from
+// the *Benchmark.cpp files linked alongside.
+
+#include <benchmark/benchmark.h>
+
+BENCHMARK_MAIN();
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Compilation cache files for the Raspberry Pi 5 NPU HAL
+ */
+
+#include "NpuCache.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+constexpr uint32_t kCacheMagic = 0x4355504e;    // "NPUC"
+constexpr uint32_t kCacheVersion = 2;
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint8_t token[kCacheTokenSize];
+    uint64_t deviceHash;
+    uint64_t structureSize;
+    uint64_t structureChecksum;
+    uint64_t weightsSize;
+    uint64_t weightsChecksum;
+    uint64_t packedSize;
+    uint64_t packedChecksum;
+};
+
+// FNV-1a over 64-bit words, then the tail bytes; only has to catch damage
+static uint64_t checksum(const uint8_t* data, size_t size) {
+    constexpr uint64_t kPrime = 0x100000001b3ULL;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * kPrime;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ data[i]) * kPrime;
+    }
+    return hash;
+}
+
+static bool writeAll(int fd, const void* data, size_t size, off_t offset) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t ret = pwrite(fd, bytes, size, offset);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return false;
+        }
+        bytes += ret;
+        offset += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void* data, size_t size, off_t offset) {
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        ssize_t ret = pread(fd, bytes, size, offset);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return false;
+        }
+        bytes += ret;
+        offset += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+static bool fileSize(int fd, uint64_t* size) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return false;
+    }
+    *size = st.st_size;
+    return true;
+}
+
+bool writeGraphCache(int modelFd, int dataFd, const uint8_t* token,
+                     const std::string& deviceVersion, const NpuGraph& graph,
+                     const std::vector<uint8_t>& packedWeights) {
+    std::vector<uint8_t> structure;
+    std::vector<uint8_t> weights;
+    serializeGraph(graph, &structure, &weights);
+
+    CacheHeader header = {};
+    header.magic = kCacheMagic;
+    header.version = kCacheVersion;
+    memcpy(header.token, token, kCacheTokenSize);
+    header.deviceHash = checksum(reinterpret_cast<const uint8_t*>(deviceVersion.data()),
+                                 deviceVersion.size());
+    header.structureSize = structure.size();
+    header.structureChecksum = checksum(structure.data(), structure.size());
+    header.weightsSize = weights.size();
+    header.weightsChecksum = checksum(weights.data(), weights.size());
+    header.packedSize = packedWeights.size();
+    header.packedChecksum = checksum(packedWeights.data(), packedWeights.size());
+
+    return ftruncate(modelFd, 0) == 0 && ftruncate(dataFd, 0) == 0 &&
+           writeAll(dataFd, weights.data(), weights.size(), 0) &&
+           writeAll(dataFd, packedWeights.data(), packedWeights.size(), weights.size()) &&
+           writeAll(modelFd, structure.data(), structure.size(), sizeof(header)) &&
+           // Header last, so a partially written cache never validates
+           writeAll(modelFd, &header, sizeof(header), 0);
+}
+
+bool readGraphCache(int modelFd, int dataFd, const uint8_t* token,
+                    const std::string& deviceVersion, NpuGraph* graph,
+                    std::vector<uint8_t>* packedWeights) {
+    CacheHeader header;
+    uint64_t modelSize;
+    uint64_t dataSize;
+    if (!fileSize(modelFd, &modelSize) || !fileSize(dataFd, &dataSize) ||
+        modelSize < sizeof(header) || !readAll(modelFd, &header, sizeof(header), 0)) {
+        return false;
+    }
+    if (header.magic != kCacheMagic || header.version != kCacheVersion ||
+        memcmp(header.token, token, kCacheTokenSize) != 0 ||
+        header.deviceHash != checksum(reinterpret_cast<const uint8_t*>(deviceVersion.data()),
+                                      deviceVersion.size()) ||
+        header.structureSize != modelSize - sizeof(header) || header.weightsSize > dataSize ||
+        header.packedSize != dataSize - header.weightsSize) {
+        return false;
+    }
+
+    std::vector<uint8_t> structure(header.structureSize);
+    std::vector<uint8_t> weights(header.weightsSize);
+    std::vector<uint8_t> packed(packedWeights != nullptr ? header.packedSize : 0);
+    if (!readAll(modelFd, structure.data(), structure.size(), sizeof(header)) ||
+        !readAll(dataFd, weights.data(), weights.size(), 0) ||
+        !readAll(dataFd, packed.data(), packed.size(), header.weightsSize) ||
+        checksum(structure.data(), structure.size()) != header.structureChecksum ||
+        checksum(weights.data(), weights.size()) != header.weightsChecksum ||
+        (packedWeights != nullptr &&
+         checksum(packed.data(), packed.size()) != header.packedChecksum)) {
+        return false;
+    }
+    if (!deserializeGraph(structure.data(), structure.size(), weights.data(), weights.size(),
+                          graph)) {
+        return false;
+    }
+    if (packedWeights != nullptr) {
+        *packedWeights = std::move(packed);
+    }
+    return true;
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
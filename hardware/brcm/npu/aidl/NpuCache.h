@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Compilation cache files for the Raspberry Pi 5 NPU HAL
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "NpuGraph.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// Matches IDevice::BYTE_SIZE_OF_CACHE_TOKEN
+constexpr size_t kCacheTokenSize = 32;
+
+// The model cache file holds a header and the graph structure, the data cache
+// file holds the weights followed by the backend's packed weights, if any
+// (CpuModel::packedWeights()), so a model restored from the cache is not
+// packed again. The header records the token, a hash of the device version
+// string and checksums of all three, so a file written for another model or
+// accelerator, or damaged on disk, is refused rather than loaded.
+
+// Replaces the contents of both files
+bool writeGraphCache(int modelFd, int dataFd, const uint8_t* token,
+                     const std::string& deviceVersion, const NpuGraph& graph,
+                     const std::vector<uint8_t>& packedWeights = {});
+
+// False if either file is missing, corrupt or was written for another token
+// or device. |packedWeights| may be null; it comes back empty if none were
+// stored.
+bool readGraphCache(int modelFd, int dataFd, const uint8_t* token,
+                    const std::string& deviceVersion, NpuGraph* graph,
+                    std::vector<uint8_t>* packedWeights = nullptr);
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,75 @@
+// Copyright (C) 2025 The Android Open Source Project
+
+// Writing and restoring the compilation cache for a MobileNet-sized int8
+// graph: 28 convolutions and about 4 MB of weights.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+
+#include "NpuCache.h"
+
+using namespace aidl::android::hardware::neuralnetworks::rpi5;
+
+static const std::string kDeviceVersion = "rpi5-npu Hailo-8 4.17.0";
+
+static NpuGraph makeGraph() {
+    NpuGraph graph;
+    auto addTensor = [&graph](NpuOperandLifetime lifetime, std::vector<uint32_t> dims,
+                              size_t valueSize) {
+        NpuOperand operand;
+        operand.type = NpuOperandType::TENSOR_QUANT8_ASYMM;
+        operand.lifetime = lifetime;
+        operand.dimensions = std::move(dims);
+        operand.scale = 0.05f;
+        operand.zeroPoint = 128;
+        operand.value.assign(valueSize, 0x5a);
+        graph.operands.push_back(std::move(operand));
+        return static_cast<uint32_t>(graph.operands.size() - 1);
+    };
+
+    uint32_t activation = addTensor(NpuOperandLifetime::INPUT, {1, 224, 224, 3}, 0);
+    graph.inputIndexes.push_back(activation);
+    for (int layer = 0; layer < 28; layer++) {
+        uint32_t weights = addTensor(NpuOperandLifetime::CONSTANT, {256, 3, 3, 64}, 147456);
+        uint32_t output = addTensor(layer == 27 ? NpuOperandLifetime::OUTPUT
+                                                : NpuOperandLifetime::TEMPORARY,
+                                    {1, 56, 56, 64}, 0);
+        graph.operations.push_back({3 /* CONV_2D */, {activation, weights}, {output}});
+        activation = output;
+    }
+    graph.outputIndexes.push_back(activation);
+    return graph;
+}
+
+static void BM_CacheWrite(benchmark::State& state) {
+    NpuGraph graph = makeGraph();
+    uint8_t token[kCacheTokenSize] = {1};
+    FILE* model = tmpfile();
+    FILE* data = tmpfile();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+                writeGraphCache(fileno(model), fileno(data), token, kDeviceVersion, graph));
+    }
+    fclose(model);
+    fclose(data);
+}
+BENCHMARK(BM_CacheWrite)->Unit(benchmark::kMillisecond);
+
+static void BM_CacheRestore(benchmark::State& state) {
+    uint8_t token[kCacheTokenSize] = {1};
+    FILE* model = tmpfile();
+    FILE* data = tmpfile();
+    writeGraphCache(fileno(model), fileno(data), token, kDeviceVersion, makeGraph());
+    for (auto _ : state) {
+        NpuGraph graph;
+        if (!readGraphCache(fileno(model), fileno(data), token, kDeviceVersion, &graph)) {
+            state.SkipWithError("cache rejected");
+            break;
+        }
+        benchmark::DoNotOptimize(graph);
+    }
+    fclose(model);
+    fclose(data);
+}
+BENCHMARK(BM_CacheRestore)->Unit(benchmark::kMillisecond);
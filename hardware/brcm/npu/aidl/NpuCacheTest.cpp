@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Compilation cache round trip and the cases it must refuse
+ */
+
+#include <gtest/gtest.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "NpuCache.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+namespace {
+
+const std::string kDeviceVersion = "rpi5-npu Hailo-8 4.17.0";
+
+NpuGraph makeGraph() {
+    NpuGraph graph;
+    NpuOperand input;
+    input.type = NpuOperandType::TENSOR_QUANT8_ASYMM;
+    input.lifetime = NpuOperandLifetime::INPUT;
+    input.dimensions = {1, 8, 8, 3};
+    input.scale = 0.5f;
+    input.zeroPoint = 128;
+    NpuOperand weights = input;
+    weights.lifetime = NpuOperandLifetime::CONSTANT;
+    weights.dimensions = {4, 3, 3, 3};
+    for (int i = 0; i < 4 * 3 * 3 * 3; i++) {
+        weights.value.push_back(static_cast<uint8_t>(i * 7));
+    }
+    NpuOperand output = input;
+    output.lifetime = NpuOperandLifetime::OUTPUT;
+    output.dimensions = {1, 8, 8, 4};
+    graph.operands = {input, weights, output};
+    graph.operations.push_back({3 /* CONV_2D */, {0, 1}, {2}});
+    graph.inputIndexes = {0};
+    graph.outputIndexes = {2};
+    return graph;
+}
+
+class NpuCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mModel = tmpfile();
+        mData = tmpfile();
+        ASSERT_NE(mModel, nullptr);
+        ASSERT_NE(mData, nullptr);
+        for (size_t i = 0; i < kCacheTokenSize; i++) {
+            mToken[i] = static_cast<uint8_t>(i + 1);
+        }
+        ASSERT_TRUE(writeGraphCache(modelFd(), dataFd(), mToken, kDeviceVersion, makeGraph()));
+    }
+
+    void TearDown() override {
+        fclose(mModel);
+        fclose(mData);
+    }
+
+    int modelFd() { return fileno(mModel); }
+    int dataFd() { return fileno(mData); }
+
+    bool read(const uint8_t* token, const std::string& version, NpuGraph* graph) {
+        return readGraphCache(modelFd(), dataFd(), token, version, graph);
+    }
+
+    // Flips one byte of a file in place
+    static void corrupt(int fd, off_t offset) {
+        uint8_t byte = 0;
+        ASSERT_EQ(pread(fd, &byte, 1, offset), 1);
+        byte ^= 0xff;
+        ASSERT_EQ(pwrite(fd, &byte, 1, offset), 1);
+    }
+
+    FILE* mModel = nullptr;
+    FILE* mData = nullptr;
+    uint8_t mToken[kCacheTokenSize];
+};
+
+TEST_F(NpuCacheTest, RoundTrip) {
+    NpuGraph restored;
+    ASSERT_TRUE(read(mToken, kDeviceVersion, &restored));
+    NpuGraph graph = makeGraph();
+    ASSERT_EQ(restored.operands.size(), graph.operands.size());
+    EXPECT_EQ(restored.operands[1].value, graph.operands[1].value);
+    EXPECT_EQ(restored.operands[2].dimensions, graph.operands[2].dimensions);
+    EXPECT_EQ(restored.operands[0].zeroPoint, 128);
+    ASSERT_EQ(restored.operations.size(), 1u);
+    EXPECT_EQ(restored.operations[0].inputs, graph.operations[0].inputs);
+    EXPECT_EQ(restored.inputIndexes, graph.inputIndexes);
+    EXPECT_EQ(restored.outputIndexes, graph.outputIndexes);
+}
+
+TEST_F(NpuCacheTest, RejectsWrongToken) {
+    uint8_t other[kCacheTokenSize];
+    memcpy(other, mToken, sizeof(other));
+    other[kCacheTokenSize - 1] ^= 1;
+    NpuGraph graph;
+    EXPECT_FALSE(read(other, kDeviceVersion, &graph));
+}
+
+TEST_F(NpuCacheTest, RejectsOtherDevice) {
+    NpuGraph graph;
+    EXPECT_FALSE(read(mToken, "rpi5-npu Coral Edge TPU 16.0", &graph));
+}
+
+TEST_F(NpuCacheTest, RejectsBadMagic) {
+    corrupt(modelFd(), 0);
+    NpuGraph graph;
+    EXPECT_FALSE(read(mToken, kDeviceVersion, &graph));
+}
+
+TEST_F(NpuCacheTest, RejectsCorruptStructure) {
+    struct stat st;
+    ASSERT_EQ(fstat(modelFd(), &st), 0);
+    corrupt(modelFd(), st.st_size - 1);
+    NpuGraph graph;
+    EXPECT_FALSE(read(mToken, kDeviceVersion, &graph));
+}
+
+TEST_F(NpuCacheTest, RejectsCorruptWeights) {
+    corrupt(dataFd(), 5);
+    NpuGraph graph;
+    EXPECT_FALSE(read(mToken, kDeviceVersion, &graph));
+}
+
+TEST_F(NpuCacheTest, RejectsTruncatedFiles) {
+    struct stat st;
+    ASSERT_EQ(fstat(dataFd(), &st), 0);
+    ASSERT_EQ(ftruncate(dataFd(), st.st_size - 1), 0);
+    NpuGraph graph;
+    EXPECT_FALSE(read(mToken, kDeviceVersion, &graph));
+
+    ASSERT_EQ(ftruncate(modelFd(), 4), 0);
+    EXPECT_FALSE(read(mToken, kDeviceVersion, &graph));
+}
+
+TEST_F(NpuCacheTest, RejectsEmptyFiles) {
+    ASSERT_EQ(ftruncate(modelFd(), 0), 0);
+    ASSERT_EQ(ftruncate(dataFd(), 0), 0);
+    NpuGraph graph;
+    EXPECT_FALSE(read(mToken, kDeviceVersion, &graph));
+}
+
+// The packed panels ride after the weights under their own checksum
+TEST_F(NpuCacheTest, PackedWeightsRoundTrip) {
+    std::vector<uint8_t> packed(1000);
+    for (size_t i = 0; i < packed.size(); i++) {
+        packed[i] = static_cast<uint8_t>(i * 13);
+    }
+    ASSERT_TRUE(writeGraphCache(modelFd(), dataFd(), mToken, kDeviceVersion, makeGraph(),
+                                packed));
+    NpuGraph graph;
+    std::vector<uint8_t> restored;
+    ASSERT_TRUE(readGraphCache(modelFd(), dataFd(), mToken, kDeviceVersion, &graph, &restored));
+    EXPECT_EQ(restored, packed);
+    EXPECT_EQ(graph.operands[1].value, makeGraph().operands[1].value);
+
+    struct stat st;
+    ASSERT_EQ(fstat(dataFd(), &st), 0);
+    corrupt(dataFd(), st.st_size - 1);
+    EXPECT_FALSE(readGraphCache(modelFd(), dataFd(), mToken, kDeviceVersion, &graph, &restored));
+}
+
+TEST_F(NpuCacheTest, RewriteReplacesTheCache) {
+    NpuGraph smaller = makeGraph();
+    smaller.operands[1].value.resize(8);
+    smaller.operands[1].dimensions = {8};
+    ASSERT_TRUE(writeGraphCache(modelFd(), dataFd(), mToken, kDeviceVersion, smaller));
+    NpuGraph restored;
+    ASSERT_TRUE(read(mToken, kDeviceVersion, &restored));
+    EXPECT_EQ(restored.operands[1].value.size(), 8u);
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Backend-neutral model graph for the Raspberry Pi 5 NPU HAL
+ */
+
+#include "NpuGraph.h"
+
+#include <cstring>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+size_t npuElementSize(NpuOperandType type) {
+    switch (type) {
+        case NpuOperandType::BOOL:
+        case NpuOperandType::TENSOR_BOOL8:
+        case NpuOperandType::TENSOR_QUANT8_ASYMM:
+        case NpuOperandType::TENSOR_QUANT8_ASYMM_SIGNED:
+        case NpuOperandType::TENSOR_QUANT8_SYMM:
+        case NpuOperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL:
+            return 1;
+        case NpuOperandType::FLOAT16:
+        case NpuOperandType::TENSOR_FLOAT16:
+        case NpuOperandType::TENSOR_QUANT16_SYMM:
+        case NpuOperandType::TENSOR_QUANT16_ASYMM:
+            return 2;
+        case NpuOperandType::FLOAT32:
+        case NpuOperandType::INT32:
+        case NpuOperandType::UINT32:
+        case NpuOperandType::TENSOR_FLOAT32:
+        case NpuOperandType::TENSOR_INT32:
+            return 4;
+    }
+    return 0;
+}
+
+size_t npuOperandSize(NpuOperandType type, const std::vector<uint32_t>& dimensions) {
+    size_t size = npuElementSize(type);
+    for (uint32_t dim : dimensions) {
+        if (dim == 0) {
+            return 0;
+        }
+        size *= dim;
+    }
+    return size;
+}
+
+// Constant values start on this boundary in the weights blob
+constexpr size_t kWeightAlignment = 16;
+
+namespace {
+
+class Writer {
+public:
+    explicit Writer(std::vector<uint8_t>* out) : mOut(out) {}
+
+    template <typename T>
+    void put(T value) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        mOut->insert(mOut->end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    void putVector(const std::vector<T>& values) {
+        put<uint32_t>(values.size());
+        for (const T& value : values) {
+            put(value);
+        }
+    }
+
+private:
+    std::vector<uint8_t>* mOut;
+};
+
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t size) : mData(data), mSize(size) {}
+
+    template <typename T>
+    bool get(T* value) {
+        if (mSize - mPos < sizeof(T)) {
+            return false;
+        }
+        memcpy(value, mData + mPos, sizeof(T));
+        mPos += sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool getVector(std::vector<T>* values) {
+        uint32_t count;
+        // Bound the count by what is left before allocating for it
+        if (!get(&count) || count > (mSize - mPos) / sizeof(T)) {
+            return false;
+        }
+        values->resize(count);
+        for (T& value : *values) {
+            get(&value);
+        }
+        return true;
+    }
+
+    bool done() const { return mPos == mSize; }
+
+private:
+    const uint8_t* mData;
+    size_t mSize;
+    size_t mPos = 0;
+};
+
+bool validIndexes(const std::vector<uint32_t>& indexes, size_t count) {
+    for (uint32_t index : indexes) {
+        if (index >= count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+void serializeGraph(const NpuGraph& graph, std::vector<uint8_t>* structure,
+                    std::vector<uint8_t>* weights) {
+    structure->clear();
+    weights->clear();
+    Writer writer(structure);
+
+    writer.put<uint32_t>(graph.operands.size());
+    for (const NpuOperand& operand : graph.operands) {
+        writer.put<int32_t>(static_cast<int32_t>(operand.type));
+        writer.put<int32_t>(static_cast<int32_t>(operand.lifetime));
+        writer.putVector(operand.dimensions);
+        writer.put(operand.scale);
+        writer.put(operand.zeroPoint);
+        writer.putVector(operand.channelScales);
+        writer.put(operand.channelDim);
+
+        weights->resize((weights->size() + kWeightAlignment - 1) & ~(kWeightAlignment - 1));
+        writer.put<uint64_t>(weights->size());
+        writer.put<uint64_t>(operand.value.size());
+        weights->insert(weights->end(), operand.value.begin(), operand.value.end());
+    }
+
+    writer.put<uint32_t>(graph.operations.size());
+    for (const NpuOperation& operation : graph.operations) {
+        writer.put(operation.type);
+        writer.putVector(operation.inputs);
+        writer.putVector(operation.outputs);
+    }
+
+    writer.putVector(graph.inputIndexes);
+    writer.putVector(graph.outputIndexes);
+    writer.put<uint8_t>(graph.relaxFloat32toFloat16);
+}
+
+bool deserializeGraph(const uint8_t* structure, size_t structureSize, const uint8_t* weights,
+                      size_t weightsSize, NpuGraph* graph) {
+    Reader reader(structure, structureSize);
+    *graph = NpuGraph();
+
+    uint32_t operandCount;
+    if (!reader.get(&operandCount) || operandCount > structureSize) {
+        return false;
+    }
+    graph->operands.resize(operandCount);
+    for (NpuOperand& operand : graph->operands) {
+        int32_t type;
+        int32_t lifetime;
+        uint64_t offset;
+        uint64_t size;
+        if (!reader.get(&type) || !reader.get(&lifetime) ||
+            !reader.getVector(&operand.dimensions) || !reader.get(&operand.scale) ||
+            !reader.get(&operand.zeroPoint) || !reader.getVector(&operand.channelScales) ||
+            !reader.get(&operand.channelDim) || !reader.get(&offset) || !reader.get(&size)) {
+            return false;
+        }
+        operand.type = static_cast<NpuOperandType>(type);
+        operand.lifetime = static_cast<NpuOperandLifetime>(lifetime);
+        if (npuElementSize(operand.type) == 0 ||
+            lifetime < static_cast<int32_t>(NpuOperandLifetime::TEMPORARY) ||
+            lifetime > static_cast<int32_t>(NpuOperandLifetime::NO_VALUE)) {
+            return false;
+        }
+        if (offset > weightsSize || size > weightsSize - offset) {
+            return false;
+        }
+        operand.value.assign(weights + offset, weights + offset + size);
+    }
+
+    uint32_t operationCount;
+    if (!reader.get(&operationCount) || operationCount > structureSize) {
+        return false;
+    }
+    graph->operations.resize(operationCount);
+    for (NpuOperation& operation : graph->operations) {
+        if (!reader.get(&operation.type) || !reader.getVector(&operation.inputs) ||
+            !reader.getVector(&operation.outputs) ||
+            !validIndexes(operation.inputs, operandCount) ||
+            !validIndexes(operation.outputs, operandCount)) {
+            return false;
+        }
+    }
+
+    uint8_t relax;
+    if (!reader.getVector(&graph->inputIndexes) || !reader.getVector(&graph->outputIndexes) ||
+        !reader.get(&relax) || !reader.done()) {
+        return false;
+    }
+    graph->relaxFloat32toFloat16 = relax != 0;
+    return validIndexes(graph->inputIndexes, operandCount) &&
+           validIndexes(graph->outputIndexes, operandCount);
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Backend-neutral model graph for the Raspberry Pi 5 NPU HAL
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// Operand and operation codes keep the NNAPI numbering, so a model handed
+// in through IDevice converts without a lookup table.
+enum class NpuOperandType : int32_t {
+    FLOAT32 = 0,
+    INT32 = 1,
+    UINT32 = 2,
+    TENSOR_FLOAT32 = 3,
+    TENSOR_INT32 = 4,
+    TENSOR_QUANT8_ASYMM = 5,
+    BOOL = 6,
+    TENSOR_QUANT16_SYMM = 7,
+    TENSOR_FLOAT16 = 8,
+    TENSOR_BOOL8 = 9,
+    FLOAT16 = 10,
+    TENSOR_QUANT8_SYMM_PER_CHANNEL = 11,
+    TENSOR_QUANT16_ASYMM = 12,
+    TENSOR_QUANT8_SYMM = 13,
+    TENSOR_QUANT8_ASYMM_SIGNED = 14,
+};
+
+enum class NpuOperandLifetime {
+    TEMPORARY,
+    INPUT,
+    OUTPUT,
+    CONSTANT,
+    NO_VALUE,
+};
+
+struct NpuOperand {
+    NpuOperandType type;
+    NpuOperandLifetime lifetime;
+    std::vector<uint32_t> dimensions;
+    float scale = 0.0f;
+    int32_t zeroPoint = 0;
+    // TENSOR_QUANT8_SYMM_PER_CHANNEL only
+    std::vector<float> channelScales;
+    uint32_t channelDim = 0;
+    // CONSTANT only; copied out of the model so pools can be released
+    std::vector<uint8_t> value;
+};
+
+struct NpuOperation {
+    int32_t type;   // NNAPI OperationType
+    std::vector<uint32_t> inputs;
+    std::vector<uint32_t> outputs;
+};
+
+struct NpuGraph {
+    std::vector<NpuOperand> operands;
+    std::vector<NpuOperation> operations;
+    std::vector<uint32_t> inputIndexes;
+    std::vector<uint32_t> outputIndexes;
+    bool relaxFloat32toFloat16 = false;
+};
+
+// Size in bytes of one element, 0 for unknown types
+size_t npuElementSize(NpuOperandType type);
+
+// Bytes needed for an operand of |dimensions|; 0 if any dimension is unknown
+size_t npuOperandSize(NpuOperandType type, const std::vector<uint32_t>& dimensions);
+
+// Flat form of a graph for the compilation cache. |structure| holds operands,
+// operations and graph inputs/outputs; |weights| holds the constant values
+// back to back, each 16-byte aligned.
+void serializeGraph(const NpuGraph& graph, std::vector<uint8_t>* structure,
+                    std::vector<uint8_t>* weights);
+
+// Rebuilds a graph from serializeGraph() output. Every count, index and
+// offset is checked, so a truncated or corrupt blob fails instead of crashing.
+bool deserializeGraph(const uint8_t* structure, size_t structureSize, const uint8_t* weights,
+                      size_t weightsSize, NpuGraph* graph);
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Inference profiling and Chrome trace export for the Raspberry Pi 5 NPU HAL
+ */
+
+#include "NpuProfiler.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+void NpuProfiler::record(ProfileEvent event) {
+    if (mCapacity == 0) {
+        mDropped++;
+        return;
+    }
+    if (mEvents.size() == mCapacity) {
+        mEvents.pop_front();
+        mDropped++;
+    }
+    mEvents.push_back(std::move(event));
+}
+
+void NpuProfiler::clear() {
+    mEvents.clear();
+    mDropped = 0;
+}
+
+static void appendString(std::string* out, const std::string& value) {
+    out->push_back('"');
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out->push_back('\\');
+            out->push_back(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out->append(escaped);
+        } else {
+            out->push_back(c);
+        }
+    }
+    out->push_back('"');
+}
+
+// Trace timestamps are microseconds; keep the nanoseconds as decimals
+static void appendMicros(std::string* out, int64_t ns) {
+    char value[32];
+    snprintf(value, sizeof(value), "%" PRId64 ".%03" PRId64, ns / 1000, ns % 1000);
+    out->append(value);
+}
+
+std::string NpuProfiler::chromeTrace() const {
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+           "\"args\":{\"name\":\"rpi5 NPU HAL\"}}";
+
+    // One thread track per NPU, named after it
+    std::map<std::string, int> tracks;
+    for (const auto& event : mEvents) {
+        if (tracks.emplace(event.npuId, static_cast<int>(tracks.size()) + 1).second) {
+            out += ",{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" +
+                   std::to_string(tracks[event.npuId]) + ",\"args\":{\"name\":";
+            appendString(&out, event.npuId);
+            out += "}}";
+        }
+    }
+
+    for (const auto& event : mEvents) {
+        out += ",{\"name\":";
+        appendString(&out, event.name);
+        out += ",\"cat\":";
+        appendString(&out, event.backend);
+        out += ",\"ph\":\"X\",\"ts\":";
+        appendMicros(&out, event.startNs);
+        out += ",\"dur\":";
+        appendMicros(&out, event.durationNs);
+        out += ",\"pid\":1,\"tid\":" + std::to_string(tracks[event.npuId]) + ",\"args\":{\"model\":";
+        appendString(&out, event.modelId);
+        out += ",\"backend\":";
+        appendString(&out, event.backend);
+        out += ",\"bytes_in\":" + std::to_string(event.bytesIn) +
+               ",\"bytes_out\":" + std::to_string(event.bytesOut);
+        if (event.weightBytes != 0) {
+            out += ",\"weight_bytes\":" + std::to_string(event.weightBytes);
+        }
+        if (event.operation >= 0) {
+            out += ",\"operation\":" + std::to_string(event.operation);
+        }
+        out += "}}";
+    }
+    out += "]}\n";
+    return out;
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
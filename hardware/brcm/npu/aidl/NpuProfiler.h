@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Inference profiling and Chrome trace export for the Raspberry Pi 5 NPU HAL
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// One span of an inference: the whole run on a device, a layer, a switch
+struct ProfileEvent {
+    std::string name;
+    std::string backend;        // device that ran it
+    std::string npuId;          // one trace track per NPU
+    std::string modelId;
+    int64_t startNs = 0;        // CLOCK_BOOTTIME
+    int64_t durationNs = 0;
+    uint64_t bytesIn = 0;       // sent to the device, or read by the layer
+    uint64_t bytesOut = 0;
+    uint64_t weightBytes = 0;   // constants read by the layer
+    int32_t operation = -1;     // index in the graph, layers only
+};
+
+// Recent events, exported in the Chrome trace event format that
+// chrome://tracing and Perfetto open. The oldest go once it is full.
+// Not thread-safe; the owner holds its lock.
+class NpuProfiler {
+public:
+    static constexpr size_t kDefaultCapacity = 65536;
+
+    explicit NpuProfiler(size_t capacity = kDefaultCapacity) : mCapacity(capacity) {}
+
+    void record(ProfileEvent event);
+    void clear();
+
+    std::string chromeTrace() const;
+
+    size_t size() const { return mEvents.size(); }
+    uint64_t dropped() const { return mDropped; }
+
+private:
+    const size_t mCapacity;
+    std::deque<ProfileEvent> mEvents;
+    uint64_t mDropped = 0;
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,53 @@
+// Copyright (C) 2025 The Android Open Source Project
+
+// Cost of profiling: recording the ~30 layer events of a MobileNet run on
+// the CPU backend, and exporting a full buffer as a Chrome trace.
+
+#include <benchmark/benchmark.h>
+
+#include "NpuProfiler.h"
+
+using namespace aidl::android::hardware::neuralnetworks::rpi5;
+
+static constexpr int kLayers = 30;
+
+static ProfileEvent layer(int index) {
+    ProfileEvent event;
+    event.name = index % 2 == 0 ? "CONV_2D" : "DEPTHWISE_CONV_2D";
+    event.backend = "CPU";
+    event.npuId = "cpu0";
+    event.modelId = "nnapi_0";
+    event.startNs = 1000000000LL + index * 250000LL;
+    event.durationNs = 250000;
+    event.bytesIn = 112 * 112 * 32;
+    event.bytesOut = 112 * 112 * 64;
+    event.weightBytes = 32 * 64;
+    event.operation = index;
+    return event;
+}
+
+static void BM_RecordInference(benchmark::State& state) {
+    NpuProfiler profiler;
+    for (auto _ : state) {
+        for (int i = 0; i < kLayers; i++) {
+            profiler.record(layer(i));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kLayers);
+}
+BENCHMARK(BM_RecordInference);
+
+static void BM_ChromeTrace(benchmark::State& state) {
+    NpuProfiler profiler(state.range(0));
+    for (int i = 0; i < state.range(0); i++) {
+        profiler.record(layer(i % kLayers));
+    }
+    size_t bytes = 0;
+    for (auto _ : state) {
+        std::string trace = profiler.chromeTrace();
+        bytes = trace.size();
+        benchmark::DoNotOptimize(trace);
+    }
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_ChromeTrace)->Arg(1024)->Arg(NpuProfiler::kDefaultCapacity);
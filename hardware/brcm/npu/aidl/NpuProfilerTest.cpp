@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Profiler ring buffer and the Chrome trace JSON it exports
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "NpuProfiler.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+namespace {
+
+ProfileEvent makeEvent(const std::string& name, const std::string& npuId = "hailo0") {
+    ProfileEvent event;
+    event.name = name;
+    event.backend = "Hailo-8";
+    event.npuId = npuId;
+    event.modelId = "model_0";
+    event.startNs = 2000000;
+    event.durationNs = 1500;
+    return event;
+}
+
+// Enough of a JSON reader to tell a well-formed document: strings hold no
+// raw control characters and only valid escapes, brackets pair up
+bool wellFormed(const std::string& json) {
+    std::vector<char> open;
+    for (size_t i = 0; i < json.size(); i++) {
+        const char c = json[i];
+        if (c == '"') {
+            for (i++; i < json.size() && json[i] != '"'; i++) {
+                if (static_cast<unsigned char>(json[i]) < 0x20) {
+                    return false;
+                }
+                if (json[i] != '\\') {
+                    continue;
+                }
+                if (++i == json.size()) {
+                    return false;
+                }
+                if (json[i] == 'u') {
+                    if (i + 4 >= json.size() ||
+                        json.find_first_not_of("0123456789abcdefABCDEF", i + 1) < i + 5) {
+                        return false;
+                    }
+                    i += 4;
+                } else if (std::string("\"\\/bfnrt").find(json[i]) == std::string::npos) {
+                    return false;
+                }
+            }
+            if (i == json.size()) {
+                return false;
+            }
+        } else if (c == '{' || c == '[') {
+            open.push_back(c == '{' ? '}' : ']');
+        } else if (c == '}' || c == ']') {
+            if (open.empty() || open.back() != c) {
+                return false;
+            }
+            open.pop_back();
+        }
+    }
+    return open.empty();
+}
+
+TEST(NpuProfilerTest, EmptyTraceIsValid) {
+    NpuProfiler profiler;
+    const std::string trace = profiler.chromeTrace();
+    EXPECT_TRUE(wellFormed(trace));
+    EXPECT_NE(trace.find("\"traceEvents\":["), std::string::npos);
+}
+
+TEST(NpuProfilerTest, EscapesQuotesBackslashesAndControlCharacters) {
+    NpuProfiler profiler;
+    ProfileEvent event = makeEvent("conv \"stem\"\\1");
+    event.modelId = std::string("line\nbreak\ttab\x01\x1f\0", 17);
+    event.npuId = "usb\\0";
+    profiler.record(event);
+
+    const std::string trace = profiler.chromeTrace();
+    EXPECT_TRUE(wellFormed(trace)) << trace;
+    EXPECT_NE(trace.find("\"name\":\"conv \\\"stem\\\"\\\\1\""), std::string::npos) << trace;
+    EXPECT_NE(trace.find("\"model\":\"line\\u000abreak\\u0009tab\\u0001\\u001f\\u0000\""),
+              std::string::npos) << trace;
+    EXPECT_NE(trace.find("\"args\":{\"name\":\"usb\\\\0\"}"), std::string::npos) << trace;
+}
+
+TEST(NpuProfilerTest, KeepsUtf8AsIs) {
+    NpuProfiler profiler;
+    profiler.record(makeEvent("caf\xc3\xa9 \xe2\x9c\x93"));
+    const std::string trace = profiler.chromeTrace();
+    EXPECT_TRUE(wellFormed(trace));
+    EXPECT_NE(trace.find("\"name\":\"caf\xc3\xa9 \xe2\x9c\x93\""), std::string::npos);
+}
+
+TEST(NpuProfilerTest, TimesAreMicrosecondsWithNanosecondDecimals) {
+    NpuProfiler profiler;
+    ProfileEvent event = makeEvent("run");
+    event.startNs = 1234567;
+    event.durationNs = 42;
+    event.bytesIn = 150528;
+    event.bytesOut = 4004;
+    profiler.record(event);
+    const std::string trace = profiler.chromeTrace();
+    EXPECT_NE(trace.find("\"ts\":1234.567,\"dur\":0.042,"), std::string::npos) << trace;
+    EXPECT_NE(trace.find("\"bytes_in\":150528,\"bytes_out\":4004}"), std::string::npos) << trace;
+}
+
+TEST(NpuProfilerTest, LayerFieldsOnlyWhenSet) {
+    NpuProfiler profiler;
+    ProfileEvent layer = makeEvent("CONV_2D");
+    layer.weightBytes = 864;
+    layer.operation = 3;
+    profiler.record(layer);
+    profiler.record(makeEvent("run"));
+    const std::string trace = profiler.chromeTrace();
+    EXPECT_NE(trace.find("\"weight_bytes\":864,\"operation\":3}"), std::string::npos);
+    EXPECT_EQ(trace.find("weight_bytes"), trace.rfind("weight_bytes"));
+    EXPECT_EQ(trace.find("\"operation\""), trace.rfind("\"operation\""));
+}
+
+TEST(NpuProfilerTest, OneTrackPerNpu) {
+    NpuProfiler profiler;
+    profiler.record(makeEvent("a", "hailo0"));
+    profiler.record(makeEvent("b", "cpu0"));
+    profiler.record(makeEvent("c", "hailo0"));
+    const std::string trace = profiler.chromeTrace();
+    EXPECT_NE(trace.find("\"tid\":1,\"args\":{\"name\":\"hailo0\"}"), std::string::npos);
+    EXPECT_NE(trace.find("\"tid\":2,\"args\":{\"name\":\"cpu0\"}"), std::string::npos);
+    EXPECT_EQ(trace.find("\"name\":\"hailo0\""), trace.rfind("\"name\":\"hailo0\""));
+    EXPECT_NE(trace.find("\"name\":\"c\",\"cat\":\"Hailo-8\",\"ph\":\"X\""), std::string::npos);
+}
+
+TEST(NpuProfilerTest, OldestEventsGoWhenFull) {
+    NpuProfiler profiler(2);
+    profiler.record(makeEvent("first"));
+    profiler.record(makeEvent("second"));
+    profiler.record(makeEvent("third"));
+    EXPECT_EQ(profiler.size(), 2u);
+    EXPECT_EQ(profiler.dropped(), 1u);
+    const std::string trace = profiler.chromeTrace();
+    EXPECT_EQ(trace.find("\"first\""), std::string::npos);
+    EXPECT_NE(trace.find("\"third\""), std::string::npos);
+
+    profiler.clear();
+    EXPECT_EQ(profiler.size(), 0u);
+    EXPECT_EQ(profiler.dropped(), 0u);
+
+    NpuProfiler disabled(0);
+    disabled.record(makeEvent("run"));
+    EXPECT_EQ(disabled.size(), 0u);
+    EXPECT_EQ(disabled.dropped(), 1u);
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
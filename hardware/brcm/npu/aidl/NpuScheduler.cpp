@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Deadline-aware inference queue for the Raspberry Pi 5 NPU HAL
+ */
+
+#include "NpuScheduler.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+void InferenceQueue::push(InferenceHandle handle, InferencePriority priority,
+                          int64_t deadlineNs) {
+    const size_t level = std::min<size_t>(static_cast<size_t>(priority),
+                                          kInferencePriorityCount - 1);
+    const uint64_t deadline = deadlineNs < 0 ? std::numeric_limits<uint64_t>::max()
+                                             : static_cast<uint64_t>(deadlineNs);
+    auto entry = mQueues[level].insert({deadline, mSequence++, handle}).first;
+    mIndex[handle] = {level, entry};
+}
+
+bool InferenceQueue::pop(int64_t nowNs, InferenceHandle* handle,
+                         std::vector<InferenceHandle>* expired) {
+    // Each class is sorted by deadline, so its expired requests are at the front
+    for (auto& queue : mQueues) {
+        while (!queue.empty() && queue.begin()->deadline <= static_cast<uint64_t>(nowNs)) {
+            expired->push_back(queue.begin()->handle);
+            mIndex.erase(queue.begin()->handle);
+            queue.erase(queue.begin());
+        }
+    }
+
+    for (size_t level = kInferencePriorityCount; level-- > 0;) {
+        auto& queue = mQueues[level];
+        if (!queue.empty()) {
+            *handle = queue.begin()->handle;
+            mIndex.erase(*handle);
+            queue.erase(queue.begin());
+            return true;
+        }
+    }
+    return false;
+}
+
+bool InferenceQueue::cancel(InferenceHandle handle) {
+    auto it = mIndex.find(handle);
+    if (it == mIndex.end()) {
+        return false;
+    }
+    mQueues[it->second.priority].erase(it->second.entry);
+    mIndex.erase(it);
+    return true;
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Deadline-aware inference queue for the Raspberry Pi 5 NPU HAL
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// Classes are served strictly in order; earliest deadline first within one
+enum class InferencePriority : int32_t {
+    LOW = 0,
+    NORMAL = 1,
+    HIGH = 2,
+};
+
+constexpr size_t kInferencePriorityCount = 3;
+
+// Runs after every request of its class that has a deadline
+constexpr int64_t kNoDeadline = -1;
+
+// 0 is never handed out
+using InferenceHandle = uint64_t;
+
+struct SchedulerStats {
+    uint64_t completed = 0;
+    uint64_t deadlineMisses = 0;    // ran, but finished after its deadline
+    uint64_t dropped = 0;           // deadline passed while queued, never ran
+    uint64_t cancelled = 0;
+};
+
+// Pending requests of one NPU. Not thread-safe; the owner holds its lock.
+class InferenceQueue {
+public:
+    void push(InferenceHandle handle, InferencePriority priority, int64_t deadlineNs);
+
+    // Next request to run at |nowNs|. Queued requests whose deadline has
+    // passed are removed on the way and appended to |expired|. False if
+    // nothing is left to run.
+    bool pop(int64_t nowNs, InferenceHandle* handle, std::vector<InferenceHandle>* expired);
+
+    // False if |handle| is not queued (unknown, already running or done)
+    bool cancel(InferenceHandle handle);
+
+    size_t size() const { return mIndex.size(); }
+    bool empty() const { return mIndex.empty(); }
+
+private:
+    struct Entry {
+        uint64_t deadline;      // kNoDeadline sorts last
+        uint64_t sequence;      // FIFO among equal deadlines
+        InferenceHandle handle;
+
+        bool operator<(const Entry& other) const {
+            return deadline != other.deadline ? deadline < other.deadline
+                                              : sequence < other.sequence;
+        }
+    };
+
+    struct Location {
+        size_t priority;
+        std::set<Entry>::iterator entry;
+    };
+
+    std::set<Entry> mQueues[kInferencePriorityCount];
+    std::unordered_map<InferenceHandle, Location> mIndex;
+    uint64_t mSequence = 0;
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
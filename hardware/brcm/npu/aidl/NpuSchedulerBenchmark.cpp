@@ -0,0 +1,55 @@
+// Copyright (C) 2025 The Android Open Source Project
+
+// Queue operations with a backlog of camera frames spread over the three
+// priority classes, a quarter of them already past their deadline.
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+#include "NpuScheduler.h"
+
+using namespace aidl::android::hardware::neuralnetworks::rpi5;
+
+static constexpr int64_t kNowNs = 1000000000;
+static constexpr int64_t kFrameNs = 33333333;
+
+static void fill(InferenceQueue* queue, int count, std::mt19937* rng, InferenceHandle* next) {
+    std::uniform_int_distribution<int> priority(0, kInferencePriorityCount - 1);
+    std::uniform_int_distribution<int64_t> deadline(kNowNs - kFrameNs, kNowNs + 3 * kFrameNs);
+    for (int i = 0; i < count; i++) {
+        queue->push((*next)++, static_cast<InferencePriority>(priority(*rng)), deadline(*rng));
+    }
+}
+
+// Steady state: one request in, one out, with |range(0)| queued
+static void BM_PushPop(benchmark::State& state) {
+    std::mt19937 rng(42);
+    InferenceQueue queue;
+    InferenceHandle next = 1;
+    fill(&queue, state.range(0), &rng, &next);
+    std::vector<InferenceHandle> expired;
+    for (auto _ : state) {
+        if (queue.size() < static_cast<size_t>(state.range(0))) {
+            fill(&queue, state.range(0) - queue.size(), &rng, &next);
+        }
+        InferenceHandle handle;
+        expired.clear();
+        benchmark::DoNotOptimize(queue.pop(kNowNs, &handle, &expired));
+    }
+}
+BENCHMARK(BM_PushPop)->Arg(8)->Arg(64)->Arg(512);
+
+static void BM_Cancel(benchmark::State& state) {
+    std::mt19937 rng(42);
+    InferenceQueue queue;
+    InferenceHandle next = 1;
+    fill(&queue, state.range(0), &rng, &next);
+    InferenceHandle victim = 1;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(queue.cancel(victim));
+        fill(&queue, 1, &rng, &next);
+        victim++;
+    }
+}
+BENCHMARK(BM_Cancel)->Arg(64)->Arg(512);
@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * NNAPI prepared model for the Raspberry Pi 5 NPU driver
+ */
+
+#include "PreparedModel.h"
+
+#include <aidl/android/hardware/neuralnetworks/BnExecution.h>
+#include <aidl/android/hardware/neuralnetworks/BnFencedExecutionCallback.h>
+#include <poll.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <android-base/chrono_utils.h>
+
+#define ATRACE_TAG ATRACE_TAG_NNAPI
+#include <log/log.h>
+#include <utils/Trace.h>
+
+#include "Burst.h"
+#include "Npu.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+using ::android::base::boot_clock;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            boot_clock::now().time_since_epoch()).count();
+}
+
+// Blocks until every fence has signalled; false on error or at the deadline
+static bool waitForFences(const std::vector<ndk::ScopedFileDescriptor>& fences,
+                          int64_t deadlineNs) {
+    for (const auto& fence : fences) {
+        struct pollfd pfd = {fence.get(), POLLIN, 0};
+        if (pfd.fd < 0) {
+            return false;
+        }
+        int ret;
+        do {
+            int timeoutMs = -1;
+            if (deadlineNs >= 0) {
+                timeoutMs = std::max<int64_t>(0, (deadlineNs - nowNs()) / 1000000);
+            }
+            ret = poll(&pfd, 1, timeoutMs);
+        } while (ret < 0 && errno == EINTR);
+        if (ret <= 0 || (pfd.revents & (POLLERR | POLLNVAL))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Result of an execution that has already finished when executeFenced returns
+class FencedExecutionCallback : public BnFencedExecutionCallback {
+  public:
+    FencedExecutionCallback(Timing launched, Timing fenced)
+        : launched_(launched), fenced_(fenced) {}
+
+    ndk::ScopedAStatus getExecutionInfo(Timing* timingLaunched, Timing* timingFenced,
+                                        ErrorStatus* _aidl_return) override {
+        *timingLaunched = launched_;
+        *timingFenced = fenced_;
+        *_aidl_return = ErrorStatus::NONE;
+        return ndk::ScopedAStatus::ok();
+    }
+
+  private:
+    const Timing launched_;
+    const Timing fenced_;
+};
+
+// Request validated and its pools mapped once, for any number of runs
+class Execution : public BnExecution {
+  public:
+    Execution(std::shared_ptr<PreparedModel> preparedModel, std::vector<RequestArgument> inputs,
+              std::vector<RequestArgument> outputs, MappedPools pools, bool measureTiming)
+        : prepared_model_(std::move(preparedModel)),
+          inputs_(std::move(inputs)),
+          outputs_(std::move(outputs)),
+          pools_(std::move(pools)),
+          measure_timing_(measureTiming) {}
+
+    ndk::ScopedAStatus executeSynchronously(int64_t deadlineNs,
+                                            ExecutionResult* _aidl_return) override {
+        return prepared_model_->run(inputs_, outputs_, pools_, measure_timing_, deadlineNs,
+                                    _aidl_return);
+    }
+
+    ndk::ScopedAStatus executeFenced(const std::vector<ndk::ScopedFileDescriptor>& waitFor,
+                                     int64_t deadlineNs, int64_t durationNs,
+                                     FencedExecutionResult* _aidl_return) override {
+        return prepared_model_->runFenced(inputs_, outputs_, pools_, waitFor, measure_timing_,
+                                          deadlineNs, durationNs, _aidl_return);
+    }
+
+  private:
+    const std::shared_ptr<PreparedModel> prepared_model_;
+    const std::vector<RequestArgument> inputs_;
+    const std::vector<RequestArgument> outputs_;
+    const MappedPools pools_;
+    const bool measure_timing_;
+};
+
+PreparedModel::PreparedModel(std::string npuId, std::string modelId,
+                             std::shared_ptr<const NpuGraph> graph, InferencePriority priority)
+    : npu_id_(std::move(npuId)),
+      model_id_(std::move(modelId)),
+      graph_(std::move(graph)),
+      priority_(priority) {}
+
+PreparedModel::~PreparedModel() {
+    NpuManager::getInstance().unloadModel(npu_id_, model_id_);
+}
+
+ndk::ScopedAStatus PreparedModel::validate(const std::vector<RequestArgument>& inputs,
+                                           const std::vector<RequestArgument>& outputs,
+                                           const MappedPools& pools) const {
+    if (inputs.size() != graph_->inputIndexes.size() ||
+        outputs.size() != graph_->outputIndexes.size()) {
+        return toAStatus(ErrorStatus::INVALID_ARGUMENT, "request does not match the model");
+    }
+    auto inPool = [&pools](const RequestArgument& arg) {
+        if (arg.hasNoValue) {
+            return true;
+        }
+        const int32_t index = arg.location.poolIndex;
+        return index >= 0 && static_cast<size_t>(index) < pools.size() &&
+               pools[index]->at(arg.location) != nullptr;
+    };
+    if (!std::all_of(inputs.begin(), inputs.end(), inPool) ||
+        !std::all_of(outputs.begin(), outputs.end(), inPool)) {
+        return toAStatus(ErrorStatus::INVALID_ARGUMENT, "request argument outside of its pool");
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus PreparedModel::run(const std::vector<RequestArgument>& inputs,
+                                      const std::vector<RequestArgument>& outputs,
+                                      const MappedPools& pools, bool measureTiming,
+                                      int64_t deadlineNs, ExecutionResult* result) {
+    ATRACE_CALL();
+    const int64_t startNs = nowNs();
+    if (deadlinePassed(deadlineNs)) {
+        return toAStatus(ErrorStatus::MISSED_DEADLINE_TRANSIENT,
+                         "deadline passed before execution");
+    }
+    auto status = validate(inputs, outputs, pools);
+    if (!status.isOk()) {
+        return status;
+    }
+
+    InferenceRequest request;
+    request.modelId = model_id_;
+    request.measureTiming = measureTiming;
+    request.priority = priority_;
+    request.deadlineNs = deadlineNs;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (inputs[i].hasNoValue) {
+            continue;
+        }
+        const DataLocation& location = inputs[i].location;
+        const uint8_t* data = pools[location.poolIndex]->at(location);
+        request.inputs.emplace_back("input" + std::to_string(i),
+                                    std::vector<uint8_t>(data, data + location.length));
+    }
+
+    InferenceResult inference = NpuManager::getInstance().runInference(npu_id_, request);
+    if (inference.expired) {
+        return toAStatus(ErrorStatus::MISSED_DEADLINE_TRANSIENT, "deadline passed while queued");
+    }
+    if (!inference.success) {
+        return toAStatus(ErrorStatus::GENERAL_FAILURE, "inference failed: " + inference.error);
+    }
+
+    result->outputSufficientSize = true;
+    result->outputShapes.resize(outputs.size());
+    for (size_t i = 0; i < outputs.size(); i++) {
+        const RequestArgument& arg = outputs[i];
+        OutputShape& shape = result->outputShapes[i];
+        if (arg.dimensions.empty()) {
+            const auto& dims = graph_->operands[graph_->outputIndexes[i]].dimensions;
+            shape.dimensions.assign(dims.begin(), dims.end());
+        } else {
+            shape.dimensions = arg.dimensions;
+        }
+        shape.isSufficient = true;
+
+        const std::string name = "output" + std::to_string(i);
+        auto it = std::find_if(inference.outputs.begin(), inference.outputs.end(),
+                               [&name](const auto& output) { return output.first == name; });
+        if (arg.hasNoValue) {
+            continue;
+        }
+        if (it == inference.outputs.end()) {
+            // Succeeding here would hand back the caller's buffer untouched
+            return toAStatus(ErrorStatus::GENERAL_FAILURE,
+                             "accelerator returned no data for " + name);
+        }
+        const std::vector<uint8_t>& data = it->second;
+        if (data.size() > static_cast<size_t>(arg.location.length)) {
+            shape.isSufficient = false;
+            result->outputSufficientSize = false;
+            continue;
+        }
+        memcpy(pools[arg.location.poolIndex]->at(arg.location), data.data(), data.size());
+    }
+
+    if (measureTiming && result->outputSufficientSize) {
+        result->timing.timeOnDeviceNs = static_cast<int64_t>(inference.inferenceTimeMs * 1e6);
+        result->timing.timeInDriverNs = nowNs() - startNs;
+    } else {
+        result->timing = {kNoTiming, kNoTiming};
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus PreparedModel::runFenced(const std::vector<RequestArgument>& inputs,
+                                            const std::vector<RequestArgument>& outputs,
+                                            const MappedPools& pools,
+                                            const std::vector<ndk::ScopedFileDescriptor>& waitFor,
+                                            bool measureTiming, int64_t deadlineNs,
+                                            int64_t durationNs, FencedExecutionResult* result) {
+    const int64_t launchedNs = nowNs();
+    if (!waitForFences(waitFor, deadlineNs)) {
+        if (deadlinePassed(deadlineNs)) {
+            return toAStatus(ErrorStatus::MISSED_DEADLINE_TRANSIENT,
+                             "deadline passed waiting for fences");
+        }
+        return toAStatus(ErrorStatus::GENERAL_FAILURE, "sync fence signalled an error");
+    }
+
+    // |durationNs| bounds the execution itself, counted from the last fence
+    const int64_t fencedNs = nowNs();
+    if (durationNs >= 0 && (deadlineNs < 0 || fencedNs + durationNs < deadlineNs)) {
+        deadlineNs = fencedNs + durationNs;
+    }
+
+    ExecutionResult execution;
+    auto status = run(inputs, outputs, pools, measureTiming, deadlineNs, &execution);
+    if (!status.isOk()) {
+        return status;
+    }
+    if (!execution.outputSufficientSize) {
+        // Fenced executions cannot report shapes; the runtime falls back
+        return toAStatus(ErrorStatus::OUTPUT_INSUFFICIENT_SIZE, "output buffer too small");
+    }
+
+    Timing launched = execution.timing;
+    Timing fenced = execution.timing;
+    if (measureTiming) {
+        launched.timeInDriverNs += fencedNs - launchedNs;
+    }
+    result->callback = ndk::SharedRefBase::make<FencedExecutionCallback>(launched, fenced);
+    result->syncFence = ndk::ScopedFileDescriptor();
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus PreparedModel::executeSynchronously(const Request& request, bool measureTiming,
+                                                       int64_t deadlineNs,
+                                                       int64_t loopTimeoutDurationNs,
+                                                       ExecutionResult* _aidl_return) {
+    MappedPools pools;
+    auto status = mapRequestPools(request, &pools);
+    if (!status.isOk()) {
+        return status;
+    }
+    return run(request.inputs, request.outputs, pools, measureTiming, deadlineNs, _aidl_return);
+}
+
+ndk::ScopedAStatus PreparedModel::executeFenced(
+        const Request& request, const std::vector<ndk::ScopedFileDescriptor>& waitFor,
+        bool measureTiming, int64_t deadlineNs, int64_t loopTimeoutDurationNs, int64_t durationNs,
+        FencedExecutionResult* _aidl_return) {
+    MappedPools pools;
+    auto status = mapRequestPools(request, &pools);
+    if (!status.isOk()) {
+        return status;
+    }
+    return runFenced(request.inputs, request.outputs, pools, waitFor, measureTiming, deadlineNs,
+                     durationNs, _aidl_return);
+}
+
+ndk::ScopedAStatus PreparedModel::configureExecutionBurst(std::shared_ptr<IBurst>* _aidl_return) {
+    *_aidl_return = ndk::SharedRefBase::make<Burst>(ref<PreparedModel>());
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus PreparedModel::createReusableExecution(
+        const Request& request, const ExecutionConfig& config,
+        std::shared_ptr<IExecution>* _aidl_return) {
+    MappedPools pools;
+    auto status = mapRequestPools(request, &pools);
+    if (!status.isOk()) {
+        return status;
+    }
+    status = validate(request.inputs, request.outputs, pools);
+    if (!status.isOk()) {
+        return status;
+    }
+    *_aidl_return = ndk::SharedRefBase::make<Execution>(ref<PreparedModel>(), request.inputs,
+                                                        request.outputs, std::move(pools),
+                                                        config.measureTiming);
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus PreparedModel::executeSynchronouslyWithConfig(const Request& request,
+                                                                 const ExecutionConfig& config,
+                                                                 int64_t deadlineNs,
+                                                                 ExecutionResult* _aidl_return) {
+    return executeSynchronously(request, config.measureTiming, deadlineNs,
+                                config.loopTimeoutDurationNs, _aidl_return);
+}
+
+ndk::ScopedAStatus PreparedModel::executeFencedWithConfig(
+        const Request& request, const std::vector<ndk::ScopedFileDescriptor>& waitFor,
+        const ExecutionConfig& config, int64_t deadlineNs, int64_t durationNs,
+        FencedExecutionResult* _aidl_return) {
+    return executeFenced(request, waitFor, config.measureTiming, deadlineNs,
+                         config.loopTimeoutDurationNs, durationNs, _aidl_return);
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
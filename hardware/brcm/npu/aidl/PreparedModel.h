@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * NNAPI prepared model for the Raspberry Pi 5 NPU driver
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/neuralnetworks/BnPreparedModel.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "NnapiUtils.h"
+#include "NpuGraph.h"
+#include "NpuScheduler.h"
+
+namespace aidl::android::hardware::neuralnetworks::rpi5 {
+
+// A graph loaded on one NPU through NpuManager. One-shot, burst and reusable
+// executions all end up in run() once their request pools are mapped; they
+// differ only in how long those mappings live.
+class PreparedModel : public BnPreparedModel {
+  public:
+    PreparedModel(std::string npuId, std::string modelId, std::shared_ptr<const NpuGraph> graph,
+                  InferencePriority priority);
+    ~PreparedModel() override;
+
+    ndk::ScopedAStatus executeSynchronously(const Request& request, bool measureTiming,
+                                            int64_t deadlineNs, int64_t loopTimeoutDurationNs,
+                                            ExecutionResult* _aidl_return) override;
+    ndk::ScopedAStatus executeFenced(const Request& request,
+                                     const std::vector<ndk::ScopedFileDescriptor>& waitFor,
+                                     bool measureTiming, int64_t deadlineNs,
+                                     int64_t loopTimeoutDurationNs, int64_t durationNs,
+                                     FencedExecutionResult* _aidl_return) override;
+    ndk::ScopedAStatus configureExecutionBurst(std::shared_ptr<IBurst>* _aidl_return) override;
+    ndk::ScopedAStatus createReusableExecution(const Request& request,
+                                               const ExecutionConfig& config,
+                                               std::shared_ptr<IExecution>* _aidl_return) override;
+    ndk::ScopedAStatus executeSynchronouslyWithConfig(const Request& request,
+                                                      const ExecutionConfig& config,
+                                                      int64_t deadlineNs,
+                                                      ExecutionResult* _aidl_return) override;
+    ndk::ScopedAStatus executeFencedWithConfig(
+            const Request& request, const std::vector<ndk::ScopedFileDescriptor>& waitFor,
+            const ExecutionConfig& config, int64_t deadlineNs, int64_t durationNs,
+            FencedExecutionResult* _aidl_return) override;
+
+    // Checks argument counts and that every location lies inside its pool
+    ndk::ScopedAStatus validate(const std::vector<RequestArgument>& inputs,
+                                const std::vector<RequestArgument>& outputs,
+                                const MappedPools& pools) const;
+    ndk::ScopedAStatus run(const std::vector<RequestArgument>& inputs,
+                           const std::vector<RequestArgument>& outputs, const MappedPools& pools,
+                           bool measureTiming, int64_t deadlineNs, ExecutionResult* result);
+    // Waits for |waitFor| and then runs synchronously; the returned sync
+    // fence is therefore always already signalled (-1)
+    ndk::ScopedAStatus runFenced(const std::vector<RequestArgument>& inputs,
+                                 const std::vector<RequestArgument>& outputs,
+                                 const MappedPools& pools,
+                                 const std::vector<ndk::ScopedFileDescriptor>& waitFor,
+                                 bool measureTiming, int64_t deadlineNs, int64_t durationNs,
+                                 FencedExecutionResult* result);
+
+  private:
+    const std::string npu_id_;
+    const std::string model_id_;
+    const std::shared_ptr<const NpuGraph> graph_;
+    const InferencePriority priority_;
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::rpi5
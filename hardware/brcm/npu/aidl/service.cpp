@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * Neural Networks HAL AIDL Service Main for Raspberry Pi 5
+ */
+
+#include "Device.h"
+#include "Npu.h"
+
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android/binder_manager.h>
+#include <android/binder_process.h>
+
+using aidl::android::hardware::neuralnetworks::rpi5::Device;
+using aidl::android::hardware::neuralnetworks::rpi5::kCpuNpuId;
+using aidl::android::hardware::neuralnetworks::rpi5::NpuManager;
+using aidl::android::hardware::neuralnetworks::rpi5::NpuType;
+using aidl::android::hardware::neuralnetworks::rpi5::WarmupConfig;
+
+// Each execution blocks a binder thread until the NPU is done
+constexpr int kMaxThreads = 4;
+
+int main() {
+    ABinderProcess_setThreadPoolMaxThreadCount(kMaxThreads);
+    ABinderProcess_startThreadPool();
+
+    NpuManager& npus = NpuManager::getInstance();
+    npus.initialize();
+
+    // Only the CPU backend has an inference runtime so far; accelerators are
+    // detected and scheduled but cannot produce outputs, so the single NNAPI
+    // device runs on the CPU whatever is plugged in
+    const std::string primary = npus.getPrimaryNpu();
+    if (!primary.empty() && npus.getNpuInfo(primary).type != NpuType::CPU_FALLBACK) {
+        LOG(WARNING) << "NPU " << primary << " has no inference runtime; "
+                     << "rpi5 NNAPI device runs on the CPU";
+    }
+    const std::string npuId = kCpuNpuId;
+
+    // Clients already wait in prepareModel; the first execution should not
+    // wait again for page faults and scratch allocation
+    WarmupConfig warmup;
+    warmup.inferences = 2;
+    warmup.lockPages = true;
+    npus.setWarmupConfig(npuId, warmup);
+
+    // Per-inference profiles for `dumpsys` to write out as a Chrome trace;
+    // see Device::dump()
+    if (::android::base::GetBoolProperty("persist.vendor.npu.profile", false)) {
+        npus.setProfiling(true);
+    }
+
+    std::shared_ptr<Device> device = ndk::SharedRefBase::make<Device>(npuId);
+
+    const std::string instance = std::string() + Device::descriptor + "/rpi5";
+    binder_status_t status = AServiceManager_addService(
+            device->asBinder().get(), instance.c_str());
+    CHECK_EQ(status, STATUS_OK);
+
+    LOG(INFO) << "Raspberry Pi 5 Neural Networks HAL started on " << npuId;
+
+    ABinderProcess_joinThreadPool();
+    return EXIT_FAILURE;  // Should not reach here
+}
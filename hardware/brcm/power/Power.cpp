@@ -15,13 +15,17 @@
  */
 
 #define LOG_TAG "PowerHAL_RPi5"
+#define ATRACE_TAG ATRACE_TAG_POWER
 
 #include <android-base/logging.h>
 #include <android/hardware/power/1.3/IPower.h>
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
+#include <utils/Trace.h>
 
-#include <fstream>
+#include <Sysfs.h>
+
+#include <map>
 #include <string>
 #include <mutex>
 
@@ -37,6 +41,7 @@ using ::android::hardware::Void;
 using ::android::hardware::power::V1_0::Feature;
 using ::android::hardware::power::V1_0::PowerHint;
 using ::android::hardware::power::V1_0::Status;
+using ::android::hardware::brcm::sysfs::SysfsFile;
 
 // CPU frequency paths for Raspberry Pi 5
 constexpr char CPU_FREQ_MAX[] = "/sys/devices/system/cpu/cpu0/cpufreq/scaling_max_freq";
@@ -94,6 +99,11 @@ private:
     std::string readFile(const char* path);
     int readInt(const char* path);
 
+    // Hints repeat the same few writes; keep the files open and skip
+    // writes of unchanged values
+    std::mutex mFileLock;
+    std::map<std::string, SysfsFile> mFiles;
+
     std::mutex mMutex;
     bool mInteractive;
     bool mSustainedPerformance;
@@ -108,27 +118,34 @@ Power::Power() : mInteractive(true), mSustainedPerformance(false),
 }
 
 bool Power::writeFile(const char* path, const std::string& value) {
-    std::ofstream file(path);
-    if (!file.is_open()) {
-        LOG(ERROR) << "Failed to open: " << path;
+    std::lock_guard<std::mutex> lock(mFileLock);
+    auto it = mFiles.find(path);
+    if (it == mFiles.end()) {
+        it = mFiles.emplace(path, SysfsFile(path, O_WRONLY)).first;
+    }
+    if (!it->second.write(value)) {
+        PLOG(ERROR) << "Failed to write " << value << " to " << path;
         return false;
     }
-    file << value;
-    return file.good();
+    // Frequency limits show up as counters named after their node
+    int64_t freq;
+    if (ATRACE_ENABLED() &&
+        ::android::hardware::brcm::sysfs::parseInt(value, &freq)) {
+        ATRACE_INT64(path, freq);
+    }
+    return true;
 }
 
 std::string Power::readFile(const char* path) {
-    std::ifstream file(path);
     std::string value;
-    if (file.is_open()) {
-        file >> value;
-    }
+    ::android::hardware::brcm::sysfs::readString(path, &value);
     return value;
 }
 
 int Power::readInt(const char* path) {
-    std::string value = readFile(path);
-    return value.empty() ? 0 : std::stoi(value);
+    int value = 0;
+    ::android::hardware::brcm::sysfs::readInt(path, &value);
+    return value;
 }
 
 void Power::setPerformanceMode(bool enable) {
@@ -139,6 +156,7 @@ void Power::setPerformanceMode(bool enable) {
         writeFile(CPU_FREQ_MIN, std::to_string(CPU_FREQ_PERFORMANCE));
         writeFile(GPU_FREQ_MIN, std::to_string(GPU_FREQ_PERFORMANCE));
         mCurrentProfile = 2;
+        ATRACE_INT("power profile", mCurrentProfile);
         LOG(INFO) << "Performance mode enabled";
     }
 }
@@ -151,6 +169,7 @@ void Power::setPowersaveMode(bool enable) {
         writeFile(CPU_FREQ_MAX, std::to_string(CPU_FREQ_POWERSAVE));
         writeFile(GPU_FREQ_MAX, std::to_string(GPU_FREQ_POWERSAVE));
         mCurrentProfile = 0;
+        ATRACE_INT("power profile", mCurrentProfile);
         LOG(INFO) << "Powersave mode enabled";
     }
 }
@@ -164,6 +183,7 @@ void Power::setBalancedMode() {
     writeFile(GPU_FREQ_MIN, std::to_string(GPU_FREQ_POWERSAVE));
     writeFile(GPU_FREQ_MAX, std::to_string(GPU_FREQ_PERFORMANCE));
     mCurrentProfile = 1;
+    ATRACE_INT("power profile", mCurrentProfile);
     LOG(INFO) << "Balanced mode enabled";
 }
 
@@ -204,6 +224,7 @@ void Power::handleInteraction(int32_t duration) {
 }
 
 Return<void> Power::setInteractive(bool interactive) {
+    ATRACE_CALL();
     mInteractive = interactive;
     
     if (!interactive) {
@@ -222,6 +243,7 @@ Return<void> Power::setInteractive(bool interactive) {
 }
 
 Return<void> Power::powerHint(PowerHint hint, int32_t data) {
+    ATRACE_CALL();
     switch (hint) {
         case PowerHint::VSYNC:
             // VSync hint - not much we can do
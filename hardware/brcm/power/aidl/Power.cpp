@@ -12,12 +12,13 @@
  */
 
 #define LOG_TAG "android.hardware.power-service.rpi5"
+#define ATRACE_TAG ATRACE_TAG_POWER
 
 #include "Power.h"
 
 #include <android-base/logging.h>
-#include <android-base/file.h>
 #include <android-base/strings.h>
+#include <utils/Trace.h>
 
 namespace aidl {
 namespace android {
@@ -35,75 +36,66 @@ static constexpr const char* kCpuMaxFreqPath =
     "/sys/devices/system/cpu/cpu0/cpufreq/scaling_max_freq";
 static constexpr const char* kCpuMinFreqPath = 
     "/sys/devices/system/cpu/cpu0/cpufreq/scaling_min_freq";
-
-Power::Power() {
+static constexpr const char* kCpuInfoMinFreqPath =
+    "/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_min_freq";
+static constexpr const char* kCpuInfoMaxFreqPath =
+    "/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq";
+
+Power::Power()
+    : cpu_governor_(kCpuGovernorPath, O_WRONLY),
+      cpu_max_freq_(kCpuMaxFreqPath, O_WRONLY),
+      cpu_min_freq_(kCpuMinFreqPath, O_WRONLY),
+      range_{1500000, 2400000} {
+    namespace sysfs = ::android::hardware::brcm::sysfs;
+    sysfs::readInt(kCpuInfoMinFreqPath, &range_.min_khz);
+    sysfs::readInt(kCpuInfoMaxFreqPath, &range_.max_khz);
+    policy_ = {nullptr, range_.min_khz, range_.max_khz};
     LOG(INFO) << "Raspberry Pi 5 Power HAL AIDL initialized";
 }
 
 ndk::ScopedAStatus Power::setMode(Mode type, bool enabled) {
     LOG(DEBUG) << "setMode: " << static_cast<int>(type) << " enabled: " << enabled;
+    if (ATRACE_ENABLED()) {
+        ATRACE_INT(("mode " + toString(type)).c_str(), enabled);
+    }
     
+    uint32_t mode = 0;
     switch (type) {
         case Mode::LOW_POWER:
-            if (enabled) {
-                ::android::base::WriteStringToFile("powersave", kCpuGovernorPath);
-                ::android::base::WriteStringToFile("1500000", kCpuMaxFreqPath);
-            } else {
-                ::android::base::WriteStringToFile("schedutil", kCpuGovernorPath);
-                ::android::base::WriteStringToFile("2400000", kCpuMaxFreqPath);
-            }
+            mode = kLowPower;
             break;
-            
         case Mode::SUSTAINED_PERFORMANCE:
-            if (enabled) {
-                ::android::base::WriteStringToFile("performance", kCpuGovernorPath);
-                ::android::base::WriteStringToFile("2000000", kCpuMaxFreqPath);
-                ::android::base::WriteStringToFile("2000000", kCpuMinFreqPath);
-            } else {
-                ::android::base::WriteStringToFile("schedutil", kCpuGovernorPath);
-                ::android::base::WriteStringToFile("1500000", kCpuMinFreqPath);
-            }
-            break;
-            
-        case Mode::LAUNCH:
-        case Mode::INTERACTIVE:
-            if (enabled) {
-                ::android::base::WriteStringToFile("schedutil", kCpuGovernorPath);
-                ::android::base::WriteStringToFile("2400000", kCpuMaxFreqPath);
-            }
+            mode = kSustainedPerformance;
             break;
-            
         case Mode::DEVICE_IDLE:
-            if (enabled) {
-                ::android::base::WriteStringToFile("powersave", kCpuGovernorPath);
-                ::android::base::WriteStringToFile("1000000", kCpuMaxFreqPath);
-            } else {
-                ::android::base::WriteStringToFile("schedutil", kCpuGovernorPath);
-                ::android::base::WriteStringToFile("2400000", kCpuMaxFreqPath);
-            }
+            mode = kDeviceIdle;
             break;
-            
-        case Mode::DISPLAY_INACTIVE:
-        case Mode::AUDIO_STREAMING_LOW_LATENCY:
-        case Mode::CAMERA_STREAMING_SECURE:
-        case Mode::CAMERA_STREAMING_LOW:
-        case Mode::CAMERA_STREAMING_MID:
-        case Mode::CAMERA_STREAMING_HIGH:
-        case Mode::VR:
-        case Mode::EXPENSIVE_RENDERING:
-        case Mode::FIXED_PERFORMANCE:
-        case Mode::GAME:
-        case Mode::GAME_LOADING:
-            // Handle other modes as needed
+        case Mode::LAUNCH:
+            mode = kLaunch;
             break;
-            
         default:
-            break;
+            // INTERACTIVE and the rest leave the CPU policy alone
+            return ndk::ScopedAStatus::ok();
     }
     
+    std::lock_guard<std::mutex> lock(lock_);
+    modes_ = enabled ? (modes_ | mode) : (modes_ & ~mode);
+    applyPolicy(resolveCpuPolicy(modes_, range_));
     return ndk::ScopedAStatus::ok();
 }
 
+void Power::applyPolicy(const CpuPolicy& policy) {
+    cpu_governor_.write(policy.governor);
+    if (writeMaxFirst(policy_, policy)) {
+        cpu_max_freq_.writeInt(policy.max_khz);
+        cpu_min_freq_.writeInt(policy.min_khz);
+    } else {
+        cpu_min_freq_.writeInt(policy.min_khz);
+        cpu_max_freq_.writeInt(policy.max_khz);
+    }
+    policy_ = policy;
+}
+
 ndk::ScopedAStatus Power::isModeSupported(Mode type, bool* _aidl_return) {
     switch (type) {
         case Mode::LOW_POWER:
@@ -122,11 +114,15 @@ ndk::ScopedAStatus Power::isModeSupported(Mode type, bool* _aidl_return) {
 
 ndk::ScopedAStatus Power::setBoost(Boost type, int32_t durationMs) {
     LOG(DEBUG) << "setBoost: " << static_cast<int>(type) << " duration: " << durationMs;
+    if (ATRACE_ENABLED()) {
+        ATRACE_INT(("boost " + toString(type)).c_str(), durationMs);
+    }
+    std::lock_guard<std::mutex> lock(lock_);
     
     switch (type) {
         case Boost::INTERACTION:
             // Short burst to max frequency
-            ::android::base::WriteStringToFile("performance", kCpuGovernorPath);
+            cpu_governor_.write("performance");
             // Would need a timer to restore - simplified for now
             break;
             
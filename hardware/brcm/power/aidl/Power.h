@@ -14,6 +14,11 @@
 #pragma once
 
 #include <aidl/android/hardware/power/BnPower.h>
+#include <Sysfs.h>
+
+#include "PowerProfile.h"
+
+#include <mutex>
 
 namespace aidl {
 namespace android {
@@ -52,6 +57,19 @@ class Power : public BnPower {
             ChannelConfig* config) override;
             
     ndk::ScopedAStatus closeSessionChannel(int32_t tgid, int32_t uid) override;
+
+  private:
+    void applyPolicy(const CpuPolicy& policy);
+    
+    std::mutex lock_;
+    // Held open; mode changes rewrite the same values often
+    ::android::hardware::brcm::sysfs::SysfsFile cpu_governor_;
+    ::android::hardware::brcm::sysfs::SysfsFile cpu_max_freq_;
+    ::android::hardware::brcm::sysfs::SysfsFile cpu_min_freq_;
+    
+    uint32_t modes_ = 0;    // PolicyMode bits
+    CpuRange range_;
+    CpuPolicy policy_;      // last applied
 };
 
 }  // namespace rpi5
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * CPU policy resolution for the Raspberry Pi 5 Power HAL
+ */
+
+#include "PowerProfile.h"
+
+#include <algorithm>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace rpi5 {
+
+static constexpr int64_t kSustainedKhz = 2000000;
+static constexpr int64_t kLowPowerMaxKhz = 1500000;
+static constexpr int64_t kDeviceIdleMaxKhz = 1000000;
+
+CpuPolicy resolveCpuPolicy(uint32_t modes, const CpuRange& range) {
+    CpuPolicy policy = {"schedutil", range.min_khz, range.max_khz};
+    
+    if (modes & kSustainedPerformance) {
+        // Fixed below the top step so the clock holds without throttling
+        policy = {"performance", kSustainedKhz, kSustainedKhz};
+    } else if (modes & kLaunch) {
+        // Full range, ignoring power saving for the duration
+    } else if (modes & kDeviceIdle) {
+        policy = {"powersave", range.min_khz, kDeviceIdleMaxKhz};
+    } else if (modes & kLowPower) {
+        policy = {"powersave", range.min_khz, kLowPowerMaxKhz};
+    }
+    
+    policy.min_khz = std::clamp(policy.min_khz, range.min_khz, range.max_khz);
+    policy.max_khz = std::clamp(policy.max_khz, policy.min_khz, range.max_khz);
+    return policy;
+}
+
+bool writeMaxFirst(const CpuPolicy& current, const CpuPolicy& next) {
+    return next.min_khz > current.max_khz;
+}
+
+}  // namespace rpi5
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
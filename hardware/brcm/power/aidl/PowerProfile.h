@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * CPU policy resolution for the Raspberry Pi 5 Power HAL. Free of binder
+ * and sysfs so it builds for the host as libbrcm_power_profile.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace rpi5 {
+
+// Modes that shape the CPU policy. The HAL tracks which are active and
+// resolves the policy from the whole set, so turning one mode off doesn't
+// undo another that is still on.
+enum PolicyMode : uint32_t {
+    kLowPower = 1 << 0,
+    kSustainedPerformance = 1 << 1,
+    kDeviceIdle = 1 << 2,
+    kLaunch = 1 << 3,
+};
+
+struct CpuPolicy {
+    const char* governor;
+    int64_t min_khz;
+    int64_t max_khz;
+};
+
+// Range of the cluster, from cpuinfo_min_freq/cpuinfo_max_freq
+struct CpuRange {
+    int64_t min_khz;
+    int64_t max_khz;
+};
+
+// In priority order: sustained performance pins the clock, a launch lifts
+// any power saving, then device idle, then low power. With none of them
+// active schedutil gets the full range.
+CpuPolicy resolveCpuPolicy(uint32_t modes, const CpuRange& range);
+
+// The kernel rejects a min above the current max and a max below the
+// current min. True when going from |current| to |next| has to raise max
+// before min; otherwise min is lowered before max.
+bool writeMaxFirst(const CpuPolicy& current, const CpuPolicy& next);
+
+}  // namespace rpi5
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Policy resolution from the set of active modes and the order of the
+ * frequency writes.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "PowerProfile.h"
+
+using namespace aidl::android::hardware::power::impl::rpi5;
+
+static const CpuRange kRange = {1500000, 2400000};
+
+TEST(PowerProfileTest, NoModesGivesSchedutilFullRange) {
+    CpuPolicy policy = resolveCpuPolicy(0, kRange);
+    EXPECT_EQ(std::string(policy.governor), "schedutil");
+    EXPECT_EQ(policy.min_khz, kRange.min_khz);
+    EXPECT_EQ(policy.max_khz, kRange.max_khz);
+}
+
+TEST(PowerProfileTest, SustainedPerformanceWinsOverEverything) {
+    CpuPolicy policy = resolveCpuPolicy(
+            kLowPower | kSustainedPerformance | kDeviceIdle | kLaunch, kRange);
+    EXPECT_EQ(std::string(policy.governor), "performance");
+    EXPECT_EQ(policy.min_khz, policy.max_khz);
+}
+
+TEST(PowerProfileTest, LaunchLiftsPowerSaving) {
+    CpuPolicy policy = resolveCpuPolicy(kLowPower | kLaunch, kRange);
+    EXPECT_EQ(std::string(policy.governor), "schedutil");
+    EXPECT_EQ(policy.max_khz, kRange.max_khz);
+}
+
+TEST(PowerProfileTest, DeviceIdleCapsBelowLowPower) {
+    CpuPolicy idle = resolveCpuPolicy(kDeviceIdle | kLowPower, kRange);
+    CpuPolicy lowPower = resolveCpuPolicy(kLowPower, kRange);
+    EXPECT_EQ(std::string(idle.governor), "powersave");
+    EXPECT_LE(idle.max_khz, lowPower.max_khz);
+}
+
+TEST(PowerProfileTest, TurningOneModeOffKeepsTheOther) {
+    // Low power stays in force after device idle ends
+    CpuPolicy policy = resolveCpuPolicy((kDeviceIdle | kLowPower) & ~kDeviceIdle, kRange);
+    EXPECT_EQ(policy.max_khz, resolveCpuPolicy(kLowPower, kRange).max_khz);
+    EXPECT_LT(policy.max_khz, kRange.max_khz);
+}
+
+TEST(PowerProfileTest, PolicyStaysInsideTheRange) {
+    const CpuRange narrow = {600000, 1200000};
+    for (uint32_t modes = 0; modes < 16; modes++) {
+        CpuPolicy policy = resolveCpuPolicy(modes, narrow);
+        EXPECT_GE(policy.min_khz, narrow.min_khz) << modes;
+        EXPECT_LE(policy.max_khz, narrow.max_khz) << modes;
+        EXPECT_LE(policy.min_khz, policy.max_khz) << modes;
+    }
+}
+
+TEST(PowerProfileTest, RaisingAboveTheCurrentMaxWritesMaxFirst) {
+    CpuPolicy idle = resolveCpuPolicy(kDeviceIdle, kRange);
+    CpuPolicy sustained = resolveCpuPolicy(kSustainedPerformance, kRange);
+    ASSERT_GT(sustained.min_khz, idle.max_khz);
+    EXPECT_TRUE(writeMaxFirst(idle, sustained));
+    // Back down: the new max is below the current min, so min goes first
+    EXPECT_FALSE(writeMaxFirst(sustained, idle));
+}
+
+TEST(PowerProfileTest, OverlappingRangesWriteMinFirst) {
+    CpuPolicy full = resolveCpuPolicy(0, kRange);
+    CpuPolicy lowPower = resolveCpuPolicy(kLowPower, kRange);
+    EXPECT_FALSE(writeMaxFirst(full, lowPower));
+    EXPECT_FALSE(writeMaxFirst(lowPower, full));
+}
@@ -0,0 +1,332 @@
+// Copyright (C) 2025 The Android Open Source Project
+// Shared epoll event loop for the Raspberry Pi 5 HALs
+
+#include "Reactor.h"
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <cutils/uevent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace android {
+namespace hardware {
+namespace brcm {
+
+static constexpr int kMaxEvents = 16;
+static constexpr size_t kUeventBufferSize = 64 * 1024;
+
+static uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static struct timespec toTimespec(std::chrono::nanoseconds ns) {
+    struct timespec ts;
+    ts.tv_sec = ns.count() / 1000000000LL;
+    ts.tv_nsec = ns.count() % 1000000000LL;
+    return ts;
+}
+
+Reactor& Reactor::get() {
+    // Leaked on purpose: handlers may still be registered from static
+    // destructors at exit
+    static Reactor* sReactor = new Reactor();
+    return *sReactor;
+}
+
+Reactor::Reactor() {
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEpollFd < 0) {
+        PLOG(FATAL) << "Failed to create epoll fd";
+    }
+    std::thread(&Reactor::threadFunc, this).detach();
+}
+
+Reactor::Handle Reactor::add(const std::string& name, Kind kind, int fd, uint32_t events,
+                             FdHandler handler) {
+    if (fd < 0) {
+        return 0;
+    }
+
+    auto entry = std::make_shared<Entry>();
+    entry->kind = kind;
+    entry->fd = fd;
+    entry->handler = std::move(handler);
+    entry->stats.name = name;
+
+    std::lock_guard<std::mutex> lock(mLock);
+    Handle handle = mNextHandle++;
+
+    struct epoll_event ev = {};
+    ev.events = events;
+    ev.data.u64 = handle;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        PLOG(ERROR) << "Failed to add " << name << " to the reactor";
+        return 0;
+    }
+    mEntries[handle] = std::move(entry);
+    return handle;
+}
+
+Reactor::Handle Reactor::addFd(const std::string& name, int fd, uint32_t events,
+                               FdHandler handler) {
+    return add(name, Kind::FD, fd, events, std::move(handler));
+}
+
+bool Reactor::modifyFd(Handle handle, uint32_t events) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mEntries.find(handle);
+    if (it == mEntries.end()) {
+        return false;
+    }
+    struct epoll_event ev = {};
+    ev.events = events;
+    ev.data.u64 = handle;
+    return epoll_ctl(mEpollFd, EPOLL_CTL_MOD, it->second->fd, &ev) == 0;
+}
+
+Reactor::Handle Reactor::addTimer(const std::string& name, Callback callback) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        PLOG(ERROR) << "Failed to create timerfd for " << name;
+        return 0;
+    }
+    Handle handle = add(name, Kind::TIMER, fd, EPOLLIN,
+                        [callback = std::move(callback)](uint32_t) { callback(); });
+    if (handle == 0) {
+        close(fd);
+    }
+    return handle;
+}
+
+bool Reactor::armTimer(Handle handle, std::chrono::nanoseconds delay,
+                       std::chrono::nanoseconds period) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mEntries.find(handle);
+    if (it == mEntries.end() || it->second->kind != Kind::TIMER) {
+        return false;
+    }
+
+    // A zero it_value would disarm the timer instead of firing now
+    if (delay.count() <= 0) {
+        delay = std::chrono::nanoseconds(1);
+    }
+    struct itimerspec spec = {};
+    spec.it_value = toTimespec(delay);
+    spec.it_interval = toTimespec(period);
+
+    Entry& entry = *it->second;
+    entry.deadlineNs = nowNs() + delay.count();
+    entry.periodNs = period.count();
+    if (timerfd_settime(entry.fd, 0, &spec, nullptr) < 0) {
+        PLOG(ERROR) << "Failed to arm " << entry.stats.name;
+        entry.deadlineNs = 0;
+        return false;
+    }
+    return true;
+}
+
+bool Reactor::disarmTimer(Handle handle) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mEntries.find(handle);
+    if (it == mEntries.end() || it->second->kind != Kind::TIMER) {
+        return false;
+    }
+    struct itimerspec spec = {};
+    it->second->deadlineNs = 0;
+    return timerfd_settime(it->second->fd, 0, &spec, nullptr) == 0;
+}
+
+Reactor::Handle Reactor::addPeriodic(const std::string& name, std::chrono::nanoseconds period,
+                                     Callback callback) {
+    Handle handle = addTimer(name, std::move(callback));
+    if (handle != 0 && !armTimer(handle, period, period)) {
+        remove(handle);
+        return 0;
+    }
+    return handle;
+}
+
+Reactor::Handle Reactor::addEvent(const std::string& name, Callback callback) {
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0) {
+        PLOG(ERROR) << "Failed to create eventfd for " << name;
+        return 0;
+    }
+    Handle handle = add(name, Kind::EVENT, fd, EPOLLIN,
+                        [callback = std::move(callback)](uint32_t) { callback(); });
+    if (handle == 0) {
+        close(fd);
+    }
+    return handle;
+}
+
+bool Reactor::signal(Handle handle) {
+    int fd;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        auto it = mEntries.find(handle);
+        if (it == mEntries.end() || it->second->kind != Kind::EVENT) {
+            return false;
+        }
+        fd = it->second->fd;
+    }
+    uint64_t value = 1;
+    return TEMP_FAILURE_RETRY(write(fd, &value, sizeof(value))) == sizeof(value);
+}
+
+Reactor::Handle Reactor::addUevent(const std::string& name, UeventHandler handler) {
+    int fd = uevent_open_socket(kUeventBufferSize, true);
+    if (fd < 0) {
+        PLOG(ERROR) << "Failed to open uevent socket for " << name;
+        return 0;
+    }
+    // Drained until empty on every wakeup
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    Handle handle = add(name, Kind::UEVENT, fd, EPOLLIN,
+                        [fd, handler = std::move(handler)](uint32_t) {
+                            char msg[2048];
+                            ssize_t length;
+                            // Only accepts messages sent by the kernel
+                            while ((length = uevent_kernel_multicast_recv(
+                                            fd, msg, sizeof(msg) - 1)) > 0) {
+                                msg[length] = '\0';
+                                handler(msg, length);
+                            }
+                        });
+    if (handle == 0) {
+        close(fd);
+    }
+    return handle;
+}
+
+void Reactor::remove(Handle handle) {
+    std::shared_ptr<Entry> entry;
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        auto it = mEntries.find(handle);
+        if (it == mEntries.end()) {
+            return;
+        }
+        entry = it->second;
+        mEntries.erase(it);
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, entry->fd, nullptr);
+
+        // Events already returned by epoll_wait() for this handle are
+        // dropped in dispatch() because the handle is gone
+        if (std::this_thread::get_id() != mThreadId) {
+            mIdle.wait(lock, [this, handle] { return mDispatching != handle; });
+        }
+    }
+
+    if (entry->kind != Kind::FD) {
+        close(entry->fd);
+    }
+}
+
+void Reactor::dispatch(Handle handle, uint32_t events, uint64_t readyNs) {
+    std::shared_ptr<Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        auto it = mEntries.find(handle);
+        if (it == mEntries.end()) {
+            return;
+        }
+        entry = it->second;
+        mDispatching = handle;
+    }
+
+    uint64_t expectedNs = readyNs;
+    bool run = true;
+    if (entry->kind == Kind::TIMER || entry->kind == Kind::EVENT) {
+        uint64_t count;
+        // EAGAIN if the timer was re-armed after it fired
+        run = read(entry->fd, &count, sizeof(count)) == sizeof(count);
+        if (run && entry->kind == Kind::TIMER) {
+            std::lock_guard<std::mutex> lock(mLock);
+            if (entry->deadlineNs != 0) {
+                expectedNs = entry->deadlineNs;
+                entry->deadlineNs = entry->periodNs ? entry->deadlineNs + count * entry->periodNs
+                                                    : 0;
+            }
+        }
+    }
+
+    uint64_t startNs = nowNs();
+    if (run) {
+        entry->handler(events);
+    }
+    uint64_t endNs = nowNs();
+
+    std::lock_guard<std::mutex> lock(mLock);
+    if (run) {
+        HandlerStats& stats = entry->stats;
+        uint64_t runNs = endNs - startNs;
+        uint64_t latencyNs = startNs > expectedNs ? startNs - expectedNs : 0;
+        stats.calls++;
+        stats.totalRunNs += runNs;
+        stats.maxRunNs = std::max(stats.maxRunNs, runNs);
+        stats.totalLatencyNs += latencyNs;
+        stats.maxLatencyNs = std::max(stats.maxLatencyNs, latencyNs);
+    }
+    mDispatching = 0;
+    mIdle.notify_all();
+}
+
+void Reactor::threadFunc() {
+    pthread_setname_np(pthread_self(), "brcm_reactor");
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mThreadId = std::this_thread::get_id();
+    }
+
+    struct epoll_event events[kMaxEvents];
+    while (true) {
+        int count = epoll_wait(mEpollFd, events, kMaxEvents, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            PLOG(FATAL) << "Reactor epoll_wait failed";
+        }
+
+        uint64_t readyNs = nowNs();
+        for (int i = 0; i < count; i++) {
+            dispatch(events[i].data.u64, events[i].events, readyNs);
+        }
+    }
+}
+
+std::vector<Reactor::HandlerStats> Reactor::getStats() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    std::vector<HandlerStats> stats;
+    for (const auto& [handle, entry] : mEntries) {
+        stats.push_back(entry->stats);
+    }
+    return stats;
+}
+
+std::string Reactor::dump() const {
+    std::string out = "Reactor handlers (run / dispatch latency, avg max in us):\n";
+    for (const HandlerStats& stats : getStats()) {
+        uint64_t calls = std::max<uint64_t>(stats.calls, 1);
+        out += ::android::base::StringPrintf(
+                "  %-24s %10llu calls  run %8.1f %8.1f  latency %8.1f %8.1f\n",
+                stats.name.c_str(), static_cast<unsigned long long>(stats.calls),
+                stats.totalRunNs / 1e3 / calls, stats.maxRunNs / 1e3,
+                stats.totalLatencyNs / 1e3 / calls, stats.maxLatencyNs / 1e3);
+    }
+    return out;
+}
+
+}  // namespace brcm
+}  // namespace hardware
+}  // namespace android
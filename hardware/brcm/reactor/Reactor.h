@@ -0,0 +1,115 @@
+// Copyright (C) 2025 The Android Open Source Project
+// Shared epoll event loop for the Raspberry Pi 5 HALs
+
+#pragma once
+
+#include <sys/epoll.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace brcm {
+
+// One epoll thread per HAL process that every event source registers with,
+// in place of a thread per source that sleeps or polls on a timeout. When
+// nothing is ready the thread stays in epoll_wait() and costs no wakeups.
+//
+// Handlers run on the reactor thread one at a time and must not block; work
+// that takes more than a millisecond or so belongs on its own thread. Every
+// handler is timed: run time, plus dispatch latency, measured from the
+// timer's expiry for timers and from epoll_wait() returning for fds.
+class Reactor {
+public:
+    // 0 is never a valid handle
+    using Handle = uint64_t;
+    using FdHandler = std::function<void(uint32_t events)>;
+    using Callback = std::function<void()>;
+    // One kernel uevent, as NUL-separated KEY=value strings
+    using UeventHandler = std::function<void(const char* msg, size_t length)>;
+
+    struct HandlerStats {
+        std::string name;
+        uint64_t calls = 0;
+        uint64_t totalRunNs = 0;
+        uint64_t maxRunNs = 0;
+        uint64_t totalLatencyNs = 0;
+        uint64_t maxLatencyNs = 0;
+    };
+
+    // The process-wide reactor, started on first use and never torn down
+    static Reactor& get();
+
+    // Any pollable fd: V4L2 capture (EPOLLIN), GPIO line events (EPOLLIN),
+    // sysfs_notify() attributes (EPOLLPRI). The caller keeps ownership.
+    Handle addFd(const std::string& name, int fd, uint32_t events, FdHandler handler);
+    bool modifyFd(Handle handle, uint32_t events);
+
+    // A timerfd on CLOCK_MONOTONIC, created disarmed. armTimer() starts it;
+    // a zero period makes it one-shot.
+    Handle addTimer(const std::string& name, Callback callback);
+    bool armTimer(Handle handle, std::chrono::nanoseconds delay,
+                  std::chrono::nanoseconds period = std::chrono::nanoseconds(0));
+    bool disarmTimer(Handle handle);
+
+    // Convenience: a timer armed with the same delay and period
+    Handle addPeriodic(const std::string& name, std::chrono::nanoseconds period,
+                       Callback callback);
+
+    // An eventfd; signal() from any thread runs the callback once on the
+    // reactor thread, however many signals arrived before it ran
+    Handle addEvent(const std::string& name, Callback callback);
+    bool signal(Handle handle);
+
+    // Kernel uevents from the netlink multicast group
+    Handle addUevent(const std::string& name, UeventHandler handler);
+
+    // Once this returns the handler is not running and will not run again,
+    // except when called from that handler itself. It waits for a running
+    // handler, so never call it with a lock held that the handler takes.
+    // fds created by the reactor (timers, events, uevents) are closed.
+    void remove(Handle handle);
+
+    std::vector<HandlerStats> getStats() const;
+    std::string dump() const;
+
+private:
+    enum class Kind { FD, TIMER, EVENT, UEVENT };
+
+    struct Entry {
+        Kind kind;
+        int fd = -1;
+        FdHandler handler;
+        uint64_t deadlineNs = 0;    // next timer expiry, 0 when disarmed
+        uint64_t periodNs = 0;
+        HandlerStats stats;
+    };
+
+    Reactor();
+
+    Handle add(const std::string& name, Kind kind, int fd, uint32_t events, FdHandler handler);
+    void dispatch(Handle handle, uint32_t events, uint64_t readyNs);
+    void threadFunc();
+
+    mutable std::mutex mLock;
+    std::condition_variable mIdle;
+    std::map<Handle, std::shared_ptr<Entry>> mEntries;
+    Handle mNextHandle = 1;
+    Handle mDispatching = 0;
+
+    int mEpollFd = -1;
+    std::thread::id mThreadId;
+};
+
+}  // namespace brcm
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,295 @@
+// Copyright (C) 2025 The Android Open Source Project
+// Shared sysfs access for the Raspberry Pi 5 HALs
+
+#include "Sysfs.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cstdlib>
+
+namespace android {
+namespace hardware {
+namespace brcm {
+namespace sysfs {
+
+// sysfs attributes are at most one page
+static constexpr size_t kMaxValueSize = 4096;
+
+static std::string& root() {
+    static std::string sRoot;
+    return sRoot;
+}
+
+void setRoot(const std::string& path) {
+    root() = path;
+}
+
+const std::string& getRoot() {
+    return root();
+}
+
+std::string resolve(const std::string& path) {
+    if (root().empty() || path.empty() || path[0] != '/') {
+        return path;
+    }
+    return root() + path;
+}
+
+static std::string_view trim(std::string_view text) {
+    while (!text.empty() && isspace(static_cast<unsigned char>(text.front()))) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && isspace(static_cast<unsigned char>(text.back()))) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+bool parseInt(std::string_view text, int64_t* value, int base) {
+    text = trim(text);
+    if (text.empty() || text.size() >= 32) {
+        return false;
+    }
+    // strtoll needs a terminated string; attribute values are short
+    char buf[32];
+    text.copy(buf, text.size());
+    buf[text.size()] = '\0';
+
+    char* end;
+    errno = 0;
+    long long parsed = strtoll(buf, &end, base);
+    if (errno != 0 || end != buf + text.size()) {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+bool parseInt(std::string_view text, uint64_t* value, int base) {
+    text = trim(text);
+    // strtoull would negate a '-' value instead of failing
+    if (text.empty() || text.size() >= 32 || text.front() == '-') {
+        return false;
+    }
+    char buf[32];
+    text.copy(buf, text.size());
+    buf[text.size()] = '\0';
+
+    char* end;
+    errno = 0;
+    unsigned long long parsed = strtoull(buf, &end, base);
+    if (errno != 0 || end != buf + text.size()) {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+bool parseFloat(std::string_view text, float* value) {
+    text = trim(text);
+    if (text.empty() || text.size() >= 64) {
+        return false;
+    }
+    char buf[64];
+    text.copy(buf, text.size());
+    buf[text.size()] = '\0';
+
+    char* end;
+    errno = 0;
+    float parsed = strtof(buf, &end);
+    if (errno != 0 || end != buf + text.size()) {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+static bool readFd(int fd, std::string* value) {
+    char buf[kMaxValueSize];
+    ssize_t n = TEMP_FAILURE_RETRY(pread(fd, buf, sizeof(buf), 0));
+    if (n < 0) {
+        return false;
+    }
+    while (n > 0 && buf[n - 1] == '\n') {
+        n--;
+    }
+    value->assign(buf, n);
+    return true;
+}
+
+// sysfs replaces the value on every write; the regular files of a test tree
+// need truncating to behave the same
+static bool writeFd(int fd, std::string_view value, bool regular) {
+    ssize_t n = TEMP_FAILURE_RETRY(pwrite(fd, value.data(), value.size(), 0));
+    if (n != static_cast<ssize_t>(value.size())) {
+        return false;
+    }
+    return !regular || ftruncate(fd, value.size()) == 0;
+}
+
+static bool isRegular(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+bool readString(const std::string& path, std::string* value) {
+    int fd = TEMP_FAILURE_RETRY(open(resolve(path).c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = readFd(fd, value);
+    ::close(fd);
+    return ok;
+}
+
+bool writeString(const std::string& path, std::string_view value) {
+    int fd = TEMP_FAILURE_RETRY(open(resolve(path).c_str(), O_WRONLY | O_CLOEXEC));
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = writeFd(fd, value, isRegular(fd));
+    ::close(fd);
+    return ok;
+}
+
+bool readFloat(const std::string& path, float* value) {
+    std::string text;
+    return readString(path, &text) && parseFloat(text, value);
+}
+
+SysfsFile::SysfsFile(const std::string& path, int flags) : mPath(path), mFlags(flags) {}
+
+SysfsFile::~SysfsFile() {
+    close();
+}
+
+SysfsFile::SysfsFile(SysfsFile&& other) noexcept
+    : mPath(std::move(other.mPath)),
+      mFlags(other.mFlags),
+      mFd(other.mFd),
+      mRegular(other.mRegular),
+      mCached(other.mCached),
+      mLastWritten(std::move(other.mLastWritten)) {
+    other.mFd = -1;
+    other.mCached = false;
+}
+
+SysfsFile& SysfsFile::operator=(SysfsFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        mPath = std::move(other.mPath);
+        mFlags = other.mFlags;
+        mFd = other.mFd;
+        mRegular = other.mRegular;
+        mCached = other.mCached;
+        mLastWritten = std::move(other.mLastWritten);
+        other.mFd = -1;
+        other.mCached = false;
+    }
+    return *this;
+}
+
+bool SysfsFile::ensureOpen() {
+    if (mFd >= 0) {
+        return true;
+    }
+    if (mPath.empty()) {
+        return false;
+    }
+    mFd = TEMP_FAILURE_RETRY(open(resolve(mPath).c_str(), mFlags | O_CLOEXEC));
+    if (mFd < 0) {
+        return false;
+    }
+    mRegular = isRegular(mFd);
+    return true;
+}
+
+bool SysfsFile::exists() const {
+    return mFd >= 0 || access(resolve(mPath).c_str(), F_OK) == 0;
+}
+
+void SysfsFile::close() {
+    if (mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+    mCached = false;
+}
+
+int SysfsFile::fd() {
+    return ensureOpen() ? mFd : -1;
+}
+
+bool SysfsFile::read(std::string* value) {
+    if (!ensureOpen()) {
+        return false;
+    }
+    if (!readFd(mFd, value)) {
+        // Reopen next time in case the device was removed and re-added
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool SysfsFile::readFloat(float* value) {
+    std::string text;
+    return read(&text) && parseFloat(text, value);
+}
+
+bool SysfsFile::write(std::string_view value) {
+    if (mCached && mLastWritten == value) {
+        return true;
+    }
+    if (!ensureOpen()) {
+        return false;
+    }
+    if (!writeFd(mFd, value, mRegular)) {
+        int savedErrno = errno;
+        close();
+        errno = savedErrno;
+        return false;
+    }
+    mLastWritten.assign(value.data(), value.size());
+    mCached = true;
+    return true;
+}
+
+bool SysfsFile::writeInt(int64_t value) {
+    return write(std::to_string(value));
+}
+
+void SysfsFile::invalidate() {
+    mCached = false;
+}
+
+SysfsFile::WaitResult SysfsFile::waitForChange(int timeoutMs) {
+    // poll() reports a regular file readable straight away, without POLLPRI
+    if (!ensureOpen() || mRegular) {
+        return WaitResult::kUnsupported;
+    }
+    // A notification only arrives after the attribute has been read once
+    std::string discard;
+    readFd(mFd, &discard);
+
+    struct pollfd pfd = {};
+    pfd.fd = mFd;
+    pfd.events = POLLPRI | POLLERR;
+    int ret = TEMP_FAILURE_RETRY(poll(&pfd, 1, timeoutMs));
+    if (ret < 0) {
+        return WaitResult::kUnsupported;
+    }
+    if (ret > 0 && (pfd.revents & (POLLPRI | POLLERR))) {
+        return WaitResult::kChanged;
+    }
+    return WaitResult::kTimeout;
+}
+
+}  // namespace sysfs
+}  // namespace brcm
+}  // namespace hardware
+}  // namespace android
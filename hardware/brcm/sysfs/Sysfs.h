@@ -0,0 +1,130 @@
+// Copyright (C) 2025 The Android Open Source Project
+// Shared sysfs access for the Raspberry Pi 5 HALs
+
+#pragma once
+
+#include <fcntl.h>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace android {
+namespace hardware {
+namespace brcm {
+namespace sysfs {
+
+// Prefix applied to every absolute path opened through this library. Empty on
+// device; tests point it at a directory tree that mimics /sys. Set it before
+// any file is opened.
+void setRoot(const std::string& root);
+const std::string& getRoot();
+std::string resolve(const std::string& path);
+
+// Parse a whole attribute value, ignoring surrounding whitespace. Unlike
+// std::stoi these never throw; they return false on empty input, trailing
+// garbage or overflow and leave *value untouched.
+bool parseInt(std::string_view text, int64_t* value, int base = 0);
+// Unsigned values use the full uint64_t range; a leading '-' is rejected
+bool parseInt(std::string_view text, uint64_t* value, int base = 0);
+bool parseFloat(std::string_view text, float* value);
+
+template <typename T>
+bool parseInt(std::string_view text, T* value, int base = 0) {
+    static_assert(std::is_integral_v<T>, "parseInt needs an integral type");
+    using Wide = std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>;
+    Wide parsed;
+    if (!parseInt(text, &parsed, base)) {
+        return false;
+    }
+    if (parsed < std::numeric_limits<T>::min() || parsed > std::numeric_limits<T>::max()) {
+        return false;
+    }
+    *value = static_cast<T>(parsed);
+    return true;
+}
+
+// One-shot helpers for attributes read or written once. Values are returned
+// without the trailing newline.
+bool readString(const std::string& path, std::string* value);
+bool writeString(const std::string& path, std::string_view value);
+
+template <typename T>
+bool readInt(const std::string& path, T* value, int base = 0) {
+    std::string text;
+    return readString(path, &text) && parseInt(text, value, base);
+}
+
+bool readFloat(const std::string& path, float* value);
+
+// An attribute kept open between accesses. Reads and writes go through
+// pread/pwrite at offset 0, which sysfs treats as a fresh access, so a hot
+// loop costs one syscall per sample instead of open/read/close. The file is
+// opened on first use and reopened after an error, so a device that goes
+// away and comes back is picked up again.
+class SysfsFile {
+public:
+    SysfsFile() = default;
+    explicit SysfsFile(const std::string& path, int flags = O_RDONLY);
+    ~SysfsFile();
+
+    SysfsFile(SysfsFile&& other) noexcept;
+    SysfsFile& operator=(SysfsFile&& other) noexcept;
+    SysfsFile(const SysfsFile&) = delete;
+    SysfsFile& operator=(const SysfsFile&) = delete;
+
+    const std::string& path() const { return mPath; }
+    bool exists() const;
+    void close();
+
+    bool read(std::string* value);
+    bool readFloat(float* value);
+
+    template <typename T>
+    bool readInt(T* value, int base = 0) {
+        std::string text;
+        return read(&text) && parseInt(text, value, base);
+    }
+
+    // Skips the syscall when the value matches the last successful write.
+    // Call invalidate() if something else may have changed the attribute.
+    bool write(std::string_view value);
+    bool writeInt(int64_t value);
+    void invalidate();
+
+    enum class WaitResult {
+        kChanged,
+        kTimeout,
+        // Returned at once: the file cannot be opened or polled, or is a
+        // regular file of a test tree, which never notifies. Waiting again
+        // will not help, so callers must not retry in a loop.
+        kUnsupported,
+    };
+
+    // Blocks until the kernel calls sysfs_notify() on the attribute or the
+    // timeout expires (-1 waits forever). Only attributes that notify wake
+    // this early.
+    WaitResult waitForChange(int timeoutMs);
+
+    // For callers that multiplex several attributes in their own poll()
+    // loop: poll the fd for POLLPRI and call read() to re-arm it. Returns -1
+    // if the file cannot be opened.
+    int fd();
+
+private:
+    bool ensureOpen();
+
+    std::string mPath;
+    int mFlags = O_RDONLY;
+    int mFd = -1;
+    bool mRegular = false;      // a file in a test tree rather than sysfs
+    bool mCached = false;
+    std::string mLastWritten;
+};
+
+}  // namespace sysfs
+}  // namespace brcm
+}  // namespace hardware
+}  // namespace android
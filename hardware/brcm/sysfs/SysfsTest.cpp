@@ -0,0 +1,213 @@
+// Copyright (C) 2025 The Android Open Source Project
+// Host tests for the shared sysfs library, against a tree under setRoot()
+
+#include "Sysfs.h"
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <string>
+
+namespace android {
+namespace hardware {
+namespace brcm {
+namespace sysfs {
+namespace {
+
+TEST(SysfsParseTest, Integers) {
+    int64_t value = 0;
+    EXPECT_TRUE(parseInt(" 42\n", &value));
+    EXPECT_EQ(value, 42);
+    EXPECT_TRUE(parseInt("-17", &value));
+    EXPECT_EQ(value, -17);
+    EXPECT_TRUE(parseInt("0x1f", &value));
+    EXPECT_EQ(value, 0x1f);
+    EXPECT_TRUE(parseInt("ff", &value, 16));
+    EXPECT_EQ(value, 0xff);
+
+    value = 7;
+    EXPECT_FALSE(parseInt("", &value));
+    EXPECT_FALSE(parseInt("  \n", &value));
+    EXPECT_FALSE(parseInt("12abc", &value));
+    EXPECT_FALSE(parseInt("99999999999999999999", &value));
+    EXPECT_EQ(value, 7);
+}
+
+TEST(SysfsParseTest, IntegerRanges) {
+    uint64_t wide = 0;
+    EXPECT_TRUE(parseInt("18446744073709551615", &wide));
+    EXPECT_EQ(wide, UINT64_MAX);
+    EXPECT_FALSE(parseInt("-1", &wide));
+
+    int8_t narrow = 3;
+    EXPECT_TRUE(parseInt("-128", &narrow));
+    EXPECT_EQ(narrow, -128);
+    EXPECT_FALSE(parseInt("128", &narrow));
+    EXPECT_EQ(narrow, -128);
+
+    uint16_t port = 0;
+    EXPECT_TRUE(parseInt("65535", &port));
+    EXPECT_EQ(port, 65535);
+    EXPECT_FALSE(parseInt("65536", &port));
+    EXPECT_FALSE(parseInt("-5", &port));
+}
+
+TEST(SysfsParseTest, Floats) {
+    float value = 0.0f;
+    EXPECT_TRUE(parseFloat(" 1.5\n", &value));
+    EXPECT_FLOAT_EQ(value, 1.5f);
+    EXPECT_FALSE(parseFloat("1.5V", &value));
+    EXPECT_FALSE(parseFloat("", &value));
+    EXPECT_FLOAT_EQ(value, 1.5f);
+}
+
+class SysfsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(mkdir((std::string(mRoot.path) + "/sys").c_str(), 0755), 0);
+        ASSERT_EQ(mkdir((std::string(mRoot.path) + "/sys/fan").c_str(), 0755), 0);
+        setRoot(mRoot.path);
+    }
+
+    void TearDown() override { setRoot(""); }
+
+    // Absolute path under the tree, for checking behind the library's back
+    std::string real(const std::string& path) const { return std::string(mRoot.path) + path; }
+
+    void put(const std::string& path, const std::string& contents) {
+        ASSERT_TRUE(::android::base::WriteStringToFile(contents, real(path)));
+    }
+
+    std::string get(const std::string& path) const {
+        std::string contents;
+        ::android::base::ReadFileToString(real(path), &contents);
+        return contents;
+    }
+
+    ::android::base::TemporaryDir mRoot;
+};
+
+TEST_F(SysfsTest, ResolvesOnlyAbsolutePaths) {
+    EXPECT_EQ(resolve("/sys/fan/pwm"), real("/sys/fan/pwm"));
+    EXPECT_EQ(resolve("relative/pwm"), "relative/pwm");
+    setRoot("");
+    EXPECT_EQ(resolve("/sys/fan/pwm"), "/sys/fan/pwm");
+}
+
+TEST_F(SysfsTest, ReadsValues) {
+    put("/sys/fan/pwm", "128\n");
+    put("/sys/fan/name", "pwmfan\n");
+    put("/sys/fan/volts", "0.85\n");
+
+    int value = 0;
+    EXPECT_TRUE(readInt("/sys/fan/pwm", &value));
+    EXPECT_EQ(value, 128);
+    std::string name;
+    EXPECT_TRUE(readString("/sys/fan/name", &name));
+    EXPECT_EQ(name, "pwmfan");
+    float volts = 0.0f;
+    EXPECT_TRUE(readFloat("/sys/fan/volts", &volts));
+    EXPECT_FLOAT_EQ(volts, 0.85f);
+
+    EXPECT_FALSE(readInt("/sys/fan/name", &value));
+    EXPECT_FALSE(readString("/sys/fan/missing", &name));
+}
+
+TEST_F(SysfsTest, WritesReplaceTheValue) {
+    put("/sys/fan/pwm", "255\n");
+    EXPECT_TRUE(writeString("/sys/fan/pwm", "7"));
+    EXPECT_EQ(get("/sys/fan/pwm"), "7");
+    EXPECT_FALSE(writeString("/sys/fan/missing", "7"));
+
+    SysfsFile file("/sys/fan/pwm", O_RDWR);
+    EXPECT_TRUE(file.writeInt(1000));
+    EXPECT_EQ(get("/sys/fan/pwm"), "1000");
+    EXPECT_TRUE(file.writeInt(3));
+    EXPECT_EQ(get("/sys/fan/pwm"), "3");
+    int value = 0;
+    EXPECT_TRUE(file.readInt(&value));
+    EXPECT_EQ(value, 3);
+}
+
+TEST_F(SysfsTest, SkipsUnchangedWritesUntilInvalidated) {
+    put("/sys/fan/pwm", "0\n");
+    SysfsFile file("/sys/fan/pwm", O_RDWR);
+    ASSERT_TRUE(file.write("64"));
+
+    // Something else changes the attribute; the cached write does not see it
+    put("/sys/fan/pwm", "200");
+    EXPECT_TRUE(file.write("64"));
+    EXPECT_EQ(get("/sys/fan/pwm"), "200");
+
+    file.invalidate();
+    EXPECT_TRUE(file.write("64"));
+    EXPECT_EQ(get("/sys/fan/pwm"), "64");
+
+    // close() drops the cache as well
+    put("/sys/fan/pwm", "200");
+    file.close();
+    EXPECT_TRUE(file.write("64"));
+    EXPECT_EQ(get("/sys/fan/pwm"), "64");
+}
+
+TEST_F(SysfsTest, OpensLazilyAndReopensAfterErrors) {
+    SysfsFile file("/sys/fan/pwm");
+    EXPECT_FALSE(file.exists());
+    std::string value;
+    EXPECT_FALSE(file.read(&value));
+    EXPECT_EQ(file.fd(), -1);
+
+    // The attribute appears later
+    put("/sys/fan/pwm", "10\n");
+    EXPECT_TRUE(file.exists());
+    EXPECT_TRUE(file.read(&value));
+    EXPECT_EQ(value, "10");
+
+    // Reads stay on the open fd and see new values at offset 0
+    put("/sys/fan/pwm", "11\n");
+    EXPECT_TRUE(file.read(&value));
+    EXPECT_EQ(value, "11");
+
+    // A read that fails drops the fd, and the next read opens the path again:
+    // here a directory stands in for a device that went away
+    SysfsFile gone("/sys/fan/gone");
+    ASSERT_EQ(mkdir(real("/sys/fan/gone").c_str(), 0755), 0);
+    EXPECT_FALSE(gone.read(&value));
+    ASSERT_EQ(rmdir(real("/sys/fan/gone").c_str()), 0);
+    put("/sys/fan/gone", "back\n");
+    EXPECT_TRUE(gone.read(&value));
+    EXPECT_EQ(value, "back");
+}
+
+TEST_F(SysfsTest, MovesKeepTheOpenFile) {
+    put("/sys/fan/pwm", "5\n");
+    SysfsFile file("/sys/fan/pwm", O_RDWR);
+    ASSERT_TRUE(file.write("6"));
+    int fd = file.fd();
+
+    SysfsFile moved(std::move(file));
+    EXPECT_EQ(moved.fd(), fd);
+    EXPECT_EQ(moved.path(), "/sys/fan/pwm");
+    // The cache moved along
+    put("/sys/fan/pwm", "9");
+    EXPECT_TRUE(moved.write("6"));
+    EXPECT_EQ(get("/sys/fan/pwm"), "9");
+}
+
+TEST_F(SysfsTest, RegularFilesNeverNotify) {
+    put("/sys/fan/alarm", "0\n");
+    SysfsFile file("/sys/fan/alarm");
+    EXPECT_EQ(file.waitForChange(1000), SysfsFile::WaitResult::kUnsupported);
+
+    SysfsFile missing("/sys/fan/missing");
+    EXPECT_EQ(missing.waitForChange(1000), SysfsFile::WaitResult::kUnsupported);
+}
+
+}  // namespace
+}  // namespace sysfs
+}  // namespace brcm
+}  // namespace hardware
+}  // namespace android
@@ -15,18 +15,25 @@
  */
 
 #define LOG_TAG "ThermalHAL_RPi5"
+#define ATRACE_TAG ATRACE_TAG_POWER
 
 #include <android-base/logging.h>
 #include <android/hardware/thermal/2.0/IThermal.h>
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
+#include <utils/Trace.h>
+
+#include <Reactor.h>
+#include <Sysfs.h>
+
+#include "ThermalPolicy.h"
 
 #include <fstream>
 #include <string>
 #include <mutex>
-#include <thread>
 #include <chrono>
 #include <functional>
+#include <limits>
 
 namespace android {
 namespace hardware {
@@ -50,6 +57,12 @@ constexpr float TEMP_THROTTLE_LIGHT = 70.0f;    // 70°C - light throttling
 constexpr float TEMP_THROTTLE_MODERATE = 80.0f; // 80°C - moderate throttling  
 constexpr float TEMP_THROTTLE_SEVERE = 85.0f;   // 85°C - severe throttling
 constexpr float TEMP_SHUTDOWN = 90.0f;          // 90°C - shutdown threshold
+constexpr float TEMP_UNUSED = std::numeric_limits<float>::infinity();
+
+static const brcm::thermal::SeverityThresholds kSeverityThresholds = {
+    TEMP_THROTTLE_LIGHT, TEMP_THROTTLE_MODERATE, TEMP_THROTTLE_SEVERE,
+    TEMP_UNUSED, TEMP_UNUSED, TEMP_SHUTDOWN,
+};
 
 // Cooling device paths
 constexpr char FAN_PWM[] = "/sys/class/hwmon/hwmon0/pwm1";  // Official Pi 5 cooler
@@ -83,20 +96,31 @@ private:
     void setFanSpeed(int speed);
     void startThermalMonitor();
     void stopThermalMonitor();
-    void thermalMonitorLoop();
+    void thermalMonitorTick();
     ThrottlingSeverity getSeverity(float temp);
 
     std::mutex mMutex;
     std::mutex mCallbackMutex;
     std::vector<sp<IThermalChangedCallback>> mCallbacks;
-    std::thread mMonitorThread;
-    bool mMonitorRunning;
+    // 1 Hz on the shared reactor thread
+    brcm::Reactor::Handle mMonitorTimer;
     ThrottlingSeverity mCurrentSeverity;
     float mLastTemperature;
+
+    // Written by the monitor loop every cycle, usually with the same value
+    brcm::sysfs::SysfsFile mFanEnable;
+    brcm::sysfs::SysfsFile mFanPwm;
+    brcm::thermal::FanCurve mFanCurve;
 };
 
-Thermal::Thermal() : mMonitorRunning(false), mCurrentSeverity(ThrottlingSeverity::NONE), 
-                     mLastTemperature(0.0f) {
+Thermal::Thermal() : mMonitorTimer(0), mCurrentSeverity(ThrottlingSeverity::NONE), 
+                     mLastTemperature(0.0f), mFanEnable(FAN_ENABLE, O_WRONLY),
+                     mFanPwm(FAN_PWM, O_WRONLY),
+                     mFanCurve({{50.0f, 64},                     // 25%
+                                {TEMP_THROTTLE_LIGHT, 128},      // 50%
+                                {TEMP_THROTTLE_MODERATE, 192},   // 75%
+                                {TEMP_THROTTLE_SEVERE, 255}},    // Full speed
+                               3.0f) {
     LOG(INFO) << "Thermal HAL initialized for Raspberry Pi 5";
     startThermalMonitor();
 }
@@ -106,94 +130,62 @@ Thermal::~Thermal() {
 }
 
 float Thermal::readTemperature(const char* path) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        return 0.0f;
-    }
-    
-    int tempMilliC;
-    file >> tempMilliC;
+    int tempMilliC = 0;
+    brcm::sysfs::readInt(path, &tempMilliC);
     return tempMilliC / 1000.0f;  // Convert from millidegrees to degrees
 }
 
 void Thermal::setFanSpeed(int speed) {
     // Enable manual fan control
-    std::ofstream enableFile(FAN_ENABLE);
-    if (enableFile.is_open()) {
-        enableFile << "1";  // Manual mode
-        enableFile.close();
-    }
+    mFanEnable.write("1");
     
     // Set fan PWM (0-255)
-    std::ofstream pwmFile(FAN_PWM);
-    if (pwmFile.is_open()) {
-        pwmFile << std::to_string(speed);
-    }
+    mFanPwm.writeInt(speed);
+    ATRACE_INT("fan pwm", speed);
 }
 
 ThrottlingSeverity Thermal::getSeverity(float temp) {
-    if (temp >= TEMP_SHUTDOWN) {
-        return ThrottlingSeverity::SHUTDOWN;
-    } else if (temp >= TEMP_THROTTLE_SEVERE) {
-        return ThrottlingSeverity::SEVERE;
-    } else if (temp >= TEMP_THROTTLE_MODERATE) {
-        return ThrottlingSeverity::MODERATE;
-    } else if (temp >= TEMP_THROTTLE_LIGHT) {
-        return ThrottlingSeverity::LIGHT;
-    }
-    return ThrottlingSeverity::NONE;
+    return static_cast<ThrottlingSeverity>(
+            brcm::thermal::severityFor(temp, kSeverityThresholds));
 }
 
 void Thermal::startThermalMonitor() {
-    mMonitorRunning = true;
-    mMonitorThread = std::thread(&Thermal::thermalMonitorLoop, this);
+    mMonitorTimer = brcm::Reactor::get().addPeriodic(
+            "thermal", std::chrono::seconds(1), [this]() { thermalMonitorTick(); });
 }
 
 void Thermal::stopThermalMonitor() {
-    mMonitorRunning = false;
-    if (mMonitorThread.joinable()) {
-        mMonitorThread.join();
-    }
+    brcm::Reactor::get().remove(mMonitorTimer);
+    mMonitorTimer = 0;
 }
 
-void Thermal::thermalMonitorLoop() {
-    while (mMonitorRunning) {
-        float temp = readTemperature(THERMAL_ZONE_CPU);
-        ThrottlingSeverity severity = getSeverity(temp);
+void Thermal::thermalMonitorTick() {
+    ATRACE_CALL();
+    float temp = readTemperature(THERMAL_ZONE_CPU);
+    ThrottlingSeverity severity = getSeverity(temp);
+    ATRACE_INT("cpu temp mC", static_cast<int32_t>(temp * 1000.0f));
+    ATRACE_INT("thermal severity", static_cast<int32_t>(severity));
+    
+    // Adjust fan speed based on temperature
+    setFanSpeed(mFanCurve.update(temp));
+    
+    // Notify callbacks if severity changed
+    if (severity != mCurrentSeverity || std::abs(temp - mLastTemperature) > 2.0f) {
+        mCurrentSeverity = severity;
+        mLastTemperature = temp;
         
-        // Adjust fan speed based on temperature
-        int fanSpeed = 0;
-        if (temp >= TEMP_THROTTLE_SEVERE) {
-            fanSpeed = 255;  // Full speed
-        } else if (temp >= TEMP_THROTTLE_MODERATE) {
-            fanSpeed = 192;  // 75%
-        } else if (temp >= TEMP_THROTTLE_LIGHT) {
-            fanSpeed = 128;  // 50%
-        } else if (temp >= 50.0f) {
-            fanSpeed = 64;   // 25%
-        }
-        setFanSpeed(fanSpeed);
+        Temperature temperature;
+        temperature.type = TemperatureType::CPU;
+        temperature.name = "CPU";
+        temperature.value = temp;
+        temperature.throttlingStatus = severity;
         
-        // Notify callbacks if severity changed
-        if (severity != mCurrentSeverity || std::abs(temp - mLastTemperature) > 2.0f) {
-            mCurrentSeverity = severity;
-            mLastTemperature = temp;
-            
-            Temperature temperature;
-            temperature.type = TemperatureType::CPU;
-            temperature.name = "CPU";
-            temperature.value = temp;
-            temperature.throttlingStatus = severity;
-            
-            std::lock_guard<std::mutex> lock(mCallbackMutex);
-            for (const auto& callback : mCallbacks) {
-                if (callback != nullptr) {
-                    callback->notifyThrottling(temperature);
-                }
+        std::lock_guard<std::mutex> lock(mCallbackMutex);
+        for (const auto& callback : mCallbacks) {
+            if (callback != nullptr) {
+                callback->notifyThrottling(temperature);
             }
         }
-        
-        std::this_thread::sleep_for(std::chrono::seconds(1));
     }
 }
 
@@ -268,11 +260,8 @@ Return<void> Thermal::getCoolingDevices(getCoolingDevices_cb _hidl_cb) {
     coolingDevices[0].name = "Pi 5 Cooler";
     
     // Read current fan speed
-    std::ifstream pwmFile(FAN_PWM);
     int pwmValue = 0;
-    if (pwmFile.is_open()) {
-        pwmFile >> pwmValue;
-    }
+    brcm::sysfs::readInt(FAN_PWM, &pwmValue);
     coolingDevices[0].currentValue = (pwmValue * 100.0f) / 255.0f;  // Convert to percentage
     
     _hidl_cb(status, coolingDevices);
@@ -399,11 +388,8 @@ Return<void> Thermal::getCurrentCoolingDevices(bool filterType, CoolingType type
         device.type = CoolingType::FAN;
         device.name = "Pi 5 Cooler";
         
-        std::ifstream pwmFile(FAN_PWM);
         int pwmValue = 0;
-        if (pwmFile.is_open()) {
-            pwmFile >> pwmValue;
-        }
+        brcm::sysfs::readInt(FAN_PWM, &pwmValue);
         device.value = pwmValue;
         
         devices.push_back(device);
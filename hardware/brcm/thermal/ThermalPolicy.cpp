@@ -0,0 +1,42 @@
+// Copyright (C) 2025 The Android Open Source Project
+
+#include "ThermalPolicy.h"
+
+#include <utility>
+
+namespace android {
+namespace hardware {
+namespace brcm {
+namespace thermal {
+
+Severity severityFor(float tempC, const SeverityThresholds& thresholds) {
+    // Highest level whose threshold has been reached
+    for (size_t i = thresholds.size(); i > 0; i--) {
+        if (tempC >= thresholds[i - 1]) {
+            return static_cast<Severity>(i);
+        }
+    }
+    return Severity::NONE;
+}
+
+FanCurve::FanCurve(std::vector<FanStep> steps, float hysteresisC)
+    : mSteps(std::move(steps)), mHysteresis(hysteresisC) {}
+
+uint8_t FanCurve::update(float tempC) {
+    while (mLevel < mSteps.size() && tempC >= mSteps[mLevel].tempC) {
+        mLevel++;
+    }
+    while (mLevel > 0 && tempC < mSteps[mLevel - 1].tempC - mHysteresis) {
+        mLevel--;
+    }
+    return pwm();
+}
+
+uint8_t FanCurve::pwm() const {
+    return mLevel > 0 ? mSteps[mLevel - 1].pwm : 0;
+}
+
+}  // namespace thermal
+}  // namespace brcm
+}  // namespace hardware
+}  // namespace android
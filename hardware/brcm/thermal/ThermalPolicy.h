@@ -0,0 +1,61 @@
+// Copyright (C) 2025 The Android Open Source Project
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Temperature to throttling/fan decisions shared by the HIDL and AIDL thermal
+// HALs. Pure functions of the readings, so it builds for the host as
+// libbrcm_thermal_policy.
+
+namespace android {
+namespace hardware {
+namespace brcm {
+namespace thermal {
+
+// ThrottlingSeverity order; the HIDL 2.0 and AIDL enums share these values
+enum class Severity : int32_t {
+    NONE = 0,
+    LIGHT,
+    MODERATE,
+    SEVERE,
+    CRITICAL,
+    EMERGENCY,
+    SHUTDOWN,
+};
+
+// Temperature in Celsius at which LIGHT through SHUTDOWN begin. A level
+// a platform doesn't use is set to infinity and never reported.
+using SeverityThresholds = std::array<float, 6>;
+
+Severity severityFor(float tempC, const SeverityThresholds& thresholds);
+
+struct FanStep {
+    float tempC;
+    uint8_t pwm;
+};
+
+// Stepped fan curve. The fan speeds up as soon as a step is reached but only
+// slows down once the temperature is |hysteresisC| below that step, so a
+// reading hovering on a boundary doesn't change the speed every tick.
+class FanCurve {
+public:
+    // |steps| in ascending temperature; below the first step the fan is off
+    FanCurve(std::vector<FanStep> steps, float hysteresisC);
+
+    uint8_t update(float tempC);
+    uint8_t pwm() const;
+
+private:
+    std::vector<FanStep> mSteps;
+    float mHysteresis;
+    size_t mLevel = 0;  // steps currently reached
+};
+
+}  // namespace thermal
+}  // namespace brcm
+}  // namespace hardware
+}  // namespace android
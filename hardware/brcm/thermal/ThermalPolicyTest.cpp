@@ -0,0 +1,67 @@
+// Copyright (C) 2025 The Android Open Source Project
+
+// Severity thresholds and the fan curve's hysteresis.
+
+#include <gtest/gtest.h>
+
+#include <limits>
+
+#include "ThermalPolicy.h"
+
+using namespace android::hardware::brcm::thermal;
+
+static constexpr float kUnused = std::numeric_limits<float>::infinity();
+static const SeverityThresholds kThresholds = {70.0f, 80.0f, 85.0f, kUnused, kUnused, 90.0f};
+
+static FanCurve makeFan() {
+    return FanCurve({{50.0f, 64}, {70.0f, 128}, {80.0f, 192}, {85.0f, 255}}, 3.0f);
+}
+
+TEST(ThermalPolicyTest, SeverityFollowsThresholds) {
+    EXPECT_EQ(severityFor(40.0f, kThresholds), Severity::NONE);
+    EXPECT_EQ(severityFor(70.0f, kThresholds), Severity::LIGHT);
+    EXPECT_EQ(severityFor(84.9f, kThresholds), Severity::MODERATE);
+    EXPECT_EQ(severityFor(85.0f, kThresholds), Severity::SEVERE);
+}
+
+TEST(ThermalPolicyTest, UnusedLevelsAreSkipped) {
+    EXPECT_EQ(severityFor(89.0f, kThresholds), Severity::SEVERE);
+    EXPECT_EQ(severityFor(90.0f, kThresholds), Severity::SHUTDOWN);
+}
+
+TEST(ThermalPolicyTest, FanOffBelowFirstStep) {
+    FanCurve fan = makeFan();
+    EXPECT_EQ(fan.update(30.0f), 0);
+    EXPECT_EQ(fan.pwm(), 0);
+}
+
+TEST(ThermalPolicyTest, FanSpeedsUpAsSoonAsAStepIsReached) {
+    FanCurve fan = makeFan();
+    EXPECT_EQ(fan.update(50.0f), 64);
+    EXPECT_EQ(fan.update(70.0f), 128);
+    // Jumps straight over intermediate steps
+    EXPECT_EQ(fan.update(86.0f), 255);
+}
+
+TEST(ThermalPolicyTest, FanSlowsDownOnlyThreeDegreesBelowTheStep) {
+    FanCurve fan = makeFan();
+    ASSERT_EQ(fan.update(71.0f), 128);
+    EXPECT_EQ(fan.update(69.0f), 128);
+    EXPECT_EQ(fan.update(67.0f), 128);
+    EXPECT_EQ(fan.update(66.9f), 64);
+}
+
+TEST(ThermalPolicyTest, FanHoldsWhileHoveringOnABoundary) {
+    FanCurve fan = makeFan();
+    uint8_t first = fan.update(70.0f);
+    for (int i = 0; i < 20; i++) {
+        EXPECT_EQ(fan.update(i % 2 == 0 ? 69.5f : 70.5f), first) << i;
+    }
+}
+
+TEST(ThermalPolicyTest, FanDropsSeveralStepsOnALargeFall) {
+    FanCurve fan = makeFan();
+    ASSERT_EQ(fan.update(90.0f), 255);
+    EXPECT_EQ(fan.update(60.0f), 64);
+    EXPECT_EQ(fan.update(20.0f), 0);
+}
@@ -3,8 +3,7 @@
 
 #include "ThermalUtils.h"
 #include <android-base/logging.h>
-#include <android-base/file.h>
-#include <android-base/strings.h>
+#include <Sysfs.h>
 #include <json/json.h>
 #include <fstream>
 
@@ -74,13 +73,13 @@ float ThermalUtils::readTemperature(const std::string& name) {
         return 0.0f;
     }
 
-    std::string temp;
-    if (!android::base::ReadFileToString(it->second.sysfsPath, &temp)) {
+    float temp;
+    if (!brcm::sysfs::readFloat(it->second.sysfsPath, &temp)) {
         LOG(WARNING) << "Failed to read " << it->second.sysfsPath;
         return 0.0f;
     }
 
-    return std::stof(android::base::Trim(temp)) * it->second.multiplier;
+    return temp * it->second.multiplier;
 }
 
 bool ThermalUtils::setCoolingLevel(const std::string& name, uint32_t level) {
@@ -94,7 +93,7 @@ bool ThermalUtils::setCoolingLevel(const std::string& name, uint32_t level) {
         level = it->second.maxState;
     }
 
-    return android::base::WriteStringToFile(std::to_string(level), it->second.sysfsPath);
+    return brcm::sysfs::writeString(it->second.sysfsPath, std::to_string(level));
 }
 
 }  // namespace implementation
@@ -6,12 +6,16 @@
  */
 
 #define LOG_TAG "android.hardware.thermal-service.rpi5"
+#define ATRACE_TAG ATRACE_TAG_POWER
 
 #include "Thermal.h"
 
 #include <android-base/logging.h>
-#include <android-base/file.h>
-#include <android-base/strings.h>
+#include <utils/Trace.h>
+#include <Sysfs.h>
+#include <ThermalPolicy.h>
+
+#include <limits>
 
 namespace aidl {
 namespace android {
@@ -29,20 +33,22 @@ static constexpr const char* kCpuTempPath = "/sys/class/thermal/thermal_zone0/te
 static constexpr const char* kGpuTempPath = "/sys/class/thermal/thermal_zone1/temp";
 
 static float readTemperature(const char* path) {
-    std::string temp_str;
-    if (::android::base::ReadFileToString(path, &temp_str)) {
-        return std::stof(::android::base::Trim(temp_str)) / 1000.0f;
+    float milli_celsius;
+    if (::android::hardware::brcm::sysfs::readFloat(path, &milli_celsius)) {
+        ATRACE_INT64(path, static_cast<int64_t>(milli_celsius));
+        return milli_celsius / 1000.0f;
     }
     return 0.0f;
 }
 
+// LIGHT through SHUTDOWN; EMERGENCY is not used
+static const ::android::hardware::brcm::thermal::SeverityThresholds kSeverityThresholds = {
+    65.0f, 70.0f, 75.0f, 80.0f, std::numeric_limits<float>::infinity(), 85.0f,
+};
+
 static ThrottlingSeverity getSeverity(float temp) {
-    if (temp >= 85.0f) return ThrottlingSeverity::SHUTDOWN;
-    if (temp >= 80.0f) return ThrottlingSeverity::CRITICAL;
-    if (temp >= 75.0f) return ThrottlingSeverity::SEVERE;
-    if (temp >= 70.0f) return ThrottlingSeverity::MODERATE;
-    if (temp >= 65.0f) return ThrottlingSeverity::LIGHT;
-    return ThrottlingSeverity::NONE;
+    return static_cast<ThrottlingSeverity>(
+            ::android::hardware::brcm::thermal::severityFor(temp, kSeverityThresholds));
 }
 
 Thermal::Thermal() {
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TouchDecode.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace input {
+namespace implementation {
+
+bool decodeFT5X06(const std::vector<uint8_t>& data, int count, std::vector<TouchEvent>& events) {
+    if (data.size() < (size_t)(count * 6)) {
+        return false;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        int offset = i * 6;
+        
+        TouchEvent event;
+        event.id = (data[offset + 2] >> 4) & 0x0F;
+        event.x = ((data[offset] & 0x0F) << 8) | data[offset + 1];
+        event.y = ((data[offset + 2] & 0x0F) << 8) | data[offset + 3];
+        event.pressure = data[offset + 4];
+        event.touchMajor = data[offset + 5];
+        event.touchMinor = data[offset + 5];
+        event.active = ((data[offset] >> 6) & 0x03) != 0x01;  // Not lift-up
+        
+        events.push_back(event);
+    }
+    
+    return true;
+}
+
+bool decodeGT911(const std::vector<uint8_t>& data, int count, std::vector<TouchEvent>& events) {
+    if (data.size() < (size_t)(count * 8)) {
+        return false;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        int offset = i * 8;
+        
+        TouchEvent event;
+        event.id = data[offset];
+        event.x = data[offset + 1] | (data[offset + 2] << 8);
+        event.y = data[offset + 3] | (data[offset + 4] << 8);
+        event.touchMajor = data[offset + 5] | (data[offset + 6] << 8);
+        event.touchMinor = event.touchMajor;
+        event.pressure = 50;  // GT911 doesn't report pressure
+        event.active = true;
+        
+        events.push_back(event);
+    }
+    
+    return true;
+}
+
+bool decodeILI251X(const std::vector<uint8_t>& data, std::vector<TouchEvent>& events) {
+    if (data.empty()) {
+        return false;
+    }
+    
+    int count = data[0];
+    if (count == 0 || count > 10) {
+        return true;
+    }
+    if (data.size() < (size_t)(1 + count * 5)) {
+        return false;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        int offset = 1 + i * 5;
+        
+        TouchEvent event;
+        event.id = (data[offset] & 0x3F) >> 2;
+        event.x = ((data[offset] & 0x03) << 8) | data[offset + 1];
+        event.y = ((data[offset + 2] & 0x03) << 8) | data[offset + 3];
+        event.pressure = data[offset + 4];
+        event.touchMajor = 20;
+        event.touchMinor = 20;
+        event.active = true;
+        
+        events.push_back(event);
+    }
+    
+    return true;
+}
+
+bool decodeElan(const std::vector<uint8_t>& data, std::vector<TouchEvent>& events) {
+    if (data.size() < 34) {
+        return false;
+    }
+    
+    if (data[0] != 0x55 || data[1] != 0x55) {
+        return false;  // Invalid report
+    }
+    
+    int count = data[2] & 0x0F;
+    
+    for (int i = 0; i < count && i < 5; i++) {
+        int offset = 3 + i * 6;
+        
+        TouchEvent event;
+        event.id = i;
+        event.x = (data[offset] << 4) | ((data[offset + 2] & 0xF0) >> 4);
+        event.y = (data[offset + 1] << 4) | (data[offset + 2] & 0x0F);
+        event.pressure = data[offset + 3];
+        event.touchMajor = data[offset + 4];
+        event.touchMinor = data[offset + 5];
+        event.active = true;
+        
+        events.push_back(event);
+    }
+    
+    return true;
+}
+
+bool decodeSitronix(const std::vector<uint8_t>& data, std::vector<TouchEvent>& events) {
+    if (data.size() < 16) {
+        return false;
+    }
+    
+    int count = data[0] & 0x0F;
+    
+    for (int i = 0; i < count && i < 2; i++) {
+        int offset = 2 + i * 4;
+        
+        TouchEvent event;
+        event.id = i;
+        event.x = ((data[offset] & 0x70) << 4) | data[offset + 1];
+        event.y = ((data[offset] & 0x07) << 8) | data[offset + 2];
+        event.pressure = data[offset + 3];
+        event.touchMajor = 20;
+        event.touchMinor = 20;
+        event.active = (data[offset] & 0x80) != 0;
+        
+        events.push_back(event);
+    }
+    
+    return true;
+}
+
+void applyTransform(const TouchTransform& t, std::vector<TouchEvent>& events) {
+    // A collapsed window (no calibration yet) leaves coordinates unscaled
+    bool scaleX = t.calMaxX != t.calMinX;
+    bool scaleY = t.calMaxY != t.calMinY;
+    
+    for (auto& event : events) {
+        if (scaleX) {
+            event.x = (event.x - t.calMinX) * t.maxX / (t.calMaxX - t.calMinX);
+        }
+        if (scaleY) {
+            event.y = (event.y - t.calMinY) * t.maxY / (t.calMaxY - t.calMinY);
+        }
+        
+        event.x = std::clamp(event.x, 0, t.maxX);
+        event.y = std::clamp(event.y, 0, t.maxY);
+        
+        if (t.swapXY) {
+            std::swap(event.x, event.y);
+        }
+        if (t.invertX) {
+            event.x = t.maxX - event.x;
+        }
+        if (t.invertY) {
+            event.y = t.maxY - event.y;
+        }
+    }
+}
+
+}  // namespace implementation
+}  // namespace input
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Report decoding and coordinate mapping for the touch controllers. Nothing
+// here touches the bus, so it builds for the host as libbrcm_touch_decode.
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace input {
+namespace implementation {
+
+// Touch event structure
+struct TouchEvent {
+    int32_t id;
+    int32_t x;
+    int32_t y;
+    int32_t pressure;
+    int32_t touchMajor;
+    int32_t touchMinor;
+    bool active;
+};
+
+// Calibration window and orientation applied to raw controller coordinates
+struct TouchTransform {
+    int32_t calMinX = 0;
+    int32_t calMaxX = 0;
+    int32_t calMinY = 0;
+    int32_t calMaxY = 0;
+    int32_t maxX = 0;
+    int32_t maxY = 0;
+    bool invertX = false;
+    bool invertY = false;
+    bool swapXY = false;
+};
+
+// Each decoder appends the points of one report and returns false if the
+// buffer is shorter than the report it describes.
+
+// FocalTech FT5x06/FT6x06: |count| 6-byte records from TOUCH_START
+bool decodeFT5X06(const std::vector<uint8_t>& data, int count, std::vector<TouchEvent>& events);
+// Goodix GT9xx: |count| 8-byte records from the point info register
+bool decodeGT911(const std::vector<uint8_t>& data, int count, std::vector<TouchEvent>& events);
+// Ilitek ILI251x: count byte followed by 5-byte records
+bool decodeILI251X(const std::vector<uint8_t>& data, std::vector<TouchEvent>& events);
+// Elan eKTF/eKTH: 34-byte report with a 0x55 0x55 header
+bool decodeElan(const std::vector<uint8_t>& data, std::vector<TouchEvent>& events);
+// Sitronix ST1232/ST1633: 16-byte report from register 0
+bool decodeSitronix(const std::vector<uint8_t>& data, std::vector<TouchEvent>& events);
+
+// Scales to the panel, clamps, then applies swap and inversion
+void applyTransform(const TouchTransform& transform, std::vector<TouchEvent>& events);
+
+}  // namespace implementation
+}  // namespace input
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
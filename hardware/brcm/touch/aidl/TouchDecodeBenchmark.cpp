@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cost of turning one controller report into mapped events, which the
+// input timer pays 100 times a second per panel.
+
+#include <benchmark/benchmark.h>
+
+#include "TouchDecode.h"
+
+using namespace aidl::android::hardware::input::implementation;
+
+// |count| FT5x06 records with distinct ids, the last one lifting
+static std::vector<uint8_t> makeFT5X06Report(int count) {
+    std::vector<uint8_t> data;
+    for (int i = 0; i < count; i++) {
+        int x = 40 + i * 70;
+        int y = 30 + i * 40;
+        uint8_t flag = (i == count - 1) ? 0x40 : 0x80;
+        data.insert(data.end(), {
+            static_cast<uint8_t>(flag | (x >> 8)), static_cast<uint8_t>(x),
+            static_cast<uint8_t>((i << 4) | (y >> 8)), static_cast<uint8_t>(y),
+            0x30, 0x08,
+        });
+    }
+    return data;
+}
+
+static std::vector<uint8_t> makeGT911Report(int count) {
+    std::vector<uint8_t> data;
+    for (int i = 0; i < count; i++) {
+        int x = 100 + i * 90;
+        int y = 60 + i * 50;
+        data.insert(data.end(), {
+            static_cast<uint8_t>(i), static_cast<uint8_t>(x), static_cast<uint8_t>(x >> 8),
+            static_cast<uint8_t>(y), static_cast<uint8_t>(y >> 8), 0x18, 0x00, 0x00,
+        });
+    }
+    return data;
+}
+
+static TouchTransform makeTransform() {
+    TouchTransform t;
+    t.calMinX = 12;
+    t.calMaxX = 1012;
+    t.calMinY = 8;
+    t.calMaxY = 592;
+    t.maxX = 1024;
+    t.maxY = 600;
+    t.swapXY = true;
+    t.invertY = true;
+    return t;
+}
+
+static void BM_DecodeFT5X06(benchmark::State& state) {
+    int count = state.range(0);
+    auto report = makeFT5X06Report(count);
+    TouchTransform transform = makeTransform();
+    std::vector<TouchEvent> events;
+    events.reserve(10);
+    for (auto _ : state) {
+        events.clear();
+        decodeFT5X06(report, count, events);
+        applyTransform(transform, events);
+        benchmark::DoNotOptimize(events.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_DecodeFT5X06)->Arg(1)->Arg(5)->Arg(10);
+
+static void BM_DecodeGT911(benchmark::State& state) {
+    int count = state.range(0);
+    auto report = makeGT911Report(count);
+    TouchTransform transform = makeTransform();
+    std::vector<TouchEvent> events;
+    events.reserve(10);
+    for (auto _ : state) {
+        events.clear();
+        decodeGT911(report, count, events);
+        applyTransform(transform, events);
+        benchmark::DoNotOptimize(events.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_DecodeGT911)->Arg(1)->Arg(5)->Arg(10);
+
+BENCHMARK_MAIN();
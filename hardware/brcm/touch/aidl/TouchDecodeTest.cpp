@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Report decoding for each controller and the calibration transform.
+
+#include <gtest/gtest.h>
+
+#include "TouchDecode.h"
+
+using namespace aidl::android::hardware::input::implementation;
+
+TEST(TouchDecodeTest, Ft5x06) {
+    // Point 0: contact, id 1, x 0x123, y 0x456; point 1: lift-up, id 2
+    std::vector<uint8_t> data = {
+        0x81, 0x23, 0x14, 0x56, 0x30, 0x08,
+        0x40, 0x10, 0x20, 0x20, 0x00, 0x04,
+    };
+    std::vector<TouchEvent> events;
+    ASSERT_TRUE(decodeFT5X06(data, 2, events));
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(events[0].id, 1);
+    EXPECT_EQ(events[0].x, 0x123);
+    EXPECT_EQ(events[0].y, 0x456);
+    EXPECT_EQ(events[0].pressure, 0x30);
+    EXPECT_EQ(events[0].touchMajor, 8);
+    EXPECT_TRUE(events[0].active);
+    EXPECT_EQ(events[1].id, 2);
+    EXPECT_FALSE(events[1].active);
+}
+
+TEST(TouchDecodeTest, Gt911) {
+    std::vector<uint8_t> data = {3, 0x20, 0x03, 0xE0, 0x01, 0x10, 0x00, 0x00};
+    std::vector<TouchEvent> events;
+    ASSERT_TRUE(decodeGT911(data, 1, events));
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].id, 3);
+    EXPECT_EQ(events[0].x, 800);
+    EXPECT_EQ(events[0].y, 480);
+    EXPECT_EQ(events[0].touchMajor, 16);
+    EXPECT_TRUE(events[0].active);
+}
+
+TEST(TouchDecodeTest, Ili251x) {
+    // Count 1, id 5, x 0x2AB, y 0x1CD, pressure 0x40
+    std::vector<uint8_t> data = {1, (5 << 2) | 0x02, 0xAB, 0x01, 0xCD, 0x40};
+    std::vector<TouchEvent> events;
+    ASSERT_TRUE(decodeILI251X(data, events));
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].id, 5);
+    EXPECT_EQ(events[0].x, 0x2AB);
+    EXPECT_EQ(events[0].y, 0x1CD);
+    EXPECT_EQ(events[0].pressure, 0x40);
+}
+
+TEST(TouchDecodeTest, Ili251xIgnoresImplausibleCount) {
+    std::vector<TouchEvent> events;
+    EXPECT_TRUE(decodeILI251X({0}, events));
+    EXPECT_TRUE(decodeILI251X({11, 0, 0, 0, 0, 0}, events));
+    EXPECT_TRUE(events.empty());
+}
+
+TEST(TouchDecodeTest, Elan) {
+    std::vector<uint8_t> data(34, 0);
+    data[0] = 0x55;
+    data[1] = 0x55;
+    data[2] = 1;
+    // x = 0x123, y = 0x456 as 12-bit values split over three bytes
+    data[3] = 0x12;
+    data[4] = 0x45;
+    data[5] = 0x36;
+    data[6] = 0x20;
+    data[7] = 7;
+    data[8] = 5;
+    std::vector<TouchEvent> events;
+    ASSERT_TRUE(decodeElan(data, events));
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].x, 0x123);
+    EXPECT_EQ(events[0].y, 0x456);
+    EXPECT_EQ(events[0].pressure, 0x20);
+    EXPECT_EQ(events[0].touchMajor, 7);
+    EXPECT_EQ(events[0].touchMinor, 5);
+}
+
+TEST(TouchDecodeTest, ElanRejectsBadHeader) {
+    std::vector<uint8_t> data(34, 0);
+    data[0] = 0x55;
+    std::vector<TouchEvent> events;
+    EXPECT_FALSE(decodeElan(data, events));
+    EXPECT_TRUE(events.empty());
+}
+
+TEST(TouchDecodeTest, Sitronix) {
+    std::vector<uint8_t> data(16, 0);
+    data[0] = 2;
+    // Point 0 valid at (0x3AB, 0x5CD); point 1 not valid
+    data[2] = 0x80 | (0x3 << 4) | 0x5;
+    data[3] = 0xAB;
+    data[4] = 0xCD;
+    data[5] = 9;
+    std::vector<TouchEvent> events;
+    ASSERT_TRUE(decodeSitronix(data, events));
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(events[0].x, 0x3AB);
+    EXPECT_EQ(events[0].y, 0x5CD);
+    EXPECT_EQ(events[0].pressure, 9);
+    EXPECT_TRUE(events[0].active);
+    EXPECT_FALSE(events[1].active);
+}
+
+TEST(TouchDecodeTest, ShortReportsAreRejected) {
+    std::vector<TouchEvent> events;
+    EXPECT_FALSE(decodeFT5X06(std::vector<uint8_t>(11), 2, events));
+    EXPECT_FALSE(decodeGT911(std::vector<uint8_t>(15), 2, events));
+    EXPECT_FALSE(decodeILI251X({}, events));
+    EXPECT_FALSE(decodeILI251X({2, 0, 0, 0, 0, 0}, events));
+    EXPECT_FALSE(decodeElan(std::vector<uint8_t>(33), events));
+    EXPECT_FALSE(decodeSitronix(std::vector<uint8_t>(15), events));
+    EXPECT_TRUE(events.empty());
+}
+
+static TouchEvent at(int32_t x, int32_t y) {
+    return {0, x, y, 0, 0, 0, true};
+}
+
+TEST(TouchDecodeTest, TransformScalesTheCalibrationWindow) {
+    TouchTransform t;
+    t.calMinX = 100;
+    t.calMaxX = 4000;
+    t.calMinY = 200;
+    t.calMaxY = 3800;
+    t.maxX = 799;
+    t.maxY = 479;
+    std::vector<TouchEvent> events = {at(100, 200), at(4000, 3800), at(2050, 2000)};
+    applyTransform(t, events);
+    EXPECT_EQ(events[0].x, 0);
+    EXPECT_EQ(events[0].y, 0);
+    EXPECT_EQ(events[1].x, 799);
+    EXPECT_EQ(events[1].y, 479);
+    EXPECT_EQ(events[2].x, 399);
+    EXPECT_EQ(events[2].y, 239);
+}
+
+TEST(TouchDecodeTest, TransformClampsOutsideTheWindow) {
+    TouchTransform t;
+    t.calMinX = 100;
+    t.calMaxX = 1100;
+    t.calMinY = 100;
+    t.calMaxY = 1100;
+    t.maxX = 1000;
+    t.maxY = 1000;
+    std::vector<TouchEvent> events = {at(50, 2000)};
+    applyTransform(t, events);
+    EXPECT_EQ(events[0].x, 0);
+    EXPECT_EQ(events[0].y, 1000);
+}
+
+TEST(TouchDecodeTest, TransformWithoutCalibrationOnlyClamps) {
+    TouchTransform t;
+    t.maxX = 799;
+    t.maxY = 479;
+    std::vector<TouchEvent> events = {at(300, 200), at(900, 500)};
+    applyTransform(t, events);
+    EXPECT_EQ(events[0].x, 300);
+    EXPECT_EQ(events[0].y, 200);
+    EXPECT_EQ(events[1].x, 799);
+    EXPECT_EQ(events[1].y, 479);
+}
+
+TEST(TouchDecodeTest, TransformSwapsThenInverts) {
+    TouchTransform t;
+    t.maxX = 1000;
+    t.maxY = 1000;
+    t.swapXY = true;
+    t.invertX = true;
+    std::vector<TouchEvent> events = {at(100, 300)};
+    applyTransform(t, events);
+    EXPECT_EQ(events[0].x, 700);
+    EXPECT_EQ(events[0].y, 100);
+}
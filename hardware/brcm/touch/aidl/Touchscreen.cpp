@@ -15,10 +15,12 @@
  */
 
 #define LOG_TAG "TouchscreenHAL"
+#define ATRACE_TAG ATRACE_TAG_INPUT
 
 #include "Touchscreen.h"
 
 #include <android-base/logging.h>
+#include <utils/Trace.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
@@ -70,10 +72,7 @@ TouchscreenManager& TouchscreenManager::getInstance() {
 TouchscreenManager::TouchscreenManager()
     : mI2cFd(-1),
       mInitialized(false),
-      mRunning(false),
-      mCalMinX(0), mCalMaxX(0),
-      mCalMinY(0), mCalMaxY(0),
-      mInvertX(false), mInvertY(false), mSwapXY(false),
+      mInputTimer(0),
       mInputFd(-1) {
     LOG(INFO) << "TouchscreenManager initialized";
 }
@@ -309,13 +308,15 @@ bool TouchscreenManager::initController(const TouchDeviceInfo& device) {
     
     if (result) {
         // Set calibration defaults
-        mCalMinX = 0;
-        mCalMaxX = device.maxX;
-        mCalMinY = 0;
-        mCalMaxY = device.maxY;
-        mInvertX = device.invertX;
-        mInvertY = device.invertY;
-        mSwapXY = device.swapXY;
+        mTransform.calMinX = 0;
+        mTransform.calMaxX = device.maxX;
+        mTransform.calMinY = 0;
+        mTransform.calMaxY = device.maxY;
+        mTransform.maxX = device.maxX;
+        mTransform.maxY = device.maxY;
+        mTransform.invertX = device.invertX;
+        mTransform.invertY = device.invertY;
+        mTransform.swapXY = device.swapXY;
         
         LOG(INFO) << "Touch controller " << device.name << " initialized";
         LOG(INFO) << "  Resolution: " << device.maxX << "x" << device.maxY;
@@ -479,6 +480,7 @@ bool TouchscreenManager::initSitronix() {
 // ============================================================================
 
 bool TouchscreenManager::pollTouchEvents(std::vector<TouchEvent>& events) {
+    ATRACE_CALL();
     std::lock_guard<std::mutex> lock(mLock);
     
     if (!mInitialized || mI2cFd < 0) {
@@ -538,29 +540,9 @@ bool TouchscreenManager::pollTouchEvents(std::vector<TouchEvent>& events) {
     }
     
     // Apply calibration and orientation
-    for (auto& event : events) {
-        // Apply calibration
-        event.x = (event.x - mCalMinX) * mActiveDevice.maxX / (mCalMaxX - mCalMinX);
-        event.y = (event.y - mCalMinY) * mActiveDevice.maxY / (mCalMaxY - mCalMinY);
-        
-        // Clamp
-        if (event.x < 0) event.x = 0;
-        if (event.x > mActiveDevice.maxX) event.x = mActiveDevice.maxX;
-        if (event.y < 0) event.y = 0;
-        if (event.y > mActiveDevice.maxY) event.y = mActiveDevice.maxY;
-        
-        // Apply orientation
-        if (mSwapXY) {
-            std::swap(event.x, event.y);
-        }
-        if (mInvertX) {
-            event.x = mActiveDevice.maxX - event.x;
-        }
-        if (mInvertY) {
-            event.y = mActiveDevice.maxY - event.y;
-        }
-    }
+    applyTransform(mTransform, events);
     
+    ATRACE_INT("touch contacts", static_cast<int32_t>(events.size()));
     return result;
 }
 
@@ -582,27 +564,11 @@ bool TouchscreenManager::readFT5X06(std::vector<TouchEvent>& events) {
     
     // Read touch data
     regAddr = {FT5X06_REG_TOUCH_START};
-    if (!i2cWriteRead(regAddr, data, touchCount * 6) || data.size() < (size_t)(touchCount * 6)) {
+    if (!i2cWriteRead(regAddr, data, touchCount * 6)) {
         return false;
     }
     
-    // Parse touch points
-    for (int i = 0; i < touchCount; i++) {
-        int offset = i * 6;
-        
-        TouchEvent event;
-        event.id = (data[offset + 2] >> 4) & 0x0F;
-        event.x = ((data[offset] & 0x0F) << 8) | data[offset + 1];
-        event.y = ((data[offset + 2] & 0x0F) << 8) | data[offset + 3];
-        event.pressure = data[offset + 4];
-        event.touchMajor = data[offset + 5];
-        event.touchMinor = data[offset + 5];
-        event.active = ((data[offset] >> 6) & 0x03) != 0x01;  // Not lift-up
-        
-        events.push_back(event);
-    }
-    
-    return true;
+    return decodeFT5X06(data, touchCount, events);
 }
 
 bool TouchscreenManager::readFT6X06(std::vector<TouchEvent>& events) {
@@ -630,24 +596,10 @@ bool TouchscreenManager::readGT911(std::vector<TouchEvent>& events) {
     // Read touch points
     if (touchCount > 0) {
         regAddr = {0x81, 0x4F};  // First touch point
-        if (!i2cWriteRead(regAddr, data, touchCount * 8) || data.size() < (size_t)(touchCount * 8)) {
+        if (!i2cWriteRead(regAddr, data, touchCount * 8) ||
+            !decodeGT911(data, touchCount, events)) {
             return false;
         }
-        
-        for (int i = 0; i < touchCount; i++) {
-            int offset = i * 8;
-            
-            TouchEvent event;
-            event.id = data[offset];
-            event.x = data[offset + 1] | (data[offset + 2] << 8);
-            event.y = data[offset + 3] | (data[offset + 4] << 8);
-            event.touchMajor = data[offset + 5] | (data[offset + 6] << 8);
-            event.touchMinor = event.touchMajor;
-            event.pressure = 50;  // GT911 doesn't report pressure
-            event.active = true;
-            
-            events.push_back(event);
-        }
     }
     
     // Clear status
@@ -677,26 +629,11 @@ bool TouchscreenManager::readILI251X(std::vector<TouchEvent>& events) {
     
     // Read touch data
     cmd = {0x10};
-    if (!i2cWriteRead(cmd, data, 1 + touchCount * 5) || data.size() < (size_t)(1 + touchCount * 5)) {
+    if (!i2cWriteRead(cmd, data, 1 + touchCount * 5)) {
         return false;
     }
     
-    for (int i = 0; i < touchCount; i++) {
-        int offset = 1 + i * 5;
-        
-        TouchEvent event;
-        event.id = (data[offset] & 0x3F) >> 2;
-        event.x = ((data[offset] & 0x03) << 8) | data[offset + 1];
-        event.y = ((data[offset + 2] & 0x03) << 8) | data[offset + 3];
-        event.pressure = data[offset + 4];
-        event.touchMajor = 20;
-        event.touchMinor = 20;
-        event.active = true;
-        
-        events.push_back(event);
-    }
-    
-    return true;
+    return decodeILI251X(data, events);
 }
 
 bool TouchscreenManager::readMXT(std::vector<TouchEvent>& events) {
@@ -708,60 +645,22 @@ bool TouchscreenManager::readMXT(std::vector<TouchEvent>& events) {
 bool TouchscreenManager::readElan(std::vector<TouchEvent>& events) {
     std::vector<uint8_t> data;
     
-    if (!i2cRead(data, 34) || data.size() < 34) {
+    if (!i2cRead(data, 34)) {
         return false;
     }
     
-    if (data[0] != 0x55 || data[1] != 0x55) {
-        return false;  // Invalid report
-    }
-    
-    int touchCount = data[2] & 0x0F;
-    
-    for (int i = 0; i < touchCount && i < 5; i++) {
-        int offset = 3 + i * 6;
-        
-        TouchEvent event;
-        event.id = i;
-        event.x = (data[offset] << 4) | ((data[offset + 2] & 0xF0) >> 4);
-        event.y = (data[offset + 1] << 4) | (data[offset + 2] & 0x0F);
-        event.pressure = data[offset + 3];
-        event.touchMajor = data[offset + 4];
-        event.touchMinor = data[offset + 5];
-        event.active = true;
-        
-        events.push_back(event);
-    }
-    
-    return true;
+    return decodeElan(data, events);
 }
 
 bool TouchscreenManager::readSitronix(std::vector<TouchEvent>& events) {
     std::vector<uint8_t> regAddr = {0x00};
     std::vector<uint8_t> data;
     
-    if (!i2cWriteRead(regAddr, data, 16) || data.size() < 16) {
+    if (!i2cWriteRead(regAddr, data, 16)) {
         return false;
     }
     
-    int touchCount = data[0] & 0x0F;
-    
-    for (int i = 0; i < touchCount && i < 2; i++) {
-        int offset = 2 + i * 4;
-        
-        TouchEvent event;
-        event.id = i;
-        event.x = ((data[offset] & 0x70) << 4) | data[offset + 1];
-        event.y = ((data[offset] & 0x07) << 8) | data[offset + 2];
-        event.pressure = data[offset + 3];
-        event.touchMajor = 20;
-        event.touchMinor = 20;
-        event.active = (data[offset] & 0x80) != 0;
-        
-        events.push_back(event);
-    }
-    
-    return true;
+    return decodeSitronix(data, events);
 }
 
 // ============================================================================
@@ -863,18 +762,18 @@ bool TouchscreenManager::resetController() {
 
 bool TouchscreenManager::setCalibration(int32_t minX, int32_t maxX, int32_t minY, int32_t maxY) {
     std::lock_guard<std::mutex> lock(mLock);
-    mCalMinX = minX;
-    mCalMaxX = maxX;
-    mCalMinY = minY;
-    mCalMaxY = maxY;
+    mTransform.calMinX = minX;
+    mTransform.calMaxX = maxX;
+    mTransform.calMinY = minY;
+    mTransform.calMaxY = maxY;
     return true;
 }
 
 bool TouchscreenManager::setOrientation(bool invertX, bool invertY, bool swapXY) {
     std::lock_guard<std::mutex> lock(mLock);
-    mInvertX = invertX;
-    mInvertY = invertY;
-    mSwapXY = swapXY;
+    mTransform.invertX = invertX;
+    mTransform.invertY = invertY;
+    mTransform.swapXY = swapXY;
     return true;
 }
 
@@ -913,31 +812,25 @@ bool TouchscreenManager::getTouchInfo(int32_t& maxX, int32_t& maxY, int32_t& max
 }
 
 void TouchscreenManager::startInputThread() {
-    if (mRunning.load()) return;
-    mRunning.store(true);
-    mInputThread = std::thread(&TouchscreenManager::inputThreadFunc, this);
+    if (mInputTimer != 0) return;
+    mInputTimer = ::android::hardware::brcm::Reactor::get().addPeriodic(
+            "touch", std::chrono::milliseconds(10), [this]() { onInputTimer(); });
+    LOG(INFO) << "Touch input polling started";
 }
 
 void TouchscreenManager::stopInputThread() {
-    mRunning.store(false);
-    if (mInputThread.joinable()) {
-        mInputThread.join();
-    }
+    if (mInputTimer == 0) return;
+    ::android::hardware::brcm::Reactor::get().remove(mInputTimer);
+    mInputTimer = 0;
+    LOG(INFO) << "Touch input polling stopped";
 }
 
-void TouchscreenManager::inputThreadFunc() {
-    LOG(INFO) << "Touch input thread started";
-    
-    while (mRunning.load()) {
-        std::vector<TouchEvent> events;
-        if (pollTouchEvents(events)) {
-            // Events would be sent to input subsystem
-            // In practice, this is handled by the kernel driver
-        }
-        usleep(10000);  // 100Hz polling
+void TouchscreenManager::onInputTimer() {
+    std::vector<TouchEvent> events;
+    if (pollTouchEvents(events)) {
+        // Events would be sent to input subsystem
+        // In practice, this is handled by the kernel driver
     }
-    
-    LOG(INFO) << "Touch input thread stopped";
 }
 
 }  // namespace implementation
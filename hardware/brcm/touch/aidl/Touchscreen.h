@@ -22,8 +22,10 @@
 #include <map>
 #include <mutex>
 #include <string>
-#include <thread>
-#include <atomic>
+
+#include <Reactor.h>
+
+#include "TouchDecode.h"
 
 namespace aidl {
 namespace android {
@@ -95,17 +97,6 @@ enum class TouchController {
     GENERIC_SPI,
 };
 
-// Touch event structure
-struct TouchEvent {
-    int32_t id;
-    int32_t x;
-    int32_t y;
-    int32_t pressure;
-    int32_t touchMajor;
-    int32_t touchMinor;
-    bool active;
-};
-
 // Touchscreen device info
 struct TouchDeviceInfo {
     std::string name;
@@ -235,7 +226,7 @@ private:
     TouchscreenManager();
     ~TouchscreenManager();
     
-    void inputThreadFunc();
+    void onInputTimer();
     
     // I2C communication
     bool i2cOpen(uint8_t bus, uint8_t addr);
@@ -270,13 +261,11 @@ private:
     TouchDeviceInfo mActiveDevice;
     bool mInitialized;
     
-    std::thread mInputThread;
-    std::atomic<bool> mRunning;
+    // 100 Hz controller poll on the shared reactor thread
+    ::android::hardware::brcm::Reactor::Handle mInputTimer;
     
-    // Calibration
-    int32_t mCalMinX, mCalMaxX;
-    int32_t mCalMinY, mCalMaxY;
-    bool mInvertX, mInvertY, mSwapXY;
+    // Calibration and orientation
+    TouchTransform mTransform;
     
     // Input event device
     int mInputFd;
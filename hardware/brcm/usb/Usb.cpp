@@ -9,11 +9,7 @@
 #include <android/hardware/usb/1.3/IUsb.h>
 #include <android/hardware/usb/1.3/types.h>
 #include <hidl/Status.h>
-#include <dirent.h>
-#include <fcntl.h>
 #include <unistd.h>
-#include <pthread.h>
-#include <sys/inotify.h>
 #include "Usb.h"
 
 namespace android {
@@ -23,85 +19,36 @@ namespace V1_3 {
 namespace implementation {
 
 // USB gadget configfs paths
-static const char* USB_CONTROLLER_PATH = "/sys/class/udc";
 static const char* CONFIGFS_PATH = "/config/usb_gadget/g1";
-static const char* USB_STATE_PATH = "/sys/class/udc/*/state";
 static const char* USB_DATA_ROLE_PATH = "/sys/class/typec/port0/data_role";
 static const char* USB_POWER_ROLE_PATH = "/sys/class/typec/port0/power_role";
 
 Usb::Usb() : mCallback(nullptr) {
     LOG(INFO) << "USB HAL initialized";
 
-    // Find USB controller
-    findUsbController();
-
-    // Start monitoring thread
-    pthread_create(&mPollThread, nullptr, pollThreadFunc, this);
+    // Port changes are pushed to the callback as they happen
+    mMonitor.start([this](const UsbPortState& state) { notifyPortStatus(state); });
 }
 
 Usb::~Usb() {
+    mMonitor.stop();
     LOG(INFO) << "USB HAL destroyed";
 }
 
-void Usb::findUsbController() {
-    DIR* dir = opendir(USB_CONTROLLER_PATH);
-    if (!dir) {
-        LOG(ERROR) << "Cannot open " << USB_CONTROLLER_PATH;
-        return;
-    }
-
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (entry->d_name[0] == '.') continue;
-        mUsbController = entry->d_name;
-        LOG(INFO) << "Found USB controller: " << mUsbController;
-        break;
-    }
-
-    closedir(dir);
-}
-
-void* Usb::pollThreadFunc(void* arg) {
-    Usb* usb = static_cast<Usb*>(arg);
-    usb->pollLoop();
-    return nullptr;
-}
-
-void Usb::pollLoop() {
-    int inotifyFd = inotify_init();
-    if (inotifyFd < 0) {
-        LOG(ERROR) << "Failed to init inotify";
+void Usb::notifyPortStatus(const UsbPortState& state) {
+    std::lock_guard<std::mutex> lock(mCallbackLock);
+    if (mCallback == nullptr) {
         return;
     }
 
-    std::string statePath = std::string("/sys/class/udc/") + mUsbController + "/state";
-    int wd = inotify_add_watch(inotifyFd, statePath.c_str(), IN_MODIFY);
-
-    char buffer[512];
-    while (true) {
-        int length = read(inotifyFd, buffer, sizeof(buffer));
-        if (length < 0) {
-            LOG(ERROR) << "inotify read error";
-            break;
-        }
-
-        // Notify callback about USB state change
-        if (mCallback != nullptr) {
-            PortStatus status;
-            queryPortStatus(&status);
+    hidl_vec<PortStatus> statusVec;
+    statusVec.resize(1);
+    toPortStatus(state, &statusVec[0]);
 
-            hidl_vec<PortStatus> statusVec;
-            statusVec.resize(1);
-            statusVec[0] = status;
-
-            auto ret = mCallback->notifyPortStatusChange(statusVec, Status::SUCCESS);
-            if (!ret.isOk()) {
-                LOG(ERROR) << "Failed to notify port status change";
-            }
-        }
+    auto ret = mCallback->notifyPortStatusChange(statusVec, Status::SUCCESS);
+    if (!ret.isOk()) {
+        LOG(ERROR) << "Failed to notify port status change";
     }
-
-    close(inotifyFd);
 }
 
 Return<void> Usb::switchRole(const hidl_string& portName,
@@ -120,17 +67,20 @@ Return<void> Usb::switchRole(const hidl_string& portName,
             path = USB_POWER_ROLE_PATH;
             value = (newRole.role == static_cast<uint32_t>(PortPowerRole::SOURCE)) ? "source" : "sink";
             break;
-        default:
+        default: {
             LOG(ERROR) << "Unknown role type";
+            std::lock_guard<std::mutex> lock(mCallbackLock);
             if (mCallback) {
                 mCallback->notifyRoleSwitchStatus(portName, newRole, Status::ERROR);
             }
             return Void();
+        }
     }
 
     // Try to switch role
     bool success = android::base::WriteStringToFile(value, path);
 
+    std::lock_guard<std::mutex> lock(mCallbackLock);
     if (mCallback) {
         mCallback->notifyRoleSwitchStatus(portName, newRole,
             success ? Status::SUCCESS : Status::ERROR);
@@ -141,6 +91,7 @@ Return<void> Usb::switchRole(const hidl_string& portName,
 
 Return<void> Usb::setCallback(const sp<V1_0::IUsbCallback>& callback) {
     LOG(INFO) << "setCallback";
+    std::lock_guard<std::mutex> lock(mCallbackLock);
     mCallback = callback;
     return Void();
 }
@@ -148,20 +99,12 @@ Return<void> Usb::setCallback(const sp<V1_0::IUsbCallback>& callback) {
 Return<void> Usb::queryPortStatus() {
     LOG(INFO) << "queryPortStatus";
 
-    PortStatus status;
-    queryPortStatus(&status);
-
-    if (mCallback) {
-        hidl_vec<PortStatus> statusVec;
-        statusVec.resize(1);
-        statusVec[0] = status;
-        mCallback->notifyPortStatusChange(statusVec, Status::SUCCESS);
-    }
-
+    // The monitor keeps the cached state current, so no sysfs reads here
+    notifyPortStatus(mMonitor.getState());
     return Void();
 }
 
-void Usb::queryPortStatus(PortStatus* status) {
+void Usb::toPortStatus(const UsbPortState& state, PortStatus* status) {
     status->portName = "port0";
     status->currentDataRole = PortDataRole::DEVICE;
     status->currentPowerRole = PortPowerRole::SINK;
@@ -171,35 +114,19 @@ void Usb::queryPortStatus(PortStatus* status) {
     status->canChangePowerRole = false;
     status->supportedModes = PortMode::UFP;
 
-    // Check USB state
-    std::string statePath = std::string("/sys/class/udc/") + mUsbController + "/state";
-    std::string state;
-    if (android::base::ReadFileToString(statePath, &state)) {
-        state = android::base::Trim(state);
-        if (state == "configured") {
-            status->currentDataRole = PortDataRole::DEVICE;
-        }
+    if (state.udcState == "not attached") {
+        status->currentMode = PortMode::NONE;
     }
 
-    // Check for Type-C
-    if (access(USB_DATA_ROLE_PATH, R_OK) == 0) {
-        std::string dataRole;
-        if (android::base::ReadFileToString(USB_DATA_ROLE_PATH, &dataRole)) {
-            dataRole = android::base::Trim(dataRole);
-            status->currentDataRole = (dataRole == "host") ?
-                PortDataRole::HOST : PortDataRole::DEVICE;
-            status->canChangeDataRole = true;
-        }
-    }
-
-    if (access(USB_POWER_ROLE_PATH, R_OK) == 0) {
-        std::string powerRole;
-        if (android::base::ReadFileToString(USB_POWER_ROLE_PATH, &powerRole)) {
-            powerRole = android::base::Trim(powerRole);
-            status->currentPowerRole = (powerRole == "source") ?
-                PortPowerRole::SOURCE : PortPowerRole::SINK;
-            status->canChangePowerRole = true;
-        }
+    // Type-C roles override the gadget-only defaults
+    if (state.hasTypec) {
+        status->currentDataRole = (state.dataRole == "host") ?
+            PortDataRole::HOST : PortDataRole::DEVICE;
+        status->canChangeDataRole = true;
+        status->currentPowerRole = (state.powerRole == "source") ?
+            PortPowerRole::SOURCE : PortPowerRole::SINK;
+        status->canChangePowerRole = true;
+        status->currentMode = (state.dataRole == "host") ? PortMode::DFP : PortMode::UFP;
     }
 }
 
@@ -228,7 +155,7 @@ Return<bool> Usb::enableUsbDataSignal(bool enable) {
     
     // Control USB gadget
     std::string udcPath = std::string(CONFIGFS_PATH) + "/UDC";
-    std::string value = enable ? mUsbController : "";
+    std::string value = enable ? mMonitor.getController() : "";
     
     return android::base::WriteStringToFile(value, udcPath);
 }
@@ -8,8 +8,8 @@
 #include <android/hardware/usb/1.1/types.h>
 #include <android/hardware/usb/1.1/IUsbCallback.h>
 #include <hidl/Status.h>
-#include <pthread.h>
-#include <string>
+#include <mutex>
+#include "UsbPortMonitor.h"
 
 namespace android {
 namespace hardware {
@@ -55,14 +55,12 @@ public:
     Return<bool> enableUsbDataSignal(bool enable) override;
 
 private:
-    void findUsbController();
-    void queryPortStatus(PortStatus* status);
-    void pollLoop();
-    static void* pollThreadFunc(void* arg);
+    static void toPortStatus(const UsbPortState& state, PortStatus* status);
+    void notifyPortStatus(const UsbPortState& state);
 
+    std::mutex mCallbackLock;
     sp<V1_0::IUsbCallback> mCallback;
-    std::string mUsbController;
-    pthread_t mPollThread;
+    UsbPortMonitor mMonitor;
 };
 
 }  // namespace implementation
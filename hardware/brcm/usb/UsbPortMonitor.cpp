@@ -0,0 +1,318 @@
+// Copyright (C) 2024 The Android Open Source Project
+// Event-driven USB port state tracking for the Raspberry Pi 5 USB HALs
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <cutils/uevent.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include "UsbPortMonitor.h"
+
+namespace android {
+namespace hardware {
+namespace usb {
+
+static const char* UDC_CLASS_PATH = "/sys/class/udc";
+static const char* TYPEC_PORT_PATH = "/sys/class/typec/port0";
+static const char* POWER_SUPPLY_CLASS_PATH = "/sys/class/power_supply";
+
+static std::string readSysfs(const std::string& path) {
+    std::string value;
+    if (!android::base::ReadFileToString(path, &value)) {
+        return "";
+    }
+    return android::base::Trim(value);
+}
+
+// Type-C role attributes list every role with the current one bracketed,
+// e.g. "[host] device"
+static std::string readTypecRole(const std::string& path) {
+    std::string value = readSysfs(path);
+    size_t open = value.find('[');
+    size_t close = value.find(']', open);
+    if (open == std::string::npos || close == std::string::npos) {
+        return value;
+    }
+    return value.substr(open + 1, close - open - 1);
+}
+
+static std::string findController() {
+    DIR* dir = opendir(UDC_CLASS_PATH);
+    if (!dir) {
+        return "";
+    }
+
+    std::string controller;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_name[0] == '.') continue;
+        controller = entry->d_name;
+        break;
+    }
+
+    closedir(dir);
+    return controller;
+}
+
+static bool isVbusPresent() {
+    DIR* dir = opendir(POWER_SUPPLY_CLASS_PATH);
+    if (!dir) {
+        return false;
+    }
+
+    bool present = false;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_name[0] == '.') continue;
+        std::string supply = std::string(POWER_SUPPLY_CLASS_PATH) + "/" + entry->d_name;
+        if (android::base::StartsWith(readSysfs(supply + "/type"), "USB") &&
+            readSysfs(supply + "/online") == "1") {
+            present = true;
+            break;
+        }
+    }
+
+    closedir(dir);
+    return present;
+}
+
+UsbPortState UsbPortMonitor::readState() {
+    UsbPortState state;
+
+    state.controller = findController();
+    if (!state.controller.empty()) {
+        state.udcState = readSysfs(std::string(UDC_CLASS_PATH) + "/" + state.controller + "/state");
+    }
+
+    if (access(TYPEC_PORT_PATH, F_OK) == 0) {
+        state.hasTypec = true;
+        state.dataRole = readTypecRole(std::string(TYPEC_PORT_PATH) + "/data_role");
+        state.powerRole = readTypecRole(std::string(TYPEC_PORT_PATH) + "/power_role");
+    }
+
+    state.vbusPresent = isVbusPresent();
+    return state;
+}
+
+UsbPortMonitor::UsbPortMonitor() {
+    mState = readState();
+}
+
+UsbPortMonitor::~UsbPortMonitor() {
+    stop();
+}
+
+bool UsbPortMonitor::start(ChangeCallback onChange) {
+    if (mRunning) {
+        return true;
+    }
+
+    mUeventFd = uevent_open_socket(64 * 1024, true);
+    if (mUeventFd < 0) {
+        PLOG(ERROR) << "Failed to open uevent socket";
+        return false;
+    }
+    mWakeFd = eventfd(0, EFD_CLOEXEC);
+    if (mWakeFd < 0) {
+        PLOG(ERROR) << "Failed to create eventfd";
+        close(mUeventFd);
+        mUeventFd = -1;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mState = readState();
+    }
+    openUdcState(mState.controller);
+
+    mOnChange = std::move(onChange);
+    mRunning = true;
+    mThread = std::thread(&UsbPortMonitor::threadFunc, this);
+    LOG(INFO) << "USB port monitor started, controller '" << getController() << "'";
+    return true;
+}
+
+void UsbPortMonitor::stop() {
+    if (!mRunning) {
+        return;
+    }
+    mRunning = false;
+    uint64_t value = 1;
+    if (::write(mWakeFd, &value, sizeof(value)) != sizeof(value)) {
+        PLOG(WARNING) << "Failed to wake USB port monitor";
+    }
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    close(mUeventFd);
+    close(mWakeFd);
+    mUeventFd = -1;
+    mWakeFd = -1;
+    openUdcState("");
+
+    LOG(INFO) << "USB port monitor stopped after " << mEvents << " events, "
+              << mChanges << " state changes";
+}
+
+UsbPortState UsbPortMonitor::getState() const {
+    if (!mRunning) {
+        return readState();
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    return mState;
+}
+
+std::string UsbPortMonitor::getController() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mState.controller;
+}
+
+// The UDC state attribute is updated with sysfs_notify() rather than a
+// uevent. A notification is armed by reading the attribute and delivered as
+// POLLPRI; the fd is kept open across reads for that reason.
+void UsbPortMonitor::openUdcState(const std::string& controller) {
+    if (controller == mUdcStateController && (mUdcStateFd >= 0 || controller.empty())) {
+        return;
+    }
+    if (mUdcStateFd >= 0) {
+        close(mUdcStateFd);
+        mUdcStateFd = -1;
+    }
+    mUdcStateController = controller;
+    if (controller.empty()) {
+        return;
+    }
+
+    std::string path = std::string(UDC_CLASS_PATH) + "/" + controller + "/state";
+    mUdcStateFd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (mUdcStateFd < 0) {
+        PLOG(WARNING) << "Failed to open " << path;
+        return;
+    }
+    char buffer[64];
+    if (read(mUdcStateFd, buffer, sizeof(buffer)) < 0) {
+        PLOG(WARNING) << "Failed to read " << path;
+    }
+}
+
+// True for any event from a subsystem that feeds UsbPortState
+static bool isUsbPortEvent(const char* msg, ssize_t length) {
+    for (const char* p = msg; p < msg + length; p += strlen(p) + 1) {
+        if (!strcmp(p, "SUBSYSTEM=udc") || !strcmp(p, "SUBSYSTEM=typec") ||
+            !strcmp(p, "SUBSYSTEM=power_supply") || !strcmp(p, "SUBSYSTEM=android_usb")) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void UsbPortMonitor::update() {
+    UsbPortState state = readState();
+    openUdcState(state.controller);
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (state == mState) {
+            return;
+        }
+        mState = state;
+    }
+
+    mChanges++;
+    LOG(INFO) << "USB port: controller '" << state.controller << "' state '" << state.udcState
+              << "' data '" << state.dataRole << "' power '" << state.powerRole
+              << "' vbus " << state.vbusPresent;
+    if (mOnChange) {
+        mOnChange(state);
+    }
+}
+
+void UsbPortMonitor::threadFunc() {
+    using Clock = std::chrono::steady_clock;
+
+    char msg[2048];
+    bool pending = false;
+    Clock::time_point deadline;
+
+    while (mRunning) {
+        struct pollfd fds[3] = {
+            {.fd = mUeventFd, .events = POLLIN},
+            {.fd = mWakeFd, .events = POLLIN},
+            {.fd = mUdcStateFd, .events = POLLPRI},
+        };
+
+        int timeoutMs = -1;
+        if (pending) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - Clock::now());
+            timeoutMs = std::max<int>(0, remaining.count());
+        }
+
+        // poll() skips the UDC entry while its fd is -1
+        int ret = poll(fds, 3, timeoutMs);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            PLOG(ERROR) << "USB port monitor poll failed";
+            break;
+        }
+
+        if (ret == 0) {
+            // Window closed; one read covers every event in it
+            pending = false;
+            update();
+            continue;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+
+        bool event = false;
+        if (fds[0].revents & POLLIN) {
+            // Only accepts messages sent by the kernel
+            ssize_t length = uevent_kernel_multicast_recv(mUeventFd, msg, sizeof(msg) - 1);
+            if (length > 0) {
+                msg[length] = '\0';
+                event = isUsbPortEvent(msg, length);
+            }
+        }
+        if (fds[2].revents & POLLPRI) {
+            // Re-arms the notification
+            char buffer[64];
+            if (lseek(mUdcStateFd, 0, SEEK_SET) < 0 ||
+                read(mUdcStateFd, buffer, sizeof(buffer)) < 0) {
+                PLOG(WARNING) << "Failed to re-read UDC state";
+            }
+            event = true;
+        } else if (fds[2].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            // The UDC went away; update() reopens the attribute if it returns
+            close(mUdcStateFd);
+            mUdcStateFd = -1;
+            event = true;
+        }
+
+        if (event) {
+            mEvents++;
+            // The window opens at the first event so a steady stream of
+            // events cannot hold off the update indefinitely
+            if (!pending) {
+                pending = true;
+                deadline = Clock::now() + std::chrono::milliseconds(kDebounceMs);
+            }
+        }
+    }
+}
+
+}  // namespace usb
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,79 @@
+// Copyright (C) 2024 The Android Open Source Project
+// Event-driven USB port state tracking for the Raspberry Pi 5 USB HALs
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace android {
+namespace hardware {
+namespace usb {
+
+// Snapshot of everything the USB HALs report about the port
+struct UsbPortState {
+    std::string controller;     // UDC name, empty if the gadget controller is absent
+    std::string udcState;       // e.g. "not attached", "configured"
+    bool hasTypec = false;
+    std::string dataRole;       // "host" or "device", empty without Type-C
+    std::string powerRole;      // "source" or "sink", empty without Type-C
+    bool vbusPresent = false;   // a USB power supply reports online
+
+    bool operator==(const UsbPortState& other) const {
+        return controller == other.controller && udcState == other.udcState &&
+               hasTypec == other.hasTypec && dataRole == other.dataRole &&
+               powerRole == other.powerRole && vbusPresent == other.vbusPresent;
+    }
+    bool operator!=(const UsbPortState& other) const { return !(*this == other); }
+};
+
+// Watches kernel uevents for the udc, typec, power_supply and android_usb
+// subsystems, plus sysfs_notify() on the UDC state attribute, which changes
+// without a uevent. Events are coalesced over a debounce window, after which
+// the port is re-read once and the callback runs only if the state changed.
+class UsbPortMonitor {
+public:
+    using ChangeCallback = std::function<void(const UsbPortState&)>;
+
+    // Bursts of events (cable insertion, enumeration) settle within this
+    static constexpr int kDebounceMs = 100;
+
+    UsbPortMonitor();
+    ~UsbPortMonitor();
+
+    // onChange runs on the monitor thread with the new state
+    bool start(ChangeCallback onChange);
+    void stop();
+
+    // Last debounced state, or a fresh read if the monitor is not running
+    UsbPortState getState() const;
+    std::string getController() const;
+
+    static UsbPortState readState();
+
+private:
+    void threadFunc();
+    void openUdcState(const std::string& controller);
+    void update();
+
+    mutable std::mutex mLock;
+    UsbPortState mState;
+
+    std::thread mThread;
+    std::atomic<bool> mRunning{false};
+    int mUeventFd = -1;
+    int mWakeFd = -1;
+    int mUdcStateFd = -1;
+    std::string mUdcStateController;
+    ChangeCallback mOnChange;
+
+    uint64_t mEvents = 0;
+    uint64_t mChanges = 0;
+};
+
+}  // namespace usb
+}  // namespace hardware
+}  // namespace android
@@ -20,44 +20,88 @@ namespace usb {
 namespace impl {
 namespace rpi5 {
 
-static constexpr const char* kUdcPath = "/sys/class/udc";
+using ::android::hardware::usb::UsbPortState;
 
 Usb::Usb() {
     LOG(INFO) << "Raspberry Pi 5 USB HAL AIDL initialized";
+
+    // Port changes are pushed to the callback as they happen
+    monitor_.start([this](const UsbPortState& state) { notifyPortStatus(state); });
 }
 
-ndk::ScopedAStatus Usb::enableContaminantPresenceDetection(
-        const std::string& /*portName*/, bool /*enable*/, int64_t /*transactionId*/) {
-    return ndk::ScopedAStatus::ok();
+Usb::~Usb() {
+    monitor_.stop();
 }
 
-ndk::ScopedAStatus Usb::queryPortStatus(int64_t transactionId) {
-    std::vector<PortStatus> ports;
-    
+PortStatus Usb::toPortStatus(const UsbPortState& state) {
     PortStatus status;
     status.portName = "usb0";
-    status.currentDataRole = PortDataRole::HOST;
-    status.currentPowerRole = PortPowerRole::SOURCE;
-    status.currentMode = PortMode::DFP;
     status.canChangeMode = false;
     status.canChangeDataRole = false;
     status.canChangePowerRole = false;
-    status.supportedModes = PortMode::DFP;
-    status.usbDataStatus = UsbDataStatus::ENABLED;
+    status.usbDataStatus = {UsbDataStatus::ENABLED};
     status.powerTransferLimited = false;
-    status.powerBrickStatus = PowerBrickStatus::NOT_CONNECTED;
-    
-    ports.push_back(status);
-    
+    status.powerBrickStatus = state.vbusPresent ?
+            PowerBrickStatus::CONNECTED : PowerBrickStatus::NOT_CONNECTED;
+
+    if (state.hasTypec) {
+        bool host = state.dataRole == "host";
+        status.currentDataRole = host ? PortDataRole::HOST : PortDataRole::DEVICE;
+        status.currentPowerRole = state.powerRole == "source" ?
+                PortPowerRole::SOURCE : PortPowerRole::SINK;
+        status.currentMode = host ? PortMode::DFP : PortMode::UFP;
+        status.canChangeDataRole = true;
+        status.canChangePowerRole = true;
+        status.supportedModes = {PortMode::DRP};
+    } else if (!state.controller.empty()) {
+        // Gadget-capable port without Type-C role control
+        status.currentDataRole = PortDataRole::DEVICE;
+        status.currentPowerRole = PortPowerRole::SINK;
+        status.currentMode = state.udcState == "not attached" ? PortMode::NONE : PortMode::UFP;
+        status.supportedModes = {PortMode::UFP};
+    } else {
+        status.currentDataRole = PortDataRole::HOST;
+        status.currentPowerRole = PortPowerRole::SOURCE;
+        status.currentMode = PortMode::DFP;
+        status.supportedModes = {PortMode::DFP};
+    }
+
+    return status;
+}
+
+void Usb::notifyPortStatus(const UsbPortState& state) {
+    std::lock_guard<std::mutex> lock(callback_lock_);
+    if (!callback_) {
+        return;
+    }
+
+    std::vector<PortStatus> ports = {toPortStatus(state)};
+    ndk::ScopedAStatus ret = callback_->notifyPortStatusChange(ports, Status::SUCCESS);
+    if (!ret.isOk()) {
+        LOG(ERROR) << "Failed to notify port status change: " << ret.getDescription();
+    }
+}
+
+ndk::ScopedAStatus Usb::enableContaminantPresenceDetection(
+        const std::string& /*portName*/, bool /*enable*/, int64_t /*transactionId*/) {
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus Usb::queryPortStatus(int64_t transactionId) {
+    // The monitor keeps the cached state current, so no sysfs reads here
+    notifyPortStatus(monitor_.getState());
+
+    std::lock_guard<std::mutex> lock(callback_lock_);
     if (callback_) {
-        callback_->notifyPortStatusChange(ports, Status::SUCCESS);
+        callback_->notifyQueryPortStatus("usb0", Status::SUCCESS, transactionId);
     }
-    
+
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Usb::setCallback(
         const std::shared_ptr<IUsbCallback>& callback) {
+    std::lock_guard<std::mutex> lock(callback_lock_);
     callback_ = callback;
     return ndk::ScopedAStatus::ok();
 }
@@ -6,6 +6,9 @@
 #pragma once
 
 #include <aidl/android/hardware/usb/BnUsb.h>
+#include <mutex>
+
+#include "UsbPortMonitor.h"
 
 namespace aidl {
 namespace android {
@@ -17,7 +20,8 @@ namespace rpi5 {
 class Usb : public BnUsb {
   public:
     Usb();
-    
+    ~Usb();
+
     ndk::ScopedAStatus enableContaminantPresenceDetection(
             const std::string& portName, bool enable, int64_t transactionId) override;
     ndk::ScopedAStatus queryPortStatus(int64_t transactionId) override;
@@ -43,7 +47,12 @@ class Usb : public BnUsb {
             int64_t transactionId) override;
 
   private:
+    static PortStatus toPortStatus(const ::android::hardware::usb::UsbPortState& state);
+    void notifyPortStatus(const ::android::hardware::usb::UsbPortState& state);
+
+    std::mutex callback_lock_;
     std::shared_ptr<IUsbCallback> callback_;
+    ::android::hardware::usb::UsbPortMonitor monitor_;
 };
 
 }  // namespace rpi5
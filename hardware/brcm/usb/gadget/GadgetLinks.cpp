@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ * Function links of a configfs gadget configuration
+ */
+
+#define LOG_TAG "android.hardware.usb.gadget-service.rpi5"
+
+#include "GadgetLinks.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <unistd.h>
+
+#include <utility>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+namespace gadget {
+namespace impl {
+namespace rpi5 {
+
+using ::android::base::StringPrintf;
+
+ConfigLinks::ConfigLinks(std::string gadgetPath, std::string configPath, size_t maxLinks)
+    : gadget_path_(std::move(gadgetPath)),
+      config_path_(std::move(configPath)),
+      max_links_(maxLinks) {}
+
+std::string ConfigLinks::linkPath(size_t slot) const {
+    return StringPrintf("%s/f%zu", config_path_.c_str(), slot + 1);
+}
+
+std::vector<std::string> ConfigLinks::read() const {
+    std::vector<std::string> links(max_links_);
+    for (size_t i = 0; i < max_links_; i++) {
+        std::string target;
+        if (::android::base::Readlink(linkPath(i), &target)) {
+            links[i] = ::android::base::Basename(target);
+        }
+    }
+    return links;
+}
+
+bool ConfigLinks::relink(const std::vector<std::string>& current,
+                         const std::vector<std::string>& wanted) {
+    auto at = [](const std::vector<std::string>& links, size_t i) -> const std::string& {
+        static const std::string kNone;
+        return i < links.size() ? links[i] : kNone;
+    };
+
+    for (size_t i = 0; i < max_links_; i++) {
+        if (at(current, i).empty() || at(current, i) == at(wanted, i)) {
+            continue;
+        }
+        std::string link = linkPath(i);
+        if (unlink(link.c_str()) != 0) {
+            PLOG(ERROR) << "Failed to remove " << link;
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < max_links_; i++) {
+        if (at(wanted, i).empty() || at(current, i) == at(wanted, i)) {
+            continue;
+        }
+        std::string function = gadget_path_ + "/functions/" + at(wanted, i);
+        if (makeLink(function, linkPath(i)) != 0) {
+            PLOG(ERROR) << "Failed to link " << function;
+            return false;
+        }
+    }
+    return true;
+}
+
+int ConfigLinks::makeLink(const std::string& function, const std::string& link) {
+    return symlink(function.c_str(), link.c_str());
+}
+
+}  // namespace rpi5
+}  // namespace impl
+}  // namespace gadget
+}  // namespace usb
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
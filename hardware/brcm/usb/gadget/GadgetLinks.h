@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ * Function links of a configfs gadget configuration
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+namespace gadget {
+namespace impl {
+namespace rpi5 {
+
+// The links f1..fN of one configuration, each pointing at a function
+// instance under <gadget>/functions.
+//
+// configfs accepts a function only once per configuration and fails a second
+// link to it with EEXIST, even while the first is about to go. A function that
+// moves between slots (mtp_adb to adb moves ffs.adb from f2 to f1) must
+// therefore be unlinked everywhere before anything is linked.
+class ConfigLinks {
+  public:
+    ConfigLinks(std::string gadgetPath, std::string configPath, size_t maxLinks);
+    virtual ~ConfigLinks() = default;
+
+    // Function instance behind each link, or empty where there is none
+    std::vector<std::string> read() const;
+
+    // Turns the links in current into wanted, touching only the slots that
+    // differ: every stale link is removed first, then the new ones are made
+    bool relink(const std::vector<std::string>& current, const std::vector<std::string>& wanted);
+
+  protected:
+    // symlink(2); returns 0 or -1 with errno set
+    virtual int makeLink(const std::string& function, const std::string& link);
+
+    std::string linkPath(size_t slot) const;
+
+  private:
+    std::string gadget_path_;
+    std::string config_path_;
+    size_t max_links_;
+};
+
+}  // namespace rpi5
+}  // namespace impl
+}  // namespace gadget
+}  // namespace usb
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
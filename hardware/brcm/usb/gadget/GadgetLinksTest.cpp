@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ * Function link switching against a configfs-like directory tree
+ */
+
+#include "GadgetLinks.h"
+
+#include <android-base/file.h>
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+namespace gadget {
+namespace impl {
+namespace rpi5 {
+namespace {
+
+constexpr size_t kMaxLinks = 5;
+
+const std::vector<std::string> kFunctions = {"ffs.adb", "mtp.gs0", "ptp.gs1", "rndis.gs4",
+                                             "uvc.gs6"};
+
+// Refuses a second link to a function already linked into the
+// configuration, as configfs does
+class ConfigfsLinks : public ConfigLinks {
+  public:
+    using ConfigLinks::ConfigLinks;
+
+  protected:
+    int makeLink(const std::string& function, const std::string& link) override {
+        for (const std::string& linked : read()) {
+            if (!linked.empty() && linked == ::android::base::Basename(function)) {
+                errno = EEXIST;
+                return -1;
+            }
+        }
+        return ConfigLinks::makeLink(function, link);
+    }
+};
+
+class GadgetLinksTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        ASSERT_EQ(mkdir(functionsPath().c_str(), 0755), 0);
+        for (const std::string& function : kFunctions) {
+            ASSERT_EQ(mkdir((functionsPath() + "/" + function).c_str(), 0755), 0);
+        }
+        ASSERT_EQ(mkdir((std::string(mDir.path) + "/configs").c_str(), 0755), 0);
+        ASSERT_EQ(mkdir(configPath().c_str(), 0755), 0);
+    }
+
+    std::string functionsPath() const { return std::string(mDir.path) + "/functions"; }
+    std::string configPath() const { return std::string(mDir.path) + "/configs/b.1"; }
+
+    // wanted padded out to every slot, as read() reports it
+    static std::vector<std::string> slots(std::vector<std::string> links) {
+        links.resize(kMaxLinks);
+        return links;
+    }
+
+    ::android::base::TemporaryDir mDir;
+    ConfigfsLinks mLinks{mDir.path, configPath(), kMaxLinks};
+};
+
+TEST_F(GadgetLinksTest, LinksIntoEmptyConfig) {
+    ASSERT_TRUE(mLinks.relink(mLinks.read(), {"mtp.gs0", "ffs.adb"}));
+    EXPECT_EQ(mLinks.read(), slots({"mtp.gs0", "ffs.adb"}));
+}
+
+TEST_F(GadgetLinksTest, UnlinksEverything) {
+    ASSERT_TRUE(mLinks.relink(mLinks.read(), {"rndis.gs4", "ffs.adb"}));
+    ASSERT_TRUE(mLinks.relink(mLinks.read(), {}));
+    EXPECT_EQ(mLinks.read(), slots({}));
+}
+
+// mtp_adb -> adb, rndis_adb -> adb and uvc_adb -> adb move ffs.adb from f2 to
+// f1; adb -> mtp_adb moves it back
+TEST_F(GadgetLinksTest, MovesFunctionBetweenSlots) {
+    const std::vector<std::vector<std::string>> sets = {
+            {"ffs.adb"},
+            {"mtp.gs0", "ffs.adb"},
+            {"ffs.adb"},
+            {"rndis.gs4", "ffs.adb"},
+            {"ffs.adb"},
+            {"uvc.gs6", "ffs.adb"},
+            {"ffs.adb"},
+            {"ptp.gs1", "ffs.adb"},
+            {"mtp.gs0", "ffs.adb"},
+    };
+    for (const auto& set : sets) {
+        SCOPED_TRACE(::testing::Message() << set[0] << " x" << set.size());
+        ASSERT_TRUE(mLinks.relink(mLinks.read(), set));
+        EXPECT_EQ(mLinks.read(), slots(set));
+    }
+}
+
+TEST_F(GadgetLinksTest, LeavesUnchangedLinksAlone) {
+    ASSERT_TRUE(mLinks.relink(mLinks.read(), {"mtp.gs0", "ffs.adb"}));
+    const std::string f1 = configPath() + "/f1";
+    struct stat before;
+    ASSERT_EQ(lstat(f1.c_str(), &before), 0);
+
+    ASSERT_TRUE(mLinks.relink(mLinks.read(), {"mtp.gs0"}));
+    struct stat after;
+    ASSERT_EQ(lstat(f1.c_str(), &after), 0);
+    EXPECT_EQ(before.st_ino, after.st_ino);
+    EXPECT_EQ(mLinks.read(), slots({"mtp.gs0"}));
+}
+
+TEST_F(GadgetLinksTest, ReportsFailedLink) {
+    ConfigfsLinks missing(mDir.path, std::string(mDir.path) + "/configs/b.2", kMaxLinks);
+    EXPECT_FALSE(missing.relink(missing.read(), {"ffs.adb"}));
+}
+
+}  // namespace
+}  // namespace rpi5
+}  // namespace impl
+}  // namespace gadget
+}  // namespace usb
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * USB Gadget HAL AIDL Implementation for Raspberry Pi 5
+ *
+ * Every supported function set is described up front, and switching between
+ * them touches as little of configfs as possible: unbind the UDC, swap only
+ * the function links that differ in the one configuration, rewrite the IDs
+ * and bind again. Nothing is torn down or recreated.
+ */
+
+#define LOG_TAG "android.hardware.usb.gadget-service.rpi5"
+
+#include "UsbGadget.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+namespace gadget {
+namespace impl {
+namespace rpi5 {
+
+using ::android::base::StringPrintf;
+
+static constexpr const char* kGadgetPath = "/config/usb_gadget/g1";
+static constexpr const char* kConfigPath = "/config/usb_gadget/g1/configs/b.1";
+static constexpr const char* kUdcClassPath = "/sys/class/udc";
+// adbd writes its descriptors to functionfs before the endpoints appear;
+// binding ffs.adb any earlier fails
+static constexpr const char* kAdbEndpointPath = "/dev/usb-ffs/adb/ep1";
+
+// Links f1..fN in the configuration
+static constexpr size_t kMaxLinks = 5;
+
+static constexpr uint16_t kGoogleVid = 0x18d1;
+
+// Function instances created by init.rpi5.usb.rc
+static constexpr const char* kAdb = "ffs.adb";
+static constexpr const char* kMtp = "mtp.gs0";
+static constexpr const char* kPtp = "ptp.gs1";
+static constexpr const char* kAccessory = "accessory.gs2";
+static constexpr const char* kRndis = "rndis.gs4";
+static constexpr const char* kMidi = "midi.gs5";
+static constexpr const char* kUvc = "uvc.gs6";
+
+// Starts and stops uvc_webcam.rpi5, which needs the function's video node
+// and so can only run while the gadget is bound
+static constexpr const char* kUvcEnabledProp = "vendor.usb.uvc.enabled";
+
+// Product IDs follow the standard Google assignments so hosts pick the
+// right drivers for each set
+static const std::vector<GadgetConfig> kGadgetConfigs = {
+    {GadgetFunction::ADB, "adb", kGoogleVid, 0x4ee7, {kAdb}},
+    {GadgetFunction::MTP, "mtp", kGoogleVid, 0x4ee1, {kMtp}},
+    {GadgetFunction::MTP | GadgetFunction::ADB, "mtp_adb", kGoogleVid, 0x4ee2, {kMtp, kAdb}},
+    {GadgetFunction::RNDIS, "rndis", kGoogleVid, 0x4ee3, {kRndis}},
+    {GadgetFunction::RNDIS | GadgetFunction::ADB, "rndis_adb", kGoogleVid, 0x4ee4, {kRndis, kAdb}},
+    {GadgetFunction::PTP, "ptp", kGoogleVid, 0x4ee5, {kPtp}},
+    {GadgetFunction::PTP | GadgetFunction::ADB, "ptp_adb", kGoogleVid, 0x4ee6, {kPtp, kAdb}},
+    {GadgetFunction::MIDI, "midi", kGoogleVid, 0x4ee8, {kMidi}},
+    {GadgetFunction::MIDI | GadgetFunction::ADB, "midi_adb", kGoogleVid, 0x4ee9, {kMidi, kAdb}},
+    {GadgetFunction::ACCESSORY, "accessory", kGoogleVid, 0x2d00, {kAccessory}},
+    {GadgetFunction::ACCESSORY | GadgetFunction::ADB, "accessory_adb", kGoogleVid, 0x2d01,
+     {kAccessory, kAdb}},
+    {GadgetFunction::UVC, "uvc", kGoogleVid, 0x4eec, {kUvc}},
+    {GadgetFunction::UVC | GadgetFunction::ADB, "uvc_adb", kGoogleVid, 0x4eed, {kUvc, kAdb}},
+};
+
+static std::string findController() {
+    std::string controller = ::android::base::GetProperty("sys.usb.controller", "");
+    if (!controller.empty()) {
+        return controller;
+    }
+
+    DIR* dir = opendir(kUdcClassPath);
+    if (!dir) {
+        return "";
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_name[0] == '.') continue;
+        controller = entry->d_name;
+        break;
+    }
+    closedir(dir);
+    return controller;
+}
+
+static bool writeGadgetFile(const std::string& path, const std::string& value) {
+    if (!::android::base::WriteStringToFile(value, path)) {
+        PLOG(ERROR) << "Failed to write '" << value << "' to " << path;
+        return false;
+    }
+    return true;
+}
+
+static std::string hex4(uint16_t value) {
+    return StringPrintf("0x%04x", value);
+}
+
+UsbGadget::UsbGadget() : links_(kGadgetPath, kConfigPath, kMaxLinks) {
+    controller_ = findController();
+    prepareConfigs();
+
+    // Adopt whatever init or a previous instance left bound
+    std::string udc;
+    if (::android::base::ReadFileToString(std::string(kGadgetPath) + "/UDC", &udc)) {
+        udc = ::android::base::Trim(udc);
+        bound_ = !udc.empty() && udc != "none";
+    }
+
+    LOG(INFO) << "Raspberry Pi 5 USB Gadget HAL AIDL initialized, controller '" << controller_
+              << "', " << configs_.size() << " function sets";
+}
+
+// Keeps only the sets whose function instances exist, so a switch never
+// discovers a missing function halfway through
+void UsbGadget::prepareConfigs() {
+    for (const GadgetConfig& config : kGadgetConfigs) {
+        bool available = true;
+        for (const std::string& link : config.links) {
+            std::string path = std::string(kGadgetPath) + "/functions/" + link;
+            if (access(path.c_str(), F_OK) != 0) {
+                LOG(WARNING) << "Function set '" << config.name << "' unavailable, no " << link;
+                available = false;
+                break;
+            }
+        }
+        if (available) {
+            configs_[config.functions] = config;
+        }
+    }
+}
+
+bool UsbGadget::bind(bool enable) {
+    if (enable == bound_) {
+        return true;
+    }
+    if (enable && controller_.empty()) {
+        LOG(ERROR) << "No USB device controller";
+        return false;
+    }
+    if (!writeGadgetFile(std::string(kGadgetPath) + "/UDC", enable ? controller_ : "none")) {
+        return false;
+    }
+    bound_ = enable;
+    return true;
+}
+
+Status UsbGadget::switchFunctions(int64_t functions, int64_t timeoutMs) {
+    using Clock = std::chrono::steady_clock;
+
+    if (functions == GadgetFunction::NONE) {
+        if (!bind(false)) {
+            return Status::ERROR;
+        }
+        if (current_functions_ & GadgetFunction::UVC) {
+            ::android::base::SetProperty(kUvcEnabledProp, "0");
+        }
+        current_functions_ = functions;
+        return Status::SUCCESS;
+    }
+
+    auto it = configs_.find(functions);
+    if (it == configs_.end()) {
+        LOG(ERROR) << "Unsupported function set " << functions;
+        return Status::CONFIGURATION_NOT_SUPPORTED;
+    }
+    const GadgetConfig& config = it->second;
+
+    // A repeated request must not make the host re-enumerate
+    if (functions == current_functions_ && bound_) {
+        return Status::SUCCESS;
+    }
+
+    Clock::time_point start = Clock::now();
+
+    if (!bind(false)) {
+        return Status::ERROR;
+    }
+    if (current_functions_ & GadgetFunction::UVC) {
+        ::android::base::SetProperty(kUvcEnabledProp, "0");
+    }
+    Clock::time_point unbound = Clock::now();
+
+    if (!links_.relink(links_.read(), config.links) ||
+        !writeGadgetFile(std::string(kGadgetPath) + "/idVendor", hex4(config.vendorId)) ||
+        !writeGadgetFile(std::string(kGadgetPath) + "/idProduct", hex4(config.productId)) ||
+        !writeGadgetFile(std::string(kConfigPath) + "/strings/0x409/configuration", config.name)) {
+        return Status::ERROR;
+    }
+    Clock::time_point relinked = Clock::now();
+
+    if (functions & GadgetFunction::ADB) {
+        Clock::time_point deadline = start + std::chrono::milliseconds(timeoutMs);
+        while (access(kAdbEndpointPath, F_OK) != 0) {
+            if (Clock::now() >= deadline) {
+                LOG(ERROR) << "Timed out waiting for adbd functionfs endpoints";
+                return Status::ERROR;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    Clock::time_point ready = Clock::now();
+
+    if (!bind(true)) {
+        return Status::ERROR;
+    }
+    Clock::time_point end = Clock::now();
+    current_functions_ = functions;
+
+    if (functions & GadgetFunction::UVC) {
+        ::android::base::SetProperty(kUvcEnabledProp, "1");
+    }
+
+    auto us = [](Clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d);
+    };
+    last_switch_ = us(end - start);
+    max_switch_ = std::max(max_switch_, last_switch_);
+    total_switch_ += last_switch_;
+    switches_++;
+
+    LOG(INFO) << "Switched to " << config.name << " in " << last_switch_.count() << " us (unbind "
+              << us(unbound - start).count() << ", relink " << us(relinked - unbound).count()
+              << ", ffs wait " << us(ready - relinked).count() << ", bind "
+              << us(end - ready).count() << ")";
+    return Status::SUCCESS;
+}
+
+ndk::ScopedAStatus UsbGadget::setCurrentUsbFunctions(
+        int64_t functions,
+        const std::shared_ptr<IUsbGadgetCallback>& callback,
+        int64_t timeoutMs,
+        int64_t transactionId) {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    Status status = switchFunctions(functions, timeoutMs);
+    if (callback) {
+        callback->setCurrentUsbFunctionsCb(functions, status, transactionId);
+    }
+
+    if (status != Status::SUCCESS) {
+        return ndk::ScopedAStatus::fromServiceSpecificErrorWithMessage(
+                -1, "Error while setting USB functions");
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus UsbGadget::getCurrentUsbFunctions(
+        const std::shared_ptr<IUsbGadgetCallback>& callback,
+        int64_t transactionId) {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    if (callback) {
+        callback->getCurrentUsbFunctionsCb(
+                current_functions_,
+                bound_ ? Status::FUNCTIONS_APPLIED : Status::FUNCTIONS_NOT_APPLIED,
+                transactionId);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus UsbGadget::getUsbSpeed(
+        const std::shared_ptr<IUsbGadgetCallback>& callback,
+        int64_t transactionId) {
+    std::string speed;
+    ::android::base::ReadFileToString(
+            std::string(kUdcClassPath) + "/" + controller_ + "/current_speed", &speed);
+    speed = ::android::base::Trim(speed);
+
+    UsbSpeed usbSpeed = UsbSpeed::UNKNOWN;
+    if (speed == "low-speed") {
+        usbSpeed = UsbSpeed::LOWSPEED;
+    } else if (speed == "full-speed") {
+        usbSpeed = UsbSpeed::FULLSPEED;
+    } else if (speed == "high-speed") {
+        usbSpeed = UsbSpeed::HIGHSPEED;
+    } else if (speed == "super-speed") {
+        usbSpeed = UsbSpeed::SUPERSPEED;
+    }
+
+    if (callback) {
+        callback->getUsbSpeedCb(usbSpeed, transactionId);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus UsbGadget::reset(
+        const std::shared_ptr<IUsbGadgetCallback>& callback,
+        int64_t transactionId) {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    bool wasBound = bound_;
+    bool ok = bind(false) && (!wasBound || bind(true));
+    if (callback) {
+        callback->resetCb(ok ? Status::SUCCESS : Status::ERROR, transactionId);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+binder_status_t UsbGadget::dump(int fd, const char** /*args*/, uint32_t /*numArgs*/) {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    std::string out = StringPrintf("USB gadget: controller %s, functions 0x%llx, %s\n",
+                                   controller_.c_str(),
+                                   static_cast<unsigned long long>(current_functions_),
+                                   bound_ ? "bound" : "unbound");
+    out += "  function sets:";
+    for (const auto& entry : configs_) {
+        out += " " + entry.second.name;
+    }
+    out += "\n";
+    if (switches_ > 0) {
+        out += StringPrintf("  switches: %u, last %lld us, max %lld us, mean %lld us\n",
+                            switches_,
+                            static_cast<long long>(last_switch_.count()),
+                            static_cast<long long>(max_switch_.count()),
+                            static_cast<long long>(total_switch_.count() / switches_));
+    }
+    ::android::base::WriteStringToFd(out, fd);
+    return STATUS_OK;
+}
+
+}  // namespace rpi5
+}  // namespace impl
+}  // namespace gadget
+}  // namespace usb
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
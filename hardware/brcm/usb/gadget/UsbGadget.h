@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ * USB Gadget HAL AIDL Header
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/usb/gadget/BnUsbGadget.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "GadgetLinks.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+namespace gadget {
+namespace impl {
+namespace rpi5 {
+
+// One supported function set. Function instances are created once at boot by
+// init.rpi5.usb.rc; switching only relinks them into the single configuration.
+struct GadgetConfig {
+    int64_t functions;
+    std::string name;                   // configuration string
+    uint16_t vendorId;
+    uint16_t productId;
+    std::vector<std::string> links;     // function instances, in link order
+};
+
+class UsbGadget : public BnUsbGadget {
+  public:
+    UsbGadget();
+
+    ndk::ScopedAStatus setCurrentUsbFunctions(
+            int64_t functions,
+            const std::shared_ptr<IUsbGadgetCallback>& callback,
+            int64_t timeoutMs,
+            int64_t transactionId) override;
+    ndk::ScopedAStatus getCurrentUsbFunctions(
+            const std::shared_ptr<IUsbGadgetCallback>& callback,
+            int64_t transactionId) override;
+    ndk::ScopedAStatus getUsbSpeed(
+            const std::shared_ptr<IUsbGadgetCallback>& callback,
+            int64_t transactionId) override;
+    ndk::ScopedAStatus reset(
+            const std::shared_ptr<IUsbGadgetCallback>& callback,
+            int64_t transactionId) override;
+
+    binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
+
+  private:
+    void prepareConfigs();
+    Status switchFunctions(int64_t functions, int64_t timeoutMs);
+    bool bind(bool enable);
+
+    std::mutex lock_;
+    std::string controller_;
+    std::map<int64_t, GadgetConfig> configs_;
+    ConfigLinks links_;
+    int64_t current_functions_ = GadgetFunction::NONE;
+    bool bound_ = false;
+
+    // Switch timing, reported by dump()
+    uint32_t switches_ = 0;
+    std::chrono::microseconds last_switch_{0};
+    std::chrono::microseconds max_switch_{0};
+    std::chrono::microseconds total_switch_{0};
+};
+
+}  // namespace rpi5
+}  // namespace impl
+}  // namespace gadget
+}  // namespace usb
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
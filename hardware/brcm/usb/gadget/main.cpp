@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ * USB Gadget HAL AIDL Service Main
+ */
+
+#define LOG_TAG "android.hardware.usb.gadget-service.rpi5"
+
+#include "UsbGadget.h"
+
+#include <android-base/logging.h>
+#include <android/binder_manager.h>
+#include <android/binder_process.h>
+
+using aidl::android::hardware::usb::gadget::impl::rpi5::UsbGadget;
+
+int main() {
+    ABinderProcess_setThreadPoolMaxThreadCount(0);
+
+    std::shared_ptr<UsbGadget> gadget = ndk::SharedRefBase::make<UsbGadget>();
+
+    const std::string instance = std::string() + UsbGadget::descriptor + "/default";
+    binder_status_t status = AServiceManager_addService(
+            gadget->asBinder().get(), instance.c_str());
+    CHECK_EQ(status, STATUS_OK);
+
+    LOG(INFO) << "Raspberry Pi 5 USB Gadget HAL AIDL Service started";
+
+    ABinderProcess_joinThreadPool();
+    return EXIT_FAILURE;
+}